@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+/** \file polycap-mpi.h
+ * \brief API for distributing polycap simulations over MPI processes
+ *
+ * This header is only available if polycap was built with MPI support, and is not included by polycap.h.
+ * Applications using it must initialize MPI themselves before calling any of its functions.
+ */
+
+#ifndef POLYCAP_MPI_H
+#define POLYCAP_MPI_H
+
+#include <mpi.h>
+#include "polycap-source.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Obtain the transmission efficiencies of a simulation that is distributed over all processes of an MPI communicator
+ *
+ * This function must be called by all processes of \c comm with the same arguments.
+ * The \c n_photons photons are divided into batches of about \c batch_size photons, which the process with rank 0 hands out to the other processes as soon as these have finished their previous batch.
+ * The sums and counters of all processes are reduced, and the photon events are collected on rank 0 in increasing batch order.
+ * As the random numbers of each photon are derived from a common seed and the photon index, the results equal those of polycap_source_get_transmission_efficiencies() with the same seed,
+ * regardless of the amount of processes and the batch size. If no seed was set with polycap_source_set_seed(), rank 0 picks a random seed and shares it with the other processes.
+ * If \c comm contains a single process, it simulates all batches by itself.
+ *
+ * \param source a polycap_source
+ * \param comm the MPI communicator of the processes that take part in the simulation
+ * \param max_threads the amount of threads to use in each process. Set to -1 to use the maximum available amount of threads.
+ * \param n_photons the amount of photons to simulate that reach the polycapillary end, over all processes together
+ * \param batch_size the amount of photons in a batch
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param progress_monitor a polycap_progress_monitor, used on rank 0 only, or \c NULL
+ * \param efficiencies a variable to contain the new polycap_transmission_efficiencies on rank 0. It is set to \c NULL on the other ranks.
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded on all processes
+ */
+POLYCAP_EXTERN
+bool polycap_source_get_transmission_efficiencies_mpi(
+	polycap_source *source,
+	MPI_Comm comm,
+	int max_threads,
+	int n_photons,
+	int batch_size,
+	bool leak_calc,
+	polycap_progress_monitor *progress_monitor,
+	polycap_transmission_efficiencies **efficiencies,
+	polycap_error **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
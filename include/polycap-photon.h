@@ -97,6 +97,91 @@ int polycap_photon_launch(
 	bool leak_calc,
 	polycap_error **error);
 
+/** Simulate a single photon trajectory for a given polycap_description, storing the transmission efficiencies in a caller-owned array.
+ *
+ * Contrary to polycap_photon_launch(), the energies, weights, attenuation coefficients and scattering factors of the photon are kept after the launch, and are reused when the photon is launched again with the same energies. Combined with polycap_photon_set_start() this allows a single polycap_photon to be relaunched without any memory allocation. The kept memory is released by polycap_photon_free().
+ *
+ * \param photon a polycap_photon
+ * \param n_energies the amount of discrete energies for which the transmission efficiency will be calculated
+ * \param energies an array containing the discrete energies for which the transmission efficiency will be calculated [keV]
+ * \param weights an array of \c n_energies that will contain the transmission efficiency values
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns an int with the same meaning as the return value of polycap_photon_launch()
+ */
+POLYCAP_EXTERN
+int polycap_photon_launch_with_buffers(
+	polycap_photon *photon,
+	size_t n_energies,
+	double *energies,
+	double *weights,
+	bool leak_calc,
+	polycap_error **error);
+
+/** Set a new initial position, direction and electric field vector for an existing polycap_photon, so that it can be launched again.
+ *
+ * \param photon a polycap_photon
+ * \param start_coords photon start coordinates
+ * \param start_direction photon start direction
+ * \param start_electric_vector photon start electric field vector
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true if succesful, false on error
+ */
+POLYCAP_EXTERN
+bool polycap_photon_set_start(
+	polycap_photon *photon,
+	polycap_vector3 start_coords,
+	polycap_vector3 start_direction,
+	polycap_vector3 start_electric_vector,
+	polycap_error **error);
+
+/** Simulate an array of photon trajectories for a given polycap_description.
+ *
+ * All output arrays are owned by the caller and, unless \c leak_calc is true, no memory is allocated per photon. The photons are distributed over \c max_threads OpenMP threads, each of which relaunches a single polycap_photon with polycap_photon_launch_with_buffers().
+ * Leak events are not retained: \c leak_calc only changes the returned \c launch_status and \c weights (photons that hit or start within the capillary walls are traced through the glass instead of being discarded).
+ * Every photon nevertheless still computes and allocates its full list of leak events, which is discarded before the next photon is launched, so \c leak_calc carries the same per-event cost as in polycap_photon_launch().
+ * Any of the output arrays, except \c weights, may be \c NULL if the corresponding data is not required.
+ * Photons with launch status -1, including those skipped after an allocation failure in another photon, get a \c weights row of 0, while their entries in the other output arrays are left untouched.
+ *
+ * \param description a polycap_description
+ * \param max_threads the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+ * \param n_photons the amount of photons to simulate
+ * \param start_coords an array of \c n_photons photon start coordinates
+ * \param start_directions an array of \c n_photons photon start directions
+ * \param start_electric_vectors an array of \c n_photons photon start electric field vectors
+ * \param n_energies the amount of discrete energies for which the transmission efficiency will be calculated
+ * \param energies an array containing the discrete energies for which the transmission efficiency will be calculated [keV]
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param launch_status an array of \c n_photons that will contain the polycap_photon_launch() return value of each photon, or \c NULL
+ * \param exit_coords an array of \c n_photons that will contain the photon exit coordinates, or \c NULL
+ * \param exit_directions an array of \c n_photons that will contain the photon exit directions, or \c NULL
+ * \param exit_electric_vectors an array of \c n_photons that will contain the photon exit electric field vectors, or \c NULL
+ * \param n_refl an array of \c n_photons that will contain the amount of reflections of each photon, or \c NULL
+ * \param d_travel an array of \c n_photons that will contain the distance travelled by each photon within the capillary walls [cm], or \c NULL
+ * \param weights an array of \c n_photons * \c n_energies (row-major, one row per photon) that will contain the transmission efficiency values. Rows of photons that were not absorbed or transmitted are set to 0.
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true if succesful, false on error
+ */
+POLYCAP_EXTERN
+bool polycap_photon_launch_batch(
+	polycap_description *description,
+	int max_threads,
+	size_t n_photons,
+	polycap_vector3 *start_coords,
+	polycap_vector3 *start_directions,
+	polycap_vector3 *start_electric_vectors,
+	size_t n_energies,
+	double *energies,
+	bool leak_calc,
+	int *launch_status,
+	polycap_vector3 *exit_coords,
+	polycap_vector3 *exit_directions,
+	polycap_vector3 *exit_electric_vectors,
+	int64_t *n_refl,
+	double *d_travel,
+	double *weights,
+	polycap_error **error);
+
 /** Retrieve start coordinates from a polycap_photon
  * 
  * \param photon a polycap_photon
@@ -97,6 +97,62 @@ polycap_profile* polycap_profile_new_from_file(
 	const char *external_shape_file,
 	polycap_error **error);
 
+/** Create a new profile from a binary profile file written by polycap_profile_write_binary().
+ *
+ * Rather than being read, the file is memory-mapped read-only, so that processes loading the same file share its memory.
+ * The file must not be modified or removed while profiles created from it, or descriptions created with these profiles, are in use.
+ *
+ * \param filename filename of a binary profile file. Suggested extension is *.pcp
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns a new polycap_profile, or \c NULL if an error occurred
+ */
+POLYCAP_EXTERN
+polycap_profile* polycap_profile_new_from_binary_file(const char *filename, polycap_error **error);
+
+/** Write a profile to a binary profile file, which can be loaded with polycap_profile_new_from_binary_file().
+ *
+ * The file contains a versioned header, followed by the Z-coordinates, single capillary radii and external radii as contiguous arrays of doubles.
+ * It is written in the native byte order of the machine, and is therefore not portable between machines of different endianness.
+ * Combined with polycap_profile_new_from_file(), this converts the ASCII files of the old polycap program format to a binary profile file.
+ *
+ * \param profile a polycap_profile
+ * \param filename the binary profile file to write. Suggested extension is *.pcp
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_profile_write_binary(polycap_profile *profile, const char *filename, polycap_error **error);
+
+/** Compact a profile by merging consecutive segments where its shape is (nearly) straight.
+ *
+ * Profile points are removed for as long as the linear interpolation between the remaining neighbouring points reproduces their single capillary and external radii within a relative \c tolerance.
+ * The remaining Z-coordinates are no longer equidistant. As photons are traced segment by segment, fewer segments speed up the simulation, whereas the shape deviates at most \c tolerance from the original one.
+ * The maximum amount of reflections per capillary is based on the amount of points before compaction, and is therefore not affected.
+ * A \c tolerance of 0 only removes points that lie exactly on a straight line.
+ *
+ * \param profile a polycap_profile, with strictly increasing Z-coordinates
+ * \param tolerance the maximum relative deviation of the single capillary and external radii at the removed points. Should be greater than or equal to 0.
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_profile_compact(polycap_profile *profile, double tolerance, polycap_error **error);
+
+/** Trace photons on the closed-form shape of a profile, rather than segment by segment.
+ *
+ * Profiles created with polycap_profile_new() keep the closed-form description of their conical, paraboloidal or ellipsoidal shape.
+ * With analytic tracing enabled, the intersection of a photon path with the capillary wall is calculated directly on this shape, as the root of a polynomial, instead of on the linear segments between the profile points.
+ * This removes the error of approximating curved profiles by segments, at the cost of simulation results that differ slightly from those obtained with segments.
+ * By default, analytic tracing is disabled. It must be enabled before the profile is used to create a polycap_description.
+ *
+ * \param profile a polycap_profile
+ * \param enable \c true to trace photons on the closed-form shape, \c false to trace them segment by segment
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded. Enabling analytic tracing fails for profiles that were not created with polycap_profile_new().
+ */
+POLYCAP_EXTERN
+bool polycap_profile_set_analytic_tracing(polycap_profile *profile, bool enable, polycap_error **error);
+
 /** Checks a profile for inconsistencies between inner capillary coordinates and the external radius.
  *
  * \param profile polycap_profile containing outer polycapillary and single capillary shape coordinates
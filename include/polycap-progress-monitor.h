@@ -12,17 +12,55 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * */
 
+/** \file polycap-progress-monitor.h
+ * \brief API for dealing with polycap_progress_monitor
+ *
+ * This header contains all functions and definitions that are necessary to create and free a polycap_progress_monitor, which can be used to follow the progress of polycap_source_get_transmission_efficiencies().
+ *
+ */
+
 #ifndef POLYCAP_PROGRESS_MONITOR_H
 #define POLYCAP_PROGRESS_MONITOR_H
 
+#include "polycap-error.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // inspired by Eclipse's IProgressMonitor class
 struct _polycap_progress_monitor;
+/** Struct containing a progress monitor
+ *
+ * When this struct is no longer required, it is the user's responsability to free the memory using polycap_progress_monitor_free().
+ */
 typedef struct _polycap_progress_monitor polycap_progress_monitor;
 
+/** Callback that is invoked by a polycap_progress_monitor
+ *
+ * The callback is always invoked from a single thread at a time, but this is not necessarily the thread that started the simulation.
+ *
+ * \param value the fraction of the simulation that has been completed, between 0 and 1
+ * \param user_data the user_data pointer that was passed to polycap_progress_monitor_new()
+ */
+typedef void (*polycap_progress_monitor_set_value_func)(double value, void *user_data);
+
+/** Create a new polycap_progress_monitor
+ *
+ * \param set_value a callback that will be invoked whenever progress is made, not \c NULL
+ * \param user_data a pointer that will be passed to \a set_value, or \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns a new polycap_progress_monitor, or \c NULL if an error occurred
+ */
+POLYCAP_EXTERN
+polycap_progress_monitor* polycap_progress_monitor_new(polycap_progress_monitor_set_value_func set_value, void *user_data, polycap_error **error);
+
+/** free a polycap_progress_monitor struct
+ *
+ * \param progress_monitor a polycap_progress_monitor
+ */
+POLYCAP_EXTERN
+void polycap_progress_monitor_free(polycap_progress_monitor *progress_monitor);
 
 #ifdef __cplusplus
 }
@@ -40,6 +40,19 @@ struct _polycap_source;
  */
 typedef struct _polycap_source                      polycap_source;
 
+/** Struct containing the source and surface roughness parameters of a single point of a parameter sweep
+ *
+ * See polycap_source_new() and polycap_description_new() for the meaning of the parameters.
+ */
+typedef struct {
+  double d_source; ///< the distance between the source and polycapillary optic entrance window along the central axis [cm]
+  double src_x; ///< the source radius along the X (horizontal) direction [cm]
+  double src_y; ///< the source radius along the Y (vertical) direction [cm]
+  double src_shiftx; ///< lateral shift of the source centre along the X (horizontal) direction [cm]
+  double src_shifty; ///< lateral shift of the source centre along the Y (vertical) direction [cm]
+  double sig_rough; ///< the surface roughness of the capillaries [Angstrom]
+} polycap_sweep_point;
+
 /** Creates a new polycap_source by providing all its properties
  *
  * \param description a polycap_description
@@ -90,6 +103,10 @@ POLYCAP_EXTERN
 polycap_photon* polycap_source_get_photon(polycap_source *source, polycap_rng *rng, polycap_error **error);
 
 /** Load a polycap_description from given ASCII *.inp input file correponding to the old polycap program format.
+ *
+ * Besides the profile types 0 (conical), 1 (paraboloidal) and 2 (ellipsoidal), followed by the profile parameters,
+ * the profile type may be 3, followed by a line with a binary profile file (see polycap_profile_new_from_binary_file()),
+ * or any other value, followed by three lines with the single capillary, central axis and external shape ASCII files (see polycap_profile_new_from_file()).
  *
  * \param filename directory path to an ASCII input file. Default extension *.inp.
  * \param error a pointer to a \c NULL polycap_error, or \c NULL
@@ -105,7 +122,7 @@ polycap_source* polycap_source_new_from_file(const char *filename, polycap_error
  * \param source a polycap_source
  * \param max_threads the amount of threads to use. Set to -1 to use the maximum available amount of threads.
  * \param n_photons the amount of photons to simulate that reach the polycapillary end
- * \param progress_monitor a polycap_progress_monitor
+ * \param progress_monitor a polycap_progress_monitor that will be notified of the progress of the simulation, or \c NULL
  * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
  * \param error a pointer to a \c NULL polycap_error, or \c NULL
  * \returns a new polycap_transmission_efficiencies, or \c NULL if an error occurred
@@ -119,6 +136,35 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 	polycap_progress_monitor *progress_monitor,
 	polycap_error **error);
 
+/** Obtain the transmission efficiencies for a given array of energies, and a full polycap_description, simulating photons until the requested statistical uncertainty is reached.
+ *
+ * The running mean and variance of the photon weights are tracked per energy, and no new photons are launched once the relative standard error of the efficiencies at all selected energies is below \c target_rel_error, or once \c max_photons photons reached the polycapillary end.
+ * The achieved uncertainties can be obtained with polycap_transmission_efficiencies_get_uncertainties().
+ * Efficiencies are allocated by this function, and need to be freed with polycap_transmission_efficiencies_free().
+ *
+ * \param source a polycap_source
+ * \param max_threads the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+ * \param max_photons the maximal amount of photons to simulate that reach the polycapillary end
+ * \param target_rel_error the relative standard error of the efficiencies at which the simulation stops. Must be greater than 0.
+ * \param n_selected the amount of energy indices in \c selected, or 0 to require \c target_rel_error to be reached at all energies
+ * \param selected an array of indices into the source energies at which \c target_rel_error must be reached, or \c NULL if \c n_selected is 0
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param progress_monitor a polycap_progress_monitor that will be notified of the progress of the simulation, or \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns a new polycap_transmission_efficiencies, or \c NULL if an error occurred
+ */
+POLYCAP_EXTERN
+polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_converged(
+	polycap_source *source,
+	int max_threads,
+	int max_photons,
+	double target_rel_error,
+	size_t n_selected,
+	const size_t *selected,
+	bool leak_calc,
+	polycap_progress_monitor *progress_monitor,
+	polycap_error **error);
+
 /** Create new polycap_description from a polycap_source
  *
  * \param source a polycap_source
@@ -127,6 +173,140 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 POLYCAP_EXTERN
 const polycap_description* polycap_source_get_description(polycap_source *source);
 
+/** Record the reflections of the transmitted photons in subsequent simulations
+ *
+ * The recorded reflections do not depend on the photon energy or the capillary material,
+ * allowing polycap_transmission_efficiencies_reweight() to obtain the efficiencies for other energies or materials without tracing new photons.
+ * Recording is disabled by default, as it requires storing every reflection of every transmitted photon.
+ *
+ * \param source a polycap_source
+ * \param record_histories True: record the reflections; False: do not record the reflections
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_source_set_record_histories(polycap_source *source, bool record_histories, polycap_error **error);
+
+/** Solve the capillary wall intersections in single precision in subsequent simulations
+ *
+ * The quadratic equation that yields the intersection of a photon path with a capillary wall segment is solved for each segment the photon passes, making it the innermost loop of the simulation.
+ * In single precision mode this equation is solved in float, while the photon coordinates, directions and weights, and therefore the transmission efficiencies and images, remain in double precision.
+ * The results differ slightly from those obtained in double precision, which is the default.
+ *
+ * \param source a polycap_source
+ * \param single_precision True: solve the intersections in single precision; False: solve them in double precision
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_source_set_single_precision(polycap_source *source, bool single_precision, polycap_error **error);
+
+/** Use a fixed seed for the random numbers of subsequent simulations
+ *
+ * The random numbers of the n-th photon are derived from \c seed and n, independent of the thread that simulates it.
+ * Simulations with the same seed are therefore reproducible (apart from rounding differences, and the distribution of leaks when leak_calc is enabled),
+ * while simulations of sources that only differ in their parameters use common random numbers.
+ *
+ * \param source a polycap_source
+ * \param seed the seed
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_source_set_seed(polycap_source *source, unsigned long int seed, polycap_error **error);
+
+/** Obtain the transmission efficiencies for a grid of source and surface roughness parameters.
+ *
+ * All grid points use the profile, material, divergence, polarisation and energies of \c source, which are not validated again.
+ * The attenuation coefficients and scattering factors of the material are therefore calculated only once, and shared by the photons of all grid points.
+ * They also use common random numbers, derived from the seed of \c source if one was set with polycap_source_set_seed(), or a random seed otherwise,
+ * so that the differences between grid points have a much lower variance than those between independent simulations.
+ * If there are at least as many grid points as threads, the grid points are simulated concurrently using a single thread each,
+ * otherwise they are simulated one after another using all threads. The returned arrays should be freed by the user with polycap_free() or free().
+ *
+ * \param source a polycap_source
+ * \param n_points the amount of grid points
+ * \param points an array of \c n_points grid points
+ * \param max_threads the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+ * \param n_photons the amount of photons to simulate that reach the polycapillary end, for each grid point
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param progress_monitor a polycap_progress_monitor that will be notified of the fraction of completed grid points, or \c NULL
+ * \param efficiencies_arr a variable to contain the transmission efficiencies of all grid points (\c n_points x \c n_energies elements)
+ * \param std_errors_arr a variable to contain the standard errors of the transmission efficiencies (\c n_points x \c n_energies elements), or \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_source_sweep(polycap_source *source,
+	size_t n_points,
+	const polycap_sweep_point *points,
+	int max_threads,
+	int n_photons,
+	bool leak_calc,
+	polycap_progress_monitor *progress_monitor,
+	double **efficiencies_arr,
+	double **std_errors_arr,
+	polycap_error **error);
+
+/** Write the results of polycap_source_sweep() to a single hdf5 file
+ *
+ * \param source the polycap_source that was passed to polycap_source_sweep()
+ * \param n_points the amount of grid points
+ * \param points an array of \c n_points grid points
+ * \param efficiencies the transmission efficiencies obtained with polycap_source_sweep()
+ * \param std_errors the standard errors of the transmission efficiencies obtained with polycap_source_sweep(), or \c NULL
+ * \param filename a hdf5 file new, not \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns \c true or \c false, depending on whether the function succeeded
+ */
+POLYCAP_EXTERN
+bool polycap_source_sweep_write_hdf5(polycap_source *source, size_t n_points, const polycap_sweep_point *points, double *efficiencies, double *std_errors, const char *filename, polycap_error **error);
+
+/** Obtain the partial transmission efficiencies of a single shard of a simulation that is split over several processes.
+ *
+ * The \c n_photons photons of the simulation are divided over \c n_shards shards, each tracing a disjoint range of photons.
+ * As the random numbers of each photon are derived from the seed of \c source and the photon index, a seed must be set with polycap_source_set_seed(),
+ * and all shards must use the same seed and \c n_photons.
+ * polycap_transmission_efficiencies_write_hdf5() additionally writes the raw sums and counters of a shard, as well as the z components of its photon directions and electric vectors,
+ * which allows polycap_transmission_efficiencies_merge() to combine the shard files into the results of the complete simulation.
+ *
+ * \param source a polycap_source
+ * \param max_threads the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+ * \param n_photons the amount of photons to simulate that reach the polycapillary end, over all shards together
+ * \param shard_index the index of this shard, from 0 up to \c n_shards - 1
+ * \param n_shards the amount of shards the simulation is split in
+ * \param leak_calc True: perform leak calculation; False: do not perform leak calculation
+ * \param progress_monitor a polycap_progress_monitor, or \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns a new polycap_transmission_efficiencies, or \c NULL if an error occurred
+ */
+POLYCAP_EXTERN
+polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_shard(
+	polycap_source *source,
+	int max_threads,
+	int n_photons,
+	int shard_index,
+	int n_shards,
+	bool leak_calc,
+	polycap_progress_monitor *progress_monitor,
+	polycap_error **error);
+
+/** Merge the hdf5 files of all shards of a simulation into a single polycap_transmission_efficiencies
+ *
+ * The shard files must have been written by polycap_transmission_efficiencies_write_hdf5() for the results of polycap_source_get_transmission_efficiencies_shard().
+ * The merged efficiencies and standard errors are computed from the raw sums and counters of the shards,
+ * and the photon events are concatenated in order of the shard index, so that polycap_transmission_efficiencies_write_hdf5() produces a file in the format of a single simulation.
+ * Reflection histories are not stored in the shard files, and are therefore not available for reweighting the merged results.
+ *
+ * \param source a polycap_source created from the same input as the shards, used for the energies and the simulation parameters written to the merged file
+ * \param n_files the amount of shard files, which must equal the amount of shards
+ * \param filenames the hdf5 shard files, in any order
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns a new polycap_transmission_efficiencies, or \c NULL if an error occurred
+ */
+POLYCAP_EXTERN
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_merge(polycap_source *source, size_t n_files, const char **filenames, polycap_error **error);
+
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,7 @@
 #define POLYCAP_TRANSEFF_H
 
 #include "polycap-error.h"
+#include "polycap-description.h"
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -65,6 +66,67 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 POLYCAP_EXTERN
 bool polycap_transmission_efficiencies_get_data(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **energies_arr, double **efficiencies_arr, polycap_error **error);
 
+/** Extract the statistical uncertainties of the transmission efficiencies from a polycap_transmission_efficiencies struct. The returned array should be freed by the user with polycap_free() or free().
+ *
+ * The uncertainties are given as the relative standard error of the efficiency at each energy, or NaN where the efficiency is 0.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_energies a variable to contain the amount of simulated photon energies
+ * \param uncertainties_arr a variable to contain the relative standard errors of the transmission efficiencies
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_uncertainties(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **uncertainties_arr, polycap_error **error);
+
+/** Extract the standard errors of the transmission efficiencies from a polycap_transmission_efficiencies struct. The returned array should be freed by the user with polycap_free() or free().
+ *
+ * The standard errors are estimated from the variance of the weights of all simulated photons, and have the same units as the efficiencies.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_energies a variable to contain the amount of simulated photon energies
+ * \param std_errors_arr a variable to contain the standard errors of the transmission efficiencies
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_std_errors(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **std_errors_arr, polycap_error **error);
+
+/** Recompute the transmission efficiencies for a new array of energies and/or capillary material, without tracing new photons. The returned arrays should be freed by the user with polycap_free() or free().
+ *
+ * Requires the reflections of the transmitted photons to have been recorded with polycap_source_set_record_histories() enabled.
+ * The weights of these photons are recomputed from their recorded reflections, as the photon paths do not depend on the energy or the material.
+ * Leaked photons are not included, and photons that were discarded during the simulation because their weights dropped below 1e-4 at all simulated energies are missing,
+ * so the energies should not extend far beyond those that were simulated.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param description a polycap_description containing the new capillary material, or \c NULL to use the material of the simulation
+ * \param n_energies the amount of elements in \c energies
+ * \param energies an array containing the new photon energies in keV
+ * \param weights_arr a variable to contain the new weights of the transmitted photons (\c n_energies per photon, in the order of polycap_transmission_efficiencies_get_exit_data()), or \c NULL
+ * \param efficiencies_arr a variable to contain the transmission efficiencies at \c energies, or \c NULL
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_reweight(polycap_transmission_efficiencies *efficiencies, polycap_description *description, size_t n_energies, double *energies, double **weights_arr, double **efficiencies_arr, polycap_error **error);
+
+/** Obtain the transmission efficiencies of several capillary materials at the simulated energies, without tracing new photons. The returned array should be freed by the user with polycap_free() or free().
+ *
+ * Requires the reflections of the transmitted photons to have been recorded with polycap_source_set_record_histories() enabled.
+ * Each recorded reflection is evaluated for all materials in a single pass, which is considerably faster than calling polycap_transmission_efficiencies_reweight() for each of them.
+ * Only the composition, density and surface roughness of the variants are used, their profiles are ignored. The same limitations as for polycap_transmission_efficiencies_reweight() apply.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_variants the amount of elements in \c variants
+ * \param variants an array of polycap_description structs, each containing a capillary material
+ * \param efficiencies_arr a variable to contain the transmission efficiencies, with the efficiencies of each variant at all simulated energies stored consecutively (\c n_variants x \c n_energies elements)
+ * \param error a pointer to a \c NULL polycap_error, or \c NULL
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_reweight_materials(polycap_transmission_efficiencies *efficiencies, size_t n_variants, polycap_description **variants, double **efficiencies_arr, polycap_error **error);
+
 /** Extract extleak data from a polycap_transmission_efficiencies struct.
  *
  * \param efficiencies a polycap_transmission_efficiencies struct
@@ -119,6 +181,86 @@ bool polycap_transmission_efficiencies_get_start_data(polycap_transmission_effic
 POLYCAP_EXTERN
 bool polycap_transmission_efficiencies_get_exit_data(polycap_transmission_efficiencies *efficiencies, int64_t *n_exit, polycap_vector3 **exit_coords, polycap_vector3 **exit_direction, polycap_vector3 **exit_elecv, int64_t **n_refl, double **d_travel, size_t *n_energies, double ***exit_weights, polycap_error **error);
 
+/** Get direct access to the photon start data stored within a polycap_transmission_efficiencies struct.
+ *
+ * Contrary to polycap_transmission_efficiencies_get_start_data(), no memory is allocated and no data is copied: the returned arrays belong to \a efficiencies and remain valid until it is freed with polycap_transmission_efficiencies_free(). They should not be modified or freed by the caller.
+ * Vector quantities are stored per component: the x, y and z components of event \c i are found at indices \c i, \c i+stride and \c i+2*stride respectively.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_start a int64_t pointer that will contain the amount of started events
+ * \param n_exit a int64_t pointer that will contain the amount of returned start events, that are also transmitted through the optic
+ * \param stride a int64_t pointer that will contain the distance between the vector components in the returned arrays
+ * \param start_coords a pointer that will refer to the event start coordinates
+ * \param start_direction a pointer that will refer to the event start direction
+ * \param start_elecv a pointer that will refer to the event start electric vector
+ * \param src_start_coords a pointer that will refer to the event source start coordinates. Z value equals 0.
+ * \param error a polycap_error
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_start_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_start, int64_t *n_exit, int64_t *stride, const double **start_coords, const double **start_direction, const double **start_elecv, const double **src_start_coords, polycap_error **error);
+
+/** Get direct access to the photon exit data stored within a polycap_transmission_efficiencies struct.
+ *
+ * Contrary to polycap_transmission_efficiencies_get_exit_data(), no memory is allocated and no data is copied: the returned arrays belong to \a efficiencies and remain valid until it is freed with polycap_transmission_efficiencies_free(). They should not be modified or freed by the caller.
+ * Vector quantities are stored per component: the x, y and z components of event \c i are found at indices \c i, \c i+stride and \c i+2*stride respectively.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_exit a int64_t pointer that will contain the amount of returned exit events
+ * \param stride a int64_t pointer that will contain the distance between the vector components in the returned arrays
+ * \param exit_coords a pointer that will refer to the event exit coordinates
+ * \param exit_direction a pointer that will refer to the event exit direction
+ * \param exit_elecv a pointer that will refer to the event exit electric vector
+ * \param n_refl a pointer that will refer to the amount of internal reflections of each event
+ * \param d_travel a pointer that will refer to the traveled distance within the optic of each event [cm]
+ * \param n_energies a size_t to contain the amount of simulated energies
+ * \param exit_weights a pointer that will refer to the exit efficiency weights, with the weight of event \c i at energy \c j found at index \c i*n_energies+j
+ * \param error a polycap_error
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_exit_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_exit, int64_t *stride, const double **exit_coords, const double **exit_direction, const double **exit_elecv, const int64_t **n_refl, const double **d_travel, size_t *n_energies, const double **exit_weights, polycap_error **error);
+
+/** Get direct access to the extleak data stored within a polycap_transmission_efficiencies struct.
+ *
+ * Contrary to polycap_transmission_efficiencies_get_extleak_data(), no memory is allocated and no data is copied: the returned arrays belong to \a efficiencies and remain valid until it is freed with polycap_transmission_efficiencies_free(). They should not be modified or freed by the caller.
+ * Vector quantities are stored per component: the x, y and z components of leak event \c i are found at indices \c i, \c i+n_leaks and \c i+2*n_leaks respectively.
+ * If no exterior leak events were recorded, \a n_leaks is set to 0 and the returned arrays should not be accessed.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_leaks a int64_t pointer that will contain the amount of extleak events
+ * \param coords a pointer that will refer to the leak event coordinates
+ * \param direction a pointer that will refer to the leak event directions
+ * \param elecv a pointer that will refer to the leak event electric vectors
+ * \param n_refl a pointer that will refer to the amount of reflections of each leak event
+ * \param n_energies a size_t to contain the amount of simulated energies
+ * \param weights a pointer that will refer to the leak event weights, with the weight of event \c i at energy \c j found at index \c i*n_energies+j
+ * \param error a polycap_error
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_extleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error);
+
+/** Get direct access to the intleak data stored within a polycap_transmission_efficiencies struct.
+ *
+ * Contrary to polycap_transmission_efficiencies_get_intleak_data(), no memory is allocated and no data is copied: the returned arrays belong to \a efficiencies and remain valid until it is freed with polycap_transmission_efficiencies_free(). They should not be modified or freed by the caller.
+ * Vector quantities are stored per component: the x, y and z components of leak event \c i are found at indices \c i, \c i+n_leaks and \c i+2*n_leaks respectively.
+ * If no interior leak events were recorded, \a n_leaks is set to 0 and the returned arrays should not be accessed.
+ *
+ * \param efficiencies a polycap_transmission_efficiencies struct
+ * \param n_leaks a int64_t pointer that will contain the amount of intleak events
+ * \param coords a pointer that will refer to the leak event coordinates
+ * \param direction a pointer that will refer to the leak event directions
+ * \param elecv a pointer that will refer to the leak event electric vectors
+ * \param n_refl a pointer that will refer to the amount of reflections of each leak event
+ * \param n_energies a size_t to contain the amount of simulated energies
+ * \param weights a pointer that will refer to the leak event weights, with the weight of event \c i at energy \c j found at index \c i*n_energies+j
+ * \param error a polycap_error
+ * \returns true or false
+ */
+POLYCAP_EXTERN
+bool polycap_transmission_efficiencies_get_intleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error);
+
 #ifdef __cplusplus
 }
 #endif
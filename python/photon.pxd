@@ -43,6 +43,25 @@ cdef extern from "polycap-photon.h" nogil:
 
     int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *energies, double **weights, bint leak_calc, polycap_error **error)
 
+    bool polycap_photon_launch_batch(
+        polycap_description *description,
+        int max_threads,
+        size_t n_photons,
+        polycap_vector3 *start_coords,
+        polycap_vector3 *start_directions,
+        polycap_vector3 *start_electric_vectors,
+        size_t n_energies,
+        double *energies,
+        bint leak_calc,
+        int *launch_status,
+        polycap_vector3 *exit_coords,
+        polycap_vector3 *exit_directions,
+        polycap_vector3 *exit_electric_vectors,
+        int64_t *n_refl,
+        double *d_travel,
+        double *weights,
+        polycap_error **error)
+
     polycap_vector3 polycap_photon_get_start_coords(polycap_photon *photon)
 
     polycap_vector3 polycap_photon_get_start_direction(polycap_photon *photon)
@@ -23,8 +23,9 @@ from description cimport *
 from transmission_efficiencies cimport *
 from photon cimport *
 from source cimport *
+from progress_monitor cimport *
 from libc.string cimport memcpy
-from libc.stdlib cimport free
+from libc.stdlib cimport malloc, free
 from cpython cimport Py_DECREF
 from collections import namedtuple
 cimport numpy as np
@@ -33,6 +34,7 @@ import sys
 import os
 from pathlib import Path
 import threading
+import queue
 
 __version__ = version.decode("utf-8")
 
@@ -287,6 +289,50 @@ cdef class Profile:
 
         return rv
 
+    @classmethod
+    def new_from_binary_file(cls, str filename not None):
+        '''Create a new :ref:``Profile`` by memory-mapping a binary profile file
+        :param filename: a binary profile file, written by write_binary()
+        :type filename: str
+        :return: a new :ref:``Profile``
+        '''
+        cdef polycap_error *error = NULL
+
+        cdef polycap_profile *profile = polycap_profile_new_from_binary_file(filename.encode(), &error)
+        polycap_set_exception(error)
+
+        rv = Profile(Profile.CONICAL, 0, 0, 0, 0, 0, 0, 0, ignore=True)
+        rv._profile = profile
+
+        return rv
+
+    def write_binary(self, str filename not None):
+        '''Write the :ref:``Profile`` to a binary profile file, which can be loaded with new_from_binary_file()
+        :param filename: the binary profile file to write
+        :type filename: str
+        '''
+        cdef polycap_error *error = NULL
+        polycap_profile_write_binary(self._profile, filename.encode(), &error)
+        polycap_set_exception(error)
+
+    def set_analytic_tracing(self, bint enable):
+        '''Trace photons on the closed-form shape of the :ref:``Profile`` rather than segment by segment. Only supported for profiles created with the :ref:``Profile`` constructor.
+        :param enable: True to trace photons on the closed-form shape, False to trace them segment by segment
+        :type enable: bool
+        '''
+        cdef polycap_error *error = NULL
+        polycap_profile_set_analytic_tracing(self._profile, enable, &error)
+        polycap_set_exception(error)
+
+    def compact(self, double tolerance):
+        '''Merge consecutive segments of the :ref:``Profile`` where its shape is (nearly) straight
+        :param tolerance: the maximum relative deviation of the capillary and exterior radii at the removed points
+        :type tolerance: float
+        '''
+        cdef polycap_error *error = NULL
+        polycap_profile_compact(self._profile, tolerance, &error)
+        polycap_set_exception(error)
+
     @property
     def get_ext(self):
         '''Retrieve exterior profile from a :ref:``Profile`` class'''
@@ -300,7 +346,7 @@ cdef class Profile:
         dims[0] = nid+1 
 
         rv = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
-        memcpy(np.PyArray_DATA(rv), ext, sizeof(double) * nid+1)
+        memcpy(np.PyArray_DATA(rv), ext, sizeof(double) * (nid+1))
         polycap_free(ext)
 
         return rv
@@ -318,7 +364,7 @@ cdef class Profile:
         dims[0] = nid+1 
 
         rv = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
-        memcpy(np.PyArray_DATA(rv), cap, sizeof(double) * nid+1)
+        memcpy(np.PyArray_DATA(rv), cap, sizeof(double) * (nid+1))
         polycap_free(cap)
 
         return rv
@@ -336,7 +382,7 @@ cdef class Profile:
         dims[0] = nid+1 
 
         rv = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
-        memcpy(np.PyArray_DATA(rv), z, sizeof(double) * nid+1)
+        memcpy(np.PyArray_DATA(rv), z, sizeof(double) * (nid+1))
         polycap_free(z)
 
         return rv
@@ -442,6 +488,92 @@ cdef class Description:
 #        self._profile_py = Profile()
 #        self._profile_py._profile = polycap_description_get_profile(self.description)
 
+    def launch_batch(self,
+        object start_coords not None,
+        object start_directions not None,
+        object start_electric_vectors not None,
+        object energies not None,
+        bool leak_calc = False,
+        int max_threads = -1):
+        '''Simulate the trajectories of an array of photons for this :ref:``Description``. The photons are traced in parallel, with the GIL released.
+
+        :param start_coords: an (N, 3) array containing the photon start coordinates
+        :type start_coords: double array
+        :param start_directions: an (N, 3) array containing the photon start directions
+        :type start_directions: double array
+        :param start_electric_vectors: an (N, 3) array containing the photon start electric field vectors
+        :type start_electric_vectors: double array
+        :param energies: an array containing the discrete energies for which the transmission efficiency will be calculated [keV]
+        :type energies: double array
+        :param leak_calc: True: perform leak calculation; False: do not perform leak calculation. Leak events are not retained: this only changes the returned status and weights,
+            while every photon still pays the full cost of computing its leak events.
+        :type leak_calc: bool
+        :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+        :type max_threads: int
+        :return: a :ref:``LaunchBatchTuple`` of numpy arrays: status (N,) containing the return value of :ref:``Photon.launch`` in C (1 if the photon was transmitted), exit_coords, exit_direction and exit_elecv (N, 3), n_refl (N,), d_travel (N,) and weights (N, n_energies). Photons with status -1 keep zeros in all of these arrays
+        '''
+
+        start_coords = np.ascontiguousarray(start_coords, dtype=np.double)
+        start_directions = np.ascontiguousarray(start_directions, dtype=np.double)
+        start_electric_vectors = np.ascontiguousarray(start_electric_vectors, dtype=np.double)
+        if start_coords.ndim != 2 or start_coords.shape[1] != 3:
+            raise ValueError("start_coords must be an (N, 3) array")
+        if start_directions.shape != start_coords.shape:
+            raise ValueError("start_directions must be an (N, 3) array, with N equal to the number of start_coords")
+        if start_electric_vectors.shape != start_coords.shape:
+            raise ValueError("start_electric_vectors must be an (N, 3) array, with N equal to the number of start_coords")
+
+        energies = np.ascontiguousarray(np.atleast_1d(np.asarray(energies, dtype=np.double)))
+        if len(energies.shape) != 1:
+            raise ValueError("energies must be a 1D array")
+
+        cdef size_t n_photons = start_coords.shape[0]
+        cdef size_t n_energies = energies.size
+
+        status = np.empty(n_photons, dtype=np.intc)
+        exit_coords = np.zeros((n_photons, 3), dtype=np.double)
+        exit_direction = np.zeros((n_photons, 3), dtype=np.double)
+        exit_elecv = np.zeros((n_photons, 3), dtype=np.double)
+        n_refl = np.zeros(n_photons, dtype=np.int64)
+        d_travel = np.zeros(n_photons, dtype=np.double)
+        weights = np.empty((n_photons, n_energies), dtype=np.double)
+
+        cdef polycap_vector3 *start_coords_arr = <polycap_vector3*> np.PyArray_DATA(start_coords)
+        cdef polycap_vector3 *start_directions_arr = <polycap_vector3*> np.PyArray_DATA(start_directions)
+        cdef polycap_vector3 *start_electric_vectors_arr = <polycap_vector3*> np.PyArray_DATA(start_electric_vectors)
+        cdef double *energies_arr = <double*> np.PyArray_DATA(energies)
+        cdef int *status_arr = <int*> np.PyArray_DATA(status)
+        cdef polycap_vector3 *exit_coords_arr = <polycap_vector3*> np.PyArray_DATA(exit_coords)
+        cdef polycap_vector3 *exit_direction_arr = <polycap_vector3*> np.PyArray_DATA(exit_direction)
+        cdef polycap_vector3 *exit_elecv_arr = <polycap_vector3*> np.PyArray_DATA(exit_elecv)
+        cdef int64_t *n_refl_arr = <int64_t*> np.PyArray_DATA(n_refl)
+        cdef double *d_travel_arr = <double*> np.PyArray_DATA(d_travel)
+        cdef double *weights_arr = <double*> np.PyArray_DATA(weights)
+        cdef polycap_error *error = NULL
+
+        with nogil:
+            polycap_photon_launch_batch(
+                self._description,
+                max_threads,
+                n_photons,
+                start_coords_arr,
+                start_directions_arr,
+                start_electric_vectors_arr,
+                n_energies,
+                energies_arr,
+                leak_calc,
+                status_arr,
+                exit_coords_arr,
+                exit_direction_arr,
+                exit_elecv_arr,
+                n_refl_arr,
+                d_travel_arr,
+                weights_arr,
+                &error)
+        polycap_set_exception(error)
+
+        return LaunchBatchTuple(status, exit_coords, exit_direction, exit_elecv, n_refl, d_travel, weights)
+
     def __dealloc__(self):
         '''free a :ref:``Description`` class and associated data'''
         if self._description is not NULL:
@@ -454,6 +586,8 @@ cdef class TransmissionEfficiencies:
     cdef polycap_transmission_efficiencies *_trans_eff
     cdef object _energies_np
     cdef object _efficiencies_np
+    cdef object _uncertainties_np
+    cdef object _std_errors_np
     cdef polycap_leak **_int_leaks
     cdef int64_t _n_int_leaks
     cdef polycap_leak **_ext_leaks
@@ -471,11 +605,25 @@ cdef class TransmissionEfficiencies:
     cdef double **_exit_weights
     cdef int64_t *_n_refl
     cdef double *_d_travel
+    # borrowed pointers to the image data stored within _trans_eff
+    cdef int64_t _stride
+    cdef const double *_start_coords_buf
+    cdef const double *_start_direction_buf
+    cdef const double *_start_elecv_buf
+    cdef const double *_src_start_coords_buf
+    cdef const double *_exit_coords_buf
+    cdef const double *_exit_direction_buf
+    cdef const double *_exit_elecv_buf
+    cdef const int64_t *_n_refl_buf
+    cdef const double *_d_travel_buf
+    cdef const double *_exit_weights_buf
 
     def __cinit__(self):
         self._trans_eff = NULL
         self._energies_np = None
         self._efficiencies_np = None
+        self._uncertainties_np = None
+        self._std_errors_np = None
         self._ext_leaks = NULL
         self._n_ext_leaks = 0
         self._int_leaks = NULL
@@ -492,6 +640,17 @@ cdef class TransmissionEfficiencies:
         self._exit_weights = NULL
         self._n_refl = NULL
         self._d_travel = NULL
+        self._stride = 0
+        self._start_coords_buf = NULL
+        self._start_direction_buf = NULL
+        self._start_elecv_buf = NULL
+        self._src_start_coords_buf = NULL
+        self._exit_coords_buf = NULL
+        self._exit_direction_buf = NULL
+        self._exit_elecv_buf = NULL
+        self._n_refl_buf = NULL
+        self._d_travel_buf = NULL
+        self._exit_weights_buf = NULL
 
     def __dealloc__(self):
         '''free a :ref:``TransmissionEfficiencies`` class and all associated data'''
@@ -554,6 +713,96 @@ cdef class TransmissionEfficiencies:
         '''
         return (self._energies_np, self._efficiencies_np)
 
+    @property
+    def uncertainties(self):
+        '''The relative standard errors of the transmission efficiencies, or NaN where the efficiency is 0.
+        return : read-only numpy array with the same shape as the efficiencies
+        '''
+        return self._uncertainties_np
+
+    @property
+    def std_errors(self):
+        '''The standard errors of the transmission efficiencies, estimated from the variance of the weights of all simulated photons.
+        return : read-only numpy array with the same shape as the efficiencies
+        '''
+        return self._std_errors_np
+
+    def reweight(self, object energies not None, Description description = None):
+        '''Recompute the transmission efficiencies for new energies and/or another capillary material, without tracing new photons.
+        Requires the reflections to have been recorded by enabling record_histories on the :ref:``Source`` before the simulation. Leaked photons are not included.
+        :param energies: an array containing the new photon energies [keV]
+        :type energies: double array
+        :param description: a :ref:``Description`` class containing the new capillary material, or None to use the material of the simulation
+        :type description: Description
+        :return: a :ref:``ReweightTuple`` containing the energies, the transmission efficiencies at these energies and the weights of the transmitted photons (shape: n_exit x n_energies)
+        '''
+        energies = np.ascontiguousarray(np.atleast_1d(energies), dtype=np.double)
+        if energies.ndim != 1:
+            raise ValueError("energies must be a 1D array")
+
+        cdef polycap_error *error = NULL
+        cdef polycap_description *description_c = NULL
+        cdef double *weights_arr = NULL
+        cdef double *efficiencies_arr = NULL
+        if description is not None:
+            description_c = description._description
+        self._get_exit_buffers()
+
+        polycap_transmission_efficiencies_reweight(self._trans_eff, description_c, energies.size, <double*> np.PyArray_DATA(energies), &weights_arr, &efficiencies_arr, &error)
+        polycap_set_exception(error)
+
+        cdef np.npy_intp dims[2]
+        dims[0] = energies.size
+        efficiencies = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
+        memcpy(np.PyArray_DATA(efficiencies), efficiencies_arr, sizeof(double) * energies.size)
+        polycap_free(efficiencies_arr)
+
+        dims[0] = self._n_exit
+        dims[1] = energies.size
+        weights = np.PyArray_EMPTY(2, dims, np.NPY_DOUBLE, False)
+        memcpy(np.PyArray_DATA(weights), weights_arr, sizeof(double) * dims[0] * dims[1])
+        polycap_free(weights_arr)
+
+        energies = energies.copy()
+        energies.flags.writeable = False
+        efficiencies.flags.writeable = False
+        weights.flags.writeable = False
+        return ReweightTuple(energies, efficiencies, weights)
+
+    def reweight_materials(self, object variants not None):
+        '''Obtain the transmission efficiencies of several capillary materials at the simulated energies, evaluating each recorded reflection for all of them in a single pass.
+        Requires the reflections to have been recorded by enabling record_histories on the :ref:``Source`` before the simulation. Only the composition, density and surface roughness of the variants are used.
+        :param variants: a sequence of :ref:``Description`` classes, each containing a capillary material
+        :type variants: list of Description
+        :return: read-only numpy array containing the transmission efficiencies of each variant (shape: n_variants x n_energies)
+        '''
+        variants = list(variants)
+        for variant in variants:
+            if not isinstance(variant, Description):
+                raise TypeError("variants must contain Description instances")
+
+        cdef polycap_error *error = NULL
+        cdef size_t n_variants = len(variants)
+        cdef double *efficiencies_arr = NULL
+        cdef polycap_description **variants_c = <polycap_description **> malloc(sizeof(polycap_description*) * max(n_variants, 1))
+        if variants_c == NULL:
+            raise MemoryError("could not allocate memory for variants")
+        for i in range(n_variants):
+            variants_c[i] = (<Description> variants[i])._description
+
+        polycap_transmission_efficiencies_reweight_materials(self._trans_eff, n_variants, variants_c, &efficiencies_arr, &error)
+        free(variants_c)
+        polycap_set_exception(error)
+
+        cdef np.npy_intp dims[2]
+        dims[0] = n_variants
+        dims[1] = self._energies_np.size
+        efficiencies = np.PyArray_EMPTY(2, dims, np.NPY_DOUBLE, False)
+        memcpy(np.PyArray_DATA(efficiencies), efficiencies_arr, sizeof(double) * dims[0] * dims[1])
+        polycap_free(efficiencies_arr)
+        efficiencies.flags.writeable = False
+        return efficiencies
+
     @property
     def extleak_data(self):
         '''Retrieve exterior :ref:``Leak`` class array from a :ref:``TransmissionEfficiencies`` class '''
@@ -592,6 +841,64 @@ cdef class TransmissionEfficiencies:
         else:
             return None
 
+    @property
+    def extleak_arrays(self):
+        '''Retrieve exterior leak data from a :ref:``TransmissionEfficiencies`` class as a :ref:``LeakArrays`` tuple of read-only numpy arrays, referring directly to the data stored within the class: coords, direction and elecv (n_leaks, 3), n_refl (n_leaks,) and weights (n_leaks, n_energies) '''
+        if self._trans_eff is NULL:
+            return None
+
+        cdef polycap_error *error = NULL
+        cdef int64_t n_leaks = 0
+        cdef size_t n_energies = 0
+        cdef const double *coords = NULL
+        cdef const double *direction = NULL
+        cdef const double *elecv = NULL
+        cdef const int64_t *n_refl = NULL
+        cdef const double *weights = NULL
+
+        polycap_transmission_efficiencies_get_extleak_buffers(self._trans_eff, &n_leaks, &coords, &direction, &elecv, &n_refl, &n_energies, &weights, &error)
+        polycap_set_exception(error)
+
+        if n_leaks == 0:
+            return empty_leak_arrays(n_energies)
+
+        return LeakArrays(
+            image_view(self, coords, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, direction, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, elecv, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, n_refl, n_leaks, 0, sizeof(int64_t), 0, np.NPY_INT64),
+            image_view(self, weights, n_leaks, n_energies, sizeof(double) * n_energies, sizeof(double), np.NPY_DOUBLE),
+            )
+
+    @property
+    def intleak_arrays(self):
+        '''Retrieve interior leak data from a :ref:``TransmissionEfficiencies`` class as a :ref:``LeakArrays`` tuple of read-only numpy arrays, referring directly to the data stored within the class: coords, direction and elecv (n_leaks, 3), n_refl (n_leaks,) and weights (n_leaks, n_energies) '''
+        if self._trans_eff is NULL:
+            return None
+
+        cdef polycap_error *error = NULL
+        cdef int64_t n_leaks = 0
+        cdef size_t n_energies = 0
+        cdef const double *coords = NULL
+        cdef const double *direction = NULL
+        cdef const double *elecv = NULL
+        cdef const int64_t *n_refl = NULL
+        cdef const double *weights = NULL
+
+        polycap_transmission_efficiencies_get_intleak_buffers(self._trans_eff, &n_leaks, &coords, &direction, &elecv, &n_refl, &n_energies, &weights, &error)
+        polycap_set_exception(error)
+
+        if n_leaks == 0:
+            return empty_leak_arrays(n_energies)
+
+        return LeakArrays(
+            image_view(self, coords, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, direction, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, elecv, n_leaks, 3, sizeof(double), sizeof(double) * n_leaks, np.NPY_DOUBLE),
+            image_view(self, n_refl, n_leaks, 0, sizeof(int64_t), 0, np.NPY_INT64),
+            image_view(self, weights, n_leaks, n_energies, sizeof(double) * n_energies, sizeof(double), np.NPY_DOUBLE),
+            )
+
     @property
     def exit_coords(self):
         '''Retrieve photon exit coordinates vector tuple from a :ref:``TransmissionEfficiencies`` class '''
@@ -780,6 +1087,106 @@ cdef class TransmissionEfficiencies:
         else:
             return None
 
+    @property
+    def n_start(self):
+        '''Retrieve the amount of photons that were launched towards the optic to obtain a :ref:``TransmissionEfficiencies`` class, i.e. the amount the efficiencies are normalized to '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_start_buffers()
+        return self._n_start
+
+    @property
+    def start_coords_array(self):
+        '''Retrieve photon start coordinates from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_start_buffers()
+        return image_view(self, self._start_coords_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def start_direction_array(self):
+        '''Retrieve photon start direction from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_start_buffers()
+        return image_view(self, self._start_direction_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def start_elecv_array(self):
+        '''Retrieve photon start electric vector from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_start_buffers()
+        return image_view(self, self._start_elecv_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def src_start_coords_array(self):
+        '''Retrieve source start coordinates from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_start_buffers()
+        return image_view(self, self._src_start_coords_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def exit_coords_array(self):
+        '''Retrieve photon exit coordinates from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._exit_coords_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def exit_direction_array(self):
+        '''Retrieve photon exit direction from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._exit_direction_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def exit_elecv_array(self):
+        '''Retrieve photon exit electric vector from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, 3) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._exit_elecv_buf, self._n_exit, 3, sizeof(double), sizeof(double) * self._stride, np.NPY_DOUBLE)
+
+    @property
+    def n_refl_array(self):
+        '''Retrieve photon amount of internal reflections from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit,) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._n_refl_buf, self._n_exit, 0, sizeof(int64_t), 0, np.NPY_INT64)
+
+    @property
+    def d_travel_array(self):
+        '''Retrieve exit photon travel distance within optic from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit,) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._d_travel_buf, self._n_exit, 0, sizeof(double), 0, np.NPY_DOUBLE)
+
+    @property
+    def exit_weights_array(self):
+        '''Retrieve photon exit weights from a :ref:``TransmissionEfficiencies`` class as a read-only (n_exit, n_energies) numpy array, referring directly to the data stored within the class '''
+        if self._trans_eff is NULL:
+            return None
+        self._get_exit_buffers()
+        return image_view(self, self._exit_weights_buf, self._n_exit, self._n_energies, sizeof(double) * self._n_energies, sizeof(double), np.NPY_DOUBLE)
+
+    cdef _get_start_buffers(self):
+        cdef polycap_error *error = NULL
+        if self._start_coords_buf == NULL:
+            polycap_transmission_efficiencies_get_start_buffers(self._trans_eff, &self._n_start, &self._n_exit, &self._stride, &self._start_coords_buf, &self._start_direction_buf, &self._start_elecv_buf, &self._src_start_coords_buf, &error)
+            polycap_set_exception(error)
+
+    cdef _get_exit_buffers(self):
+        cdef polycap_error *error = NULL
+        if self._exit_coords_buf == NULL:
+            polycap_transmission_efficiencies_get_exit_buffers(self._trans_eff, &self._n_exit, &self._stride, &self._exit_coords_buf, &self._exit_direction_buf, &self._exit_elecv_buf, &self._n_refl_buf, &self._d_travel_buf, &self._n_energies, &self._exit_weights_buf, &error)
+            polycap_set_exception(error)
+
     # factory method -> these objects cannot be newed, as they are produced via polycap_source_get_transmission_efficiencies
     @staticmethod
     cdef create(polycap_transmission_efficiencies *trans_eff):
@@ -813,6 +1220,24 @@ cdef class TransmissionEfficiencies:
         memcpy(np.PyArray_DATA(rv._efficiencies_np), efficiencies_arr, sizeof(double) * n_energies)
         polycap_free(efficiencies_arr)
 
+        cdef double *uncertainties_arr = NULL
+        polycap_transmission_efficiencies_get_uncertainties(rv._trans_eff, NULL, &uncertainties_arr, &error)
+        polycap_set_exception(error)
+
+        rv._uncertainties_np = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
+        rv._uncertainties_np.flags.writeable = False
+        memcpy(np.PyArray_DATA(rv._uncertainties_np), uncertainties_arr, sizeof(double) * n_energies)
+        polycap_free(uncertainties_arr)
+
+        cdef double *std_errors_arr = NULL
+        polycap_transmission_efficiencies_get_std_errors(rv._trans_eff, NULL, &std_errors_arr, &error)
+        polycap_set_exception(error)
+
+        rv._std_errors_np = np.PyArray_EMPTY(1, dims, np.NPY_DOUBLE, False)
+        rv._std_errors_np.flags.writeable = False
+        memcpy(np.PyArray_DATA(rv._std_errors_np), std_errors_arr, sizeof(double) * n_energies)
+        polycap_free(std_errors_arr)
+
         return rv
 
 cdef polycap_vector3 np2vector(np.ndarray[double, ndim=1] arr):
@@ -827,10 +1252,65 @@ cdef polycap_vector3 np2vector(np.ndarray[double, ndim=1] arr):
     return rv
 
 VectorTuple = namedtuple('VectorTuple','x y z')
+LaunchBatchTuple = namedtuple('LaunchBatchTuple','status exit_coords exit_direction exit_elecv n_refl d_travel weights')
+LeakArrays = namedtuple('LeakArrays','coords direction elecv n_refl weights')
+TransmissionBatch = namedtuple('TransmissionBatch','transmission_efficiencies n_photons running_efficiencies')
+ReweightTuple = namedtuple('ReweightTuple','energies efficiencies weights')
+SweepTuple = namedtuple('SweepTuple','efficiencies std_errors')
+
+cdef empty_leak_arrays(size_t n_energies):
+    return LeakArrays(np.empty((0, 3)), np.empty((0, 3)), np.empty((0, 3)), np.empty(0, dtype=np.int64), np.empty((0, n_energies)))
+
+# copy an array of leaks into columnar numpy arrays, without creating a Python object per leak
+cdef leak_arrays(polycap_leak **leaks, int64_t n_leaks):
+    cdef size_t n_energies = leaks[0].n_energies
+    cdef int64_t i
+
+    coords = np.empty((n_leaks, 3), dtype=np.double)
+    direction = np.empty((n_leaks, 3), dtype=np.double)
+    elecv = np.empty((n_leaks, 3), dtype=np.double)
+    n_refl = np.empty(n_leaks, dtype=np.int64)
+    weights = np.empty((n_leaks, n_energies), dtype=np.double)
+
+    cdef polycap_vector3 *coords_arr = <polycap_vector3*> np.PyArray_DATA(coords)
+    cdef polycap_vector3 *direction_arr = <polycap_vector3*> np.PyArray_DATA(direction)
+    cdef polycap_vector3 *elecv_arr = <polycap_vector3*> np.PyArray_DATA(elecv)
+    cdef int64_t *n_refl_arr = <int64_t*> np.PyArray_DATA(n_refl)
+    cdef double *weights_arr = <double*> np.PyArray_DATA(weights)
+
+    for i in range(n_leaks):
+        coords_arr[i] = leaks[i].coords
+        direction_arr[i] = leaks[i].direction
+        elecv_arr[i] = leaks[i].elecv
+        n_refl_arr[i] = leaks[i].n_refl
+        memcpy(&weights_arr[i * n_energies], leaks[i].weight, sizeof(double) * n_energies)
+
+    return LeakArrays(coords, direction, elecv, n_refl, weights)
 
 cdef vector2tuple(polycap_vector3 vec):
     return VectorTuple(vec.x, vec.y, vec.z)
 
+# forwards the progress of a simulation to the Python callable in user_data: the GIL is only held for the duration of the call
+cdef void progress_monitor_set_value(double value, void *user_data) noexcept with gil:
+    try:
+        (<object> user_data)(value)
+    except Exception:
+        logger.exception("progress_callback raised an exception")
+
+# wrap data owned by owner in a read-only numpy array without copying: owner is kept alive as the base of the array
+# a one-dimensional array is returned if n_cols equals 0
+cdef image_view(object owner, const void *data, np.npy_intp n_rows, np.npy_intp n_cols, np.npy_intp row_stride, np.npy_intp col_stride, int typenum):
+    cdef np.npy_intp dims[2]
+    cdef np.npy_intp strides[2]
+    dims[0] = n_rows
+    dims[1] = n_cols
+    strides[0] = row_stride
+    strides[1] = col_stride
+    rv = np.PyArray_New(np.ndarray, 1 if n_cols == 0 else 2, dims, typenum, strides, <void*> data, 0, 0, None)
+    rv.flags.writeable = False
+    np.set_array_base(rv, owner)
+    return rv
+
 '''Class containing information about the simulated leak events such as position and direction, energy and transmission weights.
 '''
 cdef class Leak:
@@ -1011,8 +1491,13 @@ cdef class Photon:
 
         cdef polycap_error *error = NULL
         cdef double *weights = NULL
-           
-        rv = polycap_photon_launch(self._photon, energies.size, <double*> np.PyArray_DATA(energies), &weights, leak_calc, &error)
+        cdef size_t n_energies = energies.size
+        cdef double *energies_arr = <double*> np.PyArray_DATA(energies)
+        cdef int rv
+
+        # the GIL is released while the photon is traced, allowing other Python threads to run
+        with nogil:
+            rv = polycap_photon_launch(self._photon, n_energies, energies_arr, &weights, leak_calc, &error)
         polycap_set_exception(error)
         if rv == 2:
             return None
@@ -1068,6 +1553,40 @@ cdef class Photon:
         else:
             return None
 
+    @property
+    def extleak_arrays(self):
+        '''Retrieve exterior leak data from a :ref:``Photon`` class as a :ref:``LeakArrays`` tuple of numpy arrays: coords, direction and elecv (n_leaks, 3), n_refl (n_leaks,) and weights (n_leaks, n_energies) '''
+        if self._photon is NULL:
+            return None
+
+        cdef polycap_error *error = NULL
+
+        if self._n_ext_leaks == 0:
+            if not polycap_photon_get_extleak_data(self._photon, &self._ext_leaks, &self._n_ext_leaks, &error) and self._n_ext_leaks == 0:
+                # no leak events: not an error here
+                polycap_error_free(error)
+                return empty_leak_arrays(0)
+            polycap_set_exception(error)
+
+        return leak_arrays(self._ext_leaks, self._n_ext_leaks)
+
+    @property
+    def intleak_arrays(self):
+        '''Retrieve interior leak data from a :ref:``Photon`` class as a :ref:``LeakArrays`` tuple of numpy arrays: coords, direction and elecv (n_leaks, 3), n_refl (n_leaks,) and weights (n_leaks, n_energies) '''
+        if self._photon is NULL:
+            return None
+
+        cdef polycap_error *error = NULL
+
+        if self._n_int_leaks == 0:
+            if not polycap_photon_get_intleak_data(self._photon, &self._int_leaks, &self._n_int_leaks, &error) and self._n_int_leaks == 0:
+                # no leak events: not an error here
+                polycap_error_free(error)
+                return empty_leak_arrays(0)
+            polycap_set_exception(error)
+
+        return leak_arrays(self._int_leaks, self._n_int_leaks)
+
     @property
     def get_exit_coords(self):
         '''Retrieve exit coordinates from a :ref:``Photon`` class'''
@@ -1127,6 +1646,8 @@ cdef class Photon:
 '''
 cdef class Source:
     cdef polycap_source *_source
+    cdef size_t _n_energies
+    cdef bint _seeded
 
     def __cinit__(self, 
         Description description not None,
@@ -1184,6 +1705,7 @@ cdef class Source:
             <double*> np.PyArray_DATA(energies),
             &error)
         polycap_set_exception(error)
+        self._n_energies = energies.size
 
     def __dealloc__(self):
         '''free a :ref:``Source`` class and associated data'''
@@ -1214,27 +1736,366 @@ cdef class Source:
     def get_transmission_efficiencies(self,
         int max_threads,
         int n_photons,
-        bool leak_calc = False):
+        bool leak_calc = False,
+        object progress_callback = None):
         '''Obtain the transmission efficiencies for a given array of energies, and a full polycap_description.
+        The GIL is released during the simulation, allowing other Python threads to run.
         :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
         :type max_threads: int
         :param n_photons: the amount of photons to simulate that reach the polycapillary end
         :type n_photons: int
         :param leak_calc: True: perform leak calculation; False: do not perform leak calculation
         :type leak_calc: bool
+        :param progress_callback: a callable that will be called with the completed fraction of the simulation (between 0 and 1) as argument, or None. Exceptions raised by the callable are logged and otherwise ignored.
+        :type progress_callback: callable
         :return: a new :ref:``TransmissionEfficiencies`` class, or \c NULL if an error occurred
         '''
 
+        if progress_callback is not None and not callable(progress_callback):
+            raise TypeError("progress_callback must be callable or None")
+
         cdef polycap_error *error = NULL
-        cdef polycap_transmission_efficiencies *transmission_efficiencies = polycap_source_get_transmission_efficiencies(
-            self._source,
-            max_threads,
-            n_photons,
-            leak_calc, #leak_calc option
-            NULL, # polycap_progress_monitor
-            &error)
+        cdef polycap_progress_monitor *progress_monitor = NULL
+        cdef polycap_transmission_efficiencies *transmission_efficiencies = NULL
+
+        if progress_callback is not None:
+            # progress_callback remains referenced by this frame while the simulation runs
+            progress_monitor = polycap_progress_monitor_new(progress_monitor_set_value, <void*> progress_callback, &error)
+            polycap_set_exception(error)
+
+        with nogil:
+            transmission_efficiencies = polycap_source_get_transmission_efficiencies(
+                self._source,
+                max_threads,
+                n_photons,
+                leak_calc, #leak_calc option
+                progress_monitor,
+                &error)
+        polycap_progress_monitor_free(progress_monitor)
+        polycap_set_exception(error)
+
+        return TransmissionEfficiencies.create(transmission_efficiencies)
+
+    def get_transmission_efficiencies_converged(self,
+        int max_threads,
+        int max_photons,
+        double target_rel_error,
+        object selected_energies = None,
+        bool leak_calc = False,
+        object progress_callback = None):
+        '''Obtain the transmission efficiencies for a given array of energies, and a full polycap_description, simulating photons until the relative standard error of the efficiencies is below target_rel_error.
+        The GIL is released during the simulation, allowing other Python threads to run. The achieved uncertainties are available through the uncertainties property of the result.
+        :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+        :type max_threads: int
+        :param max_photons: the maximal amount of photons to simulate that reach the polycapillary end
+        :type max_photons: int
+        :param target_rel_error: the relative standard error of the efficiencies at which the simulation stops
+        :type target_rel_error: double
+        :param selected_energies: indices of the source energies at which target_rel_error must be reached, or None for all energies
+        :type selected_energies: int array
+        :param leak_calc: True: perform leak calculation; False: do not perform leak calculation
+        :type leak_calc: bool
+        :param progress_callback: a callable that will be called with the completed fraction of max_photons (between 0 and 1) as argument, or None. Exceptions raised by the callable are logged and otherwise ignored.
+        :type progress_callback: callable
+        :return: a new :ref:``TransmissionEfficiencies`` class
+        '''
+
+        if progress_callback is not None and not callable(progress_callback):
+            raise TypeError("progress_callback must be callable or None")
+
+        if selected_energies is None:
+            selected_energies = np.empty(0, dtype=np.uintp)
+        else:
+            selected_energies = np.atleast_1d(selected_energies)
+            if selected_energies.ndim != 1:
+                raise ValueError("selected_energies must be a 1D array")
+            if np.any(selected_energies < 0):
+                raise ValueError("selected_energies must contain non-negative indices")
+            selected_energies = np.ascontiguousarray(selected_energies, dtype=np.uintp)
+
+        cdef size_t n_selected = selected_energies.size
+        cdef const size_t *selected = <const size_t*> np.PyArray_DATA(selected_energies)
+        cdef polycap_error *error = NULL
+        cdef polycap_progress_monitor *progress_monitor = NULL
+        cdef polycap_transmission_efficiencies *transmission_efficiencies = NULL
+
+        if progress_callback is not None:
+            # progress_callback remains referenced by this frame while the simulation runs
+            progress_monitor = polycap_progress_monitor_new(progress_monitor_set_value, <void*> progress_callback, &error)
+            polycap_set_exception(error)
+
+        with nogil:
+            transmission_efficiencies = polycap_source_get_transmission_efficiencies_converged(
+                self._source,
+                max_threads,
+                max_photons,
+                target_rel_error,
+                n_selected,
+                selected,
+                leak_calc,
+                progress_monitor,
+                &error)
+        polycap_progress_monitor_free(progress_monitor)
+        polycap_set_exception(error)
+
+        return TransmissionEfficiencies.create(transmission_efficiencies)
+
+    def set_record_histories(self, bool record_histories):
+        '''Record the reflections of the transmitted photons in subsequent simulations, allowing their transmission efficiencies to be recomputed for other energies or materials with :ref:``TransmissionEfficiencies.reweight``.
+        :param record_histories: True: record the reflections; False: do not record the reflections
+        :type record_histories: bool
+        '''
+        cdef polycap_error *error = NULL
+        polycap_source_set_record_histories(self._source, record_histories, &error)
+        polycap_set_exception(error)
+
+    def set_single_precision(self, bool single_precision):
+        '''Solve the capillary wall intersections in single precision in subsequent simulations. The photon coordinates, weights and transmission efficiencies remain in double precision, but differ slightly from those obtained in double precision, which is the default.
+        :param single_precision: True: solve the intersections in single precision; False: solve them in double precision
+        :type single_precision: bool
+        '''
+        cdef polycap_error *error = NULL
+        polycap_source_set_single_precision(self._source, single_precision, &error)
+        polycap_set_exception(error)
+
+    def set_seed(self, unsigned long seed):
+        '''Use a fixed seed for the random numbers of subsequent simulations.
+        The random numbers of the n-th photon are derived from seed and n, making simulations reproducible regardless of the amount of threads, while simulations of sources that only differ in their parameters use common random numbers.
+        :param seed: the seed
+        :type seed: int
+        '''
+        cdef polycap_error *error = NULL
+        polycap_source_set_seed(self._source, seed, &error)
+        polycap_set_exception(error)
+        self._seeded = True
+
+    def sweep(self,
+        object points not None,
+        int n_photons,
+        int max_threads = -1,
+        bool leak_calc = False,
+        object progress_callback = None,
+        str filename = None):
+        '''Obtain the transmission efficiencies for a grid of source and surface roughness parameters, using common random numbers for all grid points.
+        All other parameters are taken from this :ref:``Source``. The GIL is released during the simulation, allowing other Python threads to run.
+        :param points: the grid points, with one row per grid point containing d_source, src_x, src_y, src_shiftx, src_shifty and sig_rough
+        :type points: double array (shape: n_points x 6)
+        :param n_photons: the amount of photons to simulate that reach the polycapillary end, for each grid point
+        :type n_photons: int
+        :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+        :type max_threads: int
+        :param leak_calc: True: perform leak calculation; False: do not perform leak calculation
+        :type leak_calc: bool
+        :param progress_callback: a callable that will be called with the fraction of completed grid points (between 0 and 1) as argument, or None. Exceptions raised by the callable are logged and otherwise ignored.
+        :type progress_callback: callable
+        :param filename: a hdf5 file to write the results to, or None
+        :type filename: str
+        :return: a :ref:``SweepTuple`` containing the transmission efficiencies and their standard errors (shape: n_points x n_energies)
+        '''
+
+        if progress_callback is not None and not callable(progress_callback):
+            raise TypeError("progress_callback must be callable or None")
+
+        points = np.ascontiguousarray(np.atleast_2d(points), dtype=np.double)
+        if points.ndim != 2 or points.shape[1] != 6:
+            raise ValueError("points must be a 2D array with 6 columns")
+
+        cdef size_t n_points = points.shape[0]
+        cdef const polycap_sweep_point *points_c = <const polycap_sweep_point*> np.PyArray_DATA(points)
+        cdef polycap_error *error = NULL
+        cdef polycap_progress_monitor *progress_monitor = NULL
+        cdef double *efficiencies_arr = NULL
+        cdef double *std_errors_arr = NULL
+
+        if progress_callback is not None:
+            # progress_callback remains referenced by this frame while the simulation runs
+            progress_monitor = polycap_progress_monitor_new(progress_monitor_set_value, <void*> progress_callback, &error)
+            polycap_set_exception(error)
+
+        with nogil:
+            polycap_source_sweep(self._source, n_points, points_c, max_threads, n_photons, leak_calc, progress_monitor, &efficiencies_arr, &std_errors_arr, &error)
+        polycap_progress_monitor_free(progress_monitor)
+        polycap_set_exception(error)
+
+        if filename is not None:
+            polycap_source_sweep_write_hdf5(self._source, n_points, points_c, efficiencies_arr, std_errors_arr, filename.encode(), &error)
+            if error != NULL:
+                polycap_free(efficiencies_arr)
+                polycap_free(std_errors_arr)
+                polycap_set_exception(error)
+
+        cdef np.npy_intp dims[2]
+        dims[0] = n_points
+        dims[1] = self._n_energies
+        efficiencies = np.PyArray_EMPTY(2, dims, np.NPY_DOUBLE, False)
+        memcpy(np.PyArray_DATA(efficiencies), efficiencies_arr, sizeof(double) * dims[0] * dims[1])
+        polycap_free(efficiencies_arr)
+        std_errors = np.PyArray_EMPTY(2, dims, np.NPY_DOUBLE, False)
+        memcpy(np.PyArray_DATA(std_errors), std_errors_arr, sizeof(double) * dims[0] * dims[1])
+        polycap_free(std_errors_arr)
+        efficiencies.flags.writeable = False
+        std_errors.flags.writeable = False
+        return SweepTuple(efficiencies, std_errors)
+
+    def get_transmission_efficiencies_shard(self,
+        int max_threads,
+        int n_photons,
+        int shard_index,
+        int n_shards,
+        bool leak_calc = False,
+        object progress_callback = None):
+        '''Obtain the partial transmission efficiencies of a single shard of a simulation that is split over several processes.
+        Each shard traces a disjoint range of the n_photons photons, with random numbers derived from the seed set with :ref:``Source.set_seed``, which is required.
+        Write each shard to a hdf5 file with :ref:``TransmissionEfficiencies.write_hdf5``, and combine the files with :ref:``Source.merge_shards``.
+        :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+        :type max_threads: int
+        :param n_photons: the amount of photons to simulate that reach the polycapillary end, over all shards together
+        :type n_photons: int
+        :param shard_index: the index of this shard, from 0 up to n_shards - 1
+        :type shard_index: int
+        :param n_shards: the amount of shards the simulation is split in
+        :type n_shards: int
+        :param leak_calc: True: perform leak calculation; False: do not perform leak calculation
+        :type leak_calc: bool
+        :param progress_callback: a callable that will be called with the completed fraction of the photons of this shard (between 0 and 1) as argument, or None. Exceptions raised by the callable are logged and otherwise ignored.
+        :type progress_callback: callable
+        :return: a new :ref:``TransmissionEfficiencies`` class
+        '''
+
+        if progress_callback is not None and not callable(progress_callback):
+            raise TypeError("progress_callback must be callable or None")
+
+        cdef polycap_error *error = NULL
+        cdef polycap_progress_monitor *progress_monitor = NULL
+        cdef polycap_transmission_efficiencies *transmission_efficiencies = NULL
+
+        if progress_callback is not None:
+            # progress_callback remains referenced by this frame while the simulation runs
+            progress_monitor = polycap_progress_monitor_new(progress_monitor_set_value, <void*> progress_callback, &error)
+            polycap_set_exception(error)
+
+        with nogil:
+            transmission_efficiencies = polycap_source_get_transmission_efficiencies_shard(
+                self._source,
+                max_threads,
+                n_photons,
+                shard_index,
+                n_shards,
+                leak_calc,
+                progress_monitor,
+                &error)
+        polycap_progress_monitor_free(progress_monitor)
         polycap_set_exception(error)
 
         return TransmissionEfficiencies.create(transmission_efficiencies)
 
+    def merge_shards(self, object filenames not None):
+        '''Merge the hdf5 files of all shards of a simulation of this :ref:``Source`` into the transmission efficiencies of the complete simulation.
+        :param filenames: the hdf5 files written for the results of :ref:``Source.get_transmission_efficiencies_shard``, in any order
+        :type filenames: list of str
+        :return: a new :ref:``TransmissionEfficiencies`` class
+        '''
+        encoded = [str(filename).encode() for filename in filenames]
+        if len(encoded) == 0:
+            raise ValueError("filenames cannot be empty")
+
+        cdef size_t n_files = len(encoded)
+        cdef const char **filenames_c = <const char**> malloc(sizeof(char*) * n_files)
+        cdef polycap_error *error = NULL
+        cdef polycap_transmission_efficiencies *transmission_efficiencies = NULL
+        cdef size_t i
+        if filenames_c == NULL:
+            raise MemoryError()
+        for i in range(n_files):
+            filenames_c[i] = encoded[i]
+
+        transmission_efficiencies = polycap_transmission_efficiencies_merge(self._source, n_files, filenames_c, &error)
+        free(filenames_c)
+        polycap_set_exception(error)
+
+        return TransmissionEfficiencies.create(transmission_efficiencies)
+
+    def iter_transmission(self,
+        int n_photons,
+        int batch_size,
+        int max_threads = -1,
+        bool leak_calc = False):
+        '''Obtain the transmission efficiencies in batches of batch_size photons, yielding the results of each batch as soon as it is available.
+        The next batch is simulated in a background thread (with the GIL released) while the previous one is being processed by the caller, at most one finished batch is kept waiting.
+        If a seed was set with :ref:``Source.set_seed``, the batches are the shards of :ref:``Source.get_transmission_efficiencies_shard``: the photons are divided as evenly as possible over the same amount of batches, each tracing a disjoint range of photons, so that the final running estimate reproduces a single seeded simulation of n_photons photons.
+        :param n_photons: the total amount of photons to simulate that reach the polycapillary end
+        :type n_photons: int
+        :param batch_size: the amount of photons to simulate per batch. Without a seed, the last batch contains the remainder if n_photons is not a multiple of batch_size
+        :type batch_size: int
+        :param max_threads: the amount of threads to use. Set to -1 to use the maximum available amount of threads.
+        :type max_threads: int
+        :param leak_calc: True: perform leak calculation; False: do not perform leak calculation
+        :type leak_calc: bool
+        :return: a generator of :ref:``TransmissionBatch`` tuples, containing the :ref:``TransmissionEfficiencies`` class of the batch (providing the per-batch arrays), the total amount of photons simulated so far and the running efficiencies estimate, i.e. the average of the batch efficiencies weighted by their amount of started photons (see :ref:``TransmissionEfficiencies.n_start``)
+        '''
+
+        if n_photons < 1:
+            raise ValueError("n_photons must be greater than 0")
+        if batch_size < 1:
+            raise ValueError("batch_size must be greater than 0")
+
+        seeded = self._seeded
+        if seeded:
+            # same split as polycap_source_get_transmission_efficiencies_shard()
+            n_batches = (n_photons + batch_size - 1) // batch_size
+            batch_sizes = [n_photons * (k + 1) // n_batches - n_photons * k // n_batches for k in range(n_batches)]
+        else:
+            batch_sizes = [batch_size] * (n_photons // batch_size)
+            if n_photons % batch_size:
+                batch_sizes.append(n_photons % batch_size)
+
+        batches = queue.Queue(maxsize=1)
+        stop = threading.Event()
+
+        def simulate():
+            for k, size in enumerate(batch_sizes):
+                if stop.is_set():
+                    return
+                try:
+                    # with a seed, every batch has to trace its own range of photons instead of replaying the first ones
+                    if seeded:
+                        batch = self.get_transmission_efficiencies_shard(max_threads, n_photons, k, len(batch_sizes), leak_calc)
+                    else:
+                        batch = self.get_transmission_efficiencies(max_threads, size, leak_calc)
+                except Exception as e:
+                    batches.put((size, e))
+                    return
+                batches.put((size, batch))
+
+        thread = threading.Thread(target=simulate, daemon=True)
+        thread.start()
+
+        n_done = 0
+        n_started = 0
+        running_efficiencies = None
+        try:
+            for i in range(len(batch_sizes)):
+                size, batch = batches.get()
+                if isinstance(batch, Exception):
+                    raise batch
+                # the efficiencies are normalized to the started photons, so these are the weights of the batches
+                batch_started = batch.n_start
+                if running_efficiencies is None:
+                    running_efficiencies = batch.data[1].copy()
+                else:
+                    running_efficiencies = (running_efficiencies * n_started + batch.data[1] * batch_started) / (n_started + batch_started)
+                n_started += batch_started
+                n_done += size
+                running_efficiencies.flags.writeable = False
+                yield TransmissionBatch(batch, n_done, running_efficiencies)
+        finally:
+            # the consumer may have stopped early: let the thread finish its current batch and discard it
+            stop.set()
+            while thread.is_alive():
+                try:
+                    batches.get(timeout=0.1)
+                except queue.Empty:
+                    pass
+            thread.join()
+
 
@@ -31,6 +31,25 @@ cdef extern from "polycap-profile.h" nogil:
 	double focal_dist_downstream,
 	polycap_error **error)
 
+    polycap_profile* polycap_profile_new_from_binary_file(
+        const char *filename,
+        polycap_error **error)
+
+    bint polycap_profile_write_binary(
+        polycap_profile *profile,
+        const char *filename,
+        polycap_error **error)
+
+    bint polycap_profile_set_analytic_tracing(
+        polycap_profile *profile,
+        bint enable,
+        polycap_error **error)
+
+    bint polycap_profile_compact(
+        polycap_profile *profile,
+        double tolerance,
+        polycap_error **error)
+
     polycap_profile *polycap_profile_new_from_arrays(
         int nid,
         double *ext,
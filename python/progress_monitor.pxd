@@ -10,6 +10,13 @@
 # You should have received a copy of the GNU General Public License
 # along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+from error cimport polycap_error
+
 cdef extern from "polycap-progress-monitor.h" nogil:
     ctypedef struct polycap_progress_monitor
 
+    ctypedef void (*polycap_progress_monitor_set_value_func)(double value, void *user_data)
+
+    polycap_progress_monitor* polycap_progress_monitor_new(polycap_progress_monitor_set_value_func set_value, void *user_data, polycap_error **error)
+
+    void polycap_progress_monitor_free(polycap_progress_monitor *progress_monitor)
@@ -20,6 +20,14 @@ from progress_monitor cimport polycap_progress_monitor
 cdef extern from "polycap-source.h" nogil:
     ctypedef struct polycap_source
 
+    ctypedef struct polycap_sweep_point:
+        double d_source
+        double src_x
+        double src_y
+        double src_shiftx
+        double src_shifty
+        double sig_rough
+
     polycap_source* polycap_source_new(
         polycap_description *description,
         double d_source,
@@ -51,5 +59,47 @@ cdef extern from "polycap-source.h" nogil:
         polycap_progress_monitor *progress_monitor,
         polycap_error **error)
 
+    polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_converged(
+        polycap_source *source,
+        int max_threads,
+        int max_photons,
+        double target_rel_error,
+        size_t n_selected,
+        const size_t *selected,
+        bint leak_calc,
+        polycap_progress_monitor *progress_monitor,
+        polycap_error **error)
+
     const polycap_description* polycap_source_get_description(polycap_source *source)
 
+    bool polycap_source_set_record_histories(polycap_source *source, bool record_histories, polycap_error **error)
+    bool polycap_source_set_single_precision(polycap_source *source, bool single_precision, polycap_error **error)
+
+    bool polycap_source_set_seed(polycap_source *source, unsigned long int seed, polycap_error **error)
+
+    bool polycap_source_sweep(
+        polycap_source *source,
+        size_t n_points,
+        const polycap_sweep_point *points,
+        int max_threads,
+        int n_photons,
+        bint leak_calc,
+        polycap_progress_monitor *progress_monitor,
+        double **efficiencies_arr,
+        double **std_errors_arr,
+        polycap_error **error)
+
+    bool polycap_source_sweep_write_hdf5(polycap_source *source, size_t n_points, const polycap_sweep_point *points, double *efficiencies, double *std_errors, const char *filename, polycap_error **error)
+
+    polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_shard(
+        polycap_source *source,
+        int max_threads,
+        int n_photons,
+        int shard_index,
+        int n_shards,
+        bint leak_calc,
+        polycap_progress_monitor *progress_monitor,
+        polycap_error **error)
+
+    polycap_transmission_efficiencies* polycap_transmission_efficiencies_merge(polycap_source *source, size_t n_files, const char **filenames, polycap_error **error)
+
@@ -18,6 +18,7 @@ cdef extern from "stdbool.h" nogil:
 
 
 from photon cimport polycap_vector3, polycap_leak
+from description cimport polycap_description
 #cdef extern from "polycap-photon.h" nogil:
 #    ctypedef struct polycap_vector3:
 #        double x
@@ -39,6 +40,14 @@ cdef extern from "polycap-transmission-efficiencies.h" nogil:
 
     bool polycap_transmission_efficiencies_get_data(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **energies_arr, double **efficiencies_arr, polycap_error **error)
 
+    bool polycap_transmission_efficiencies_get_uncertainties(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **uncertainties_arr, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_get_std_errors(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **std_errors_arr, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_reweight(polycap_transmission_efficiencies *efficiencies, polycap_description *description, size_t n_energies, double *energies, double **weights_arr, double **efficiencies_arr, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_reweight_materials(polycap_transmission_efficiencies *efficiencies, size_t n_variants, polycap_description **variants, double **efficiencies_arr, polycap_error **error)
+
     bool polycap_transmission_efficiencies_get_extleak_data(polycap_transmission_efficiencies *efficiencies, polycap_leak ***leaks, int64_t *n_leaks, polycap_error **error)
 
     bool polycap_transmission_efficiencies_get_intleak_data(polycap_transmission_efficiencies *efficiencies, polycap_leak ***leaks, int64_t *n_leaks, polycap_error **error)
@@ -46,3 +55,11 @@ cdef extern from "polycap-transmission-efficiencies.h" nogil:
     bool polycap_transmission_efficiencies_get_start_data(polycap_transmission_efficiencies *efficiencies, int64_t *n_start, int64_t *n_exit, polycap_vector3 **start_coords, polycap_vector3 **start_direction, polycap_vector3 **start_elecv, polycap_vector3 **src_start_coords, polycap_error **error)
 
     bool polycap_transmission_efficiencies_get_exit_data(polycap_transmission_efficiencies *efficiencies, int64_t *n_exit, polycap_vector3 **exit_coords, polycap_vector3 **exit_direction, polycap_vector3 **exit_elecv, int64_t **n_refl, double **d_travel, size_t *n_energies, double *** exit_weights, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_get_start_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_start, int64_t *n_exit, int64_t *stride, const double **start_coords, const double **start_direction, const double **start_elecv, const double **src_start_coords, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_get_exit_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_exit, int64_t *stride, const double **exit_coords, const double **exit_direction, const double **exit_elecv, const int64_t **n_refl, const double **d_travel, size_t *n_energies, const double **exit_weights, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_get_extleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error)
+
+    bool polycap_transmission_efficiencies_get_intleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error)
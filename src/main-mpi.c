@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+#include <config.h>
+#include "polycap-private.h"
+#include "polycap-error.h"
+#include "polycap-mpi.h"
+#include <stdlib.h>
+#include <omp.h> /* openmp header */
+
+//===========================================
+//call example: mpiexec -n 4 ./polycap-mpi inputfile.inp outfile.h5     5            1           30000      12345    1000
+//							    #cores/process  leak_calc on  #photons   seed   #photons/batch
+//	rank 0 hands out the batches to the other processes and writes the output file
+int main(int argc, char *argv[])
+{
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	int rank;
+	int nthreads = -1;
+	int n_photons = 30000;
+	int batch_size = 1000;
+	bool leak_calc = false;
+	polycap_error *error = NULL;
+
+	MPI_Init(&argc, &argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	if(argc < 3){
+		if(rank == 0)
+			printf("Usage: polycap-mpi input-file output-file [#cores] [leak_calc] [#photons] [seed] [#photons/batch]\n");
+		MPI_Finalize();
+		return 1;
+	}
+	if(argc >= 4){
+		nthreads = atoi(argv[3]);
+		if(nthreads < 1 || nthreads > omp_get_max_threads() ){
+			nthreads = omp_get_max_threads();
+		}
+	}
+	if(argc >= 5){
+		if(atoi(argv[4]) == 1)
+			leak_calc = true;
+	}
+	if(argc >= 6){
+		n_photons = atoi(argv[5]);
+	}
+	if(argc >= 8){
+		batch_size = atoi(argv[7]);
+	}
+
+	// every process reads the input file
+	source = polycap_source_new_from_file(argv[1], &error);
+	if (source == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+	if(argc >= 7)
+		polycap_source_set_seed(source, strtoul(argv[6], NULL, 10), NULL);
+
+	if(rank == 0)
+		printf("Starting calculations...\n");
+	if (!polycap_source_get_transmission_efficiencies_mpi(source, MPI_COMM_WORLD, nthreads, n_photons, batch_size, leak_calc, NULL, &efficiencies, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		MPI_Finalize();
+		return 1;
+	}
+
+	//Write output
+	if (rank == 0) {
+		if (!polycap_transmission_efficiencies_write_hdf5(efficiencies, argv[2], &error)) {
+			fprintf(stderr, "%s\n", error->message);
+			MPI_Abort(MPI_COMM_WORLD, 1);
+		}
+		polycap_transmission_efficiencies_free(efficiencies);
+	}
+	polycap_source_free(source);
+
+	MPI_Finalize();
+	return 0;
+}
@@ -22,14 +22,244 @@
 #include <omp.h> /* openmp header */
 
 //===========================================
-//call example: ./polycap inputfile.inp      outfile.h5     5       1
-//					         	    #cores   leak_calc on
+// read the grid points of a parameter sweep: one point per line, containing
+//	d_source src_x src_y src_shiftx src_shifty sig_rough
+//	empty lines and lines starting with # are ignored
+static polycap_sweep_point *read_sweep_points(const char *filename, size_t *n_points)
+{
+	FILE *fptr;
+	char line[1024];
+	polycap_sweep_point *points = NULL, *points_temp, point;
+	size_t mem_size = 0;
+
+	*n_points = 0;
+	fptr = fopen(filename, "r");
+	if(fptr == NULL){
+		fprintf(stderr, "Could not open sweep file %s -> %s\n", filename, strerror(errno));
+		return NULL;
+	}
+	while(fgets(line, sizeof(line), fptr) != NULL){
+		if(line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#')
+			continue;
+		if(sscanf(line, "%lf %lf %lf %lf %lf %lf", &point.d_source, &point.src_x, &point.src_y, &point.src_shiftx, &point.src_shifty, &point.sig_rough) != 6){
+			fprintf(stderr, "Invalid line in sweep file %s: %s\n", filename, line);
+			free(points);
+			fclose(fptr);
+			return NULL;
+		}
+		if(*n_points == mem_size){
+			mem_size = mem_size == 0 ? 16 : 2*mem_size;
+			points_temp = realloc(points, sizeof(polycap_sweep_point)*mem_size);
+			if(points_temp == NULL){
+				fprintf(stderr, "Could not allocate memory for the sweep points -> %s\n", strerror(errno));
+				free(points);
+				fclose(fptr);
+				return NULL;
+			}
+			points = points_temp;
+		}
+		points[(*n_points)++] = point;
+	}
+	fclose(fptr);
+	if(*n_points == 0)
+		fprintf(stderr, "Sweep file %s contains no grid points\n", filename);
+	return points;
+}
+
+//===========================================
+//call example: ./polycap --sweep grid.txt inputfile.inp outfile.h5     5       1          30000       12345
+//						       #cores   leak_calc on  #photons/point   seed
+//	every line of grid.txt contains one grid point: d_source src_x src_y src_shiftx src_shifty sig_rough
+//	all other parameters are taken from inputfile.inp
+static int main_sweep(int argc, char *argv[])
+{
+	polycap_source *source;
+	polycap_sweep_point *points;
+	size_t n_points;
+	double *efficiencies, *std_errors;
+	int nthreads = -1;
+	int n_photons = 30000;
+	bool leak_calc = false;
+	polycap_error *error = NULL;
+
+	if(argc < 5){
+		printf("Usage: polycap --sweep grid-file input-file output-file [#cores] [leak_calc] [#photons] [seed]\n");
+		return 1;
+	}
+	if(argc >= 6){
+		nthreads = atoi(argv[5]);
+		if(nthreads < 1 || nthreads > omp_get_max_threads() ){
+			nthreads = omp_get_max_threads();
+		}
+	}
+	if(argc >= 7){
+		if(atoi(argv[6]) == 1)
+			leak_calc = true;
+	}
+	if(argc >= 8){
+		n_photons = atoi(argv[7]);
+	}
+
+	points = read_sweep_points(argv[2], &n_points);
+	if(points == NULL)
+		return 1;
+
+	source = polycap_source_new_from_file(argv[3], &error);
+	if (source == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if(argc >= 9)
+		polycap_source_set_seed(source, strtoul(argv[8], NULL, 10), NULL);
+
+	printf("Starting calculations for %zu grid points...\n", n_points);
+	if (!polycap_source_sweep(source, n_points, points, nthreads, n_photons, leak_calc, NULL, &efficiencies, &std_errors, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if (!polycap_source_sweep_write_hdf5(source, n_points, points, efficiencies, std_errors, argv[4], &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+
+	free(efficiencies);
+	free(std_errors);
+	free(points);
+	polycap_source_free(source);
+
+	return 0;
+}
+
+//===========================================
+//call example: ./polycap --shard 0       4       inputfile.inp shard0.h5 12345  5       1           30000
+//				  shard index #shards                         seed   #cores  leak_calc on #photons (all shards)
+//	run each shard in a separate process, and combine their output files with --merge
+static int main_shard(int argc, char *argv[])
+{
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	int nthreads = -1;
+	int n_photons = 30000;
+	bool leak_calc = false;
+	polycap_error *error = NULL;
+
+	if(argc < 7){
+		printf("Usage: polycap --shard shard-index #shards input-file output-file seed [#cores] [leak_calc] [#photons]\n");
+		return 1;
+	}
+	if(argc >= 8){
+		nthreads = atoi(argv[7]);
+		if(nthreads < 1 || nthreads > omp_get_max_threads() ){
+			nthreads = omp_get_max_threads();
+		}
+	}
+	if(argc >= 9){
+		if(atoi(argv[8]) == 1)
+			leak_calc = true;
+	}
+	if(argc >= 10){
+		n_photons = atoi(argv[9]);
+	}
+
+	source = polycap_source_new_from_file(argv[4], &error);
+	if (source == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	polycap_source_set_seed(source, strtoul(argv[6], NULL, 10), NULL);
+
+	printf("Starting calculations for shard %s of %s...\n", argv[2], argv[3]);
+	efficiencies = polycap_source_get_transmission_efficiencies_shard(source, nthreads, n_photons, atoi(argv[2]), atoi(argv[3]), leak_calc, NULL, &error);
+	if (efficiencies == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if (!polycap_transmission_efficiencies_write_hdf5(efficiencies, argv[5], &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_source_free(source);
+
+	return 0;
+}
+
+//===========================================
+//call example: ./polycap --merge inputfile.inp outfile.h5 shard0.h5 shard1.h5 shard2.h5 shard3.h5
+//	the input file must be the one the shards were simulated with
+static int main_merge(int argc, char *argv[])
+{
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	polycap_error *error = NULL;
+
+	if(argc < 5){
+		printf("Usage: polycap --merge input-file output-file shard-file...\n");
+		return 1;
+	}
+
+	source = polycap_source_new_from_file(argv[2], &error);
+	if (source == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+
+	efficiencies = polycap_transmission_efficiencies_merge(source, argc-4, (const char **) argv+4, &error);
+	if (efficiencies == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if (!polycap_transmission_efficiencies_write_hdf5(efficiencies, argv[3], &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_source_free(source);
+
+	return 0;
+}
+
+//===========================================
+//call example: ./polycap --convert-profile xos1.prf xos1.axs xos1.ext xos1.pcp
+//	converts the ASCII profile files to a binary profile file, to be used with profile type 3 in the input file
+static int main_convert_profile(int argc, char *argv[])
+{
+	polycap_profile *profile;
+	polycap_error *error = NULL;
+
+	if(argc < 6){
+		printf("Usage: polycap --convert-profile single-capillary-file central-axis-file external-shape-file output-file\n");
+		return 1;
+	}
+
+	profile = polycap_profile_new_from_file(argv[2], argv[3], argv[4], &error);
+	if (profile == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if (!polycap_profile_write_binary(profile, argv[5], &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+
+	polycap_profile_free(profile);
+
+	return 0;
+}
+
+//===========================================
+//call example: ./polycap inputfile.inp      outfile.h5     5       1            0.01             300000
+//					         	    #cores   leak_calc on target rel. error   max #photons
+//	if a target relative error is given, photons are simulated until the relative standard error of the efficiencies at all energies drops below it
 int main(int argc, char *argv[])
 {	
 	polycap_source *source;
 	polycap_transmission_efficiencies *efficiencies;
 	int nthreads = -1;
 	int n_photons = 30000;
+	double target_rel_error = 0.;
 	char *filename;
 	bool leak_calc = false;
 	polycap_error *error = NULL;
@@ -40,6 +270,15 @@ int main(int argc, char *argv[])
 		exit(0);
 		}
 
+	if(strcmp(argv[1], "--sweep") == 0)
+		return main_sweep(argc, argv);
+	if(strcmp(argv[1], "--shard") == 0)
+		return main_shard(argc, argv);
+	if(strcmp(argv[1], "--merge") == 0)
+		return main_merge(argc, argv);
+	if(strcmp(argv[1], "--convert-profile") == 0)
+		return main_convert_profile(argc, argv);
+
 	//Check nthreads if sufficient arguments were supplied
 	if(argc >= 3){
 		filename = polycap_strdup(argv[2]);
@@ -56,6 +295,13 @@ int main(int argc, char *argv[])
 		if(atoi(argv[4]) == 1)
 			leak_calc = true;
 	}
+	if(argc >= 6){
+		target_rel_error = atof(argv[5]);
+		n_photons = 300000;
+	}
+	if(argc >= 7){
+		n_photons = atoi(argv[6]);
+	}
 
 	// Read input file and define source structure
 	source = polycap_source_new_from_file(argv[1], &error);
@@ -66,7 +312,10 @@ int main(int argc, char *argv[])
 
 	// Perform calculations	
 	printf("Starting calculations...\n");
-	efficiencies = polycap_source_get_transmission_efficiencies(source, nthreads, n_photons, leak_calc, NULL, &error);
+	if(target_rel_error > 0.)
+		efficiencies = polycap_source_get_transmission_efficiencies_converged(source, nthreads, n_photons, target_rel_error, 0, NULL, leak_calc, NULL, &error);
+	else
+		efficiencies = polycap_source_get_transmission_efficiencies(source, nthreads, n_photons, leak_calc, NULL, &error);
 	if (efficiencies == NULL) {
 		fprintf(stderr, "%s\n", error->message);
 		return 1;
@@ -22,6 +22,7 @@
 #define NSPOT 1000  /* The number of bins in the grid for the spot*/
 #define BINSIZE 20.e-4 /* cm */
 #define EPSILON 1.0e-30
+#define POLY_MAX_DEGREE 8 /* highest degree of the wall equation of closed-form profile shapes */
 
 #ifdef HAVE_PROPER_COMPLEX_H
 /* Because MS thinks it was a good idea not to follow the C99 standard properly,
@@ -47,9 +48,55 @@
 #define Dcomplex_multiply_double(x, y) (_Cmulcr(x, y))
 #endif
 
+//===========================================
+// solves the quadratic equation for the distances along z between phot_coord0 and the intersection points of the photon trajectory and a capillary wall segment
+// 	returns the amount of solutions: 0, 1 (stored in dist1) or 2
+static int polycap_capil_segment_solve(double d_slope_x, double d_slope_y, double d_x0, double d_y0, double cap_rad0, double rad_slope, double *dist1, double *dist2)
+{
+	double a, b, c, discr; //parameters of quadratic equation and discriminant
+
+	a = d_slope_x*d_slope_x + d_slope_y*d_slope_y - rad_slope*rad_slope;
+	b = 2.*d_x0*d_slope_x + 2.*d_y0*d_slope_y - 2.*cap_rad0*rad_slope;
+	c = d_x0*d_x0 + d_y0*d_y0 - cap_rad0*cap_rad0;
+	discr = b*b - 4.*a*c;
+	if(discr < 0)
+		return 0;
+	if(discr == 0){
+		*dist1 = (-1.*b)/(2.*a);
+		return 1;
+	}
+	*dist1 = (-1.*b + sqrt(discr))/(2.*a);
+	*dist2 = (-1.*b - sqrt(discr))/(2.*a);
+	return 2;
+}
+//===========================================
+// single precision version of polycap_capil_segment_solve(), see polycap_source_set_single_precision()
+// 	the arguments are relative to the capillary axis at the start of the segment, so their magnitude is that of the capillary radius and float suffices
+static int polycap_capil_segment_solve_float(float d_slope_x, float d_slope_y, float d_x0, float d_y0, float cap_rad0, float rad_slope, double *dist1, double *dist2)
+{
+	float a, b, c, discr; //parameters of quadratic equation and discriminant
+
+	a = d_slope_x*d_slope_x + d_slope_y*d_slope_y - rad_slope*rad_slope;
+	b = 2.f*d_x0*d_slope_x + 2.f*d_y0*d_slope_y - 2.f*cap_rad0*rad_slope;
+	c = d_x0*d_x0 + d_y0*d_y0 - cap_rad0*cap_rad0;
+	discr = b*b - 4.f*a*c;
+	if(discr < 0.f)
+		return 0;
+	if(discr == 0.f){
+		*dist1 = (-1.f*b)/(2.f*a);
+		return 1;
+	}
+	*dist1 = (-1.f*b + sqrtf(discr))/(2.f*a);
+	*dist2 = (-1.f*b - sqrtf(discr))/(2.f*a);
+	return 2;
+}
 //===========================================
 // calculates the intersection point coordinates of the photon trajectory and a given linear segment of the capillary wall
-STATIC int polycap_capil_segment(polycap_vector3 cap_coord0, polycap_vector3 cap_coord1, double cap_rad0, double cap_rad1, polycap_vector3 phot_coord0, polycap_vector3 phot_coord1, polycap_vector3 photon_dir, polycap_vector3 *photon_coord, polycap_vector3 *surface_norm, polycap_error **error)
+// 	cap_slope and phot_slope contain the x and y change per unit z of the capillary axis and the photon trajectory, rad_slope the capillary radius change per unit z,
+// 	photon_dir must be normalised and phot_coord0.z equal to cap_coord0.z
+// 	single_precision selects polycap_capil_segment_solve_float() to solve the quadratic equation
+// 	no argument checks are performed, as this is called for every segment a photon passes: use polycap_capil_segment() otherwise
+static int polycap_capil_segment_intersect(polycap_vector3 cap_coord0, polycap_vector3 cap_coord1, double cap_rad0, double cap_rad1, polycap_vector3 cap_slope, double rad_slope, polycap_vector3 phot_coord0, polycap_vector3 phot_slope, polycap_vector3 photon_dir, bool single_precision, polycap_vector3 *photon_coord, polycap_vector3 *surface_norm)
 {
 	double d_proj; //distance vector projection factor
 	polycap_vector3 cap_coord; //capillary axis coordinate at interact_coord.z
@@ -59,77 +106,33 @@ STATIC int polycap_capil_segment(polycap_vector3 cap_coord0, polycap_vector3 cap
 	double d_cap_inter, d_cap_coord; //distance between capillary axis and interaction point (au), distance between cap_coords
 	double tga, sga, cga, gam; //tan(gamma), sin(ga) and cos(ga) and gamma where gamma is angle between capillary wall and axis
 	polycap_vector3 photon_coord_rel;
-	double a, b, c, discr, dist1, dist2; //parameters of quadratic equation, discriminant and solutions
-
-	//argument sanity check
-	if (cap_coord0.z < 0.){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord0.z must be greater than 0");
-		return -1;
-	}
-	if (cap_coord1.z < 0){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord0.z must be greater than 0");
-		return -1;
-	}
-	if (cap_rad0 < 0.){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_rad0 must be greater than 0");
-		return -1;
-	}
-	if (cap_rad1 < 0.){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_rad1 must be greater than 0");
-		return -1;
-	}
-	if (photon_coord == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: photon_coord must not be NULL");
-		return -1;
-	}
-	if (photon_dir.z < 0){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: photon_dir.z must be greater than 0");
-		return -1;
-	}
-	if (surface_norm == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: surface_norm must not be NULL");
-		return -1;
-	}
-	if (cap_coord0.z != phot_coord0.z || cap_coord1.z != phot_coord1.z){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord and phot_coord must have identical z coordinate");
-		return -1;
-	}
-	if (cap_coord1.z <= cap_coord0.z){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord1.z must be greater than cap_coord0.z");
-		return -1;
-	}
+	double d_slope_x, d_slope_y; //difference between photon and capillary axis slopes
+	double d_x0, d_y0; //photon coordinate relative to capillary axis at cap_coord0.z
+	double dist1, dist2; //solutions of quadratic equation
+	int n_solutions;
 
 	surface_norm->x = 0.0; //set in case of premature return
 	surface_norm->y = 0.0;
 	surface_norm->z = 0.0;
-	polycap_norm(&photon_dir);
-
-
-	//	calculate distance between capillary axis coordinates (0 and 1), and distance between interaction point and cap_coord
-	cap_dir.x = cap_coord1.x - cap_coord0.x;
-	cap_dir.y = cap_coord1.y - cap_coord0.y;
-	cap_dir.z = cap_coord1.z - cap_coord0.z;
-	d_cap_coord = sqrt(polycap_scalar(cap_dir, cap_dir));
 
 	//at unknown coordinate z, d_phot_ax must be equal to cap_rad for there to be an interaction with capillary wall
 	//	at any given position along z-axis, d_phot = sqrt( (phot_coord.x-cap_coord.x)^2 + (phot_coord.y-cap_coord.y)^2)
 	//		additionally, phot_coord.x = phot_coord0.x + dist * phot_dir.x/phot_dir.z with dist the distance between phot_coord.z and interaction point
 	//	at any given position along z-azis, cap_rad = rad0 + dist * (rad1-rad0)/(cap_coord1.z-cap_coord0.z)
 	//	at interaction point, these two must be equal to each other. Solve for dist and find interaction coordinate!
-	a = ( ((photon_dir.x/photon_dir.z)-(cap_dir.x/cap_dir.z))*((photon_dir.x/photon_dir.z)-(cap_dir.x/cap_dir.z)) + 
-		((photon_dir.y/photon_dir.z)-(cap_dir.y/cap_dir.z))*((photon_dir.y/photon_dir.z)-(cap_dir.y/cap_dir.z)) - 
-		((cap_rad1-cap_rad0)/(cap_coord1.z-cap_coord0.z))*((cap_rad1-cap_rad0)/(cap_coord1.z-cap_coord0.z)) );
-	b = (2.*(phot_coord0.x-cap_coord0.x)*((photon_dir.x/photon_dir.z)-(cap_dir.x/cap_dir.z)) + 2.*(phot_coord0.y-cap_coord0.y)*((photon_dir.y/photon_dir.z)-(cap_dir.y/cap_dir.z)) - 2.*cap_rad0*((cap_rad1-cap_rad0)/(cap_coord1.z-cap_coord0.z)));
-	c = ( (phot_coord0.x-cap_coord0.x)*(phot_coord0.x-cap_coord0.x) + (phot_coord0.y-cap_coord0.y)*(phot_coord0.y-cap_coord0.y) - cap_rad0*cap_rad0);
-	discr = b*b - 4.*a*c;
-	if(discr < 0)
+	d_slope_x = phot_slope.x - cap_slope.x;
+	d_slope_y = phot_slope.y - cap_slope.y;
+	d_x0 = phot_coord0.x - cap_coord0.x;
+	d_y0 = phot_coord0.y - cap_coord0.y;
+	if(single_precision)
+		n_solutions = polycap_capil_segment_solve_float(d_slope_x, d_slope_y, d_x0, d_y0, cap_rad0, rad_slope, &dist1, &dist2);
+	else
+		n_solutions = polycap_capil_segment_solve(d_slope_x, d_slope_y, d_x0, d_y0, cap_rad0, rad_slope, &dist1, &dist2);
+	if(n_solutions == 0)
 		return -2; //no solution in this segment
-	if(discr == 0){ //only 1 solution
-		dist1 = (-1.*b)/(2.*a);
+	if(n_solutions == 1){ //only 1 solution
 		interact_coord.z = phot_coord0.z + dist1;
 	} else { //2 solutions
-		dist1 = (-1.*b + sqrt(discr))/(2.*a);
-		dist2 = (-1.*b - sqrt(discr))/(2.*a);
 		// figure out which one of the two is the appropriate one
 		if(phot_coord0.z + dist1 < cap_coord0.z || phot_coord0.z + dist1 - photon_coord->z < 1.e-5 || phot_coord0.z + dist1 > cap_coord1.z){
 			//dist1 is not the right solution, so check dist2	
@@ -221,6 +224,12 @@ printf("surf_norm.x: %lf, y: %lf, z: %lf\n", surface_norm->x, surface_norm->y, s
 
 
 	//Determine surface_norm
+	//	as this is only required once an interaction point was found, it is not part of the precomputed segment coefficients
+	//	calculate distance between capillary axis coordinates (0 and 1), and distance between interaction point and cap_coord
+	cap_dir.x = cap_coord1.x - cap_coord0.x;
+	cap_dir.y = cap_coord1.y - cap_coord0.y;
+	cap_dir.z = cap_coord1.z - cap_coord0.z;
+	d_cap_coord = sqrt(polycap_scalar(cap_dir, cap_dir));
 	//	define point on capillary axis at same z as interact_coord
 	photon_coord_rel.x = phot_coord0.x - cap_coord0.x;
 	photon_coord_rel.y = phot_coord0.y - cap_coord0.y;
@@ -254,6 +263,63 @@ printf("surf_norm.x: %lf, y: %lf, z: %lf\n", surface_norm->x, surface_norm->y, s
 	return 1;	
 }
 //===========================================
+// calculates the intersection point coordinates of the photon trajectory and a given linear segment of the capillary wall
+STATIC int polycap_capil_segment(polycap_vector3 cap_coord0, polycap_vector3 cap_coord1, double cap_rad0, double cap_rad1, polycap_vector3 phot_coord0, polycap_vector3 phot_coord1, polycap_vector3 photon_dir, polycap_vector3 *photon_coord, polycap_vector3 *surface_norm, polycap_error **error)
+{
+	polycap_vector3 cap_slope, phot_slope; //capillary axis and photon trajectory change per unit z
+	double rad_slope; //capillary radius change per unit z
+
+	//argument sanity check
+	if (cap_coord0.z < 0.){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord0.z must be greater than 0");
+		return -1;
+	}
+	if (cap_coord1.z < 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord0.z must be greater than 0");
+		return -1;
+	}
+	if (cap_rad0 < 0.){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_rad0 must be greater than 0");
+		return -1;
+	}
+	if (cap_rad1 < 0.){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_rad1 must be greater than 0");
+		return -1;
+	}
+	if (photon_coord == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: photon_coord must not be NULL");
+		return -1;
+	}
+	if (photon_dir.z < 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: photon_dir.z must be greater than 0");
+		return -1;
+	}
+	if (surface_norm == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: surface_norm must not be NULL");
+		return -1;
+	}
+	if (cap_coord0.z != phot_coord0.z || cap_coord1.z != phot_coord1.z){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord and phot_coord must have identical z coordinate");
+		return -1;
+	}
+	if (cap_coord1.z <= cap_coord0.z){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_segment: cap_coord1.z must be greater than cap_coord0.z");
+		return -1;
+	}
+
+	polycap_norm(&photon_dir);
+
+	cap_slope.x = (cap_coord1.x - cap_coord0.x)/(cap_coord1.z - cap_coord0.z);
+	cap_slope.y = (cap_coord1.y - cap_coord0.y)/(cap_coord1.z - cap_coord0.z);
+	cap_slope.z = 1.;
+	rad_slope = (cap_rad1 - cap_rad0)/(cap_coord1.z - cap_coord0.z);
+	phot_slope.x = photon_dir.x/photon_dir.z;
+	phot_slope.y = photon_dir.y/photon_dir.z;
+	phot_slope.z = 1.;
+
+	return polycap_capil_segment_intersect(cap_coord0, cap_coord1, cap_rad0, cap_rad1, cap_slope, rad_slope, phot_coord0, phot_slope, photon_dir, false, photon_coord, surface_norm);
+}
+//===========================================
 /*
 STATIC int polycap_capil_segment(polycap_vector3 cap_coord0, polycap_vector3 cap_coord1, double cap_rad0, double cap_rad1, polycap_vector3 *photon_coord, polycap_vector3 photon_dir, polycap_vector3 *surface_norm, double *alfa, polycap_error **error)
 {
@@ -441,19 +507,54 @@ STATIC double polycap_refl(double e, double theta, double density, double scatf,
 }
 */
 //===========================================
-STATIC double polycap_refl_polar(double e, double density, double scatf, double lin_abs_coeff, polycap_vector3 surface_norm, polycap_photon *photon, polycap_vector3 *electric_vector, polycap_error **error) {
-	// scatf = SUM( (weight/A) * (Z + f')) over all elements in capillary material
-	// surface_norm is the surface normal vector
+// reflectivity at energy e of a wall hit at an angle theta between photon direction and surface normal, for a photon with a fraction frac_s of its electric vector along the s direction
+//	only depends on the photon energy and the wall material through e, density, scatf and lin_abs_coeff, which allows recomputing the weights of recorded reflections for other energies or materials
+double polycap_refl_fresnel(double e, double density, double scatf, double lin_abs_coeff, double theta, double frac_s) {
 	double alfa, beta; //alfa and beta component for Fresnel equation delta term (delta = alfa - i*beta)
 	_Dcomplex n; //index of refraction of the capillary material (n = 1. - delta)
 			//Index of refraction of medium inside capillary is assumed == 1 (vacuum, air)
 	_Dcomplex r_s, r_p; //reflectivity total, perpendicular (s) and parallel (p) to the plane of reflection
+	double frac_p; //fraction of electric_vector corresponding to the p direction
+	double cos_theta, sin_theta;
+	_Dcomplex n_inv, our_csqrt, tmp;
+	double r_s_double, r_p_double;
+
+	// calculate s and p reflection intensities
+	alfa = (HC/e)*(HC/e)*((N_AVOG*R0*density)/(2*M_PI)) * scatf;
+	beta = (HC)/(4.*M_PI) * (lin_abs_coeff/e);
+	n = new_Dcomplex(1.0 - alfa, beta);
+
+	cos_theta = cos(theta);
+	sin_theta = sin(theta);
+	n_inv = Dcomplex_inverse(n); // 1.0/n
+	tmp = Dcomplex_multiply_double(Dcomplex_multiply_Dcomplex(n_inv, n_inv), sin_theta * sin_theta);
+	our_csqrt = csqrt(new_Dcomplex(1.0 - creal(tmp), -1.0 * cimag(tmp)));
+
+	tmp = Dcomplex_multiply_Dcomplex(n, our_csqrt);
+	r_s = Dcomplex_multiply_Dcomplex(new_Dcomplex(cos_theta - creal(tmp), -1.0 * cimag(tmp)), Dcomplex_inverse(new_Dcomplex(cos_theta + creal(tmp), cimag(tmp))));
+	r_s_double = cabs(r_s);
+	r_s_double *= r_s_double; 
+
+	tmp = Dcomplex_multiply_double(n, cos_theta);
+	r_p = Dcomplex_multiply_Dcomplex(new_Dcomplex(creal(our_csqrt) - creal(tmp), cimag(our_csqrt) - cimag(tmp)), Dcomplex_inverse(new_Dcomplex(creal(our_csqrt) + creal(tmp), cimag(our_csqrt) + cimag(tmp))));
+	r_p_double = cabs(r_p);
+	r_p_double *= r_p_double; 
+
+	frac_p = 1.-frac_s; //what's not along s, is along p direction
+
+	// Determine rtot based on fraction of electric field in s and p direction
+	return r_s_double * frac_s + r_p_double * frac_p;
+}
+//===========================================
+// polycap_refl_polar(), additionally storing the energy independent angles of the reflection in refl_event if not NULL
+static double polycap_refl_polar_event(double e, double density, double scatf, double lin_abs_coeff, polycap_vector3 surface_norm, polycap_photon *photon, polycap_vector3 *electric_vector, polycap_refl_event *refl_event, polycap_error **error) {
+	// scatf = SUM( (weight/A) * (Z + f')) over all elements in capillary material
+	// surface_norm is the surface normal vector
 	polycap_vector3 s_dir, p_dir; //vector along s and p direction (p_dir is orthogonal to s_dir and surface_norm)
 	double frac_s, frac_p; //fraction of electric_vector corresponding to s and p directions
 	double angle_a, angle_b, angle_c; //some cos of angles between electric vector and (a=s_dir, b=surface_norm, c=p_dir)
-	double cos_theta, sin_theta, theta; // theta is the angle between photon direction and surface normal
-	_Dcomplex n_inv, our_csqrt, tmp;
-	double r_s_double, r_p_double, rtot;
+	double theta; // theta is the angle between photon direction and surface normal
+	double rtot;
 
 	//argument sanity check
 	if (e < 1. || e > 100.){
@@ -489,27 +590,6 @@ STATIC double polycap_refl_polar(double e, double density, double scatf, double
 	if(sqrt(photon->exit_electric_vector.x*photon->exit_electric_vector.x+photon->exit_electric_vector.y*photon->exit_electric_vector.y+photon->exit_electric_vector.z*photon->exit_electric_vector.z) != 1)
 		polycap_norm(&photon->exit_electric_vector);
 
-	// calculate s and p reflection intensities
-	alfa = (HC/e)*(HC/e)*((N_AVOG*R0*density)/(2*M_PI)) * scatf;
-	beta = (HC)/(4.*M_PI) * (lin_abs_coeff/e);
-	n = new_Dcomplex(1.0 - alfa, beta);
-
-	cos_theta = cos(theta);
-	sin_theta = sin(theta);
-	n_inv = Dcomplex_inverse(n); // 1.0/n
-	tmp = Dcomplex_multiply_double(Dcomplex_multiply_Dcomplex(n_inv, n_inv), sin_theta * sin_theta);
-	our_csqrt = csqrt(new_Dcomplex(1.0 - creal(tmp), -1.0 * cimag(tmp)));
-
-	tmp = Dcomplex_multiply_Dcomplex(n, our_csqrt);
-	r_s = Dcomplex_multiply_Dcomplex(new_Dcomplex(cos_theta - creal(tmp), -1.0 * cimag(tmp)), Dcomplex_inverse(new_Dcomplex(cos_theta + creal(tmp), cimag(tmp))));
-	r_s_double = cabs(r_s);
-	r_s_double *= r_s_double; 
-
-	tmp = Dcomplex_multiply_double(n, cos_theta);
-	r_p = Dcomplex_multiply_Dcomplex(new_Dcomplex(creal(our_csqrt) - creal(tmp), cimag(our_csqrt) - cimag(tmp)), Dcomplex_inverse(new_Dcomplex(creal(our_csqrt) + creal(tmp), cimag(our_csqrt) + cimag(tmp))));
-	r_p_double = cabs(r_p);
-	r_p_double *= r_p_double; 
-
 	// calculate fraction of electric vector in s and p directions
 		//s direction is perpendicular to both photon incident direction and surface norm
 		//determine this direction by making vector product of both vectors
@@ -532,10 +612,13 @@ STATIC double polycap_refl_polar(double e, double density, double scatf, double
 	angle_a = polycap_scalar(photon->exit_electric_vector, s_dir);
 	frac_s = angle_a*angle_a; //square it
 	frac_p = 1.-frac_s; //what's not along s, is along p direction
-	//printf("/theta: %lf, frac_s: %lf, r_s: %lf, frac_p: %lf, r_p: %lf\n", theta, frac_s, creal(r_s), frac_p, creal(r_p));
 
 	// Determine rtot based on fraction of electric field in s and p direction
-	rtot = r_s_double * frac_s + r_p_double * frac_p;
+	rtot = polycap_refl_fresnel(e, density, scatf, lin_abs_coeff, theta, frac_s);
+	if(refl_event != NULL){
+		refl_event->theta = theta;
+		refl_event->frac_s = frac_s;
+	}
 
 	// Adjust electric_vector based on reflection in s and p direction
 	angle_b = polycap_scalar(photon->exit_electric_vector, surface_norm);
@@ -562,6 +645,10 @@ STATIC double polycap_refl_polar(double e, double density, double scatf, double
 //	this is done by simply adding r_p and r_s
 }
 //===========================================
+STATIC double polycap_refl_polar(double e, double density, double scatf, double lin_abs_coeff, polycap_vector3 surface_norm, polycap_photon *photon, polycap_vector3 *electric_vector, polycap_error **error) {
+	return polycap_refl_polar_event(e, density, scatf, lin_abs_coeff, surface_norm, photon, electric_vector, NULL, error);
+}
+//===========================================
 int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm, bool leak_calc, polycap_error **error)
 {
 	int i, iesc=-5, wall_trace=0, iesc_temp=0;
@@ -569,12 +656,11 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 	double rtot; //reflectivity
 	double *w_leak; //leak weight
 	int r_cntr, q_cntr; //indices of neighbouring capillary photon traveled towards 
-	double z; //hexagon radial distance z
 	double d_travel;  //distance photon traveled through the capillary wall
 	int leak_flag=0, weight_flag=0;
 	polycap_vector3 leak_coords;
 	polycap_photon *phot_temp;
-	double *capx_temp, *capy_temp;
+	polycap_capil_axis cap_axis_temp;
 	int ix_val_temp = 0;
 	int *ix_temp = &ix_val_temp; //index to remember from which part of capillary last interaction was calculated
 	double n_shells; //amount of capillary shells in polycapillary
@@ -582,6 +668,8 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 	double current_polycap_ext;
 	polycap_vector3 electric_vector; //new electric vector after reflection will be stored here
 	double alfa; // angle between photon direction and capillary surface
+	polycap_refl_event refl_event; //energy independent description of this reflection, stored if the photon records its history
+	polycap_refl_event *refl_history_temp;
 
 	//argument sanity check
 	if (photon == NULL){
@@ -628,7 +716,7 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 
 		//reflectivity according to Fresnel expression
 		//rtot = polycap_refl(photon->energies[i], alfa, description->density, photon->scatf[i], photon->amu[i], error);
-		rtot = polycap_refl_polar(photon->energies[i], description->density, photon->scatf[i], photon->amu[i], surface_norm, photon, &electric_vector, error);
+		rtot = polycap_refl_polar_event(photon->energies[i], description->density, photon->scatf[i], photon->amu[i], surface_norm, photon, &electric_vector, i == 0 ? &refl_event : NULL, error);
 		if( rtot < 0. || rtot > 1.){
 			polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_capil_reflect: rtot should be greater than or equal to 0 and smaller than or equal to 1 -> %s", strerror(errno));
 			free(w_leak);
@@ -644,6 +732,21 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 		if(photon->weight[i] >= 1.e-4) weight_flag = 1;
 	}
 	//printf("	w0: %lf, lw0: %lf, w_sum: %lf, d_trav: %lf, exp: %lf \n", photon->weight[0], w_leak[0], photon->weight[0]+w_leak[0], d_travel, exp(-1.*d_travel*photon->amu[0]));
+	//store the reflection so the weights can be reconstructed afterwards for any energy
+	if(photon->record_history && photon->n_energies > 0){
+		if(photon->n_refl_history == photon->refl_history_mem_size){
+			photon->refl_history_mem_size = photon->refl_history_mem_size == 0 ? 16 : 2 * photon->refl_history_mem_size;
+			refl_history_temp = realloc(photon->refl_history, sizeof(polycap_refl_event) * photon->refl_history_mem_size);
+			if(refl_history_temp == NULL){
+				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for photon->refl_history -> %s", strerror(errno));
+				free(w_leak);
+				return -1;
+			}
+			photon->refl_history = refl_history_temp;
+		}
+		refl_event.alfa = alfa;
+		photon->refl_history[photon->n_refl_history++] = refl_event;
+	}
 	//stop calculation if none of the energy weights is above threshold
 	if (weight_flag != 1) {
 		iesc = 0;
@@ -652,7 +755,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 	photon->exit_electric_vector.x = electric_vector.x;
 	photon->exit_electric_vector.y = electric_vector.y;
 	photon->exit_electric_vector.z = electric_vector.z;
-	n_shells = round(sqrt(12. * photon->description->n_cap - 3.)/6.-0.5);
 
 	// save leak coordinates and weights for all energies.
 	if(leak_flag == 1){
@@ -666,19 +768,16 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 
 		// check if leak_coords are within polycapillary boundaries (they should be, if wall_trace ==1)
 		if(wall_trace == 1){
-			for(i=0; i < photon->description->profile->nmax; i++){
-				if(photon->description->profile->z[i] <= leak_coords.z)
-					z_id = i;
-			}
+			z_id = polycap_profile_find_segment(photon->description->profile, leak_coords.z, photon->description->profile->nmax-1, z_id);
 			current_polycap_ext = ((photon->description->profile->ext[z_id+1] - photon->description->profile->ext[z_id])/
 				(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
 				(leak_coords.z - photon->description->profile->z[z_id]) + photon->description->profile->ext[z_id];
-			if(n_shells == 0.){ //monocapillary case
+			if(photon->description->geometry.monocap){ //monocapillary case
 				if(sqrt(leak_coords.x*leak_coords.x + leak_coords.y*leak_coords.y) >= current_polycap_ext){
 					wall_trace = 3;
 				}
 			} else { //polycapillary case
-				if(polycap_photon_within_pc_boundary(current_polycap_ext, leak_coords, error) == 0){
+				if(polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), leak_coords.x, leak_coords.y) == 0){
 					wall_trace = 3;
 				}
 			}
@@ -717,6 +816,7 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 			phot_temp->i_refl = photon->i_refl; //phot_temp reflect photon->i_refl times before starting its reflection inside new capillary, so add this to total amount
 			phot_temp->n_extleak = 0; //set leaks to 0
 			phot_temp->n_intleak = 0; //set intleak to 0
+			phot_temp->single_precision = photon->single_precision;
 			//add traveled distance to d_travel
 			phot_temp->d_travel = photon->d_travel + d_travel; //NOTE: this is total traveled distance, however the weight has been adjusted already for the distance d_travel, so post-simulation air-absorption correction may induce some errors here. Users are advised to not perform air absorption corrections for leaked photons. //TODO: when adding our own internal air absorption, this will become a redundant note
 			phot_temp->n_energies = photon->n_energies;
@@ -738,53 +838,36 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 				phot_temp->weight[i] = w_leak[i];
 				phot_temp->energies[i] = photon->energies[i];
 			}
-			polycap_photon_scatf(phot_temp, error);
+			//the new photon shares the description and energies of its parent, so its attenuation coefficients and scattering factors can be copied
+			phot_temp->amu = malloc(sizeof(double)*phot_temp->n_energies);
 			if(phot_temp->amu == NULL){
 				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for phot_temp->amu -> %s", strerror(errno));
 				polycap_photon_free(phot_temp);
 				free(w_leak);
 				return -1;
 			}
+			phot_temp->scatf = malloc(sizeof(double)*phot_temp->n_energies);
 			if(phot_temp->scatf == NULL){
 				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for phot_temp->scatf -> %s", strerror(errno));
 				polycap_photon_free(phot_temp);
 				free(w_leak);
 				return -1;
 			}
-			capx_temp = malloc(sizeof(double)*(description->profile->nmax+1));
-			if(capx_temp == NULL){
-				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for capx_temp -> %s", strerror(errno));
-				polycap_photon_free(phot_temp);
-				free(w_leak);
-				return -1;
-			}
-			capy_temp = malloc(sizeof(double)*(description->profile->nmax+1));
-			if(capy_temp == NULL){
-				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for capy_temp -> %s", strerror(errno));
-				free(capx_temp);
-				polycap_photon_free(phot_temp);
-				free(w_leak);
-				return -1;
-			}
-			n_shells = round(sqrt(12. * phot_temp->description->n_cap - 3.)/6.-0.5);
-			for(i=0; i<=description->profile->nmax; i++){
-				if(description->profile->z[i] <= phot_temp->exit_coords.z) *ix_temp = i; //set ix_temp to current photon id value
-				if(n_shells == 0.){ //monocapillary case, normally code should never reach here (wall_trace should not return 1 for monocaps)
-					capx_temp[i] = 0.;
-					capy_temp[i] = 0.;
-				} else {
-					z = description->profile->ext[i]/(2.*COSPI_6*(n_shells+1));
-					capy_temp[i] = (3./2) * r_cntr * z;
-					capx_temp[i] = (2.* q_cntr + r_cntr) * COSPI_6 * z;
-				}
+			memcpy(phot_temp->amu, photon->amu, sizeof(double)*phot_temp->n_energies);
+			memcpy(phot_temp->scatf, photon->scatf, sizeof(double)*phot_temp->n_energies);
+			n_shells = phot_temp->description->geometry.n_shells;
+			if(phot_temp->description->geometry.monocap){ //monocapillary case, normally code should never reach here (wall_trace should not return 1 for monocaps)
+				cap_axis_temp = polycap_capil_axis_new(n_shells, 0., 0.);
+			} else {
+				cap_axis_temp = polycap_capil_axis_new(n_shells, q_cntr, r_cntr);
 			}
-			//polycap_capil_trace should be ran description->profile->nmax at most,
-			//which means it essentially reflected once every known capillary coordinate
+			*ix_temp = polycap_profile_find_segment(description->profile, phot_temp->exit_coords.z, description->profile->nmax, *ix_temp); //set ix_temp to current photon id value
+			//polycap_capil_trace should be ran description->profile->nmax_trace at most,
+			//which means it essentially reflected once every known capillary coordinate of the uncompacted profile
 //printf("Here wal_trace == 1, q: %i r: %i, n_shells: %lf\n",q_cntr, r_cntr, n_shells);
-//printf("capx_0: %lf: y_0: %lf, ix_temp: %i, ph_t_exit.x: %lf y: %lf z: %lf, ext[0]: %lf\n", capx_temp[0], capy_temp[0], *ix_temp, phot_temp->exit_coords.x, phot_temp->exit_coords.y, phot_temp->exit_coords.z, description->profile->ext[0]);
-			for(i=*ix_temp; i<=description->profile->nmax; i++){
+			for(i=*ix_temp; i<=description->profile->nmax_trace; i++){
 //printf("	Initiating phot_temp trace: photx: %lf, y: %lf, z: %lf, q: %i, r: %i, phot_exit.x: %lf, y: %lf, z: %lf, exit_dir.x: %lf, y: %lf, z: %lf, ix_temp: %i\n", phot_temp->start_coords.x, phot_temp->start_coords.y, phot_temp->start_coords.z, q_cntr, r_cntr, phot_temp->exit_coords.x, phot_temp->exit_coords.y, phot_temp->exit_coords.z, phot_temp->exit_direction.x, phot_temp->exit_direction.y, phot_temp->exit_direction.z, *ix_temp);
-				iesc_temp = polycap_capil_trace(ix_temp, phot_temp, description, capx_temp, capy_temp, leak_calc, error);
+				iesc_temp = polycap_capil_trace(ix_temp, phot_temp, description, cap_axis_temp, leak_calc, error);
 				if(iesc_temp != 1){ //as long as iesc_temp = 1 photon is still reflecting in capillary
 					//iesc_temp == 0, which means this photon has reached its final point (weight[*] <1e-4)
 					//alternatively, iesc_temp can be -2 or -3 due to not finding intersection point, as the photon reached the end of the capillary/is outside of the optic
@@ -798,8 +881,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 			//iesc_temp could be == -1 if errors occurred...
 			if(iesc_temp == -1 || iesc_temp == -3){
 				polycap_photon_free(phot_temp);
-				free(capx_temp);
-				free(capy_temp);
 				free(w_leak);
 				return -2;
 			}
@@ -813,8 +894,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 				if(photon->extleak == NULL){
 					polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: could not allocate memory for photon->extleak -> %s", strerror(errno));
 					polycap_photon_free(phot_temp);
-					free(capx_temp);
-					free(capy_temp);
 					free(w_leak);
 					return -1;
 				}
@@ -829,8 +908,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 				if(photon->intleak == NULL){
 					polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect: *could not allocate memory for photon->intleak -> %s", strerror(errno));
 					polycap_photon_free(phot_temp);
-					free(capx_temp);
-					free(capy_temp);
 					free(w_leak);
 					return -1;
 				}
@@ -849,7 +926,7 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 				leak_coords.x = phot_temp->exit_coords.x + phot_temp->exit_direction.x * ((phot_temp->description->profile->z[phot_temp->description->profile->nmax]-phot_temp->exit_coords.z)/phot_temp->exit_direction.z );
 				leak_coords.y = phot_temp->exit_coords.y + phot_temp->exit_direction.y * ((phot_temp->description->profile->z[phot_temp->description->profile->nmax]-phot_temp->exit_coords.z)/phot_temp->exit_direction.z);
 				leak_coords.z = phot_temp->exit_coords.z + phot_temp->exit_direction.z * ((phot_temp->description->profile->z[phot_temp->description->profile->nmax]-phot_temp->exit_coords.z)/phot_temp->exit_direction.z);
-				iesc_temp = polycap_photon_within_pc_boundary(phot_temp->description->profile->ext[phot_temp->description->profile->nmax], leak_coords, error);
+				iesc_temp = polycap_hex_within_boundary(phot_temp->description->profile->ext_apothem[phot_temp->description->profile->nmax], leak_coords.x, leak_coords.y);
 				//iesc_temp == 0: photon outside of PC boundaries
 				//iesc_temp == 1: photon within PC boundaries
 				if(iesc_temp == 0){ //Save event as leak
@@ -857,8 +934,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 					if(photon->extleak == NULL){
 						polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect#2: could not allocate memory for photon->extleak -> %s", strerror(errno));
 						polycap_photon_free(phot_temp);
-						free(capx_temp);
-						free(capy_temp);
 						free(w_leak);
 						return -1;
 					}
@@ -869,8 +944,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 					if(photon->intleak == NULL){
 						polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_capil_reflect#2: could not allocate memory for photon->intleak -> %s", strerror(errno));
 						polycap_photon_free(phot_temp);
-						free(capx_temp);
-						free(capy_temp);
 						free(w_leak);
 						return -1;
 					}
@@ -881,8 +954,6 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 
 			// Free memory that's no longer needed
 			polycap_photon_free(phot_temp);
-			free(capx_temp);
-			free(capy_temp);
 		} //endif(wall_trace == 1){ // photon entered new capillary through the capillary walls	
 	}//endif(leak_flag == 1)
 
@@ -895,14 +966,14 @@ int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm,
 //TODO: currently ignores the refraction of light when going from air to polycap medium
 int polycap_capil_trace_wall(polycap_photon *photon, double *d_travel, int *r_cntr, int *q_cntr, polycap_error **error)
 {
-	int i, photon_pos_check = 0, iesc = 0;
+	int photon_pos_check = 0, iesc = 0;
 	int z_id = 0; 
 	double current_polycap_ext = 0;
 	polycap_vector3 photon_coord_rel; //relative photon_coords
 	double n_shells; //amount of capillary shells in polycapillary
 	double r_i, q_i, z; //indices of selected capillary and radial distance z
 	polycap_vector3 cap_coord0, cap_coord1, phot_coord0, phot_coord1, temp_phot;
-	polycap_vector3 *phot_inter=NULL; //intersection coordinate of photn propagation and PC exterior
+	polycap_vector3 phot_inter; //intersection coordinate of photn propagation and PC exterior
 	double rad0, rad1;
 	polycap_vector3 interact_coords, surface_norm;
 	double q_new=0, r_new=0;
@@ -920,10 +991,7 @@ int polycap_capil_trace_wall(polycap_photon *photon, double *d_travel, int *r_cn
 	// 	current coordinates are photon->exit_coords
 	if(photon->exit_coords.z >= photon->description->profile->z[photon->description->profile->nmax])
 		return -2; //photon already at end of polycap, so there is no wall to travel through anyway
-	for(i=0; i < photon->description->profile->nmax; i++){
-		if(photon->description->profile->z[i] <= photon->exit_coords.z)
-			z_id = i;
-	}
+	z_id = polycap_profile_find_segment(photon->description->profile, photon->exit_coords.z, photon->description->profile->nmax-1, z_id);
 	//	interpolate the exterior size between index z_id and next point
 	if(photon->description->profile->z[z_id] != photon->exit_coords.z){
 		current_polycap_ext = ((photon->description->profile->ext[z_id+1] - photon->description->profile->ext[z_id])/
@@ -941,14 +1009,14 @@ int polycap_capil_trace_wall(polycap_photon *photon, double *d_travel, int *r_cn
 	//calculate amount of shells in polycapillary
 	//NOTE: with description->n_cap <7 only a mono-capillary will be simulated.
 	//    10 describes 1 shell (of 7 capillaries), ... due to hexagon stacking
-	n_shells = round(sqrt(12. * photon->description->n_cap - 3.)/6.-0.5);
-	if(n_shells == 0.){ //monocapillary case
+	n_shells = photon->description->geometry.n_shells;
+	if(photon->description->geometry.monocap){ //monocapillary case
 		if(sqrt((photon->exit_coords.x)*(photon->exit_coords.x) + (photon->exit_coords.y)*(photon->exit_coords.y)) > current_polycap_ext){
 			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace_wall: photon_pos_check: photon not within monocapillary boundaries");
 			return -2;
 		}
 	} else { //polycapillary case
-		photon_pos_check = polycap_photon_within_pc_boundary(current_polycap_ext, photon->exit_coords, error);
+		photon_pos_check = polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), photon->exit_coords.x, photon->exit_coords.y);
 		//iesc == 0: photon outside of PC boundaries
 		//iesc == 1: photon within PC boundaries
 		if(photon_pos_check == 0){
@@ -958,26 +1026,14 @@ int polycap_capil_trace_wall(polycap_photon *photon, double *d_travel, int *r_cn
 	}
 
 	// obtain the capillary indices of the capillary region the photon is currently in
-	z = current_polycap_ext/(2.*COSPI_6*(n_shells+1));
-	r_i = photon->exit_coords.y * (2./3) / z;
-	q_i = (photon->exit_coords.x/(2.*COSPI_6) - photon->exit_coords.y/3) / z;
-	if (fabs(q_i - round(q_i)) > fabs(r_i - round(r_i)) && fabs(q_i - round(q_i)) > fabs(-1.*q_i-r_i - round(-1.*q_i-r_i)) ){
-		q_i = -1.*round(r_i) - round(-1.*q_i-r_i);
-		r_i = round(r_i);
-	} else if (fabs(r_i - round(r_i)) >  fabs(-1.*q_i-r_i - round(-1.*q_i-r_i))){
-		r_i = -1.*round(q_i) - round(-1.*q_i-r_i);
-		q_i = round(q_i);
-	} else {
-		q_i = round(q_i);
-		r_i = round(r_i);
-	}
+	polycap_hex_round(current_polycap_ext/photon->description->geometry.z_div, photon->exit_coords.x, photon->exit_coords.y, &q_i, &r_i);
 
 /*
 	// confirm that photon is currently not within capillary but in wall
 	rad0 = ((photon->description->profile->cap[z_id+1] - photon->description->profile->cap[z_id])/
 		(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
 		(photon->exit_coords.z - photon->description->profile->z[z_id]) + photon->description->profile->cap[z_id];
-	z = current_polycap_ext/(2.*COSPI_6*(n_shells+1));
+	z = current_polycap_ext/photon->description->geometry.z_div;
 	cap_coord0.y = r_i * (3./2) * z;
 	cap_coord0.x = (2.* q_i+r_i) * COSPI_6 * z;
 	d_phot0 = sqrt((photon->exit_coords.x-cap_coord0.x)*(photon->exit_coords.x-cap_coord0.x)+(photon->exit_coords.y-cap_coord0.y)*(photon->exit_coords.y-cap_coord0.y));
@@ -989,7 +1045,7 @@ printf("	trace wall: phot not in cap wall, q: %lf r: %lf\n",q_i, r_i);
 */
 
 	// There should be an intersection point between capillary wall and photon trajectory... Find it!
-	if(n_shells == 0.){ //monocapillary case
+	if(photon->description->geometry.monocap){ //monocapillary case
 		iesc = 0;
 		do{
 			rad0 = photon->description->profile->cap[z_id];
@@ -1021,10 +1077,7 @@ next_hexagon:
 			phot_coord0.y = photon->exit_coords.y + dist*photon->exit_direction.y;
 			phot_coord0.z = photon->exit_coords.z + dist*photon->exit_direction.z;
 			// find current segment index and current polycap ext
-			for(i=0; i < photon->description->profile->nmax; i++){
-				if(photon->description->profile->z[i] <= phot_coord0.z)
-					z_id = i;
-			}
+			z_id = polycap_profile_find_segment(photon->description->profile, phot_coord0.z, photon->description->profile->nmax-1, z_id);
 			current_polycap_ext = ((photon->description->profile->ext[z_id+1] - photon->description->profile->ext[z_id])/
 				(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
 				(phot_coord0.z - photon->description->profile->z[z_id]) + photon->description->profile->ext[z_id];
@@ -1032,24 +1085,15 @@ next_hexagon:
 				(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
 				(phot_coord0.z - photon->description->profile->z[z_id]) + photon->description->profile->cap[z_id];
 			// obtain the capillary indices of the projected photon
-			z = current_polycap_ext/(2.*COSPI_6*(n_shells+1));
-			r_new = phot_coord0.y * (2./3) / z;
-			q_new = (phot_coord0.x/(2.*COSPI_6) - phot_coord0.y/3) / z;
-			if (fabs(q_new - round(q_new)) > fabs(r_new - round(r_new)) && fabs(q_new - round(q_new)) > fabs(-1.*q_new-r_new - round(-1.*q_new-r_new)) ){
-				q_new = -1.*round(r_new) - round(-1.*q_new-r_new);
-				r_new = round(r_new);
-			} else if (fabs(r_new - round(r_new)) >  fabs(-1.*q_new-r_new - round(-1.*q_new-r_new))){
-				r_new = -1.*round(q_new) - round(-1.*q_new-r_new);
-				q_new = round(q_new);
-			} else {
-				q_new = round(q_new);
-				r_new = round(r_new);
-			}
+			z = current_polycap_ext/photon->description->geometry.z_div;
+			d_phot0 = polycap_hex_round(z, phot_coord0.x, phot_coord0.y, &q_new, &r_new);
 			// check if photon happens to be inside initial capillary. Could have started in q_i,r_i just next to capillary
-			z = current_polycap_ext/(2.*COSPI_6*(n_shells+1));
-			cap_coord0.y = r_i * (3./2) * z;
-			cap_coord0.x = (2.* q_i+r_i) * COSPI_6 * z;
-			d_phot0 = sqrt((phot_coord0.x-cap_coord0.x)*(phot_coord0.x-cap_coord0.x)+(phot_coord0.y-cap_coord0.y)*(phot_coord0.y-cap_coord0.y));
+			//	while the photon is still in hexagon q_i,r_i its distance to the capillary axis is already known
+			if(q_new != q_i || r_new != r_i){
+				cap_coord0.y = r_i * (3./2) * z;
+				cap_coord0.x = (2.* q_i+r_i) * COSPI_6 * z;
+				d_phot0 = sqrt((phot_coord0.x-cap_coord0.x)*(phot_coord0.x-cap_coord0.x)+(phot_coord0.y-cap_coord0.y)*(phot_coord0.y-cap_coord0.y));
+			}
 			if(d_phot0 < rad0 && fabs(q_i) <= n_shells && fabs(r_i) <= n_shells && fabs(-1.*q_i-r_i) <= n_shells){ //photon stumbled into capillary q_i,r_i
 				// calculate d_travel and set q_cntr and r_cntr for photon that got this far
 				photon_coord_rel.x = phot_coord0.x - photon->exit_coords.x;
@@ -1078,19 +1122,16 @@ next_hexagon:
 			// calculate d_travel and set q_cntr and r_cntr for photon that got this far
 			*r_cntr = r_new;
 			*q_cntr = q_new;
-			if(polycap_photon_within_pc_boundary(photon->description->profile->ext[photon->description->profile->nmax], temp_phot, error) == 0){
+			if(polycap_hex_within_boundary(photon->description->profile->ext_apothem[photon->description->profile->nmax], temp_phot.x, temp_phot.y) == 0){
 				//photon not in polycap at exit window, so escaped through walls
-				phot_inter = polycap_photon_pc_intersect(temp_phot, photon->exit_direction, photon->description->profile, error);
-				if(phot_inter == NULL){ // if no interaction was found, just use last known coordinate. Less precise, but should be sufficient in most cases
+				if(!polycap_photon_pc_intersect(temp_phot, photon->exit_direction, photon->description->profile, &phot_inter, error)){ // if no interaction was found, just use last known coordinate. Less precise, but should be sufficient in most cases
 					photon_coord_rel.x = phot_coord0.x - photon->exit_coords.x;
 					photon_coord_rel.y = phot_coord0.y - photon->exit_coords.y;
 					photon_coord_rel.z = phot_coord0.z - photon->exit_coords.z;
 				} else {
-					photon_coord_rel.x = phot_inter->x - photon->exit_coords.x;
-					photon_coord_rel.y = phot_inter->y - photon->exit_coords.y;
-					photon_coord_rel.z = phot_inter->z - photon->exit_coords.z;
-					free(phot_inter);
-					phot_inter = NULL;
+					photon_coord_rel.x = phot_inter.x - photon->exit_coords.x;
+					photon_coord_rel.y = phot_inter.y - photon->exit_coords.y;
+					photon_coord_rel.z = phot_inter.z - photon->exit_coords.z;
 				}
 
 				*d_travel = sqrt(polycap_scalar(photon_coord_rel, photon_coord_rel));
@@ -1118,11 +1159,11 @@ next_hexagon:
 			phot_coord1.y = photon->exit_coords.y + photon->exit_direction.y * (photon->description->profile->z[z_id+1]-photon->exit_coords.z)/photon->exit_direction.z;
 			phot_coord1.z = photon->description->profile->z[z_id+1];
 
-			z = photon->description->profile->ext[z_id]/(2.*COSPI_6*(n_shells+1));
+			z = photon->description->geometry.hex_dist[z_id];
 			cap_coord0.y = r_new * (3./2) * z;
 			cap_coord0.x = (2.* q_new+r_new) * COSPI_6 * z;
 			cap_coord0.z = photon->description->profile->z[z_id];
-			z = photon->description->profile->ext[z_id+1]/(2.*COSPI_6*(n_shells+1));
+			z = photon->description->geometry.hex_dist[z_id+1];
 			cap_coord1.y = r_new * (3./2) * z;
 			cap_coord1.x = (2.* q_new+r_new) * COSPI_6 * z;
 			cap_coord1.z = photon->description->profile->z[z_id+1];
@@ -1152,19 +1193,16 @@ next_hexagon:
 		temp_phot.y = photon->exit_coords.y + photon->exit_direction.y * (photon->description->profile->z[photon->description->profile->nmax]-photon->exit_coords.z)/photon->exit_direction.z;
 		temp_phot.z = photon->description->profile->z[photon->description->profile->nmax];
 		// calculate d_travel and set q_cntr and r_cntr for photon that got this far
-		if(polycap_photon_within_pc_boundary(photon->description->profile->ext[photon->description->profile->nmax], temp_phot, error) == 0){
+		if(polycap_hex_within_boundary(photon->description->profile->ext_apothem[photon->description->profile->nmax], temp_phot.x, temp_phot.y) == 0){
 			//photon not in polycap at exit window, so escaped through side walls
-			phot_inter = polycap_photon_pc_intersect(temp_phot, photon->exit_direction, photon->description->profile, error);
-			if(phot_inter == NULL){ // if no interaction was found, just use last known coordinate. Less precise, but should be sufficient in most cases
+			if(!polycap_photon_pc_intersect(temp_phot, photon->exit_direction, photon->description->profile, &phot_inter, error)){ // if no interaction was found, just use last known coordinate. Less precise, but should be sufficient in most cases
 				photon_coord_rel.x = temp_phot.x - photon->exit_coords.x;
 				photon_coord_rel.y = temp_phot.y - photon->exit_coords.y;
 				photon_coord_rel.z = temp_phot.z - photon->exit_coords.z;
 			} else {
-				photon_coord_rel.x = phot_inter->x - photon->exit_coords.x;
-				photon_coord_rel.y = phot_inter->y - photon->exit_coords.y;
-				photon_coord_rel.z = phot_inter->z - photon->exit_coords.z;
-				free(phot_inter);
-				phot_inter = NULL;
+				photon_coord_rel.x = phot_inter.x - photon->exit_coords.x;
+				photon_coord_rel.y = phot_inter.y - photon->exit_coords.y;
+				photon_coord_rel.z = phot_inter.z - photon->exit_coords.z;
 			}
 			*d_travel = sqrt(polycap_scalar(photon_coord_rel, photon_coord_rel));
 			return 3;
@@ -1192,23 +1230,255 @@ next_hexagon:
 	return -1; //the function should actually never return -1 here. All (physical) options are covered by return values 1, 2 and 3.
 
 }
+//===========================================
+// evaluate a polynomial with coefficients in increasing order
+static double polycap_poly_eval(const double *coeff, int degree, double t)
+{
+	double result = coeff[degree];
+	int i;
+
+	for(i=degree-1; i>=0; i--)
+		result = result*t + coeff[i];
+	return result;
+}
+//===========================================
+// multiply two polynomials with coefficients in increasing order
+static void polycap_poly_multiply(const double *coeff1, int degree1, const double *coeff2, int degree2, double *result)
+{
+	int i, j;
+
+	for(i=0; i<=degree1+degree2; i++)
+		result[i] = 0.;
+	for(i=0; i<=degree1; i++)
+		for(j=0; j<=degree2; j++)
+			result[i+j] += coeff1[i]*coeff2[j];
+}
+//===========================================
+// find the real roots of a polynomial within [t_min,t_max], in increasing order, and return their amount
+// 	up to degree 2 they follow from a closed form, otherwise the roots of the derivative split the interval in monotonic parts, each of which contains at most one root
+// 	that is found with Newton-Raphson, falling back to bisection whenever a step would leave the part
+static int polycap_poly_roots(const double *coeff, int degree, double t_min, double t_max, double *roots)
+{
+	double deriv[POLY_MAX_DEGREE], bounds[POLY_MAX_DEGREE+1];
+	double lo, hi, f_lo, f_hi, f, t, t_new;
+	int i, j, n_bounds, n_roots = 0;
+
+	while(degree > 0 && coeff[degree] == 0.)
+		degree--;
+	if(degree == 0 || t_min > t_max)
+		return 0;
+	if(degree == 1){
+		t = -1.*coeff[0]/coeff[1];
+		if(t >= t_min && t <= t_max)
+			roots[n_roots++] = t;
+		return n_roots;
+	}
+	if(degree == 2){
+		//numerically stable form of the quadratic formula
+		f = coeff[1]*coeff[1] - 4.*coeff[2]*coeff[0];
+		if(f < 0.)
+			return 0;
+		f = -0.5*(coeff[1] + (coeff[1] < 0. ? -1. : 1.)*sqrt(f));
+		lo = f/coeff[2];
+		hi = f != 0. ? coeff[0]/f : lo;
+		if(hi < lo){
+			t = lo;
+			lo = hi;
+			hi = t;
+		}
+		if(lo >= t_min && lo <= t_max)
+			roots[n_roots++] = lo;
+		if(hi != lo && hi >= t_min && hi <= t_max)
+			roots[n_roots++] = hi;
+		return n_roots;
+	}
+
+	for(i=1; i<=degree; i++)
+		deriv[i-1] = i*coeff[i];
+	bounds[0] = t_min;
+	n_bounds = 1 + polycap_poly_roots(deriv, degree-1, t_min, t_max, bounds+1);
+	bounds[n_bounds++] = t_max;
+
+	f_hi = polycap_poly_eval(coeff, degree, t_min);
+	for(i=0; i<n_bounds-1; i++){
+		lo = bounds[i];
+		hi = bounds[i+1];
+		f_lo = f_hi;
+		f_hi = polycap_poly_eval(coeff, degree, hi);
+		if(f_lo == 0.){
+			if(n_roots == 0 || roots[n_roots-1] != lo)
+				roots[n_roots++] = lo;
+			continue;
+		}
+		if(f_hi == 0. || (f_lo < 0.) == (f_hi < 0.))
+			continue; //a root at hi is the lo of the next part
+		t = lo - f_lo*(hi - lo)/(f_hi - f_lo);
+		for(j=0; j<100; j++){
+			f = polycap_poly_eval(coeff, degree, t);
+			if(f == 0.)
+				break;
+			if((f < 0.) == (f_lo < 0.))
+				lo = t;
+			else
+				hi = t;
+			t_new = t - f/polycap_poly_eval(deriv, degree-1, t);
+			if(!(t_new > lo && t_new < hi))
+				t_new = 0.5*(lo+hi);
+			if(fabs(t_new - t) <= 1.e-12*(1.+fabs(t))){
+				t = t_new;
+				break;
+			}
+			t = t_new;
+		}
+		roots[n_roots++] = t;
+	}
+	if(f_hi == 0. && (n_roots == 0 || roots[n_roots-1] != t_max))
+		roots[n_roots++] = t_max;
+
+	return n_roots;
+}
+//===========================================
+// evaluate the capillary wall function of a closed-form profile shape at coord, and its gradient
+// 	the function is the squared distance to the capillary axis in the plane of constant z minus the squared capillary radius,
+// 	so it is negative inside the capillary and its gradient is the outward surface normal
+static double polycap_capil_analytic_wall(const polycap_profile_shape *shape, double axis_x, double axis_y, polycap_vector3 coord, polycap_vector3 *gradient)
+{
+	double w, root, ext, d_ext, cap, d_x, d_y;
+
+	ext = shape->ext_poly[0] + coord.z*(shape->ext_poly[1] + coord.z*shape->ext_poly[2]);
+	d_ext = shape->ext_poly[1] + 2.*shape->ext_poly[2]*coord.z;
+	w = coord.z - shape->ext_sqrt_z0;
+	root = shape->ext_sqrt[0] + w*(shape->ext_sqrt[1] + w*shape->ext_sqrt[2]);
+	if(root > 0.){
+		root = sqrt(root);
+		ext += root;
+		d_ext += (shape->ext_sqrt[1] + 2.*shape->ext_sqrt[2]*w)/(2.*root);
+	}
+	cap = shape->cap_poly[0] + shape->cap_poly[1]*coord.z;
+	d_x = coord.x - axis_x*ext;
+	d_y = coord.y - axis_y*ext;
+
+	gradient->x = 2.*d_x;
+	gradient->y = 2.*d_y;
+	gradient->z = -2.*d_ext*(axis_x*d_x + axis_y*d_y) - 2.*cap*shape->cap_poly[1];
+	return d_x*d_x + d_y*d_y - cap*cap;
+}
+//===========================================
+// calculates the intersection point coordinates of the photon trajectory and the capillary wall of a profile with a closed-form shape
+// 	along the photon trajectory the wall function is a polynomial in the travelled z distance t, after squaring away the square root of ellipsoidal shapes,
+// 	so the first intersection beyond photon_coord is found directly instead of segment by segment
+// 	photon_dir must be normalised and point downstream
+static int polycap_capil_analytic_intersect(const polycap_profile_shape *shape, double z_end, polycap_capil_axis cap_axis, polycap_vector3 photon_coord, polycap_vector3 photon_dir, polycap_vector3 *interact_coord, polycap_vector3 *surface_norm)
+{
+	double axis_x, axis_y, slope_x, slope_y, w0, f = 0., df = 0., cap;
+	double ext_poly[3], ext_sqrt[3], cap_poly[2], d_x[3], d_y[3], prod[5], wall[5], axis_dot[3], wall_sq[POLY_MAX_DEGREE+1], roots[POLY_MAX_DEGREE];
+	polycap_vector3 coord, gradient;
+	int i, j, degree, n_roots;
+
+	//capillary axis coordinates per unit exterior radius, photon trajectory change per unit z
+	axis_x = cap_axis.x/cap_axis.z_div;
+	axis_y = cap_axis.y/cap_axis.z_div;
+	slope_x = photon_dir.x/photon_dir.z;
+	slope_y = photon_dir.y/photon_dir.z;
+
+	//shape polynomials as a function of t, the z distance travelled beyond photon_coord
+	ext_poly[0] = shape->ext_poly[0] + photon_coord.z*(shape->ext_poly[1] + photon_coord.z*shape->ext_poly[2]);
+	ext_poly[1] = shape->ext_poly[1] + 2.*shape->ext_poly[2]*photon_coord.z;
+	ext_poly[2] = shape->ext_poly[2];
+	w0 = photon_coord.z - shape->ext_sqrt_z0;
+	ext_sqrt[0] = shape->ext_sqrt[0] + w0*(shape->ext_sqrt[1] + w0*shape->ext_sqrt[2]);
+	ext_sqrt[1] = shape->ext_sqrt[1] + 2.*shape->ext_sqrt[2]*w0;
+	ext_sqrt[2] = shape->ext_sqrt[2];
+	cap_poly[0] = shape->cap_poly[0] + shape->cap_poly[1]*photon_coord.z;
+	cap_poly[1] = shape->cap_poly[1];
+
+	//photon coordinates relative to the capillary axis, leaving out the square root term of the exterior radius
+	d_x[0] = photon_coord.x - axis_x*ext_poly[0];
+	d_x[1] = slope_x - axis_x*ext_poly[1];
+	d_x[2] = -1.*axis_x*ext_poly[2];
+	d_y[0] = photon_coord.y - axis_y*ext_poly[0];
+	d_y[1] = slope_y - axis_y*ext_poly[1];
+	d_y[2] = -1.*axis_y*ext_poly[2];
+
+	//wall function: (d_x - axis_x*sqrt(ext_sqrt))^2 + (d_y - axis_y*sqrt(ext_sqrt))^2 - cap^2 = wall - axis_dot*sqrt(ext_sqrt)
+	polycap_poly_multiply(d_x, 2, d_x, 2, wall);
+	polycap_poly_multiply(d_y, 2, d_y, 2, prod);
+	for(i=0; i<=4; i++)
+		wall[i] += prod[i];
+	polycap_poly_multiply(cap_poly, 1, cap_poly, 1, prod);
+	for(i=0; i<=2; i++)
+		wall[i] += (axis_x*axis_x + axis_y*axis_y)*ext_sqrt[i] - prod[i];
+	if(shape->ext_sqrt[0] == 0. && shape->ext_sqrt[1] == 0. && shape->ext_sqrt[2] == 0.){
+		for(i=0; i<=4; i++)
+			wall_sq[i] = wall[i];
+		degree = 4;
+	} else {
+		//wall = axis_dot*sqrt(ext_sqrt) implies wall^2 - axis_dot^2*ext_sqrt = 0, whose roots that only solve wall = -axis_dot*sqrt(ext_sqrt) are discarded below
+		for(i=0; i<=2; i++)
+			axis_dot[i] = 2.*(axis_x*d_x[i] + axis_y*d_y[i]);
+		polycap_poly_multiply(wall, 4, wall, 4, wall_sq);
+		polycap_poly_multiply(axis_dot, 2, axis_dot, 2, prod);
+		polycap_poly_multiply(prod, 4, ext_sqrt, 2, roots); //roots holds the 7 coefficients until it is needed
+		for(i=0; i<=6; i++)
+			wall_sq[i] -= roots[i];
+		degree = 8;
+	}
+
+	//same minimal distance between interactions as for segments
+	n_roots = polycap_poly_roots(wall_sq, degree, 1.e-5, z_end - photon_coord.z, roots);
+	for(i=0; i<n_roots; i++){
+		//refine the root on the wall function itself, which does not suffer from the cancellation in its polynomial form
+		coord.z = photon_coord.z + roots[i];
+		for(j=0; j<3; j++){
+			coord.x = photon_coord.x + slope_x*(coord.z - photon_coord.z);
+			coord.y = photon_coord.y + slope_y*(coord.z - photon_coord.z);
+			f = polycap_capil_analytic_wall(shape, axis_x, axis_y, coord, &gradient);
+			df = gradient.x*slope_x + gradient.y*slope_y + gradient.z;
+			if(j == 2 || df == 0. || coord.z - f/df - photon_coord.z < 1.e-5 || coord.z - f/df > z_end)
+				break;
+			coord.z -= f/df;
+		}
+		cap = cap_poly[0] + cap_poly[1]*(coord.z - photon_coord.z);
+		//skip roots of the squared equation that are not on the wall, and wall crossings into the capillary
+		if(fabs(f) > 1.e-6*cap*cap || df <= 0.)
+			continue;
+
+		*interact_coord = coord;
+		*surface_norm = gradient;
+		polycap_norm(surface_norm);
+		return 1;
+	}
+
+	return -2; //no interaction before the end of the capillary
+}
+//===========================================
+// define the central axis of capillary (q_i,r_i) in a hexagonal lattice of n_shells capillary shells
+polycap_capil_axis polycap_capil_axis_new(double n_shells, double q_i, double r_i)
+{
+	polycap_capil_axis cap_axis;
+
+	//hexagon radial distance z at profile index i is ext[i]/z_div, as precomputed in description->geometry.hex_dist
+	cap_axis.z_div = 2.*COSPI_6*(n_shells+1);
+	cap_axis.x = (2.* q_i+r_i) * COSPI_6;
+	cap_axis.y = r_i * (3./2);
+
+	return cap_axis;
+}
+
 //===========================================
 // trace photon through capillary
-int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *description, double *cap_x, double *cap_y, bool leak_calc, polycap_error **error)
+int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *description, polycap_capil_axis cap_axis, bool leak_calc, polycap_error **error)
 {
 	int i, iesc=0;
-	double cap_rad0, cap_rad1;
-	polycap_vector3 cap_coord0, cap_coord1;
-	polycap_vector3 phot_coord0, phot_coord1;
-	polycap_vector3 photon_coord, photon_dir;
+	polycap_vector3 cap_coord0, cap_coord1, cap_slope; //capillary axis coordinates at start and end of segment, and its change per unit z
+	polycap_vector3 phot_coord0, phot_coord1, phot_slope; //photon coordinates at start and end of segment, and its change per unit z
+	polycap_vector3 photon_coord, photon_dir, seg_dir;
+	polycap_profile_segment *segment;
 	polycap_vector3 surface_norm; //surface normal of capillary at interaction point
 	double cosalfa; //angle between capillary normal at interaction point and photon direction before interaction
 	polycap_vector3 photon_coord_rel; //relative coordinates of new interaction point compared to previous interaction
 	double d_travel; //distance between interactions
 	double current_polycap_ext; //optic exterior radius at photon_coord.z position
-	polycap_vector3 temp_phot;
-	double d_phot0; //distance between temp_phot and capillary axis at given z
-	double n_shells; //amount of capillary shells in polycapillary
 
 	//argument sanity check
 	if (ix == NULL){
@@ -1223,14 +1493,6 @@ int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *de
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace: description must not be NULL");
 		return -1;
 	}
-	if (cap_x == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace: cap_x must not be NULL");
-		return -1;
-	}
-	if (cap_y == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace: cap_y must not be NULL");
-		return -1;
-	}
 
 	//normalise the direction vectors
 	polycap_norm(&photon->exit_direction);
@@ -1242,70 +1504,95 @@ int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *de
 	photon_dir.y = photon->exit_direction.y;
 	photon_dir.z = photon->exit_direction.z;
 
-	n_shells = round(sqrt(12. * photon->description->n_cap - 3.)/6.-0.5);
-	for(i=*ix; i<description->profile->nmax; i++){ //i<nmax as otherwise i+1 could reach out of array bounds
-		//calculate next intersection point
-		cap_coord0.x = cap_x[i];
-		cap_coord0.y = cap_y[i];
-		cap_coord0.z = description->profile->z[i];
-		cap_rad0 = description->profile->cap[i];
-		cap_coord1.x = cap_x[i+1];
-		cap_coord1.y = cap_y[i+1];
-		cap_coord1.z = description->profile->z[i+1];
-		cap_rad1 = description->profile->cap[i+1];
-		phot_coord0.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[i]-photon->exit_coords.z)/photon->exit_direction.z;
-		phot_coord0.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[i]-photon->exit_coords.z)/photon->exit_direction.z;
-		phot_coord0.z = description->profile->z[i];
-		phot_coord1.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[i+1]-photon->exit_coords.z)/photon->exit_direction.z;
-		phot_coord1.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[i+1]-photon->exit_coords.z)/photon->exit_direction.z;
-		phot_coord1.z = description->profile->z[i+1];
-		// check if cap_coord0 and cap_coord1 are within optic: otherwise errors are inbound
-		if( (polycap_photon_within_pc_boundary(description->profile->ext[i], cap_coord0, NULL) == 0) || (polycap_photon_within_pc_boundary(description->profile->ext[i+1], cap_coord1, NULL) == 0) ){
-			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace: invalid description->profile shape: cap_coord outside optic");
-			return -1;
-		}
-		//looking for intersection of photon from inside to outside of capillary
-		iesc = polycap_capil_segment(cap_coord0, cap_coord1, cap_rad0, cap_rad1, phot_coord0, phot_coord1, photon_dir, &photon_coord, &surface_norm, error);
-		//fprintf(stderr,"		ix: %i, segment: %i, caprad0: %lf, d_phot-capcen0: %lf, caprad1: %lf, d_phot-capcen1: %lf, cap-in-optic: %i\n",i, iesc, cap_rad0, sqrt((phot_coord0.x-cap_coord0.x)*(phot_coord0.x-cap_coord0.x)+(phot_coord0.y-cap_coord0.y)*(phot_coord0.y-cap_coord0.y)), cap_rad1, sqrt((phot_coord1.x-cap_coord1.x)*(phot_coord1.x-cap_coord1.x)+(phot_coord1.y-cap_coord1.y)*(phot_coord1.y-cap_coord1.y)), polycap_photon_within_pc_boundary(description->profile->ext[i], cap_coord0, NULL));
-		cosalfa = polycap_scalar(surface_norm, photon_dir);
-		if(acos(cosalfa) > M_PI/2. || acos(cosalfa) < 0.){
-			iesc = -5;
+	if(*ix >= description->profile->nmax)
+		return -2;
+
+	//direction and slopes of the photon trajectory are fixed for the whole walk along the capillary
+	seg_dir = photon_dir;
+	polycap_norm(&seg_dir);
+	phot_slope.x = seg_dir.x/seg_dir.z;
+	phot_slope.y = seg_dir.y/seg_dir.z;
+	phot_slope.z = 1.;
+	cap_slope.z = 1.;
+
+	//capillary axis and photon coordinates at the start of the first segment
+	//	afterwards the end point of each segment is the start point of the next one
+	cap_coord1.x = cap_axis.x * description->geometry.hex_dist[*ix];
+	cap_coord1.y = cap_axis.y * description->geometry.hex_dist[*ix];
+	cap_coord1.z = description->profile->z[*ix];
+	phot_coord1.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[*ix]-photon->exit_coords.z)/photon->exit_direction.z;
+	phot_coord1.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[*ix]-photon->exit_coords.z)/photon->exit_direction.z;
+	phot_coord1.z = description->profile->z[*ix];
+	// check if the capillary axis is within optic: otherwise errors are inbound
+	//	the axis coordinates scale with the optic exterior radius, so checking a single z is sufficient
+	if(polycap_hex_within_boundary(description->profile->ext_apothem[*ix], cap_coord1.x, cap_coord1.y) == 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_capil_trace: invalid description->profile shape: cap_coord outside optic");
+		return -1;
+	}
+
+	if(description->profile->shape.traced){
+		//the capillary wall is known in closed form, so the intersection is found directly instead of segment by segment
+		if(seg_dir.z <= 0.){ //photon going backwards, no intersection to be found
+			iesc = -2;
+		} else {
+			iesc = polycap_capil_analytic_intersect(&description->profile->shape, description->profile->z[description->profile->nmax], cap_axis, photon->exit_coords, seg_dir, &photon_coord, &surface_norm);
+			cosalfa = polycap_scalar(surface_norm, photon_dir);
 		}
+	} else {
+		for(i=*ix; i<description->profile->nmax; i++){ //i<nmax as otherwise i+1 could reach out of array bounds
+			//calculate next intersection point
+			segment = &description->profile->segments[i];
+			cap_coord0 = cap_coord1;
+			cap_coord1.x = cap_axis.x * description->geometry.hex_dist[i+1];
+			cap_coord1.y = cap_axis.y * description->geometry.hex_dist[i+1];
+			cap_coord1.z = description->profile->z[i+1];
+			cap_slope.x = (cap_coord1.x - cap_coord0.x)/segment->dz;
+			cap_slope.y = (cap_coord1.y - cap_coord0.y)/segment->dz;
+			phot_coord0 = phot_coord1;
+			phot_coord1.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[i+1]-photon->exit_coords.z)/photon->exit_direction.z;
+			phot_coord1.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[i+1]-photon->exit_coords.z)/photon->exit_direction.z;
+			phot_coord1.z = description->profile->z[i+1];
+			//looking for intersection of photon from inside to outside of capillary
+			if(seg_dir.z < 0.){ //photon going backwards, no intersection to be found
+				surface_norm.x = 0.;
+				surface_norm.y = 0.;
+				surface_norm.z = 0.;
+				iesc = -1;
+			} else {
+				iesc = polycap_capil_segment_intersect(cap_coord0, cap_coord1, description->profile->cap[i], description->profile->cap[i+1], cap_slope, segment->rad_slope, phot_coord0, phot_slope, seg_dir, photon->single_precision, &photon_coord, &surface_norm);
+			}
+			cosalfa = polycap_scalar(surface_norm, photon_dir);
+			if(cosalfa < 0. && acos(cosalfa) > M_PI/2.){
+				iesc = -5;
+			}
 //printf("		Segment: %i phot_temp trace: photx: %lf, y: %lf, z: %lf, interact.x: %lf, y: %lf, z: %lf, alfa: %lf\n", iesc, photon->exit_coords.x, photon->exit_coords.y, photon->exit_coords.z, photon_coord.x, photon_coord.y, photon_coord.z, acos(cosalfa)*180./M_PI);
-		//TODO: issues actually only arise after -2 was returned.... This suggest last interaction point came from within glass wall
-
-		if(iesc == 1){
-			current_polycap_ext = ((photon->description->profile->ext[i] - photon->description->profile->ext[i+1])/
-				(photon->description->profile->z[i] - photon->description->profile->z[i+1])) * 
-				(photon_coord.z - photon->description->profile->z[i+1]) + photon->description->profile->ext[i+1];
-			//check if photon is inside optic
-			if(n_shells == 0.){ //monocapillary case
-				if(sqrt(photon_coord.x*photon_coord.x + photon_coord.y*photon_coord.y) >= current_polycap_ext){
-					fprintf(stderr,"Segment end: photon not in polycap!!; i: %i, i+1: %i, nmax: %i\n",i, i+1, description->profile->nmax);
-					return -3;
+			//TODO: issues actually only arise after -2 was returned.... This suggest last interaction point came from within glass wall
+
+			if(iesc == 1){
+				current_polycap_ext = ((photon->description->profile->ext[i] - photon->description->profile->ext[i+1])/
+					(photon->description->profile->z[i] - photon->description->profile->z[i+1])) * 
+					(photon_coord.z - photon->description->profile->z[i+1]) + photon->description->profile->ext[i+1];
+				//check if photon is inside optic
+				if(photon->description->geometry.monocap){ //monocapillary case
+					if(sqrt(photon_coord.x*photon_coord.x + photon_coord.y*photon_coord.y) >= current_polycap_ext){
+						fprintf(stderr,"Segment end: photon not in polycap!!; i: %i, i+1: %i, nmax: %i\n",i, i+1, description->profile->nmax);
+						return -3;
+					}
+				} else { //polycapillary case
+					if(polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), photon_coord.x, photon_coord.y) == 0){
+						fprintf(stderr,"Segment end: photon not in polycap!!; i: %i, i+1: %i, nmax: %i\n",i, i+1, description->profile->nmax);
+						return -3;
+					}
 				}
-			} else { //polycapillary case
-				if(polycap_photon_within_pc_boundary(current_polycap_ext, photon_coord, error) == 0){
-					fprintf(stderr,"Segment end: photon not in polycap!!; i: %i, i+1: %i, nmax: %i\n",i, i+1, description->profile->nmax);
+				*ix = i+1; //set ix to i+1 as otherwise next interaction search could find photon outside of optic due to modified propagation after interaction
+				break;
+			} else {
+				//check if photon would still be inside optic at these positions (it should be!)
+				if(polycap_hex_within_boundary(description->profile->ext_apothem[i], phot_coord0.x, phot_coord0.y) == 0){ //often occurs
+//so here photon is not within polycap, but is within radial distance of capillary with central axis cap_axis
 					return -3;
 				}
 			}
-			*ix = i+1; //set ix to i+1 as otherwise next interaction search could find photon outside of optic due to modified propagation after interaction
-			break;
-		} else {
-			//check if photon would still be inside optic at these positions (it should be!)
-			temp_phot.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[i]-photon->exit_coords.z)/photon->exit_direction.z;
-			temp_phot.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[i]-photon->exit_coords.z)/photon->exit_direction.z;
-			temp_phot.z = description->profile->z[i];
-			if(polycap_photon_within_pc_boundary(description->profile->ext[i], temp_phot, error) == 0){ //often occurs
-/*				printf("Error2: photon escaping from optic!: i: %i, ext: %lf, d: %lf\n", i, description->profile->ext[i], sqrt(temp_phot.x*temp_phot.x+temp_phot.y*temp_phot.y));
-				d_phot0 = sqrt( (temp_phot.x-cap_x[i])*(temp_phot.x-cap_x[i]) + (temp_phot.y-cap_y[i])*(temp_phot.y-cap_y[i])  );
-				if(d_phot0 < description->profile->cap[i]) printf("	!!Error2b!\n");
-printf("	phot start.x: %lf, y: %lf, z: %lf, start dir.x: %lf, y: %lf, z: %lf\n",photon->start_coords.x, photon->start_coords.y, photon->start_coords.z, photon->start_direction.x, photon->start_direction.y, photon->start_direction.z);
-printf("		exit.x: %lf, y:%lf, z: %lf, i: %i, exit dir.x: %lf, y: %lf, z: %lf, temp.x: %lf, y: %lf, z: %lf\n", photon->exit_coords.x, photon->exit_coords.y, photon->exit_coords.z, i, photon->exit_direction.x, photon->exit_direction.y, photon->exit_direction.z, temp_phot.x, temp_phot.y, temp_phot.z); */
-//so here photon is not within polycap, but is within radial distance of capillary with central axis [cap_x,cap_y]
-				return -3;
-			}
 		}
 	}
 
@@ -1327,17 +1614,14 @@ printf("		exit.x: %lf, y:%lf, z: %lf, i: %i, exit dir.x: %lf, y: %lf, z: %lf, te
 			iesc = -1;
 		} else {
 			//Check whether intersection point is still within optic (it should be!
-			for(i=0; i<photon->description->profile->nmax; i++){ //i<nmax as otherwise i+1 could reach out of array bounds
-				if(photon->description->profile->z[i] <= photon->exit_coords.z)
-					*ix = i;
-			}
+			*ix = polycap_profile_find_segment(photon->description->profile, photon->exit_coords.z, photon->description->profile->nmax-1, *ix);
 			current_polycap_ext = ((photon->description->profile->ext[(*ix)+1] - photon->description->profile->ext[(*ix)])/
 			(photon->description->profile->z[(*ix)+1] - photon->description->profile->z[(*ix)])) * 
 			(photon_coord.z - photon->description->profile->z[(*ix)]) + photon->description->profile->ext[(*ix)];
-			if(n_shells == 0 && photon->exit_coords.x*photon->exit_coords.x+photon->exit_coords.y*photon->exit_coords.y >= current_polycap_ext){
+			if(photon->description->geometry.monocap && photon->exit_coords.x*photon->exit_coords.x+photon->exit_coords.y*photon->exit_coords.y >= current_polycap_ext){
 				printf("polycap_capil_trace: Warning: photon intersection outside of optic?!\n");
 				iesc = -3;
-			} else if(n_shells > 0 && polycap_photon_within_pc_boundary(current_polycap_ext, photon->exit_coords, error) == 0){
+			} else if(!photon->description->geometry.monocap && polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), photon->exit_coords.x, photon->exit_coords.y) == 0){
 				//photon somehow outside of PC after polycap_capil_segment
 				printf("polycap_capil_trace: Warning: photon intersection outside of optic?!\n");
 				iesc = -3;
@@ -161,52 +161,65 @@ polycap_description* polycap_description_new(polycap_profile *profile, double si
 	// Check whether weights add to 1
 	polycap_description_check_weight(description->nelem, description->wi, error);
 
-	//allocate profile memory
-	description->profile = calloc(1, sizeof(polycap_profile));
-	if(description->profile == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile -> %s", strerror(errno));
-		free(description->iz);
-		free(description->wi);
-		free(description);
-		return NULL;
-	}
-	description->profile->nmax = profile->nmax;
-	description->profile->z = malloc(sizeof(double)*(profile->nmax+1));
-	if(description->profile->z == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->z -> %s", strerror(errno));
-		free(description->iz);
-		free(description->wi);
-		free(description->profile);
-		free(description);
-		return NULL;
-	}
-	description->profile->cap = malloc(sizeof(double)*(profile->nmax+1));
-	if(description->profile->cap == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->cap -> %s", strerror(errno));
-		free(description->iz);
-		free(description->wi);
-		free(description->profile->z);
-		free(description->profile);
-		free(description);
-		return NULL;
-	}
-	description->profile->ext = malloc(sizeof(double)*(profile->nmax+1));
-	if(description->profile->ext == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->ext -> %s", strerror(errno));
-		free(description->iz);
-		free(description->wi);
-		free(description->profile->cap);
-		free(description->profile->z);
-		free(description->profile);
-		free(description);
-		return NULL;
-	}
+	//a profile from a binary profile file shares its memory mapping instead of being copied
+	if (profile->mapping != NULL) {
+		description->profile = polycap_profile_share(profile, error);
+		if (description->profile == NULL) {
+			free(description->iz);
+			free(description->wi);
+			free(description);
+			return NULL;
+		}
+	} else {
+		//allocate profile memory
+		description->profile = calloc(1, sizeof(polycap_profile));
+		if(description->profile == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile -> %s", strerror(errno));
+			free(description->iz);
+			free(description->wi);
+			free(description);
+			return NULL;
+		}
+		description->profile->nmax = profile->nmax;
+		description->profile->nmax_trace = profile->nmax_trace;
+		description->profile->shape = profile->shape;
+		description->profile->z = malloc(sizeof(double)*(profile->nmax+1));
+		if(description->profile->z == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->z -> %s", strerror(errno));
+			free(description->iz);
+			free(description->wi);
+			free(description->profile);
+			free(description);
+			return NULL;
+		}
+		description->profile->cap = malloc(sizeof(double)*(profile->nmax+1));
+		if(description->profile->cap == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->cap -> %s", strerror(errno));
+			free(description->iz);
+			free(description->wi);
+			free(description->profile->z);
+			free(description->profile);
+			free(description);
+			return NULL;
+		}
+		description->profile->ext = malloc(sizeof(double)*(profile->nmax+1));
+		if(description->profile->ext == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_new: could not allocate memory for description->profile->ext -> %s", strerror(errno));
+			free(description->iz);
+			free(description->wi);
+			free(description->profile->cap);
+			free(description->profile->z);
+			free(description->profile);
+			free(description);
+			return NULL;
+		}
 	
-	// copy description->profile values to profile
-	for(i=0;i<=profile->nmax;i++){
-		description->profile->z[i] = profile->z[i];
-		description->profile->cap[i] = profile->cap[i];
-		description->profile->ext[i] = profile->ext[i];
+		// copy description->profile values to profile
+		for(i=0;i<=profile->nmax;i++){
+			description->profile->z[i] = profile->z[i];
+			description->profile->cap[i] = profile->cap[i];
+			description->profile->ext[i] = profile->ext[i];
+		}
 	}
 	//NOTE: user should free old profile memory him/herself
 
@@ -218,18 +231,53 @@ polycap_description* polycap_description_new(polycap_profile *profile, double si
 	if(polycap_profile_validate(description->profile, description->n_cap, error) != 1){
 		polycap_clear_error(error);
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_description_new: description->profile is faulty. Some capillary coordinates are outside of the external radius.");
-		free(description->iz);
-		free(description->wi);
-		free(description->profile->cap);
-		free(description->profile->z);
-		free(description->profile);
-		free(description);
+		polycap_description_free(description);
+		return NULL;
+	}
+	if(!polycap_profile_set_segments(description->profile, error)){
+		polycap_description_free(description);
+		return NULL;
+	}
+	if(!polycap_description_set_geometry(description, error)){
+		polycap_description_free(description);
 		return NULL;
 	}
 
 	return description;
 }
 
+//===========================================
+// (re)calculate the capillary lattice of a polycap_description from its n_cap and profile
+bool polycap_description_set_geometry(polycap_description *description, polycap_error **error)
+{
+	int i;
+	polycap_geometry *geometry;
+
+	if (description == NULL || description->profile == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_description_set_geometry: description and its profile cannot be NULL");
+		return false;
+	}
+	geometry = &description->geometry;
+
+	//NOTE: with description->n_cap <7 only a mono-capillary will be simulated.
+	//    10 describes 1 shell (of 7 capillaries), ... due to hexagon stacking
+	geometry->n_shells = round(sqrt(12. * description->n_cap - 3.)/6.-0.5);
+	geometry->monocap = geometry->n_shells == 0.;
+	geometry->z_div = 2.*COSPI_6*(geometry->n_shells+1);
+
+	if (geometry->hex_dist)
+		free(geometry->hex_dist);
+	geometry->hex_dist = malloc(sizeof(double)*(description->profile->nmax+1));
+	if(geometry->hex_dist == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_description_set_geometry: could not allocate memory for geometry->hex_dist -> %s", strerror(errno));
+		return false;
+	}
+	for(i=0; i<=description->profile->nmax; i++)
+		geometry->hex_dist[i] = description->profile->ext[i]/geometry->z_div;
+
+	return true;
+}
+
 //===========================================
 // get the polycap_profile from a polycap_description
 const polycap_profile* polycap_description_get_profile(polycap_description *description)
@@ -245,6 +293,8 @@ void polycap_description_free(polycap_description *description)
 	if (description == NULL)
 		return;
 	polycap_profile_free(description->profile);
+	if (description->geometry.hex_dist)
+		free(description->geometry.hex_dist);
 	if (description->iz)
 		free(description->iz);
 	if (description->wi)
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+#include "polycap-private.h"
+#include "polycap-mpi.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define POLYCAP_MPI_TAG_REQUEST 1 /* a worker asks for a new batch, and reports whether it finished one */
+#define POLYCAP_MPI_TAG_BATCH 2 /* the master replies with the index of the next batch, or -1 if there are none left */
+#define POLYCAP_MPI_TAG_EVENTS 3 /* the photon events of a batch, sent to the master after all batches were traced */
+#define POLYCAP_MPI_MAX_BUFFERS 46
+
+//===========================================
+// List the buffers holding the photon events of images from offset on, n[0] transmitted photons, n[1] extleaks and n[2] intleaks
+//	returns the amount of buffers, which are sent and received in this order
+static int polycap_mpi_event_buffers(struct _polycap_images *images, size_t n_energies, const int64_t *offset, const int64_t *n, void **buffers, int *counts, MPI_Datatype *types)
+{
+	int i, j, n_buffers = 0;
+	double **exit_vect[] = {images->src_start_coords, images->pc_start_coords, images->pc_start_dir, images->pc_start_elecv, images->pc_exit_coords, images->pc_exit_dir, images->pc_exit_elecv};
+	double **extleak_vect[] = {images->extleak_coords, images->extleak_dir, images->extleak_elecv};
+	double **intleak_vect[] = {images->intleak_coords, images->intleak_dir, images->intleak_elecv};
+
+#define POLYCAP_MPI_BUFFER(buffer, count, type) do { buffers[n_buffers] = (buffer); counts[n_buffers] = (int) (count); types[n_buffers] = (type); n_buffers++; } while (0)
+	if (n[0] > 0) {
+		for (i = 0 ; i < 7 ; i++)
+			for (j = 0 ; j < 3 ; j++)
+				POLYCAP_MPI_BUFFER(exit_vect[i][j]+offset[0], n[0], MPI_DOUBLE);
+		POLYCAP_MPI_BUFFER(images->pc_exit_nrefl+offset[0], n[0], MPI_INT64_T);
+		POLYCAP_MPI_BUFFER(images->pc_exit_dtravel+offset[0], n[0], MPI_DOUBLE);
+		POLYCAP_MPI_BUFFER(images->exit_coord_weights+offset[0]*n_energies, n[0]*n_energies, MPI_DOUBLE);
+	}
+	if (n[1] > 0) {
+		for (i = 0 ; i < 3 ; i++)
+			for (j = 0 ; j < 3 ; j++)
+				POLYCAP_MPI_BUFFER(extleak_vect[i][j]+offset[1], n[1], MPI_DOUBLE);
+		POLYCAP_MPI_BUFFER(images->extleak_n_refl+offset[1], n[1], MPI_INT64_T);
+		POLYCAP_MPI_BUFFER(images->extleak_coord_weights+offset[1]*n_energies, n[1]*n_energies, MPI_DOUBLE);
+	}
+	if (n[2] > 0) {
+		for (i = 0 ; i < 3 ; i++)
+			for (j = 0 ; j < 3 ; j++)
+				POLYCAP_MPI_BUFFER(intleak_vect[i][j]+offset[2], n[2], MPI_DOUBLE);
+		POLYCAP_MPI_BUFFER(images->intleak_n_refl+offset[2], n[2], MPI_INT64_T);
+		POLYCAP_MPI_BUFFER(images->intleak_coord_weights+offset[2]*n_energies, n[2]*n_energies, MPI_DOUBLE);
+	}
+#undef POLYCAP_MPI_BUFFER
+	return n_buffers;
+}
+//===========================================
+// Trace a single batch of photons, and add it to the parts of this process
+static bool polycap_mpi_trace_batch(polycap_source *source, int max_threads, int n_photons, int batch, int n_batches, bool leak_calc, polycap_transmission_efficiencies ***parts, size_t *n_parts, polycap_error **error)
+{
+	polycap_transmission_efficiencies *part, **parts_temp;
+
+	part = polycap_source_get_transmission_efficiencies_shard(source, max_threads, n_photons, batch, n_batches, leak_calc, NULL, error);
+	if (part == NULL)
+		return false;
+	parts_temp = realloc(*parts, sizeof(polycap_transmission_efficiencies *)*(*n_parts+1));
+	if (parts_temp == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies_mpi: could not allocate memory for the batches -> %s", strerror(errno));
+		polycap_transmission_efficiencies_free(part);
+		return false;
+	}
+	*parts = parts_temp;
+	(*parts)[(*n_parts)++] = part;
+	return true;
+}
+//===========================================
+bool polycap_source_get_transmission_efficiencies_mpi(polycap_source *source, MPI_Comm comm, int max_threads, int n_photons, int batch_size, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_transmission_efficiencies **efficiencies, polycap_error **error)
+{
+	int rank, size, i, j, n_batches, batch, request, n_stopped, n_finished, n_buffers;
+	int ok, ok_all;
+	int *batch_rank = NULL;
+	size_t k, n_parts = 0;
+	unsigned long int seed = 0;
+	double mean, delta;
+	double *local_sq = NULL, *total_weights = NULL;
+	int64_t local_counts[6], total_counts[6], offset[3], n[3], *part_counts = NULL;
+	void *buffers[POLYCAP_MPI_MAX_BUFFERS];
+	int buffer_counts[POLYCAP_MPI_MAX_BUFFERS];
+	MPI_Datatype buffer_types[POLYCAP_MPI_MAX_BUFFERS];
+	polycap_rng *rng;
+	polycap_source batch_source;
+	polycap_transmission_efficiencies **parts = NULL, *local = NULL, *result = NULL;
+	MPI_Status status;
+
+	// argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_mpi: source cannot be NULL");
+		return false;
+	}
+	if (n_photons < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_mpi: n_photons must be greater than 0");
+		return false;
+	}
+	if (batch_size < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_mpi: batch_size must be greater than 0");
+		return false;
+	}
+	if (efficiencies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_mpi: efficiencies cannot be NULL");
+		return false;
+	}
+	*efficiencies = NULL;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	//all processes trace their batches with the seed of rank 0
+	if (rank == 0) {
+		if (source->use_seed) {
+			seed = source->seed;
+		} else {
+			rng = polycap_rng_new();
+			seed = (unsigned long int) (polycap_rng_uniform(rng) * 4294967295.);
+			polycap_rng_free(rng);
+		}
+	}
+	MPI_Bcast(&seed, 1, MPI_UNSIGNED_LONG, 0, comm);
+	batch_source = *source;
+	batch_source.use_seed = true;
+	batch_source.seed = seed;
+
+	//each batch is a shard of the simulation, so its photons are traced exactly as in a single simulation
+	n_batches = n_photons/batch_size + (n_photons % batch_size != 0);
+	ok = 1;
+	if (size == 1) {
+		for (batch = 0 ; ok && batch < n_batches ; batch++) {
+			ok = polycap_mpi_trace_batch(&batch_source, max_threads, n_photons, batch, n_batches, leak_calc, &parts, &n_parts, error);
+			polycap_progress_monitor_set_value(progress_monitor, (double) (batch+1)/(double) n_batches);
+		}
+	} else if (rank == 0) {
+		//master: hand out the batches in increasing order to the workers that ask for one, until all workers were told to stop
+		//	without memory to remember who traced which batch, the batches are still handed out, but the results are discarded
+		batch_rank = malloc(sizeof(int)*n_batches);
+		if (batch_rank == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies_mpi: could not allocate memory for the batches -> %s", strerror(errno));
+			ok = 0;
+		}
+		batch = 0;
+		n_stopped = 0;
+		n_finished = 0;
+		while (n_stopped < size-1) {
+			MPI_Recv(&request, 1, MPI_INT, MPI_ANY_SOURCE, POLYCAP_MPI_TAG_REQUEST, comm, &status);
+			n_finished += request;
+			polycap_progress_monitor_set_value(progress_monitor, (double) n_finished/(double) n_batches);
+			if (batch < n_batches) {
+				if (batch_rank != NULL)
+					batch_rank[batch] = status.MPI_SOURCE;
+				i = batch++;
+			} else {
+				i = -1;
+				n_stopped++;
+			}
+			MPI_Send(&i, 1, MPI_INT, status.MPI_SOURCE, POLYCAP_MPI_TAG_BATCH, comm);
+		}
+	} else {
+		//worker: after a failure, keep asking for batches without tracing them, so the master can finish handing them out
+		request = 0;
+		while (1) {
+			MPI_Send(&request, 1, MPI_INT, 0, POLYCAP_MPI_TAG_REQUEST, comm);
+			MPI_Recv(&batch, 1, MPI_INT, 0, POLYCAP_MPI_TAG_BATCH, comm, MPI_STATUS_IGNORE);
+			if (batch < 0)
+				break;
+			if (ok)
+				ok = polycap_mpi_trace_batch(&batch_source, max_threads, n_photons, batch, n_batches, leak_calc, &parts, &n_parts, error);
+			request = 1;
+		}
+	}
+
+	//combine the batches of this process, keeping the amount of events of each batch to send them to the master
+	if (ok) {
+		part_counts = malloc(sizeof(int64_t)*3*(n_parts > 0 ? n_parts : 1));
+		local = polycap_transmission_efficiencies_concatenate(source->n_energies, n_parts, parts, error);
+		ok = local != NULL && part_counts != NULL;
+	}
+	if (ok) {
+		for (k = 0 ; k < n_parts ; k++) {
+			part_counts[3*k] = parts[k]->images->i_exit;
+			part_counts[3*k+1] = parts[k]->images->i_extleak;
+			part_counts[3*k+2] = parts[k]->images->i_intleak;
+		}
+	}
+	for (k = 0 ; k < n_parts ; k++)
+		polycap_transmission_efficiencies_free(parts[k]);
+	free(parts);
+
+	//the totals determine the size of the results, a failed process contributes nothing
+	for (i = 0 ; i < 6 ; i++)
+		local_counts[i] = 0;
+	if (ok) {
+		local_counts[0] = local->images->i_start;
+		local_counts[1] = local->images->i_exit;
+		local_counts[2] = local->images->i_extleak;
+		local_counts[3] = local->images->i_intleak;
+		local_counts[4] = local->n_not_entered;
+		local_counts[5] = local->n_not_transmitted;
+	}
+	MPI_Allreduce(local_counts, total_counts, 6, MPI_INT64_T, MPI_SUM, comm);
+
+	local_sq = malloc(sizeof(double)*source->n_energies);
+	total_weights = malloc(sizeof(double)*source->n_energies);
+	ok = ok && local_sq != NULL && total_weights != NULL;
+	if (rank == 0 && size > 1) {
+		result = polycap_transmission_efficiencies_alloc(source->n_energies, total_counts[1], total_counts[2], total_counts[3]);
+		ok = ok && result != NULL;
+	}
+	if (!ok && (error == NULL || *error == NULL))
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies_mpi: could not allocate memory for the results -> %s", strerror(errno));
+
+	//from here on, all processes either take part in the communication, or give up together
+	MPI_Allreduce(&ok, &ok_all, 1, MPI_INT, MPI_MIN, comm);
+	if (!ok_all) {
+		if (ok)
+			polycap_set_error_literal(error, POLYCAP_ERROR_RUNTIME, "polycap_source_get_transmission_efficiencies_mpi: the simulation failed on another process");
+		polycap_transmission_efficiencies_free(local);
+		polycap_transmission_efficiencies_free(result);
+		free(local_sq);
+		free(total_weights);
+		free(part_counts);
+		free(batch_rank);
+		return false;
+	}
+
+	if (size == 1) {
+		result = local;
+		local = NULL;
+	} else {
+		//sum of the squared deviations from the overall mean: those of each process around its own mean, plus the deviation of its mean
+		MPI_Allreduce(local->sum_weights, total_weights, (int) source->n_energies, MPI_DOUBLE, MPI_SUM, comm);
+		for (k = 0 ; k < source->n_energies ; k++) {
+			local_sq[k] = local->sum_sq_dev[k];
+			if (local->images->i_start > 0) {
+				mean = total_weights[k]/(double) total_counts[0];
+				delta = local->sum_weights[k]/(double) local->images->i_start - mean;
+				local_sq[k] += delta*delta*(double) local->images->i_start;
+			}
+		}
+		MPI_Reduce(local_sq, rank == 0 ? result->sum_sq_dev : NULL, (int) source->n_energies, MPI_DOUBLE, MPI_SUM, 0, comm);
+
+		//the photon events of each batch, which the master receives in increasing batch order
+		if (rank == 0) {
+			memcpy(result->sum_weights, total_weights, sizeof(double)*source->n_energies);
+			result->images->i_start = total_counts[0];
+			result->n_not_entered = total_counts[4];
+			result->n_not_transmitted = total_counts[5];
+			for (i = 0 ; i < 3 ; i++)
+				offset[i] = 0;
+			for (batch = 0 ; batch < n_batches ; batch++) {
+				MPI_Recv(n, 3, MPI_INT64_T, batch_rank[batch], POLYCAP_MPI_TAG_EVENTS, comm, MPI_STATUS_IGNORE);
+				n_buffers = polycap_mpi_event_buffers(result->images, source->n_energies, offset, n, buffers, buffer_counts, buffer_types);
+				for (j = 0 ; j < n_buffers ; j++)
+					MPI_Recv(buffers[j], buffer_counts[j], buffer_types[j], batch_rank[batch], POLYCAP_MPI_TAG_EVENTS, comm, MPI_STATUS_IGNORE);
+				for (i = 0 ; i < 3 ; i++)
+					offset[i] += n[i];
+			}
+		} else {
+			for (i = 0 ; i < 3 ; i++)
+				offset[i] = 0;
+			for (k = 0 ; k < n_parts ; k++) {
+				MPI_Send(part_counts+3*k, 3, MPI_INT64_T, 0, POLYCAP_MPI_TAG_EVENTS, comm);
+				n_buffers = polycap_mpi_event_buffers(local->images, source->n_energies, offset, part_counts+3*k, buffers, buffer_counts, buffer_types);
+				for (j = 0 ; j < n_buffers ; j++)
+					MPI_Send(buffers[j], buffer_counts[j], buffer_types[j], 0, POLYCAP_MPI_TAG_EVENTS, comm);
+				for (i = 0 ; i < 3 ; i++)
+					offset[i] += part_counts[3*k+i];
+			}
+		}
+	}
+
+	if (rank == 0) {
+		polycap_transmission_efficiencies_finalize(result, source);
+		*efficiencies = result;
+	}
+	polycap_transmission_efficiencies_free(local);
+	free(local_sq);
+	free(total_weights);
+	free(part_counts);
+	free(batch_rank);
+	return true;
+}
@@ -17,12 +17,31 @@
 #include <stdlib.h>
 #include <math.h>
 #include <xraylib.h>
+#include <omp.h> /* openmp header */
 
 //===========================================
-void polycap_photon_scatf(polycap_photon *photon, polycap_error **error)
+// calculate linear absorption coefficients and scatter factors of the description material for each energy
+//	no argument checks are performed, these are up to the caller
+void polycap_material_scatf(polycap_description *description, size_t n_energies, double *energies, double *amu, double *scatf)
 {
 	int i, j;
-	double totmu, scatf;
+	double totmu, scatf_sum;
+
+	for(i=0; i<n_energies; i++){
+		totmu = 0;
+		scatf_sum = 0;
+		for(j=0; j<description->nelem; j++){
+			totmu = totmu + CS_Total(description->iz[j],energies[i], NULL) * description->wi[j];
+			scatf_sum = scatf_sum + (description->iz[j] + Fi(description->iz[j],energies[i], NULL) ) * (description->wi[j] / AtomicWeight(description->iz[j], NULL) );
+		}
+		amu[i] = totmu * description->density;
+		scatf[i] = scatf_sum;
+	}
+}
+//===========================================
+void polycap_photon_scatf(polycap_photon *photon, polycap_error **error)
+{
+	int i;
 
 	//argument sanity check
 	if (photon == NULL) {
@@ -70,26 +89,17 @@ void polycap_photon_scatf(polycap_photon *photon, polycap_error **error)
 	photon->amu = malloc(sizeof(double)*photon->n_energies);
 	if(photon->amu == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_scatf: could not allocate memory for photon->amu -> %s", strerror(errno));
-		polycap_photon_free(photon);
 		return;
 	}
 	photon->scatf = malloc(sizeof(double)*photon->n_energies);
 	if(photon->scatf == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_scatf: could not allocate memory for photon->scatf -> %s", strerror(errno));
-		polycap_photon_free(photon);
+		free(photon->amu);
+		photon->amu = NULL;
 		return;
 	}
 
-	for(i=0; i<photon->n_energies; i++){
-		totmu = 0;
-		scatf = 0;
-		for(j=0; j<description->nelem; j++){
-			totmu = totmu + CS_Total(description->iz[j],photon->energies[i], NULL) * description->wi[j];
-			scatf = scatf + (description->iz[j] + Fi(description->iz[j],photon->energies[i], NULL) ) * (description->wi[j] / AtomicWeight(description->iz[j], NULL) );
-		}
-		photon->amu[i] = totmu * description->density;
-		photon->scatf[i] = scatf;
-	}
+	polycap_material_scatf(description, photon->n_energies, photon->energies, photon->amu, photon->scatf);
 	return;
 }
 
@@ -138,65 +148,79 @@ polycap_photon* polycap_photon_new(polycap_description *description, polycap_vec
 //===========================================
 int polycap_photon_within_pc_boundary(double polycap_radius, polycap_vector3 photon_coord, polycap_error **error)
 {
-	double hex_edge_norm1[2], hex_edge_norm2[2], hex_edge_norm3[3]; //normal vectors of edges of the hexagonal polycap shape
-	double d_cen2hexedge; //distance between polycap centre and edges (along edge norm)
-	double dp1, dp2, dp3; //dot products; distance of photon_coord along hex edge norms
-
 	//argument sanity check
 	if (polycap_radius <= 0.) {
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_within_pc_boundary: polycap_radius must be greater than 0");
 		return -1;
 	}
 
-	hex_edge_norm1[0] = 0; //vertical hexagon edge x vector
-	hex_edge_norm1[1] = 1; //vertical hexagon edge y vector
-	hex_edge_norm2[0] = COSPI_6; //upper right and lower left hexagon edge x vector
-	hex_edge_norm2[1] = 0.5; //sin(pi/6) upper right and lower left hexagon edge y vector
-	hex_edge_norm3[0] = COSPI_6; //upper left and lower right hexagon edge x vector
-	hex_edge_norm3[1] = -0.5; //sin(-pi/6) upper left and lower right hexagon edge y vector
-
-	d_cen2hexedge = sqrt( (polycap_radius * polycap_radius) - ((polycap_radius/2.) * (polycap_radius/2.)) );
+	return polycap_hex_within_boundary(polycap_hex_apothem(polycap_radius), photon_coord.x, photon_coord.y);
+}
 
-	dp1 = fabs(hex_edge_norm1[0]*photon_coord.x + hex_edge_norm1[1]*photon_coord.y);
-	dp2 = fabs(hex_edge_norm2[0]*photon_coord.x + hex_edge_norm2[1]*photon_coord.y);
-	dp3 = fabs(hex_edge_norm3[0]*photon_coord.x + hex_edge_norm3[1]*photon_coord.y);
+//===========================================
+// check for n points (x[i], y[i]) whether they are within the polycapillary boundaries, with apothem obtained from polycap_hex_apothem()
+// 	inside[i] is set to 1 if the point is inside, 0 if it is outside; returns the amount of points inside
+int polycap_photon_within_pc_boundary_batch(double apothem, int n, const double *x, const double *y, int *inside)
+{
+	int i, n_inside = 0;
 
-	if(dp1 > d_cen2hexedge || dp2 > d_cen2hexedge || dp3 > d_cen2hexedge){
-		return 0; //outside of boundaries
-	} else {
-		return 1; //inside polycap boundaries
+	for(i = 0; i < n; i++){
+		inside[i] = polycap_hex_within_boundary(apothem, x[i], y[i]);
+		n_inside += inside[i];
 	}
+
+	return n_inside;
+}
+
+//===========================================
+// obtain for n points (x[i], y[i]) the axial indices q[i] and r[i] of the capillary they are in, and their distance d_axis[i] to its axis, with hex_dist as in polycap_hex_round()
+void polycap_hex_round_batch(double hex_dist, int n, const double *x, const double *y, double *q, double *r, double *d_axis)
+{
+	int i;
+
+	for(i = 0; i < n; i++)
+		d_axis[i] = polycap_hex_round(hex_dist, x[i], y[i], &q[i], &r[i]);
+}
+
+//===========================================
+// check whether the photon path, traced back from photon_coord along phot_dir, is within the polycapillary boundaries at profile index z_id
+static int polycap_photon_pc_inside_at(polycap_vector3 photon_coord, polycap_vector3 phot_dir, const polycap_profile *profile, int z_id)
+{
+	double x, y;
+
+	x = photon_coord.x + phot_dir.x * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
+	y = photon_coord.y + phot_dir.y * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
+
+	return polycap_hex_within_boundary(profile->ext_apothem[z_id], x, y);
 }
 
 //===========================================
 // define intersection point between photon path and polycapillary optic external wall
 // 	function assumes photon_coord just exited optic, and as such has to go back along direction (i.e. in opposite direction than the one supplied by user)
-polycap_vector3 *polycap_photon_pc_intersect(polycap_vector3 photon_coord, polycap_vector3 photon_direction, polycap_profile *profile, polycap_error **error)
+// 	returns true and stores the intersection point in intersection if one was found, false if not or if an error occurred
+bool polycap_photon_pc_intersect(polycap_vector3 photon_coord, polycap_vector3 photon_direction, const polycap_profile *profile, polycap_vector3 *intersection, polycap_error **error)
 {
-	double hex_edge_norm1[2], hex_edge_norm2[2], hex_edge_norm3[3]; //normal vectors of edges of the hexagonal polycap shape
-	double d_hexcen_beg, d_hexcen_end; //distance between polycap centre and edges (along edge norm)
-	double dp1b, dp2b, dp3b, dp1e, dp2e, dp3e; //dot products; distance of photon_coord along hex edge norms
-	polycap_vector3 phot_temp, phot_dir, phot_beg, phot_end;
-	int i, z_id=0, dir, broke=0;
+	polycap_vector3 phot_dir, phot_beg, phot_end;
+	int z_id=0, dir, z_end, z_out, z_mid, i;
+	bool found = false;
 	double current_polycap_ext;
-	double z1=1000., z2=1000., z3=1000., z_fin; //solutions to z-coordinate of intersection
+	double d_hexcen_beg, d_hexcen_end; //distance between polycap centre and edges (along edge norm)
+	double dpb[3], dpe[3]; //distance of phot_beg and phot_end along the three hex edge norms
+	double z_lo, z_hi, z_cross, z_fin = 0.; //z-coordinates of the found segment and of the intersection
 
 	//argument sanity checks
 	if(photon_direction.z == 0.){
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_pc_intersect: photon_direction.z must be different from 0");
-		return NULL;
+		return false;
 	}
 	if(profile == NULL){
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_pc_intersect: profile must not be NULL");
-		return NULL;
+		return false;
+	}
+	if(intersection == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_pc_intersect: intersection must not be NULL");
+		return false;
 	}
-
-	hex_edge_norm1[0] = 0; //vertical hexagon edge x vector
-	hex_edge_norm1[1] = 1; //vertical hexagon edge y vector
-	hex_edge_norm2[0] = COSPI_6; //upper right and lower left hexagon edge x vector
-	hex_edge_norm2[1] = 0.5; //sin(pi/6) upper right and lower left hexagon edge y vector
-	hex_edge_norm3[0] = COSPI_6; //upper left and lower right hexagon edge x vector
-	hex_edge_norm3[1] = -0.5; //sin(-pi/6) upper left and lower right hexagon edge y vector
 
 	//inverse direction of propagation
 	phot_dir.x = -1.*photon_direction.x;
@@ -204,42 +228,48 @@ polycap_vector3 *polycap_photon_pc_intersect(polycap_vector3 photon_coord, polyc
 	phot_dir.z = -1.*photon_direction.z;
 	polycap_norm(&phot_dir);
 
-	//find segment along z where intersection should occur
-	for(i=0; i< profile->nmax; i++){
-		if(profile->z[i] <= photon_coord.z)
-			z_id = i;
-	}
+	//find segment along z where photon_coord is
+	z_id = polycap_profile_find_segment(profile, photon_coord.z, profile->nmax-1, z_id);
 	current_polycap_ext = (profile->ext[z_id+1]-profile->ext[z_id])/(profile->z[z_id+1]-profile->z[z_id]) * (photon_coord.z - profile->z[z_id]) + profile->ext[z_id];
-	if(polycap_photon_within_pc_boundary(current_polycap_ext, photon_coord, NULL) == 1){
+	if(polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), photon_coord.x, photon_coord.y) == 1){
 		fprintf(stderr, "polycap_photon_pc_intersect: photon_coord not outside of optic");
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_pc_intersect: photon_coord not outside of optic");
-		return NULL;
+		return false;
 	}
+
+	//find the first profile point along the inverse direction where the photon path is within the optic
+	//	the path is outside at z_out; bisection requires the path to be inside at the last profile point, otherwise the points are checked one by one
 	if(phot_dir.z < 0.){
-		z_id = z_id+1;
+		z_out = z_id+1;
 		dir = -1;
+		z_end = 0;
 	} else {
-		// z_id = z_id;
+		z_out = z_id;
 		dir = 1;
+		z_end = profile->nmax;
 	}
-	do {
-		z_id += dir;
-		phot_temp.x = photon_coord.x + phot_dir.x * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
-		phot_temp.y = photon_coord.y + phot_dir.y * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
-		phot_temp.z = profile->z[z_id];
-		if(polycap_photon_within_pc_boundary(current_polycap_ext, photon_coord, NULL) != polycap_photon_within_pc_boundary(profile->ext[z_id], phot_temp, NULL)){
-			// photon goes from out to inside optic in this segment
-			broke = 1;
-			break;
+	if(z_out == z_end)
+		return false;
+	if(polycap_photon_pc_inside_at(photon_coord, phot_dir, profile, z_end) == 1){
+		z_id = z_end;
+		while(abs(z_id - z_out) > 1){
+			z_mid = (z_id + z_out)/2;
+			if(polycap_photon_pc_inside_at(photon_coord, phot_dir, profile, z_mid) == 1)
+				z_id = z_mid;
+			else
+				z_out = z_mid;
+		}
+	} else {
+		for(z_id = z_out+dir; z_id != z_end; z_id += dir){
+			if(polycap_photon_pc_inside_at(photon_coord, phot_dir, profile, z_id) == 1)
+				break;
 		}
-	} while (z_id >= 0 && z_id <= profile->nmax);
+		if(z_id == z_end) //no intersection was found
+			return false;
+	}
 
 	//determine photon coordinates at start and end of segment
 	//	segment defined between z_id and z_id-dir
-	if (broke == 0){
-		//no intersection was found
-		return NULL;
-	}
 	phot_beg.x = photon_coord.x + phot_dir.x * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
 	phot_beg.y = photon_coord.y + phot_dir.y * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
 	phot_beg.z = photon_coord.z + phot_dir.z * (profile->z[z_id]-photon_coord.z)/phot_dir.z;
@@ -247,118 +277,39 @@ polycap_vector3 *polycap_photon_pc_intersect(polycap_vector3 photon_coord, polyc
 	phot_end.y = photon_coord.y + phot_dir.y * (profile->z[z_id-dir]-photon_coord.z)/phot_dir.z;
 	phot_end.z = photon_coord.z + phot_dir.z * (profile->z[z_id-dir]-photon_coord.z)/phot_dir.z;
 
-	// define d_cen2hexedge and dp1,2,3 at start and end of segment
-	d_hexcen_beg = sqrt( (profile->ext[z_id] * profile->ext[z_id]) - ((profile->ext[z_id]/2.) * (profile->ext[z_id]/2.)) );
-	d_hexcen_end = sqrt( (profile->ext[z_id-dir] * profile->ext[z_id-dir]) - ((profile->ext[z_id-dir]/2.) * (profile->ext[z_id-dir]/2.)) );
-	dp1b = fabs(hex_edge_norm1[0]*phot_beg.x + hex_edge_norm1[1]*phot_beg.y);
-	dp2b = fabs(hex_edge_norm2[0]*phot_beg.x + hex_edge_norm2[1]*phot_beg.y);
-	dp3b = fabs(hex_edge_norm3[0]*phot_beg.x + hex_edge_norm3[1]*phot_beg.y);
-	dp1e = fabs(hex_edge_norm1[0]*phot_end.x + hex_edge_norm1[1]*phot_end.y);
-	dp2e = fabs(hex_edge_norm2[0]*phot_end.x + hex_edge_norm2[1]*phot_end.y);
-	dp3e = fabs(hex_edge_norm3[0]*phot_end.x + hex_edge_norm3[1]*phot_end.y);
-
-	// interpolate where dp1, dp2 and dp3 become equal to d_cen2hexedge
-	z1 = (dp1b - d_hexcen_beg) / (d_hexcen_beg-d_hexcen_end - dp1b+dp1e) * (profile->ext[z_id]-profile->ext[z_id-dir]) + profile->ext[z_id];
-	z2 = (dp2b - d_hexcen_beg) / (d_hexcen_beg-d_hexcen_end - dp2b+dp2e) * (profile->ext[z_id]-profile->ext[z_id-dir]) + profile->ext[z_id];
-	z3 = (dp3b - d_hexcen_beg) / (d_hexcen_beg-d_hexcen_end - dp3b+dp3e) * (profile->ext[z_id]-profile->ext[z_id-dir]) + profile->ext[z_id];
-
-	// if multiple found coordinates, select the one within found segment and with lowest z value.
-	if(dir < 0){
-		//profile->z[z_id-dir] > profile->z[z_id]
-		if(z1 >= profile->z[z_id] && z1 <= profile->z[z_id-dir] && z2 >= profile->z[z_id] && z2 <= profile->z[z_id-dir] && z3 >= profile->z[z_id] && z3 <= profile->z[z_id-dir]){ //all are viable answers, only use lowest value
-			if(z1 >= z2 && z1 >= z3){
-				z_fin = z1;
-			} else if (z2 >= z1 && z2 >= z3){
-				z_fin = z2;
-			} else if (z3 >= z1 && z3 >= z2){
-				z_fin = z3;
-			} else {
-				return NULL;
-			}
-		} else if (z2 >= profile->z[z_id] && z2 <= profile->z[z_id-dir] && z3 >= profile->z[z_id] && z3 <= profile->z[z_id-dir]){ // only z2 and z3 are viable
-			if(z3 > z2){
-				z_fin = z3;
-			} else{
-				z_fin = z2;
-			}
-		} else if (z1 >= profile->z[z_id] && z1 <= profile->z[z_id-dir] && z3 >= profile->z[z_id] && z3 <= profile->z[z_id-dir]){ // only z1 and z3 are viable
-			if(z1 > z3){
-				z_fin = z1;
-			} else{
-				z_fin = z3;
-			}
-		} else if (z1 >= profile->z[z_id] && z1 <= profile->z[z_id-dir] && z2 >= profile->z[z_id] && z2 <= profile->z[z_id-dir]){ // only z1 and z2 are viable
-			if(z1 > z2){
-				z_fin = z1;
-			} else{
-				z_fin = z2;
-			}
-		} else if (z1 >= profile->z[z_id] && z1 <= profile->z[z_id-dir]){ // only z1 is viable
-			z_fin = z1;
-		} else if (z2 >= profile->z[z_id] && z2 <= profile->z[z_id-dir]){ // only z2 is viable
-			z_fin = z2;
-		} else if (z3 >= profile->z[z_id] && z3 <= profile->z[z_id-dir]){ // only z3 is viable
-			z_fin = z3;
-		} else {
-			//none of the solutions is viable (not within the found segment!
-			polycap_vector3 *rv = malloc(sizeof(polycap_vector3));
-			*rv = phot_end;
-			return rv;
-		}
-	} else {
-		//profile->z[z_id-dir] < profile->z[z_id]
-		if(z1 <= profile->z[z_id] && z1 >= profile->z[z_id-dir] && z2 <= profile->z[z_id] && z2 >= profile->z[z_id-dir] && z3 <= profile->z[z_id] && z3 >= profile->z[z_id-dir]){ //all are viable answers, only use lowest value
-			if(z1 <= z2 && z1 <= z3){
-				z_fin = z1;
-			} else if (z2 <= z1 && z2 <= z3){
-				z_fin = z2;
-			} else if (z3 <= z1 && z3 <= z2){
-				z_fin = z3;
-			} else {
-				return NULL;
-			}
-		} else if (z2 <= profile->z[z_id] && z2 >= profile->z[z_id-dir] && z3 <= profile->z[z_id] && z3 >= profile->z[z_id-dir]){ // only z2 and z3 are viable
-			if(z3 < z2){
-				z_fin = z3;
-			} else{
-				z_fin = z2;
-			}
-		} else if (z1 <= profile->z[z_id] && z1 >= profile->z[z_id-dir] && z3 <= profile->z[z_id] && z3 >= profile->z[z_id-dir]){ // only z1 and z3 are viable
-			if(z1 < z3){
-				z_fin = z1;
-			} else{
-				z_fin = z3;
-			}
-		} else if (z1 <= profile->z[z_id] && z1 >= profile->z[z_id-dir] && z2 <= profile->z[z_id] && z2 >= profile->z[z_id-dir]){ // only z1 and z2 are viable
-			if(z1 < z2){
-				z_fin = z1;
-			} else{
-				z_fin = z2;
-			}
-		} else if (z1 <= profile->z[z_id] && z1 >= profile->z[z_id-dir]){ // only z1 is viable
-			z_fin = z1;
-		} else if (z2 <= profile->z[z_id] && z2 >= profile->z[z_id-dir]){ // only z2 is viable
-			z_fin = z2;
-		} else if (z3 <= profile->z[z_id] && z3 >= profile->z[z_id-dir]){ // only z3 is viable
-			z_fin = z3;
-		} else {
-			//none of the solutions is viable (not within the found segment!
-			polycap_vector3 *rv = malloc(sizeof(polycap_vector3));
-			*rv = phot_end;
-			return rv;
-		}
+	// define d_cen2hexedge and the distances along the hex edge norms (0,1), (cos(pi/6),0.5) and (cos(pi/6),-0.5) at start and end of segment
+	d_hexcen_beg = profile->ext_apothem[z_id];
+	d_hexcen_end = profile->ext_apothem[z_id-dir];
+	dpb[0] = fabs(phot_beg.y);
+	dpb[1] = fabs(COSPI_6*phot_beg.x + 0.5*phot_beg.y);
+	dpb[2] = fabs(COSPI_6*phot_beg.x - 0.5*phot_beg.y);
+	dpe[0] = fabs(phot_end.y);
+	dpe[1] = fabs(COSPI_6*phot_end.x + 0.5*phot_end.y);
+	dpe[2] = fabs(COSPI_6*phot_end.x - 0.5*phot_end.y);
+
+	// interpolate where the three distances become equal to d_cen2hexedge
+	// 	of the solutions within the found segment, select the first one along the inverse direction
+	z_lo = dir < 0 ? profile->z[z_id] : profile->z[z_id-dir];
+	z_hi = dir < 0 ? profile->z[z_id-dir] : profile->z[z_id];
+	for(i = 0; i < 3; i++){
+		z_cross = (dpb[i] - d_hexcen_beg) / (d_hexcen_beg-d_hexcen_end - dpb[i]+dpe[i]) * (profile->ext[z_id]-profile->ext[z_id-dir]) + profile->ext[z_id];
+		if(!(z_cross >= z_lo && z_cross <= z_hi))
+			continue;
+		if(!found || (dir < 0 ? z_cross > z_fin : z_cross < z_fin))
+			z_fin = z_cross;
+		found = true;
+	}
+	if(!found){
+		//none of the solutions is viable (not within the found segment!)
+		*intersection = phot_end;
+		return true;
 	}
 
-	phot_temp.x = photon_coord.x + phot_dir.x * (z_fin-photon_coord.z)/phot_dir.z;
-	phot_temp.y = photon_coord.y + phot_dir.y * (z_fin-photon_coord.z)/phot_dir.z;
-	phot_temp.z = photon_coord.z + phot_dir.z * (z_fin-photon_coord.z)/phot_dir.z;
-
-	polycap_vector3 *rv = malloc(sizeof(polycap_vector3));
-	
-	*rv = phot_temp;
-
-	return rv;
+	intersection->x = photon_coord.x + phot_dir.x * (z_fin-photon_coord.z)/phot_dir.z;
+	intersection->y = photon_coord.y + phot_dir.y * (z_fin-photon_coord.z)/phot_dir.z;
+	intersection->z = photon_coord.z + phot_dir.z * (z_fin-photon_coord.z)/phot_dir.z;
 
+	return true;
 }
 
 //===========================================
@@ -386,16 +337,14 @@ double polycap_scalar(polycap_vector3 vect1, polycap_vector3 vect2)
 }
 
 //===========================================
-// simulate a single photon for a given polycap_description
-int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *energies, double **weights, bool leak_calc, polycap_error **error)
+// trace a photon of which the energies, weight, amu and scatf arrays have already been set up
+// 	returns the same codes as polycap_photon_launch()
+int polycap_photon_launch_prepared(polycap_photon *photon, bool leak_calc, polycap_error **error)
 {
 	polycap_vector3 central_axis;
-//	double weight;
 	int i, iesc = 0;
 	double n_shells; //amount of capillary shells in polycapillary
-	double q_i, r_i, z; //indices of selected capillary and hexagon radial z
-//	double capx_0, capy_0; //coordinates of selected capillary at polycap entrance
-	double *cap_x, *cap_y; //arrays containing selected capillary central axis coordinates
+	double q_i, r_i; //indices of selected capillary
 	int ix_val = 0;
 	int *ix = &ix_val; //index to remember from which part of capillary last interaction was calculated
 	double d_ph_capcen; //distance between photon start coordinates and selected capillary center
@@ -403,84 +352,38 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 	double current_polycap_ext = 0; //optic exterior radius at current photon z position
 	double current_cap_rad = 0; //capillary internal radius at current photon z position
 	double current_cap_x, current_cap_y; // capillary central axis coordinate at current photon z position
+	double cap_x0, cap_x1, cap_y0, cap_y1; // capillary central axis coordinates at the surrounding profile indices
+	polycap_capil_axis cap_axis; //selected capillary central axis
 	int wall_trace=0, r_cntr, q_cntr;
 	double d_travel=0;
+	polycap_description *description = photon->description;
 
-	//argument sanity check
-	if (photon == NULL) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: photon cannot be NULL");
-		return -1;
-	}
-	if (energies == NULL) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: energies cannot be NULL");
-		return -1;
-	}
-	if (n_energies < 1) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: n_energies must be greater than 0");
-		return -1;
-	}
-	for(i=0; i< n_energies; i++){
-		if (energies[i] < 1. || energies[i] > 100.) {
-			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: energies[i] must be greater than 1 and less than 100");
-			return -1;
-		}
-	}
-	if (weights == NULL) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: weights cannot be NULL");
-		return -1;
-	}
-
-	//free photon->extleak and intleak here in case polycap_photon_launch would be called twice on same photon (without intermittant photon freeing)
+	//free photon->extleak and intleak here in case the photon is launched more than once (without intermittant photon freeing)
 	if (photon->extleak){
-		for(i=0; i<photon->n_extleak; i++){
-			if (photon->extleak[i]->weight)
-				free(photon->extleak[i]->weight);
-		}
+		for(i=0; i<photon->n_extleak; i++)
+			polycap_leak_free(photon->extleak[i]);
 		free(photon->extleak);
 		photon->extleak = NULL;
 	}
 	if (photon->intleak){
-		for(i=0; i<photon->n_intleak; i++){
-			if (photon->intleak[i]->weight)
-				free(photon->intleak[i]->weight);
-		}
+		for(i=0; i<photon->n_intleak; i++)
+			polycap_leak_free(photon->intleak[i]);
 		free(photon->intleak);
 		photon->intleak = NULL;
 	}
 
-	polycap_description *description = photon->description;
-	if (description == NULL) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: description cannot be NULL");
-		return -1;
-	}
-
-	//fill in energy array and initiate weights
-	*weights = malloc(sizeof(double)*n_energies);
-	photon->n_energies = n_energies;
-	photon->energies = malloc(sizeof(double)*photon->n_energies);
-	if(photon->energies == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->energies -> %s", strerror(errno));
-		polycap_photon_free(photon);
-		return -1;
-	}
-	photon->weight = malloc(sizeof(double)*photon->n_energies);
-	if(photon->weight == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->weight -> %s", strerror(errno));
-		polycap_photon_free(photon);
-		return -1;
-	}
-	for(i=0; i<photon->n_energies; i++){
-		photon->energies[i] = energies[i];
+	for(i=0; i<photon->n_energies; i++)
 		photon->weight[i] = 1.;
-	}
 	photon->i_refl = 0; //set reflections to 0
+	photon->n_refl_history = 0; //clear the reflection history
+	photon->d_travel = 0; //set travelled distance to 0
 	photon->n_extleak = 0; //set extleak to 0
 	photon->n_intleak = 0; //set intleak photons to 0
 
 	//calculate amount of shells in polycapillary
 	//NOTE: with description->n_cap <7 only a mono-capillary will be simulated.
 	//    10 describes 1 shell (of 7 capillaries), ... due to hexagon stacking
-	n_shells = round(sqrt(12. * description->n_cap - 3.)/6.-0.5);
+	n_shells = description->geometry.n_shells;
 
 	//define polycapillary-to-photonsource axis 
 	//Now we assume all sources are in a straight line with PC central axis
@@ -491,9 +394,6 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 	//normalize start_direction
 	polycap_norm(&photon->start_direction);
 
-	//calculate attenuation coefficients and scattering factors
-	polycap_photon_scatf(photon, error);
-
 	//Set exit coordinates and direction equal to start coordinates and direction in order to get a clean launch
 	photon->exit_coords.x = photon->start_coords.x;
 	photon->exit_coords.y = photon->start_coords.y;
@@ -502,144 +402,56 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 	photon->exit_direction.y = photon->start_direction.y;
 	photon->exit_direction.z = photon->start_direction.z;
 	polycap_norm(&photon->exit_direction);
+	photon->exit_electric_vector = photon->start_electric_vector;
 
 	//determine current optic segment position
 	if(photon->start_coords.z > 0){
-		for (i=0; i<photon->description->profile->nmax; i++)
-			if(photon->description->profile->z[i] <= photon->start_coords.z) z_id = i;
+		z_id = polycap_profile_find_segment(photon->description->profile, photon->start_coords.z, photon->description->profile->nmax-1, z_id);
 	} else z_id = 0;
 	//determine current photon position exterior
 	current_polycap_ext = ((photon->description->profile->ext[z_id] - photon->description->profile->ext[z_id+1]) / (photon->description->profile->z[z_id] - photon->description->profile->z[z_id+1])) * (photon->start_coords.z - photon->description->profile->z[z_id]) + photon->description->profile->ext[z_id];
 
-	if(n_shells == 0.){ //monocapillary case
+	if(description->geometry.monocap){ //monocapillary case
 		q_i = 0;
 		r_i = 0;
 		//check if photon->start_coord are within optic boundaries
 		if(sqrt((photon->start_coords.x)*(photon->start_coords.x) + (photon->start_coords.y)*(photon->start_coords.y)) > current_polycap_ext){
 			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: photon_pos_check: photon not within monocapillary boundaries");
-			if (photon->energies){
-				free(photon->energies);
-				photon->energies = NULL;
-			}
-			if (photon->weight){
-				free(photon->weight);
-				photon->weight = NULL;
-			}
-			if (photon->amu){
-				free(photon->amu);
-				photon->amu = NULL;
-			}
-			if (photon->scatf){
-				free(photon->scatf);
-				photon->scatf = NULL;
-			}
 			return -2;
 		}
 	} else {    // proper polycapillary case
 		//obtain selected capillary indices	
-		z = current_polycap_ext/(2.*COSPI_6*(n_shells+1));
-		r_i = photon->start_coords.y * (2./3) / z;
-		q_i = (photon->start_coords.x/(2.*COSPI_6) - photon->start_coords.y/3) / z;
-		if (fabs(q_i - round(q_i)) > fabs(r_i - round(r_i)) && fabs(q_i - round(q_i)) > fabs(-1.*q_i-r_i - round(-1.*q_i-r_i)) ){
-			q_i = -1.*round(r_i) - round(-1.*q_i-r_i);
-			r_i = round(r_i);
-		} else if (fabs(r_i - round(r_i)) >  fabs(-1.*q_i-r_i - round(-1.*q_i-r_i))){
-			r_i = -1.*round(q_i) - round(-1.*q_i-r_i);
-			q_i = round(q_i);
-		} else {
-			q_i = round(q_i);
-			r_i = round(r_i);
-		}
+		polycap_hex_round(current_polycap_ext/description->geometry.z_div, photon->start_coords.x, photon->start_coords.y, &q_i, &r_i);
 		//check if photon->start_coord are within optic boundaries
-		if(polycap_photon_within_pc_boundary(current_polycap_ext, photon->start_coords, error) == 0){
+		if(polycap_hex_within_boundary(polycap_hex_apothem(current_polycap_ext), photon->start_coords.x, photon->start_coords.y) == 0){
 			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: photon_pos_check: photon not within optic boundaries");
-			if (photon->energies){
-				free(photon->energies);
-				photon->energies = NULL;
-			}
-			if (photon->weight){
-				free(photon->weight);
-				photon->weight = NULL;
-			}
-			if (photon->amu){
-				free(photon->amu);
-				photon->amu = NULL;
-			}
-			if (photon->scatf){
-				free(photon->scatf);
-				photon->scatf = NULL;
-			}
 			return -2;
 		}
 	}
 
 	//define selected capillary axis X and Y coordinates
 	//NOTE: Assuming polycap centre coordinates are X=0,Y=0 with respect to photon->start_coords
-	cap_x = malloc(sizeof(double)*(description->profile->nmax+1));
-	if(cap_x == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for cap_x -> %s", strerror(errno));
-		if (photon->energies){
-			free(photon->energies);
-			photon->energies = NULL;
-		}
-		if (photon->weight){
-			free(photon->weight);
-			photon->weight = NULL;
-		}
-		if (photon->amu){
-			free(photon->amu);
-			photon->amu = NULL;
-		}
-		if (photon->scatf){
-			free(photon->scatf);
-			photon->scatf = NULL;
-		}
-		return -1;
-	}
-	cap_y = malloc(sizeof(double)*(description->profile->nmax+1));
-	if(cap_y == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for cap_y -> %s", strerror(errno));
-		if (photon->energies){
-			free(photon->energies);
-			photon->energies = NULL;
-		}
-		if (photon->weight){
-			free(photon->weight);
-			photon->weight = NULL;
-		}
-		if (photon->amu){
-			free(photon->amu);
-			photon->amu = NULL;
-		}
-		if (photon->scatf){
-			free(photon->scatf);
-			photon->scatf = NULL;
-		}
-		free(cap_x);
-		return -1;
-	}
-
-	for(i=0; i<=description->profile->nmax; i++){
-		z = photon->description->profile->ext[i]/(2.*COSPI_6*(n_shells+1));
-		cap_y[i] = r_i * (3./2) * z;
-		cap_x[i] = (2.* q_i+r_i) * COSPI_6 * z;
-		if(description->profile->z[i] <= photon->start_coords.z) *ix = i; //set ix to current photon segment id
-	}
+	cap_axis = polycap_capil_axis_new(n_shells, q_i, r_i);
+	*ix = polycap_profile_find_segment(description->profile, photon->start_coords.z, description->profile->nmax, *ix); //set ix to current photon segment id
 	//Check whether photon start coordinate is within capillary (within capillary center at distance < capillary radius)
 	if(photon->start_coords.z > 0){
 		current_cap_rad = ((photon->description->profile->cap[z_id+1] - photon->description->profile->cap[z_id])/
 			(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
 			(photon->start_coords.z - photon->description->profile->z[z_id]) + photon->description->profile->cap[z_id];
-		current_cap_x = ((cap_x[z_id+1] - cap_x[z_id])/
+		cap_x0 = cap_axis.x * description->geometry.hex_dist[z_id];
+		cap_x1 = cap_axis.x * description->geometry.hex_dist[z_id+1];
+		cap_y0 = cap_axis.y * description->geometry.hex_dist[z_id];
+		cap_y1 = cap_axis.y * description->geometry.hex_dist[z_id+1];
+		current_cap_x = ((cap_x1 - cap_x0)/
 			(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
-			(photon->start_coords.z - photon->description->profile->z[z_id]) + cap_x[z_id];
-		current_cap_y = ((cap_y[z_id+1] - cap_y[z_id])/
+			(photon->start_coords.z - photon->description->profile->z[z_id]) + cap_x0;
+		current_cap_y = ((cap_y1 - cap_y0)/
 			(photon->description->profile->z[z_id+1] - photon->description->profile->z[z_id])) * 
-			(photon->start_coords.z - photon->description->profile->z[z_id]) + cap_y[z_id];
+			(photon->start_coords.z - photon->description->profile->z[z_id]) + cap_y0;
 	} else {
 		current_cap_rad = description->profile->cap[0];
-		current_cap_x = cap_x[0];
-		current_cap_y = cap_y[0];
+		current_cap_x = cap_axis.x * description->geometry.hex_dist[0];
+		current_cap_y = cap_axis.y * description->geometry.hex_dist[0];
 	}
 	d_ph_capcen = sqrt( (photon->start_coords.x-current_cap_x)*(photon->start_coords.x-current_cap_x) + (photon->start_coords.y-current_cap_y)*(photon->start_coords.y-current_cap_y) );
 	if(d_ph_capcen > current_cap_rad){
@@ -650,48 +462,12 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 			central_axis.y = 0;
 			central_axis.z = 1;
 			polycap_capil_reflect(photon, central_axis, leak_calc, NULL);
-			if (photon->energies){
-				free(photon->energies);
-				photon->energies = NULL;
-			}
-			if (photon->weight){
-				free(photon->weight);
-				photon->weight = NULL;
-			}
-			if (photon->amu){
-				free(photon->amu);
-				photon->amu = NULL;
-			}
-			if (photon->scatf){
-				free(photon->scatf);
-				photon->scatf = NULL;
-			}
-			free(cap_x);
-			free(cap_y);
 			return 2; //simulates new photon in polycap_source_get_transmission_efficiencies() and adds to open area
 		}
 		if(leak_calc && photon->start_coords.z > 0){ // case where photon is launched within capillary wall at z>0
 			// first check if photon propagates through wall, or is absorbed
 			wall_trace = polycap_capil_trace_wall(photon, &d_travel, &r_cntr, &q_cntr, error);
 			if(wall_trace <= 0){
-				free(cap_x);
-				free(cap_y);
-				if (photon->energies){
-					free(photon->energies);
-					photon->energies = NULL;
-				}
-				if (photon->weight){
-					free(photon->weight);
-					photon->weight = NULL;
-				}
-				if (photon->amu){
-					free(photon->amu);
-					photon->amu = NULL;
-				}
-				if (photon->scatf){
-					free(photon->scatf);
-					photon->scatf = NULL;
-				}
 				return -1; //simulates new photon in polycap_source_get_transmission_efficiencies(), but does not add to open area
 			} else { //photon translated through wall, so trace it using adjusted weights and new capillary coordinates
 				for(i=0; i < photon->n_energies; i++)
@@ -706,24 +482,6 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 					photon->extleak = realloc(photon->extleak, sizeof(polycap_leak*) * ++photon->n_extleak);
 					if(photon->extleak == NULL){
 						polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->extleak -> %s", strerror(errno));
-						free(cap_x);
-						free(cap_y);
-						if (photon->energies){
-							free(photon->energies);
-							photon->energies = NULL;
-						}
-						if (photon->weight){
-							free(photon->weight);
-							photon->weight = NULL;
-						}
-						if (photon->amu){
-							free(photon->amu);
-							photon->amu = NULL;
-						}
-						if (photon->scatf){
-							free(photon->scatf);
-							photon->scatf = NULL;
-						}
 						return -1;
 					}
 					polycap_leak *new_leak = polycap_leak_new(photon->exit_coords, photon->exit_direction, photon->exit_electric_vector, photon->i_refl, photon->n_energies, photon->weight, error);
@@ -733,24 +491,6 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 					photon->intleak = realloc(photon->intleak, sizeof(polycap_leak*) * ++photon->n_intleak);
 					if(photon->intleak == NULL){
 						polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->intleak -> %s", strerror(errno));
-						free(cap_x);
-						free(cap_y);
-						if (photon->energies){
-							free(photon->energies);
-							photon->energies = NULL;
-						}
-						if (photon->weight){
-							free(photon->weight);
-							photon->weight = NULL;
-						}
-						if (photon->amu){
-							free(photon->amu);
-							photon->amu = NULL;
-						}
-						if (photon->scatf){
-							free(photon->scatf);
-							photon->scatf = NULL;
-						}
 						return -1;
 					}
 					polycap_leak *new_leak = polycap_leak_new(photon->exit_coords, photon->exit_direction, photon->exit_electric_vector, photon->i_refl, photon->n_energies, photon->weight, error);
@@ -758,14 +498,10 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 				}
 				if(wall_trace == 1){ //photon entered new capillary
 					photon->d_travel = photon->d_travel + d_travel;
-					for(i=0; i<=description->profile->nmax; i++){
-						z = photon->description->profile->ext[i]/(2.*COSPI_6*(n_shells+1));
-						cap_y[i] = r_cntr * (3./2) * z;
-						cap_x[i] = (2.* q_cntr+r_cntr) * COSPI_6 * z;
-						if(description->profile->z[i] <= photon->exit_coords.z) *ix = i; //set ix to current photon segment id
-					}
-					for(i=0; i<=description->profile->nmax; i++){
-						iesc = polycap_capil_trace(ix, photon, description, cap_x, cap_y, leak_calc, error);
+					cap_axis = polycap_capil_axis_new(n_shells, q_cntr, r_cntr);
+					*ix = polycap_profile_find_segment(description->profile, photon->exit_coords.z, description->profile->nmax, *ix); //set ix to current photon segment id
+					for(i=0; i<=description->profile->nmax_trace; i++){
+						iesc = polycap_capil_trace(ix, photon, description, cap_axis, leak_calc, error);
 						if(iesc != 1){ //as long as iesc = 1 photon is still reflecting in capillary
 							//iesc == 0, which means this photon has reached its final point (weight[*] <1e-4)
 							//alternatively, iesc can be -2 or -3due to not finding intersection point, as the photon reached the end of the capillary
@@ -773,53 +509,17 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 						}
 					}
 					if(iesc == -1 || iesc == -3){ //some error occurred
-						free(cap_x);
-						free(cap_y);
-						if (photon->energies){
-							free(photon->energies);
-							photon->energies = NULL;
-						}
-						if (photon->weight){
-							free(photon->weight);
-							photon->weight = NULL;
-						}
-						if (photon->amu){
-							free(photon->amu);
-							photon->amu = NULL;
-						}
-						if (photon->scatf){
-							free(photon->scatf);
-							photon->scatf = NULL;
-						}
 						return -1;
 					}
 					if(iesc == 1 || iesc == -2){ // photon reached end of optic, and has to be stored as such
 						photon->exit_coords.x = photon->exit_coords.x + photon->exit_direction.x * ((photon->description->profile->z[photon->description->profile->nmax]-photon->exit_coords.z)/photon->exit_direction.z );
 						photon->exit_coords.y = photon->exit_coords.y + photon->exit_direction.y * ((photon->description->profile->z[photon->description->profile->nmax]-photon->exit_coords.z)/photon->exit_direction.z);
 						photon->exit_coords.z = photon->exit_coords.z + photon->exit_direction.z * ((photon->description->profile->z[photon->description->profile->nmax]-photon->exit_coords.z)/photon->exit_direction.z);
-						iesc = polycap_photon_within_pc_boundary(photon->description->profile->ext[photon->description->profile->nmax], photon->exit_coords, error);
+						iesc = polycap_hex_within_boundary(photon->description->profile->ext_apothem[photon->description->profile->nmax], photon->exit_coords.x, photon->exit_coords.y);
 						if(iesc == 0){ //it's a leak event
 							photon->extleak = realloc(photon->extleak, sizeof(polycap_leak*) * ++photon->n_extleak);
 							if(photon->extleak == NULL){
 								polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->extleak -> %s", strerror(errno));
-								free(cap_x);
-								free(cap_y);
-								if (photon->energies){
-									free(photon->energies);
-									photon->energies = NULL;
-								}
-								if (photon->weight){
-									free(photon->weight);
-									photon->weight = NULL;
-								}
-								if (photon->amu){
-									free(photon->amu);
-									photon->amu = NULL;
-								}
-								if (photon->scatf){
-									free(photon->scatf);
-									photon->scatf = NULL;
-								}
 								return -1;
 							}
 							polycap_leak *new_leak = polycap_leak_new(photon->exit_coords, photon->exit_direction, photon->exit_electric_vector, photon->i_refl, photon->n_energies, photon->weight, error);
@@ -828,24 +528,6 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 							photon->intleak = realloc(photon->intleak, sizeof(polycap_leak*) * ++photon->n_intleak);
 							if(photon->intleak == NULL){
 								polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->intleak -> %s", strerror(errno));
-								free(cap_x);
-								free(cap_y);
-								if (photon->energies){
-									free(photon->energies);
-									photon->energies = NULL;
-								}
-								if (photon->weight){
-									free(photon->weight);
-									photon->weight = NULL;
-								}
-								if (photon->amu){
-									free(photon->amu);
-									photon->amu = NULL;
-								}
-								if (photon->scatf){
-									free(photon->scatf);
-									photon->scatf = NULL;
-								}
 								return -1;
 							}
 							polycap_leak *new_leak = polycap_leak_new(photon->exit_coords, photon->exit_direction, photon->exit_electric_vector, photon->i_refl, photon->n_energies, photon->weight, error);
@@ -864,53 +546,17 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 				photon->exit_direction.y = photon->start_direction.y;
 				photon->exit_direction.z = photon->start_direction.z;
 				polycap_norm(&photon->exit_direction);
-				free(cap_x);
-				free(cap_y);
-				if (photon->energies){
-					free(photon->energies);
-					photon->energies = NULL;
-				}
-				if (photon->weight){
-					free(photon->weight);
-					photon->weight = NULL;
-				}
-				if (photon->amu){
-					free(photon->amu);
-					photon->amu = NULL;
-				}
-				if (photon->scatf){
-					free(photon->scatf);
-					photon->scatf = NULL;
-				}
 				return 1;
 			} //if wall_trace >0
 		} //if(leak_calc && photon->start_coords.z > 0)
-		free(cap_x);
-		free(cap_y);
-		if (photon->energies){
-			free(photon->energies);
-			photon->energies = NULL;
-		}
-		if (photon->weight){
-			free(photon->weight);
-			photon->weight = NULL;
-		}
-		if (photon->amu){
-			free(photon->amu);
-			photon->amu = NULL;
-		}
-		if (photon->scatf){
-			free(photon->scatf);
-			photon->scatf = NULL;
-		}
 		return 2; //simulates new photon in polycap_source_get_transmission_efficiencies() and adds to open area
 	} //if(d_ph_capcen > current_cap_rad)
 
-	//polycap_capil_trace should be ran description->profile->nmax at most,
-	//	which means it essentially reflected once every known capillary coordinate
+	//polycap_capil_trace should be ran description->profile->nmax_trace at most,
+	//	which means it essentially reflected once every known capillary coordinate of the uncompacted profile
 	//Photon will also contain all info on potential leak and intleak events ( if(leak_calc) )
-	for(i=0; i<=description->profile->nmax; i++){
-		iesc = polycap_capil_trace(ix, photon, description, cap_x, cap_y, leak_calc, error);
+	for(i=0; i<=description->profile->nmax_trace; i++){
+		iesc = polycap_capil_trace(ix, photon, description, cap_axis, leak_calc, error);
 		if(iesc != 1){ //as long as iesc = 1 photon is still reflecting in capillary
 		//iesc == 0, which means this photon has reached its final point (weight[*] <1e-4)
 		//alternatively, iesc can be -2 or -3 due to not finding intersection point, as the photon reached the end of the capillary
@@ -918,14 +564,113 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 		}
 	}
 
+	if( (iesc == -1) || (iesc == -3) ){
+		return -1; //Return -1 if polycap_capil_trace() returned -1 (error) or -3 (something nonsensical occured during polycap_capil_trace)
+	}
+	if(iesc == 0){
+		return 0; //return 0 if photon did not reach end of capillary; is absorbed
+	} else {
+		return 1; //if photon reached end of capillary, return 1 (when capil_trace returns -2: photon reaches exit without interections, or 1: photon reaches exit after interactions)
+	}
+}
+
+//===========================================
+// simulate a single photon for a given polycap_description
+int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *energies, double **weights, bool leak_calc, polycap_error **error)
+{
+	return polycap_photon_launch_tables(photon, n_energies, energies, NULL, NULL, weights, leak_calc, error);
+}
+
+//===========================================
+// simulate a single photon, copying precomputed attenuation coefficients and scattering factors of the energies if amu and scatf are not NULL
+int polycap_photon_launch_tables(polycap_photon *photon, size_t n_energies, double *energies, const double *amu, const double *scatf, double **weights, bool leak_calc, polycap_error **error)
+{
+	int i, rv;
+
+	//argument sanity check
+	if (photon == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: photon cannot be NULL");
+		return -1;
+	}
+	if (energies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: energies cannot be NULL");
+		return -1;
+	}
+	if (n_energies < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: n_energies must be greater than 0");
+		return -1;
+	}
+	for(i=0; i< n_energies; i++){
+		if (energies[i] < 1. || energies[i] > 100.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: energies[i] must be greater than 1 and less than 100");
+			return -1;
+		}
+	}
+	if (weights == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: weights cannot be NULL");
+		return -1;
+	}
+
+	polycap_description *description = photon->description;
+	if (description == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch: description cannot be NULL");
+		return -1;
+	}
+
+	//free buffers that may have been kept by polycap_photon_launch_with_buffers()
+	free(photon->energies);
+	free(photon->weight);
+	free(photon->amu);
+	free(photon->scatf);
+	photon->energies = NULL;
+	photon->weight = NULL;
+	photon->amu = NULL;
+	photon->scatf = NULL;
+
+	//fill in energy array and initiate weights
+	*weights = malloc(sizeof(double)*n_energies);
+	if(*weights == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for weights -> %s", strerror(errno));
+		return -1;
+	}
+	photon->n_energies = n_energies;
+	photon->energies = malloc(sizeof(double)*photon->n_energies);
+	if(photon->energies == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->energies -> %s", strerror(errno));
+		polycap_photon_free(photon);
+		return -1;
+	}
+	photon->weight = malloc(sizeof(double)*photon->n_energies);
+	if(photon->weight == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch: could not allocate memory for photon->weight -> %s", strerror(errno));
+		polycap_photon_free(photon);
+		return -1;
+	}
+	for(i=0; i<photon->n_energies; i++){
+		photon->energies[i] = energies[i];
+		photon->weight[i] = 1.;
+	}
+
+	//calculate attenuation coefficients and scattering factors, unless they were provided
+	if(amu != NULL && scatf != NULL){
+		photon->amu = malloc(sizeof(double)*photon->n_energies);
+		photon->scatf = malloc(sizeof(double)*photon->n_energies);
+		if(photon->amu == NULL || photon->scatf == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_launch_tables: could not allocate memory for photon->amu and photon->scatf -> %s", strerror(errno));
+			return -1;
+		}
+		memcpy(photon->amu, amu, sizeof(double)*photon->n_energies);
+		memcpy(photon->scatf, scatf, sizeof(double)*photon->n_energies);
+	} else {
+		polycap_photon_scatf(photon, error);
+	}
+
+	rv = polycap_photon_launch_prepared(photon, leak_calc, error);
 
 	//Store photon->weight in weights array
 	memcpy(*weights, photon->weight, sizeof(double)*n_energies);
 
-	//Free alloced memory
-	free(cap_x);
-	free(cap_y);
-	//Also free photon->amu, photon->scatf, photon->weight and photon->energy
+	//Free photon->amu, photon->scatf, photon->weight and photon->energy
 	//in case polycap_photon_launch would be called twice on same photon (without intermittant photon freeing)
 	if (photon->energies){
 		free(photon->energies);
@@ -944,14 +689,244 @@ int polycap_photon_launch(polycap_photon *photon, size_t n_energies, double *ene
 		photon->scatf = NULL;
 	}
 
-	if( (iesc == -1) || (iesc == -3) ){
-		return -1; //Return -1 if polycap_capil_trace() returned -1 (error) or -3 (something nonsensical occured during polycap_capil_trace)
+	return rv;
+}
+
+//===========================================
+// (re)initialize the energies, weight, amu and scatf arrays of a photon, reusing them if the energies did not change
+static bool polycap_photon_set_energies(polycap_photon *photon, size_t n_energies, double *energies, polycap_error **error)
+{
+	int i;
+	double *temp;
+
+	if (photon->energies != NULL && photon->weight != NULL && photon->amu != NULL && photon->scatf != NULL && photon->n_energies == n_energies && memcmp(photon->energies, energies, sizeof(double)*n_energies) == 0)
+		return true;
+
+	temp = realloc(photon->energies, sizeof(double)*n_energies);
+	if(temp == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_set_energies: could not allocate memory for photon->energies -> %s", strerror(errno));
+		return false;
 	}
-	if(iesc == 0){
-		return 0; //return 0 if photon did not reach end of capillary; is absorbed
-	} else {
-		return 1; //if photon reached end of capillary, return 1 (when capil_trace returns -2: photon reaches exit without interections, or 1: photon reaches exit after interactions)
+	photon->energies = temp;
+	temp = realloc(photon->weight, sizeof(double)*n_energies);
+	if(temp == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_photon_set_energies: could not allocate memory for photon->weight -> %s", strerror(errno));
+		return false;
+	}
+	photon->weight = temp;
+	photon->n_energies = n_energies;
+	for(i=0; i<photon->n_energies; i++)
+		photon->energies[i] = energies[i];
+
+	//attenuation coefficients and scattering factors have to be recalculated for the new energies
+	free(photon->amu);
+	free(photon->scatf);
+	photon->amu = NULL;
+	photon->scatf = NULL;
+	polycap_photon_scatf(photon, error);
+	if(photon->amu == NULL || photon->scatf == NULL)
+		return false;
+
+	return true;
+}
+
+//===========================================
+// simulate a single photon for a given polycap_description, storing the weights in a caller-owned array
+int polycap_photon_launch_with_buffers(polycap_photon *photon, size_t n_energies, double *energies, double *weights, bool leak_calc, polycap_error **error)
+{
+	int i, rv;
+
+	//argument sanity check
+	if (photon == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: photon cannot be NULL");
+		return -1;
+	}
+	if (photon->description == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: description cannot be NULL");
+		return -1;
 	}
+	if (energies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: energies cannot be NULL");
+		return -1;
+	}
+	if (n_energies < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: n_energies must be greater than 0");
+		return -1;
+	}
+	for(i=0; i< n_energies; i++){
+		if (energies[i] < 1. || energies[i] > 100.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: energies[i] must be greater than 1 and less than 100");
+			return -1;
+		}
+	}
+	if (weights == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_with_buffers: weights cannot be NULL");
+		return -1;
+	}
+
+	if (!polycap_photon_set_energies(photon, n_energies, energies, error))
+		return -1;
+
+	rv = polycap_photon_launch_prepared(photon, leak_calc, error);
+
+	//Store photon->weight in weights array
+	memcpy(weights, photon->weight, sizeof(double)*n_energies);
+
+	return rv;
+}
+
+//===========================================
+// set a new start position, direction and electric field vector for an existing polycap_photon
+bool polycap_photon_set_start(polycap_photon *photon, polycap_vector3 start_coords, polycap_vector3 start_direction, polycap_vector3 start_electric_vector, polycap_error **error)
+{
+	//argument sanity check
+	if (photon == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_set_start: photon cannot be NULL");
+		return false;
+	}
+	if (start_coords.z < 0.) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_set_start: start_coords.z must be greater than 0");
+		return false;
+	}
+	if (start_direction.z < 0.) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_set_start: start_direction.z must be greater than 0");
+		return false;
+	}
+
+	photon->start_coords = start_coords;
+	photon->exit_coords = start_coords;
+	photon->start_direction = start_direction;
+	photon->exit_direction = start_direction;
+	photon->start_electric_vector = start_electric_vector;
+	photon->exit_electric_vector = start_electric_vector;
+	photon->d_travel = 0;
+
+	return true;
+}
+
+//===========================================
+// simulate an array of photons for a given polycap_description, storing the results in caller-owned arrays
+bool polycap_photon_launch_batch(polycap_description *description, int max_threads, size_t n_photons, polycap_vector3 *start_coords, polycap_vector3 *start_directions, polycap_vector3 *start_electric_vectors, size_t n_energies, double *energies, bool leak_calc, int *launch_status, polycap_vector3 *exit_coords, polycap_vector3 *exit_directions, polycap_vector3 *exit_electric_vectors, int64_t *n_refl, double *d_travel, double *weights, polycap_error **error)
+{
+	int64_t j;
+	int i;
+	polycap_error *batch_error = NULL; //first error encountered by any of the threads
+
+	//argument sanity check
+	if (description == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: description cannot be NULL");
+		return false;
+	}
+	if (n_photons < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: n_photons must be greater than 0");
+		return false;
+	}
+	if (start_coords == NULL || start_directions == NULL || start_electric_vectors == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: start_coords, start_directions and start_electric_vectors cannot be NULL");
+		return false;
+	}
+	if (energies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: energies cannot be NULL");
+		return false;
+	}
+	if (n_energies < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: n_energies must be greater than 0");
+		return false;
+	}
+	for(i=0; i< n_energies; i++){
+		if (energies[i] < 1. || energies[i] > 100.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: energies[i] must be greater than 1 and less than 100");
+			return false;
+		}
+	}
+	if (weights == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: weights cannot be NULL");
+		return false;
+	}
+	for(j=0; j < (int64_t) n_photons; j++){
+		if (start_coords[j].z < 0. || start_directions[j].z < 0.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_photon_launch_batch: start_coords[j].z and start_directions[j].z must be greater than 0");
+			return false;
+		}
+	}
+
+	if (max_threads < 1 || max_threads > omp_get_max_threads())
+		max_threads = omp_get_max_threads();
+
+#pragma omp parallel \
+	default(shared) \
+	private(i, j) \
+	num_threads(max_threads)
+{
+	polycap_error *local_error = NULL;
+	polycap_error *photon_error = NULL;
+	int rv;
+
+	//each thread traces all of its photons with a single photon structure, so that the
+	//	energies, weights, attenuation coefficients and scattering factors are only set up once
+	polycap_photon *photon = polycap_photon_new(description, start_coords[0], start_directions[0], start_electric_vectors[0], &local_error);
+
+	#pragma omp for
+	for(j=0; j < (int64_t) n_photons; j++){
+		if (local_error != NULL) {
+			if (launch_status)
+				launch_status[j] = -1;
+			for(i=0; i < n_energies; i++)
+				weights[j*n_energies+i] = 0.;
+			continue;
+		}
+		photon->start_coords = start_coords[j];
+		photon->start_direction = start_directions[j];
+		photon->start_electric_vector = start_electric_vectors[j];
+
+		rv = polycap_photon_launch_with_buffers(photon, n_energies, energies, weights + j*n_energies, leak_calc, &photon_error);
+		if (photon_error != NULL) {
+			//only allocation failures abort the batch, other errors only concern the current photon
+			if (polycap_error_matches(photon_error, POLYCAP_ERROR_MEMORY))
+				polycap_propagate_error(&local_error, photon_error);
+			else
+				polycap_error_free(photon_error);
+			photon_error = NULL;
+		}
+
+		if (launch_status)
+			launch_status[j] = rv;
+		if (rv != 0 && rv != 1) {
+			for(i=0; i < n_energies; i++)
+				weights[j*n_energies+i] = 0.;
+		}
+		if (rv == -1) //the photon may not have been traced at all, so its exit state is meaningless
+			continue;
+		if (exit_coords)
+			exit_coords[j] = photon->exit_coords;
+		if (exit_directions)
+			exit_directions[j] = photon->exit_direction;
+		if (exit_electric_vectors)
+			exit_electric_vectors[j] = photon->exit_electric_vector;
+		if (n_refl)
+			n_refl[j] = photon->i_refl;
+		if (d_travel)
+			d_travel[j] = photon->d_travel;
+	}
+
+	if (local_error != NULL) {
+		#pragma omp critical
+		{
+		if (batch_error == NULL)
+			batch_error = local_error;
+		else
+			polycap_error_free(local_error);
+		}
+	}
+	polycap_photon_free(photon);
+} //#pragma omp parallel
+
+	if (batch_error != NULL) {
+		polycap_propagate_error(error, batch_error);
+		return false;
+	}
+
+	return true;
 }
 
 //===========================================
@@ -1146,6 +1121,8 @@ void polycap_photon_free(polycap_photon *photon)
 		free(photon->amu);
 	if (photon->scatf)
 		free(photon->scatf);
+	if (photon->refl_history)
+		free(photon->refl_history);
 	if (photon->extleak) {
 		for(i = 0; i < photon->n_extleak; i++) {
 			polycap_leak_free(photon->extleak[i]);
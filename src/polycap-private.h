@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
 
 #define NSPOT 1000  /* The number of bins in the grid for the spot*/
 #define IMSIZE 500001
@@ -82,17 +83,64 @@ polycap_rng * polycap_rng_alloc(const polycap_rng_type * T);
 void polycap_rng_set(const polycap_rng * r, unsigned long int s);
 double polycap_rng_uniform(const polycap_rng * r);
 int polycap_capil_reflect(polycap_photon *photon, polycap_vector3 surface_norm, bool leak_calc, polycap_error **error);
+double polycap_refl_fresnel(double e, double density, double scatf, double lin_abs_coeff, double theta, double frac_s);
 
 //================================
 
+//energy independent description of a single reflection on a capillary wall
+//	with these, the reflection weight can be recomputed for any energy and wall material through polycap_refl_fresnel()
+typedef struct {
+  double theta; //angle between photon direction and surface normal
+  double frac_s; //fraction of the electric vector along the s direction
+  double alfa; //cos of the angle between photon direction and surface normal, used for the roughness term
+} polycap_refl_event;
+
+//coefficients of the linear profile segment between z[i] and z[i+1], precomputed as they are required for each segment a photon passes
+typedef struct {
+  double dz; //segment length along z
+  double rad_slope; //capillary radius change per unit z
+} polycap_profile_segment;
+
+//closed-form shape of a profile created by polycap_profile_new(), with polynomial coefficients in increasing order:
+//	ext(z) = ext_poly(z) + sqrt(ext_sqrt(z - ext_sqrt_z0)) and cap(z) = cap_poly(z)
+typedef struct {
+  bool known; //false for profiles that are only known at their points
+  bool traced; //trace photons on the closed-form shape instead of segment by segment, see polycap_profile_set_analytic_tracing()
+  double ext_poly[3];
+  double ext_sqrt[3];
+  double ext_sqrt_z0;
+  double cap_poly[2];
+} polycap_profile_shape;
+
+//a memory-mapped binary profile file, shared read-only by all profiles created from it
+typedef struct {
+  void *addr;
+  size_t size;
+  int refcount;
+} polycap_profile_mapping;
+
 struct _polycap_profile
   {
   int nmax;
+  int nmax_trace; //maximum amount of polycap_capil_trace() calls per capillary: nmax of the profile before it was compacted with polycap_profile_compact()
   double *z;
   double *cap;
   double *ext;
+  polycap_profile_segment *segments; //nmax elements
+  double *ext_apothem; //nmax+1 elements: distance between the optic centre and the edges of its hexagonal exterior at each profile point
+  polycap_profile_shape shape;
+  polycap_profile_mapping *mapping; //NULL unless z, cap and ext point into a binary profile file, see polycap_profile_new_from_binary_file()
   };
 
+//hexagonal capillary lattice of a polycap_description, derived from its n_cap and profile when the description is created
+//	as these are required for each photon and segment, the hot paths take them from here rather than recomputing them
+typedef struct {
+  double n_shells; //amount of capillary shells around the central capillary: n_cap = 1+6(n_shells^2+n_shells)/2
+  bool monocap; //true if the optic is a single capillary (n_shells == 0)
+  double z_div; //2*cos(pi/6)*(n_shells+1)
+  double *hex_dist; //nmax+1 elements: hexagon radial distance ext[i]/z_div at each profile point, which scales the capillary axis coordinates
+} polycap_geometry;
+
 struct _polycap_description
   {
   double sig_rough;
@@ -103,6 +151,7 @@ struct _polycap_description
   double *wi;
   double density;
   polycap_profile *profile;
+  polycap_geometry geometry;
   };
 
 struct _polycap_source
@@ -119,6 +168,10 @@ struct _polycap_source
   double hor_pol;
   size_t n_energies;
   double *energies;
+  bool record_histories; //store the reflections of the transmitted photons in the images
+  bool single_precision; //solve the capillary wall intersections in single precision, see polycap_source_set_single_precision()
+  bool use_seed; //derive the random numbers of each photon from seed, see polycap_source_set_seed()
+  unsigned long int seed;
   };
 
 struct _polycap_photon
@@ -142,6 +195,17 @@ struct _polycap_photon
   double *scatf;
   int64_t i_refl;
   double d_travel;
+  bool record_history; //store the reflections in refl_history while tracing
+  bool single_precision; //solve the capillary wall intersections in single precision
+  polycap_refl_event *refl_history;
+  int64_t n_refl_history;
+  int64_t refl_history_mem_size;
+  };
+
+struct _polycap_progress_monitor
+  {
+  polycap_progress_monitor_set_value_func set_value;
+  void *user_data;
   };
 
 struct _polycap_transmission_efficiencies
@@ -149,6 +213,15 @@ struct _polycap_transmission_efficiencies
   size_t n_energies;
   double *energies;
   double *efficiencies;
+  double *std_errors; //standard error of the efficiencies
+  double *sum_weights; //sum of the weights of the transmitted photons
+  double *sum_sq_dev; //sum of the squared deviations of the photon weights from their mean, required to merge the standard errors
+  int64_t n_not_entered;
+  int64_t n_not_transmitted;
+  int n_shards; //0 unless these are the partial results of a sharded simulation, see polycap_source_get_transmission_efficiencies_shard()
+  int shard_index;
+  int n_photons_total; //amount of photons of all shards together
+  unsigned long int seed;
   struct _polycap_images *images;
   polycap_source *source;
   };
@@ -157,39 +230,106 @@ struct _polycap_images
   {
   int64_t i_start;
   int64_t i_exit;
-  double *src_start_coords[2];
-  double *pc_start_coords[2];
-  double *pc_start_dir[2];
-  double *pc_start_elecv[2];
+  int64_t mem_size; //allocated events per array; the components of the vector arrays below are mem_size elements apart within a single allocation
+  double *src_start_coords[3];
+  double *pc_start_coords[3];
+  double *pc_start_dir[3];
+  double *pc_start_elecv[3];
   double *pc_exit_coords[3];
-  double *pc_exit_dir[2];
-  double *pc_exit_elecv[2];
+  double *pc_exit_dir[3];
+  double *pc_exit_elecv[3];
   int64_t *pc_exit_nrefl;
   double *pc_exit_dtravel;
   double *exit_coord_weights;
-  int64_t i_extleak;
+  polycap_refl_event *refl_history; //reflections of all transmitted photons, only if the source records histories
+  int64_t *refl_history_offset; //i_exit+1 elements: the reflections of photon j are refl_history[refl_history_offset[j]] up to refl_history[refl_history_offset[j+1]]
+  int64_t i_extleak; //the components of the leak vector arrays below are i_extleak or i_intleak elements apart within a single allocation
   double *extleak_coords[3];
-  double *extleak_dir[2];
+  double *extleak_dir[3];
+  double *extleak_elecv[3];
   double *extleak_coord_weights;
   int64_t *extleak_n_refl;
   int64_t i_intleak;
   double *intleak_coords[3];
-  double *intleak_dir[2];
-  double *intleak_elecv[2];
+  double *intleak_dir[3];
+  double *intleak_elecv[3];
   double *intleak_coord_weights;
   int64_t *intleak_n_refl;
   };
 
+//central axis of a single capillary of the hexagonal lattice
+//	the axis coordinates scale linearly with the optic exterior radius, so that at profile index i
+//	they are given by (x * z, y * z) with z = profile->ext[i]/z_div and only have to be evaluated where required
+typedef struct {
+  double x;
+  double y;
+  double z_div;
+} polycap_capil_axis;
+
+//distance between the centre and the edges of a hexagon with circumscribed radius polycap_radius
+static inline double polycap_hex_apothem(double polycap_radius)
+{
+	return sqrt( (polycap_radius * polycap_radius) - ((polycap_radius/2.) * (polycap_radius/2.)) );
+}
+
+//check whether (x, y) lies within the hexagonal optic exterior with the given apothem: 1 if inside, 0 if outside
+//	the distances along the edge normals (0, 1), (cos(pi/6), 0.5) and (cos(pi/6), -0.5) are compared without branching, so that loops over many points vectorize
+static inline int polycap_hex_within_boundary(double apothem, double x, double y)
+{
+	return !((fabs(y) > apothem) | (fabs(COSPI_6*x + 0.5*y) > apothem) | (fabs(COSPI_6*x - 0.5*y) > apothem));
+}
+
+//obtain the axial indices q and r of the capillary whose hexagonal region contains (x, y), and return the distance between (x, y) and the axis of this capillary
+//	hex_dist is the distance between the optic centre and the corners of the central hexagon, i.e. polycap_geometry.hex_dist at a profile point
+//	the cube coordinates (q, r, -q-r) are rounded to the nearest integers, after which the one with the largest rounding error is recomputed from the other two.
+//	This is done with selects rather than branches, so that loops over many points vectorize
+static inline double polycap_hex_round(double hex_dist, double x, double y, double *q, double *r)
+{
+	double q_f, r_f, s_f, q_g, r_g, s_g, dq, dr, ds, cap_x, cap_y;
+	int q_worst;
+
+	r_f = y * (2./3) / hex_dist;
+	q_f = (x/(2.*COSPI_6) - y/3) / hex_dist;
+	s_f = -1.*q_f-r_f;
+	q_g = floor(q_f + 0.5);
+	r_g = floor(r_f + 0.5);
+	s_g = floor(s_f + 0.5);
+	dq = fabs(q_f - q_g);
+	dr = fabs(r_f - r_g);
+	ds = fabs(s_f - s_g);
+	q_worst = (dq > dr) & (dq > ds);
+	*q = q_worst ? -1.*r_g - s_g : q_g;
+	*r = (!q_worst & (dr > ds)) ? -1.*q_g - s_g : r_g;
+
+	cap_y = *r * (3./2) * hex_dist;
+	cap_x = (2.* *q + *r) * COSPI_6 * hex_dist;
+	return sqrt((x-cap_x)*(x-cap_x)+(y-cap_y)*(y-cap_y));
+}
+
+polycap_capil_axis polycap_capil_axis_new(double n_shells, double q_i, double r_i);
+bool polycap_profile_set_segments(polycap_profile *profile, polycap_error **error);
+bool polycap_description_set_geometry(polycap_description *description, polycap_error **error);
+int polycap_profile_find_segment(const polycap_profile *profile, double z, int last, int z_id);
+polycap_profile* polycap_profile_share(polycap_profile *profile, polycap_error **error);
 int polycap_photon_within_pc_boundary(double polycap_radius, polycap_vector3 photon_coord, polycap_error **error);
-polycap_vector3 *polycap_photon_pc_intersect(polycap_vector3 photon_coord, polycap_vector3 photon_direction, polycap_profile *profile, polycap_error **error);
+int polycap_photon_within_pc_boundary_batch(double apothem, int n, const double *x, const double *y, int *inside);
+void polycap_hex_round_batch(double hex_dist, int n, const double *x, const double *y, double *q, double *r, double *d_axis);
+bool polycap_photon_pc_intersect(polycap_vector3 photon_coord, polycap_vector3 photon_direction, const polycap_profile *profile, polycap_vector3 *intersection, polycap_error **error);
 void polycap_norm(polycap_vector3 *vect);
 double polycap_scalar(polycap_vector3 vect1, polycap_vector3 vect2);
-int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *description, double *cap_x, double *cap_y, bool leak_calc, polycap_error **error);
+int polycap_photon_launch_prepared(polycap_photon *photon, bool leak_calc, polycap_error **error);
+int polycap_photon_launch_tables(polycap_photon *photon, size_t n_energies, double *energies, const double *amu, const double *scatf, double **weights, bool leak_calc, polycap_error **error);
+int polycap_capil_trace(int *ix, polycap_photon *photon, polycap_description *description, polycap_capil_axis cap_axis, bool leak_calc, polycap_error **error);
 int polycap_capil_trace_wall(polycap_photon *photon, double *d_travel, int *capx_id, int *capy_id, polycap_error **error);
 char *polycap_read_input_line(FILE *fptr, polycap_error **error);
 void polycap_description_check_weight(size_t nelem, double wi[], polycap_error **error);
 void polycap_photon_scatf(polycap_photon *photon, polycap_error **error);
+void polycap_material_scatf(polycap_description *description, size_t n_energies, double *energies, double *amu, double *scatf);
+void polycap_progress_monitor_set_value(polycap_progress_monitor *progress_monitor, double value);
 polycap_leak* polycap_leak_new(polycap_vector3 leak_coords, polycap_vector3 leak_dir, polycap_vector3 leak_elecv, int64_t n_refl, size_t n_energies, double *weights, polycap_error **error);
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_alloc(size_t n_energies, int64_t n_exit, int64_t n_extleak, int64_t n_intleak);
+void polycap_transmission_efficiencies_finalize(polycap_transmission_efficiencies *efficiencies, polycap_source *source);
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_concatenate(size_t n_energies, size_t n_parts, polycap_transmission_efficiencies **parts, polycap_error **error);
 
 #endif
 
@@ -19,6 +19,29 @@
 #include <gsl/gsl_multifit.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <limits.h>
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#define POLYCAP_PROFILE_BINARY_MAGIC "PCPROFIL"
+#define POLYCAP_PROFILE_BINARY_VERSION 2
+#define POLYCAP_PROFILE_BINARY_BYTE_ORDER 0x01020304 /* written in native byte order, to detect files from machines with a different byte order */
+
+// header of a binary profile file, followed by the z, cap and ext arrays of nmax+1 doubles each, starting at data_offset
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	int64_t nmax;
+	int64_t data_offset;
+	int64_t nmax_trace; //since version 2
+} polycap_profile_binary_header;
 
 //===========================================
 STATIC bool polynomialfit(int obs, int degree, 
@@ -115,6 +138,12 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 		return NULL;
 	}
 	profile->nmax = nmax;
+	profile->nmax_trace = nmax;
+	profile->segments = NULL;
+	profile->ext_apothem = NULL;
+	profile->mapping = NULL;
+	memset(&profile->shape, 0, sizeof(polycap_profile_shape));
+	profile->shape.known = true;
 	profile->z = malloc(sizeof(double)*(profile->nmax+1));
 	if(profile->z == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_new: could not allocate memory for profile->z -> %s", strerror(errno));
@@ -138,6 +167,9 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 	}
 
 	//Define actual capillary and PC shape
+	//	the single capillary shape is always conical
+	profile->shape.cap_poly[0] = rad_int_upstream;
+	profile->shape.cap_poly[1] = (rad_int_downstream-rad_int_upstream)/length;
 	switch(type){
 		case POLYCAP_PROFILE_CONICAL:
 			for(i=0;i<=nmax;i++){
@@ -145,6 +177,8 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 				profile->cap[i] = (rad_int_downstream-rad_int_upstream)/length*profile->z[i] + rad_int_upstream; //single capillary shape always conical
 				profile->ext[i] = (rad_ext_downstream-rad_ext_upstream)/length*profile->z[i] + rad_ext_upstream;
 			}
+			profile->shape.ext_poly[0] = rad_ext_upstream;
+			profile->shape.ext_poly[1] = (rad_ext_downstream-rad_ext_upstream)/length;
 			break;
 		case POLYCAP_PROFILE_PARABOLOIDAL:
 			//determine points to be part of polycap external shape, based on focii and external radii
@@ -166,6 +200,7 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 				profile->cap[i] = (rad_int_downstream-rad_int_upstream)/length*profile->z[i] + rad_int_upstream; //single capillary shape always conical
 				profile->ext[i] = coeff[0]+coeff[1]*profile->z[i]+coeff[2]*profile->z[i]*profile->z[i];
 			}
+			memcpy(profile->shape.ext_poly, coeff, sizeof(coeff));
 			break;
 
 		case POLYCAP_PROFILE_ELLIPSOIDAL: //side with largest radius has horizontal tangent, other side points towards focal_dist corresponding to smallest external radius
@@ -179,6 +214,7 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 					profile->cap[i] = (rad_int_downstream-rad_int_upstream)/length*profile->z[i] + rad_int_upstream; //single capillary shape always conical
 					profile->ext[i] = sqrt(b*b-(b*b*profile->z[i]*profile->z[i])/(a*a))+k;
 				}
+				profile->shape.ext_sqrt_z0 = 0.;
 			} else { //confocal (collimating) alignment
 				slope = rad_ext_upstream / focal_dist_upstream;
 				b = (-1.*(rad_ext_upstream-rad_ext_downstream)*(rad_ext_upstream-rad_ext_downstream)-slope*length*(rad_ext_upstream-rad_ext_downstream)) / (slope*length+2.*(rad_ext_upstream-rad_ext_downstream));
@@ -191,7 +227,11 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 				for(i=0;i<=nmax;i++){
 					profile->ext[i] = sqrt(b*b-(b*b*profile->z[nmax-i]*profile->z[nmax-i])/(a*a))+k;
 				}
+				profile->shape.ext_sqrt_z0 = length;
 			}
+			profile->shape.ext_poly[0] = k;
+			profile->shape.ext_sqrt[0] = b*b;
+			profile->shape.ext_sqrt[2] = -1.*(b*b)/(a*a);
 			break;
 
 		default:
@@ -203,6 +243,11 @@ polycap_profile* polycap_profile_new(polycap_profile_type type, double length, d
 			return NULL;
 	}
 
+	if(!polycap_profile_set_segments(profile, error)){
+		polycap_profile_free(profile);
+		return NULL;
+	}
+
 	return profile;
 }
 
@@ -235,10 +280,15 @@ polycap_profile* polycap_profile_new_from_file(const char *single_cap_profile_fi
 		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: could not open %s -> %s", single_cap_profile_file, strerror(errno));
 		return NULL;
 	}
-	fscanf(fptr,"%d",&n_tmp);
+	if(fscanf(fptr,"%d",&n_tmp) != 1){
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: could not read the number of intervals from %s", single_cap_profile_file);
+		fclose(fptr);
+		return NULL;
+	}
 	// check if these values make sense...
 	if (n_tmp <= 100) {
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_new_from_file: n_tmp must be greater than 100");
+		fclose(fptr);
 		return NULL;
 	}
 	
@@ -249,6 +299,12 @@ polycap_profile* polycap_profile_new_from_file(const char *single_cap_profile_fi
 		return NULL;
 	}
 	profile->nmax = n_tmp;
+	profile->nmax_trace = n_tmp;
+	profile->segments = NULL;
+	profile->ext_apothem = NULL;
+	profile->shape.known = false;
+	profile->shape.traced = false;
+	profile->mapping = NULL;
 	profile->z = malloc(sizeof(double)*(profile->nmax+1));
 	if(profile->z == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_new_from_file: could not allocate memory for profile->z -> %s", strerror(errno));
@@ -273,8 +329,13 @@ polycap_profile* polycap_profile_new_from_file(const char *single_cap_profile_fi
 
 	//Continue reading profile data
 	for(i=0; i<=profile->nmax; i++){
-		fscanf(fptr,"%lf %lf",&profile->z[i],&profile->cap[i]);
+		if(fscanf(fptr,"%lf %lf",&profile->z[i],&profile->cap[i]) != 2){
+			polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: could not read data point %d from %s", i, single_cap_profile_file);
+			fclose(fptr);
+			polycap_profile_free(profile);
+			return NULL;
 		}
+	}
 	fclose(fptr);
 
 	//polycapillary central axis
@@ -284,15 +345,20 @@ polycap_profile* polycap_profile_new_from_file(const char *single_cap_profile_fi
 		polycap_profile_free(profile);
 		return NULL;
 	}
-	fscanf(fptr,"%d",&n_tmp);
-	if(profile->nmax != n_tmp){
+	if(fscanf(fptr,"%d",&n_tmp) != 1 || profile->nmax != n_tmp){
 		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: Number of intervals inconsistent: %s", central_axis_file);
+		fclose(fptr);
 		polycap_profile_free(profile);
 		return NULL;
 		}
 	for(i=0; i<=profile->nmax; i++){
-		fscanf(fptr,"%lf %lf %lf",&profile->z[i],&sx,&sy);
+		if(fscanf(fptr,"%lf %lf %lf",&profile->z[i],&sx,&sy) != 3){
+			polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: could not read data point %d from %s", i, central_axis_file);
+			fclose(fptr);
+			polycap_profile_free(profile);
+			return NULL;
 		}
+	}
 	fclose(fptr);
 
 	//polycapillary external shape
@@ -302,20 +368,422 @@ polycap_profile* polycap_profile_new_from_file(const char *single_cap_profile_fi
 		polycap_profile_free(profile);
 		return NULL;
 		}
-	fscanf(fptr,"%d",&n_tmp);
-	if(profile->nmax != n_tmp){
+	if(fscanf(fptr,"%d",&n_tmp) != 1 || profile->nmax != n_tmp){
 		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: Number of intervals inconsistent: %s", external_shape_file);
+		fclose(fptr);
 		polycap_profile_free(profile);
 		return NULL;
 		}
 	for(i=0; i<=profile->nmax; i++){
-		fscanf(fptr,"%lf %lf",&profile->z[i],&profile->ext[i]);
+		if(fscanf(fptr,"%lf %lf",&profile->z[i],&profile->ext[i]) != 2){
+			polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_file: could not read data point %d from %s", i, external_shape_file);
+			fclose(fptr);
+			polycap_profile_free(profile);
+			return NULL;
 		}
+	}
 	fclose(fptr);
 
+	if(!polycap_profile_set_segments(profile, error)){
+		polycap_profile_free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+//===========================================
+// map a file read-only into memory, shared with all other processes that map it
+static void* polycap_profile_map_file(const char *filename, size_t *size, polycap_error **error)
+{
+	void *addr;
+#ifdef _WIN32
+	HANDLE file, map;
+	LARGE_INTEGER file_size;
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: could not open %s", filename);
+		return NULL;
+	}
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG) sizeof(polycap_profile_binary_header)) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: %s is not a binary profile file", filename);
+		CloseHandle(file);
+		return NULL;
+	}
+	*size = (size_t) file_size.QuadPart;
+	//the view keeps the file mapped after both handles are closed
+	map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	addr = map == NULL ? NULL : MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (map != NULL)
+		CloseHandle(map);
+	CloseHandle(file);
+	if (addr == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: could not map %s into memory", filename);
+		return NULL;
+	}
+#else
+	int fd;
+	struct stat st;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: could not open %s -> %s", filename, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(polycap_profile_binary_header)) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: %s is not a binary profile file", filename);
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t) st.st_size;
+	//the mapping remains valid after the file is closed
+	addr = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: could not map %s into memory -> %s", filename, strerror(errno));
+		return NULL;
+	}
+#endif
+	return addr;
+}
+//===========================================
+// unmap a file that was mapped with polycap_profile_map_file()
+static void polycap_profile_unmap_file(void *addr, size_t size)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(addr);
+#else
+	munmap(addr, size);
+#endif
+}
+//===========================================
+// drop a reference to a binary profile file mapping, which is unmapped when its last profile releases it
+static void polycap_profile_unref_mapping(polycap_profile_mapping *mapping)
+{
+	bool unmap;
+
+	#pragma omp critical(polycap_profile_mapping)
+	unmap = --mapping->refcount == 0;
+	if (unmap) {
+		polycap_profile_unmap_file(mapping->addr, mapping->size);
+		free(mapping);
+	}
+}
+//===========================================
+// get a new profile from a binary profile file, which is memory-mapped rather than read
+polycap_profile* polycap_profile_new_from_binary_file(const char *filename, polycap_error **error)
+{
+	polycap_profile *profile;
+	polycap_profile_binary_header header;
+	void *addr;
+	size_t size;
+
+	// argument sanity check
+	if (filename == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_new_from_binary_file: filename cannot be NULL");
+		return NULL;
+	}
+
+	addr = polycap_profile_map_file(filename, &size, error);
+	if (addr == NULL)
+		return NULL;
+
+	//check the header before trusting the array sizes it contains
+	memcpy(&header, addr, sizeof(header));
+	if (memcmp(header.magic, POLYCAP_PROFILE_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: %s is not a binary profile file", filename);
+		polycap_profile_unmap_file(addr, size);
+		return NULL;
+	}
+	if (header.version > POLYCAP_PROFILE_BINARY_VERSION) {
+		polycap_set_error(error, POLYCAP_ERROR_UNSUPPORTED, "polycap_profile_new_from_binary_file: %s has version %u, which is newer than the supported version %d", filename, (unsigned int) header.version, POLYCAP_PROFILE_BINARY_VERSION);
+		polycap_profile_unmap_file(addr, size);
+		return NULL;
+	}
+	if (header.byte_order != POLYCAP_PROFILE_BINARY_BYTE_ORDER) {
+		polycap_set_error(error, POLYCAP_ERROR_UNSUPPORTED, "polycap_profile_new_from_binary_file: %s was written on a machine with a different byte order", filename);
+		polycap_profile_unmap_file(addr, size);
+		return NULL;
+	}
+	//version 1 headers end before nmax_trace
+	if (header.version < 2)
+		header.nmax_trace = header.nmax;
+	if (header.nmax < 1 || header.nmax >= INT_MAX || header.nmax_trace < header.nmax || header.nmax_trace >= INT_MAX ||
+	    header.data_offset < (int64_t) (header.version < 2 ? offsetof(polycap_profile_binary_header, nmax_trace) : sizeof(header)) || header.data_offset % sizeof(double) != 0 ||
+	    (uint64_t) header.data_offset > size || (uint64_t) (header.nmax+1) > (size - header.data_offset)/(3*sizeof(double))) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_new_from_binary_file: %s is corrupt", filename);
+		polycap_profile_unmap_file(addr, size);
+		return NULL;
+	}
+
+	profile = calloc(1, sizeof(polycap_profile));
+	if (profile != NULL)
+		profile->mapping = malloc(sizeof(polycap_profile_mapping));
+	if (profile == NULL || profile->mapping == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_new_from_binary_file: could not allocate memory for profile -> %s", strerror(errno));
+		free(profile);
+		polycap_profile_unmap_file(addr, size);
+		return NULL;
+	}
+	profile->mapping->addr = addr;
+	profile->mapping->size = size;
+	profile->mapping->refcount = 1;
+	profile->nmax = (int) header.nmax;
+	profile->nmax_trace = (int) header.nmax_trace;
+	profile->z = (double *) ((char *) addr + header.data_offset);
+	profile->cap = profile->z + profile->nmax+1;
+	profile->ext = profile->cap + profile->nmax+1;
+
+	if(!polycap_profile_set_segments(profile, error)){
+		polycap_profile_free(profile);
+		return NULL;
+	}
+
 	return profile;
 }
 //===========================================
+// write a profile to a binary profile file
+bool polycap_profile_write_binary(polycap_profile *profile, const char *filename, polycap_error **error)
+{
+	FILE *fptr;
+	polycap_profile_binary_header header;
+	size_t n;
+	bool ok;
+
+	// argument sanity check
+	if (profile == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_write_binary: profile cannot be NULL");
+		return false;
+	}
+	if (filename == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_write_binary: filename cannot be NULL");
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, POLYCAP_PROFILE_BINARY_MAGIC, sizeof(header.magic));
+	header.version = POLYCAP_PROFILE_BINARY_VERSION;
+	header.byte_order = POLYCAP_PROFILE_BINARY_BYTE_ORDER;
+	header.nmax = profile->nmax;
+	header.data_offset = sizeof(header);
+	header.nmax_trace = profile->nmax_trace;
+
+	fptr = fopen(filename, "wb");
+	if(fptr == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_write_binary: could not open %s -> %s", filename, strerror(errno));
+		return false;
+	}
+	n = profile->nmax+1;
+	ok = fwrite(&header, sizeof(header), 1, fptr) == 1 &&
+	     fwrite(profile->z, sizeof(double), n, fptr) == n &&
+	     fwrite(profile->cap, sizeof(double), n, fptr) == n &&
+	     fwrite(profile->ext, sizeof(double), n, fptr) == n;
+	if (fclose(fptr) != 0)
+		ok = false;
+	if (!ok) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_profile_write_binary: could not write %s -> %s", filename, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+//===========================================
+// get a new profile that shares the memory-mapped arrays of profile, without segments
+polycap_profile* polycap_profile_share(polycap_profile *profile, polycap_error **error)
+{
+	polycap_profile *shared;
+
+	shared = calloc(1, sizeof(polycap_profile));
+	if (shared == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_share: could not allocate memory for profile -> %s", strerror(errno));
+		return NULL;
+	}
+	shared->nmax = profile->nmax;
+	shared->nmax_trace = profile->nmax_trace;
+	shared->shape = profile->shape;
+	shared->z = profile->z;
+	shared->cap = profile->cap;
+	shared->ext = profile->ext;
+	shared->mapping = profile->mapping;
+	#pragma omp critical(polycap_profile_mapping)
+	shared->mapping->refcount++;
+
+	return shared;
+}
+//===========================================
+// (re)calculate the segment coefficients and exterior apothems of a polycap_profile from its z, cap and ext arrays
+bool polycap_profile_set_segments(polycap_profile *profile, polycap_error **error)
+{
+	int i;
+
+	if (profile == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_set_segments: profile cannot be NULL");
+		return false;
+	}
+
+	if (profile->segments)
+		free(profile->segments);
+	profile->segments = malloc(sizeof(polycap_profile_segment)*profile->nmax);
+	if(profile->segments == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_set_segments: could not allocate memory for profile->segments -> %s", strerror(errno));
+		return false;
+	}
+
+	for(i=0; i<profile->nmax; i++){
+		profile->segments[i].dz = profile->z[i+1] - profile->z[i];
+		profile->segments[i].rad_slope = (profile->cap[i+1] - profile->cap[i])/profile->segments[i].dz;
+	}
+
+	if (profile->ext_apothem)
+		free(profile->ext_apothem);
+	profile->ext_apothem = malloc(sizeof(double)*(profile->nmax+1));
+	if(profile->ext_apothem == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_set_segments: could not allocate memory for profile->ext_apothem -> %s", strerror(errno));
+		return false;
+	}
+
+	for(i=0; i<=profile->nmax; i++)
+		profile->ext_apothem[i] = polycap_hex_apothem(profile->ext[i]);
+
+	return true;
+}
+//===========================================
+// choose between tracing photons on the closed-form shape of a profile from polycap_profile_new() and tracing them segment by segment
+bool polycap_profile_set_analytic_tracing(polycap_profile *profile, bool enable, polycap_error **error)
+{
+	// argument sanity check
+	if (profile == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_set_analytic_tracing: profile cannot be NULL");
+		return false;
+	}
+	if (enable && !profile->shape.known) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_UNSUPPORTED, "polycap_profile_set_analytic_tracing: profile has no closed-form shape, as it was not created with polycap_profile_new()");
+		return false;
+	}
+
+	profile->shape.traced = enable;
+	return true;
+}
+//===========================================
+// find the segment of a polycap_profile that contains z: the largest i in [0,last] for which profile->z[i] <= z
+// 	as the z coordinates increase monotonically this is a binary search, returning z_id if there is no such i
+int polycap_profile_find_segment(const polycap_profile *profile, double z, int last, int z_id)
+{
+	int low = 0, high = last, mid;
+
+	if (!(profile->z[0] <= z))
+		return z_id;
+	while (low < high) {
+		mid = low + (high - low + 1)/2;
+		if (profile->z[mid] <= z)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	return low;
+}
+//===========================================
+// narrow the interval [low,high] of slopes for which a line through point a of v stays within tolerance of point k
+static void polycap_profile_slope_limits(const double *z, const double *v, int a, int k, double tolerance, double *low, double *high)
+{
+	double dz = z[k] - z[a];
+
+	if ((v[k] - tolerance*fabs(v[k]) - v[a])/dz > *low)
+		*low = (v[k] - tolerance*fabs(v[k]) - v[a])/dz;
+	if ((v[k] + tolerance*fabs(v[k]) - v[a])/dz < *high)
+		*high = (v[k] + tolerance*fabs(v[k]) - v[a])/dz;
+}
+//===========================================
+// merge consecutive profile segments for as long as linear interpolation reproduces cap and ext of the removed points within a relative tolerance
+bool polycap_profile_compact(polycap_profile *profile, double tolerance, polycap_error **error)
+{
+	int *keep;
+	int n_keep, a, b, i;
+	double cap_low, cap_high, ext_low, ext_high, slope;
+	double *z, *cap, *ext;
+
+	// argument sanity check
+	if (profile == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_compact: profile cannot be NULL");
+		return false;
+	}
+	if (!(tolerance >= 0.0)) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_compact: tolerance must be greater than or equal to zero");
+		return false;
+	}
+	for(i=0; i<profile->nmax; i++){
+		if(!(profile->z[i] < profile->z[i+1])){
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_compact: profile z coordinates must be strictly increasing");
+			return false;
+		}
+	}
+
+	keep = malloc(sizeof(int)*(profile->nmax+1));
+	if (keep == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_compact: could not allocate memory for keep -> %s", strerror(errno));
+		return false;
+	}
+
+	// greedily extend each segment from point a to the furthest point b that keeps all points in between within tolerance
+	n_keep = 0;
+	a = 0;
+	keep[n_keep++] = a;
+	while (a < profile->nmax) {
+		cap_low = ext_low = -HUGE_VAL;
+		cap_high = ext_high = HUGE_VAL;
+		i = a+1;
+		for(b=a+1; b<=profile->nmax; b++){
+			slope = (profile->cap[b] - profile->cap[a])/(profile->z[b] - profile->z[a]);
+			if (slope >= cap_low && slope <= cap_high) {
+				slope = (profile->ext[b] - profile->ext[a])/(profile->z[b] - profile->z[a]);
+				if (slope >= ext_low && slope <= ext_high)
+					i = b;
+			}
+			polycap_profile_slope_limits(profile->z, profile->cap, a, b, tolerance, &cap_low, &cap_high);
+			polycap_profile_slope_limits(profile->z, profile->ext, a, b, tolerance, &ext_low, &ext_high);
+			if (cap_low > cap_high || ext_low > ext_high)
+				break;
+		}
+		a = i;
+		keep[n_keep++] = a;
+	}
+
+	z = malloc(sizeof(double)*n_keep);
+	cap = malloc(sizeof(double)*n_keep);
+	ext = malloc(sizeof(double)*n_keep);
+	if (z == NULL || cap == NULL || ext == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_compact: could not allocate memory for the compacted profile -> %s", strerror(errno));
+		free(z);
+		free(cap);
+		free(ext);
+		free(keep);
+		return false;
+	}
+	for(i=0; i<n_keep; i++){
+		z[i] = profile->z[keep[i]];
+		cap[i] = profile->cap[keep[i]];
+		ext[i] = profile->ext[keep[i]];
+	}
+	free(keep);
+
+	// the compacted arrays replace those of the profile, or its reference to a binary profile file
+	if (profile->mapping) {
+		polycap_profile_unref_mapping(profile->mapping);
+		profile->mapping = NULL;
+	} else {
+		free(profile->z);
+		free(profile->cap);
+		free(profile->ext);
+	}
+	profile->z = z;
+	profile->cap = cap;
+	profile->ext = ext;
+	profile->nmax = n_keep-1;
+
+	return polycap_profile_set_segments(profile, error);
+}
+//===========================================
 // validate (check physical feasibility of) polycap_profile
 // 	success: return 1, fail: return 0, error: return -1
 int polycap_profile_validate(polycap_profile *profile, int64_t n_cap, polycap_error **error)
@@ -345,36 +813,59 @@ int polycap_profile_validate(polycap_profile *profile, int64_t n_cap, polycap_er
 		if(full_check == 1){
 			int q_dir[6] = {1, 1, 0,-1,-1,0};
 			int r_dir[6] = {0,-1,-1, 0, 1,1};
+			int n_outer = 6*n_shells; // amount of capillaries on the outer shell
+			double *q_outer, *r_outer, *x, *y; // indices of the outer capillaries and their outer coordinates at a single Z
+			int *inside;
+
+			q_outer = malloc(sizeof(double)*4*n_outer);
+			inside = malloc(sizeof(int)*n_outer);
+			if(q_outer == NULL || inside == NULL){
+				polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_validate: could not allocate memory for outer capillary coordinates -> %s", strerror(errno));
+				free(q_outer);
+				free(inside);
+				return -1;
+			}
+			r_outer = q_outer + n_outer;
+			x = r_outer + n_outer;
+			y = x + n_outer;
+
 			q_i = -1.*n_shells;
 			r_i = n_shells;
 			for(j = 0; j < 6; j++){
 				for(k = 0; k < n_shells; k++){
 					q_i += q_dir[j];
 					r_i += r_dir[j];
-//					printf("q: %lf, r: %lf \n",q_i, r_i);
-					// determine selected capillary central axis coordinates and add capillary radius along current angle
-					for(i = 0; i <= profile->nmax; i++){
-						z = profile->ext[i]/(2.*COSPI_6*(n_shells+1));
-						coord.y = r_i * (3./2) * z;
-						coord.x = (2* q_i + r_i) * COSPI_6 * z;
-						angle = atan(coord.y/coord.x);
-						coord.x += cos(angle)*profile->cap[i];
-						coord.y += sin(angle)*profile->cap[i];
-						coord.z = profile->z[i];
-						// check if [capx,capy] is within polycap boundaries
-						check = polycap_photon_within_pc_boundary(profile->ext[i], coord, error);
-//						printf("i;j: %i; %i ext: %lf; coord.x %lf; y: %lf; z:%lf; q_i: %lf; r_i:%lf; z: %lf; n_shells: %lf\n",i,j,profile->ext[i], coord.x, coord.y, coord.z, q_i, r_i, z, n_shells);
-						if(check == 0){ //coordinate is outside of optic
-							printf("Error1\n");
-							return 0;
-						}
-						if(check == -1){ //polycap_photon_within_pc_boundary gave error
-							printf("Error2\n");
-							return -1;
-						}
-					}
+					q_outer[j*(int)n_shells+k] = q_i;
+					r_outer[j*(int)n_shells+k] = r_i;
+				}
+			}
+			for(i = 0; i <= profile->nmax; i++){
+				if(profile->ext[i] <= 0.){
+					printf("Error2\n");
+					polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_profile_validate: profile->ext must be greater than 0");
+					free(q_outer);
+					free(inside);
+					return -1;
+				}
+				// determine outer capillary central axis coordinates and add capillary radius along current angle
+				z = profile->ext[i]/(2.*COSPI_6*(n_shells+1));
+				for(j = 0; j < n_outer; j++){
+					coord.y = r_outer[j] * (3./2) * z;
+					coord.x = (2* q_outer[j] + r_outer[j]) * COSPI_6 * z;
+					angle = atan(coord.y/coord.x);
+					x[j] = coord.x + cos(angle)*profile->cap[i];
+					y[j] = coord.y + sin(angle)*profile->cap[i];
+				}
+				// check if all [capx,capy] at this Z are within polycap boundaries
+				if(polycap_photon_within_pc_boundary_batch(polycap_hex_apothem(profile->ext[i]), n_outer, x, y, inside) < n_outer){ //coordinate is outside of optic
+					printf("Error1\n");
+					free(q_outer);
+					free(inside);
+					return 0;
 				}
 			}
+			free(q_outer);
+			free(inside);
 
 		} else {
 			// calculate amount of capillaries on outer shell, divided by 4 
@@ -454,6 +945,12 @@ polycap_profile *polycap_profile_new_from_arrays(int nid, double *ext, double *c
 
 	// alloc new array memory
 	profile->nmax = nid;
+	profile->nmax_trace = nid;
+	profile->segments = NULL;
+	profile->ext_apothem = NULL;
+	profile->shape.known = false;
+	profile->shape.traced = false;
+	profile->mapping = NULL;
 	profile->ext = malloc(sizeof(double)*(nid+1));
 	if(profile->ext == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_profile_set_profile: could not allocate memory for profile->ext -> %s", strerror(errno));
@@ -470,6 +967,11 @@ polycap_profile *polycap_profile_new_from_arrays(int nid, double *ext, double *c
 	memcpy(profile->cap, cap, sizeof(double) * (nid+1));
 	memcpy(profile->z, z, sizeof(double) * (nid+1));
 
+	if(!polycap_profile_set_segments(profile, error)){
+		polycap_profile_free(profile);
+		return NULL;
+	}
+
 	return profile;
 }
 //===========================================
@@ -523,12 +1025,21 @@ void polycap_profile_free(polycap_profile *profile)
 {
 	if (profile == NULL)
 		return;
-	if (profile->z)
-		free(profile->z);
-	if (profile->cap)
-		free(profile->cap);
-	if (profile->ext)
-		free(profile->ext);
+	if (profile->mapping) {
+		//the arrays are part of the mapping
+		polycap_profile_unref_mapping(profile->mapping);
+	} else {
+		if (profile->z)
+			free(profile->z);
+		if (profile->cap)
+			free(profile->cap);
+		if (profile->ext)
+			free(profile->ext);
+	}
+	if (profile->segments)
+		free(profile->segments);
+	if (profile->ext_apothem)
+		free(profile->ext_apothem);
 	free(profile);
 }
 
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+#include "polycap-private.h"
+#include <stdlib.h>
+
+//===========================================
+// get a new progress monitor that forwards its progress to set_value
+polycap_progress_monitor* polycap_progress_monitor_new(polycap_progress_monitor_set_value_func set_value, void *user_data, polycap_error **error)
+{
+	polycap_progress_monitor *progress_monitor;
+
+	if (set_value == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_progress_monitor_new: set_value cannot be NULL");
+		return NULL;
+	}
+
+	progress_monitor = malloc(sizeof(polycap_progress_monitor));
+	if (progress_monitor == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_progress_monitor_new: could not allocate memory for progress_monitor -> %s", strerror(errno));
+		return NULL;
+	}
+	progress_monitor->set_value = set_value;
+	progress_monitor->user_data = user_data;
+
+	return progress_monitor;
+}
+//===========================================
+// report progress, if a progress monitor was provided
+void polycap_progress_monitor_set_value(polycap_progress_monitor *progress_monitor, double value)
+{
+	if (progress_monitor == NULL)
+		return;
+	progress_monitor->set_value(value, progress_monitor->user_data);
+}
+//===========================================
+// free a polycap_progress_monitor struct
+void polycap_progress_monitor_free(polycap_progress_monitor *progress_monitor)
+{
+	free(progress_monitor);
+}
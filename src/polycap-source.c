@@ -18,11 +18,19 @@
 #include <inttypes.h>
 #include <omp.h> /* openmp header */
 
+#define WELFORD_MERGE 1000 /* the amount of photons after which a thread merges its running statistics with the shared ones */
+
+// running mean and variance of the photon weights, per energy
+typedef struct {
+	int64_t n;
+	double *mean;
+	double *m2;
+} polycap_welford;
+
 //===========================================
 // Obtain a photon structure from source and polycap description
 polycap_photon* polycap_source_get_photon(polycap_source *source, polycap_rng *rng, polycap_error **error)
 {
-	double n_shells; //amount of capillary shells in polycapilary
 	polycap_vector3 start_coords, start_direction, start_electric_vector, src_start_coords;
 	double r; //random number
 	int boundary_check = 0;
@@ -73,8 +81,7 @@ polycap_photon* polycap_source_get_photon(polycap_source *source, polycap_rng *r
 	// otherwise, photon direction vector is within +- sigx or sigy
 	if( source->src_sigx < 0. || source->src_sigy < 0.){ //uniform distribution over PC entrance
 		// Obtain photon start coordinates
-		n_shells = round(sqrt(12. * description->n_cap - 3.)/6.-0.5);
-		if(n_shells == 0.){ //monocapillary case
+		if(description->geometry.monocap){ //monocapillary case
 			r = polycap_rng_uniform(rng);
 			start_coords.x = (2.*r-1.) * description->profile->cap[0];
 			r = polycap_rng_uniform(rng);
@@ -87,7 +94,7 @@ polycap_photon* polycap_source_get_photon(polycap_source *source, polycap_rng *r
 				start_coords.x = (2.*r-1.) * description->profile->ext[0];
 				r = polycap_rng_uniform(rng);
 				start_coords.y = (2.*r-1.) * description->profile->ext[0];
-				boundary_check = polycap_photon_within_pc_boundary(description->profile->ext[0], start_coords, error);
+				boundary_check = polycap_hex_within_boundary(description->profile->ext_apothem[0], start_coords.x, start_coords.y);
 			} while(boundary_check == 0);
 		}
 		//now determine direction photon must have had in order to bridge src_start_coords and start_coords
@@ -211,6 +218,10 @@ polycap_source* polycap_source_new(polycap_description *description, double d_so
 	source->src_shifty = src_shifty;
 	source->hor_pol = hor_pol;
 	source->n_energies = n_energies;
+	source->record_histories = false;
+	source->single_precision = false;
+	source->use_seed = false;
+	source->seed = 0;
 	memcpy(source->energies, energies, sizeof(double)*n_energies);
 	source->rng = polycap_rng_new();
 	source->description = polycap_description_new(description->profile, description->sig_rough, description->n_cap, description->nelem, description->iz, description->wi, description->density, NULL);
@@ -350,6 +361,16 @@ polycap_source* polycap_source_new_from_file(const char *filename, polycap_error
 			polycap_source_free(source);
 			return NULL;
 		}
+	} else if(type == 3){
+		//a binary profile file, see polycap_profile_write_binary()
+		i=fgetc(fptr); //reads in \n from last line still
+		single_cap_profile_file = polycap_read_input_line(fptr, error);
+		description->profile = polycap_profile_new_from_binary_file(single_cap_profile_file, error);
+		free(single_cap_profile_file);
+		if (description->profile == NULL) {
+			polycap_source_free(source);
+			return NULL;
+		}
 	} else {
 		i=fgetc(fptr); //reads in \n from last line still
 		single_cap_profile_file = polycap_read_input_line(fptr, error);
@@ -440,29 +461,112 @@ polycap_source* polycap_source_new_from_file(const char *filename, polycap_error
 		polycap_source_free(source);
 		return NULL;
 	}
+	if(!polycap_description_set_geometry(description, error)){
+		polycap_source_free(source);
+		return NULL;
+	}
 
 	return source;
 }
 //===========================================
+static bool polycap_welford_init(polycap_welford *acc, size_t n_energies)
+{
+	acc->n = 0;
+	acc->mean = calloc(n_energies, sizeof(double));
+	acc->m2 = calloc(n_energies, sizeof(double));
+	return acc->mean != NULL && acc->m2 != NULL;
+}
+//===========================================
+static void polycap_welford_clear(polycap_welford *acc)
+{
+	free(acc->mean);
+	free(acc->m2);
+}
+//===========================================
+// add the weights of a single photon to the running statistics (Welford's algorithm)
+//	photons that did not make it through the optic have weights NULL, and count as zero weight
+static void polycap_welford_add(polycap_welford *acc, size_t n_energies, double *weights)
+{
+	size_t i;
+	double x, delta;
+
+	acc->n++;
+	for(i=0; i < n_energies; i++){
+		x = weights == NULL ? 0. : weights[i];
+		delta = x - acc->mean[i];
+		acc->mean[i] += delta/acc->n;
+		acc->m2[i] += delta*(x - acc->mean[i]);
+	}
+}
+//===========================================
+// merge the running statistics of other into acc (Chan et al.), and reset other
+static void polycap_welford_merge(polycap_welford *acc, polycap_welford *other, size_t n_energies)
+{
+	size_t i;
+	double n, delta;
+
+	if(other->n == 0)
+		return;
+	n = (double)acc->n + (double)other->n;
+	for(i=0; i < n_energies; i++){
+		delta = other->mean[i] - acc->mean[i];
+		acc->mean[i] += delta*(double)other->n/n;
+		acc->m2[i] += other->m2[i] + delta*delta*(double)acc->n*(double)other->n/n;
+		other->mean[i] = 0.;
+		other->m2[i] = 0.;
+	}
+	acc->n += other->n;
+	other->n = 0;
+}
+//===========================================
+// standard error of the mean weight at energy index i
+static double polycap_welford_std_error(polycap_welford *acc, size_t i)
+{
+	if(acc->n < 2)
+		return 0.;
+	return sqrt(acc->m2[i]/(double)(acc->n-1)/(double)acc->n);
+}
+//===========================================
+// check whether the relative standard error of the mean weight is below target_rel_error for the selected energies (all energies if n_selected is 0)
+static bool polycap_welford_converged(polycap_welford *acc, double target_rel_error, size_t n_energies, size_t n_selected, const size_t *selected)
+{
+	size_t i, k;
+
+	for(k=0; k < (n_selected > 0 ? n_selected : n_energies); k++){
+		i = n_selected > 0 ? selected[k] : k;
+		if(acc->mean[i] <= 0. || polycap_welford_std_error(acc, i) > target_rel_error*acc->mean[i])
+			return false;
+	}
+	return true;
+}
+//===========================================
 // for a given array of energies, and a full polycap_description, get the transmission efficiencies.
-polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(polycap_source *source, int max_threads, int n_photons, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
+//	if target_rel_error is positive, no new photons are launched as soon as the relative standard error of the efficiencies at the selected energies drops below it,
+//	in which case fewer than n_photons photons may be transmitted
+//	photon_offset is added to the photon index when deriving the random numbers from the source seed
+//	amu and scatf hold the attenuation coefficients and scattering factors of the material at source->energies, which are copied into every launched photon
+static polycap_transmission_efficiencies* polycap_source_trace_tables(polycap_source *source, int max_threads, int n_photons, int64_t photon_offset, double target_rel_error, size_t n_selected, const size_t *selected, const double *amu, const double *scatf, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
 {
 	int i;
+	int64_t j;
 	int64_t sum_iexit=0, sum_irefl=0, sum_not_entered=0, sum_not_transmitted=0;
 	int64_t *iexit_temp, *not_entered_temp, *not_transmitted_temp;
 	int64_t leak_counter, intleak_counter;
+	int64_t n_stored = 0; //amount of transmitted photons stored in the images so far
+	bool converged = false;
+	bool welford_failed = false; //set when a thread could not allocate its running statistics
 	double *sum_weights;
+	polycap_welford total;
 	polycap_transmission_efficiencies *efficiencies;
+	polycap_refl_event **slot_history = NULL; //reflection history of each transmitted photon, until they are gathered in the images
+	int64_t *slot_n_history = NULL;
+	int64_t n_history = 0;
 
 	// argument sanity check
 	if (source == NULL) {
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies: source cannot be NULL");
 		return NULL;
 	}
-	if (progress_monitor != NULL) {
-		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies: progress_monitor must be NULL as polycap_progress_monitor currently has no implementation");
-		return NULL;
-	}
 	polycap_description *description = source->description;
 	if (description == NULL) {
 		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies: description cannot be NULL");
@@ -544,6 +648,13 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		free(sum_weights);
 		return NULL;
 	}
+	efficiencies->std_errors = malloc(sizeof(double)*source->n_energies);
+	if(efficiencies->std_errors == NULL){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->std_errors -> %s", strerror(errno));
+		polycap_transmission_efficiencies_free(efficiencies);
+		free(sum_weights);
+		return NULL;
+	}
 
 	//Assign image coordinate array (initial) memory
 	efficiencies->images = calloc(1, sizeof(struct _polycap_images));
@@ -553,111 +664,71 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->pc_start_coords[0] = malloc(sizeof(double)*n_photons);
+	//vector quantities are stored per component, with all three components sharing a single allocation
+	efficiencies->images->mem_size = n_photons;
+	efficiencies->images->pc_start_coords[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_start_coords[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_coords[0] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_start_coords[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_start_coords[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_coords[1] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_coords -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->src_start_coords[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->pc_start_coords[1] = efficiencies->images->pc_start_coords[0] + n_photons;
+	efficiencies->images->pc_start_coords[2] = efficiencies->images->pc_start_coords[0] + n_photons*2;
+	efficiencies->images->src_start_coords[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->src_start_coords[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->src_start_coords[0] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->src_start_coords -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->src_start_coords[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->src_start_coords[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->src_start_coords[1] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_start_dir[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->src_start_coords[1] = efficiencies->images->src_start_coords[0] + n_photons;
+	efficiencies->images->src_start_coords[2] = efficiencies->images->src_start_coords[0] + n_photons*2;
+	efficiencies->images->pc_start_dir[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_start_dir[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_dir[0] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_dir -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->pc_start_dir[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_start_dir[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_dir[1] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_start_elecv[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->pc_start_dir[1] = efficiencies->images->pc_start_dir[0] + n_photons;
+	efficiencies->images->pc_start_dir[2] = efficiencies->images->pc_start_dir[0] + n_photons*2;
+	efficiencies->images->pc_start_elecv[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_start_elecv[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_elecv[0] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_elecv -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->pc_start_elecv[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_start_elecv[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_start_elecv[1] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_exit_coords[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->pc_start_elecv[1] = efficiencies->images->pc_start_elecv[0] + n_photons;
+	efficiencies->images->pc_start_elecv[2] = efficiencies->images->pc_start_elecv[0] + n_photons*2;
+	efficiencies->images->pc_exit_coords[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_exit_coords[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_coords[0] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_exit_coords[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_exit_coords[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_coords[1] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_exit_coords[2] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_exit_coords[2] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_coords[2] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_coords -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->pc_exit_dir[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->pc_exit_coords[1] = efficiencies->images->pc_exit_coords[0] + n_photons;
+	efficiencies->images->pc_exit_coords[2] = efficiencies->images->pc_exit_coords[0] + n_photons*2;
+	efficiencies->images->pc_exit_dir[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_exit_dir[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_dir[0] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_dir -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
-	efficiencies->images->pc_exit_dir[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_exit_dir[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_dir[1] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_exit_elecv[0] = malloc(sizeof(double)*n_photons);
+	efficiencies->images->pc_exit_dir[1] = efficiencies->images->pc_exit_dir[0] + n_photons;
+	efficiencies->images->pc_exit_dir[2] = efficiencies->images->pc_exit_dir[0] + n_photons*2;
+	efficiencies->images->pc_exit_elecv[0] = malloc(sizeof(double)*n_photons*3);
 	if(efficiencies->images->pc_exit_elecv[0] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_elecv[0] -> %s", strerror(errno));
-		polycap_transmission_efficiencies_free(efficiencies);
-		free(sum_weights);
-		return NULL;
-	}
-	efficiencies->images->pc_exit_elecv[1] = malloc(sizeof(double)*n_photons);
-	if(efficiencies->images->pc_exit_elecv[1] == NULL){
-		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_elecv[1] -> %s", strerror(errno));
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_elecv -> %s", strerror(errno));
 		polycap_transmission_efficiencies_free(efficiencies);
 		free(sum_weights);
 		return NULL;
 	}
+	efficiencies->images->pc_exit_elecv[1] = efficiencies->images->pc_exit_elecv[0] + n_photons;
+	efficiencies->images->pc_exit_elecv[2] = efficiencies->images->pc_exit_elecv[0] + n_photons*2;
 	efficiencies->images->pc_exit_nrefl = malloc(sizeof(int64_t)*n_photons);
 	if(efficiencies->images->pc_exit_nrefl == NULL){
 		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->pc_exit_nrefl -> %s", strerror(errno));
@@ -679,6 +750,27 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		free(sum_weights);
 		return NULL;
 	}
+	if(!polycap_welford_init(&total, source->n_energies)){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for the running statistics -> %s", strerror(errno));
+		polycap_welford_clear(&total);
+		polycap_transmission_efficiencies_free(efficiencies);
+		free(sum_weights);
+		return NULL;
+	}
+	if(source->record_histories){
+		slot_history = calloc(n_photons, sizeof(polycap_refl_event*));
+		slot_n_history = calloc(n_photons, sizeof(int64_t));
+		efficiencies->images->refl_history_offset = malloc(sizeof(int64_t)*(n_photons+1));
+		if(slot_history == NULL || slot_n_history == NULL || efficiencies->images->refl_history_offset == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for the reflection histories -> %s", strerror(errno));
+			free(slot_history);
+			free(slot_n_history);
+			polycap_welford_clear(&total);
+			polycap_transmission_efficiencies_free(efficiencies);
+			free(sum_weights);
+			return NULL;
+		}
+	}
 	efficiencies->source = source;
 
 //	// use cancelled as global variable to indicate that the OpenMP loop was aborted due to an error
@@ -701,6 +793,8 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 {
 	int thread_id = omp_get_thread_num();
 	int j = 0;
+	int64_t slot = 0; //index of the transmitted photon within the images
+	polycap_welford local; //running statistics of this thread, merged into total every WELFORD_MERGE photons
 	polycap_rng *rng;
 	polycap_photon *photon;
 	int iesc=0, k, l;
@@ -735,6 +829,10 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 
 	for(k=0; k<source->n_energies; k++)
 		weights[k] = 0.;
+	if(!polycap_welford_init(&local, source->n_energies)){
+		#pragma omp atomic write
+		welford_failed = true;
+	}
 
 	// Create new rng
 	rng = polycap_rng_new();
@@ -743,11 +841,22 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 	i=0; //counter to monitor calculation proceeding
 	#pragma omp for
 	for(j=0; j < n_photons; j++){
+		//once the target uncertainty is reached the remaining iterations are skipped
+		#pragma omp flush(converged, welford_failed)
+		if(converged || welford_failed)
+			continue;
+		//with a fixed seed photon j always starts from the same random numbers, whichever thread traces it
+		if(source->use_seed)
+			polycap_rng_set(rng, source->seed + (unsigned long int) (photon_offset + j));
 		do{
 			// Create photon structure
 			photon = polycap_source_get_photon(source, rng, NULL);
+			if(photon != NULL){
+				photon->record_history = source->record_histories;
+				photon->single_precision = source->single_precision;
+			}
 			// Launch photon
-			iesc = polycap_photon_launch(photon, source->n_energies, source->energies, &weights_temp, leak_calc, NULL);
+			iesc = polycap_photon_launch_tables(photon, source->n_energies, source->energies, amu, scatf, &weights_temp, leak_calc, NULL);
 			//if iesc == 0 here a new photon should be simulated/started as the photon was absorbed within it.
 			//if iesc == 1 check whether photon is in PC exit window as photon reached end of PC
 			//if iesc == 2 a new photon should be simulated/started as the photon hit the walls -> can still leak
@@ -759,31 +868,40 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 				not_transmitted_temp[thread_id]++; //photon did not reach end of PC
 			if(iesc == 2)
 				not_entered_temp[thread_id]++; //photon never entered PC (hit capillary wall instead of opening)
+			if(iesc == 0 || iesc == 2)
+				polycap_welford_add(&local, source->n_energies, NULL); //these photons count towards the efficiencies with zero weight
 			if(iesc == 1) {
 				//check whether photon is within optic exit window
 					//different check for monocapillary case...
 				temp_vect.x = photon->exit_coords.x + photon->exit_direction.x * (description->profile->z[description->profile->nmax] - photon->exit_coords.z)/photon->exit_direction.z;
 				temp_vect.y = photon->exit_coords.y + photon->exit_direction.y * (description->profile->z[description->profile->nmax] - photon->exit_coords.z)/photon->exit_direction.z;
 				temp_vect.z = description->profile->z[description->profile->nmax];
-				if(round(sqrt(12. * photon->description->n_cap - 3.)/6.-0.5) == 0.){ //monocapillary case
+				if(description->geometry.monocap){ //monocapillary case
 					if(sqrt((temp_vect.x)*(temp_vect.x) + (temp_vect.y)*(temp_vect.y)) > description->profile->ext[description->profile->nmax]){ 
 						iesc = 0;
 					} else {
 						iesc = 1;
 					}
 				} else { //polycapillary case
-					iesc = polycap_photon_within_pc_boundary(description->profile->ext[description->profile->nmax],temp_vect, NULL);
+					iesc = polycap_hex_within_boundary(description->profile->ext_apothem[description->profile->nmax], temp_vect.x, temp_vect.y);
 				}
 			}
 			//Register succesfully transmitted photon, as well as save start coordinates and direction
 			if(iesc == 1){
 				iexit_temp[thread_id]++;
-				efficiencies->images->src_start_coords[0][j] = photon->src_start_coords.x;
-				efficiencies->images->src_start_coords[1][j] = photon->src_start_coords.y;
-				efficiencies->images->pc_start_coords[0][j] = photon->start_coords.x;
-				efficiencies->images->pc_start_coords[1][j] = photon->start_coords.y;
-				efficiencies->images->pc_start_dir[0][j] = photon->start_direction.x;
-				efficiencies->images->pc_start_dir[1][j] = photon->start_direction.y;
+				#pragma omp critical
+				{
+				slot = n_stored++;
+				}
+				efficiencies->images->src_start_coords[0][slot] = photon->src_start_coords.x;
+				efficiencies->images->src_start_coords[1][slot] = photon->src_start_coords.y;
+				efficiencies->images->src_start_coords[2][slot] = 0.;
+				efficiencies->images->pc_start_coords[0][slot] = photon->start_coords.x;
+				efficiencies->images->pc_start_coords[1][slot] = photon->start_coords.y;
+				efficiencies->images->pc_start_coords[2][slot] = 0.;
+				efficiencies->images->pc_start_dir[0][slot] = photon->start_direction.x;
+				efficiencies->images->pc_start_dir[1][slot] = photon->start_direction.y;
+				efficiencies->images->pc_start_dir[2][slot] = photon->start_direction.z;
 				//the start_electric_vector here is along polycapillary axis, better to project this to photon direction axis (i.e. result should be 1 0 or 0 1)
 				cosalpha = polycap_scalar(photon->start_electric_vector, photon->start_direction);
 				alpha = acos(cosalpha);
@@ -793,8 +911,9 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 				temp_vect.y = photon->start_electric_vector.y * c_ae + photon->start_direction.y * c_be;
 				temp_vect.z = photon->start_electric_vector.z * c_ae + photon->start_direction.z * c_be;
 				polycap_norm(&temp_vect);
-				efficiencies->images->pc_start_elecv[0][j] = round(temp_vect.x);
-				efficiencies->images->pc_start_elecv[1][j] = round(temp_vect.y);
+				efficiencies->images->pc_start_elecv[0][slot] = round(temp_vect.x);
+				efficiencies->images->pc_start_elecv[1][slot] = round(temp_vect.y);
+				efficiencies->images->pc_start_elecv[2][slot] = round(temp_vect.z);
 			}
 			if(leak_calc) { //store potential leak and intleak events for photons that did not reach optic exit window
 				if(iesc == 0 || iesc == 2){ 
@@ -885,6 +1004,7 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 
 		if(thread_id == 0 && (double)i/((double)n_photons/(double)max_threads/10.) >= 1.){
 			printf("%d%% Complete\t%" PRId64 " reflections\tLast reflection at z=%f, d_travel=%f\n",((j*100)/(n_photons/max_threads)),photon->i_refl,photon->exit_coords.z, photon->d_travel);
+			polycap_progress_monitor_set_value(progress_monitor, (double)j/((double)n_photons/(double)max_threads));
 			i=0;
 		}
 		i++;//counter just to follow % completed
@@ -892,19 +1012,29 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		//save photon->weight in thread unique array
 		for(k=0; k<source->n_energies; k++){
 			weights[k] += weights_temp[k];
-			efficiencies->images->exit_coord_weights[k+j*source->n_energies] = weights_temp[k];
+			efficiencies->images->exit_coord_weights[k+slot*source->n_energies] = weights_temp[k];
+		}
+		polycap_welford_add(&local, source->n_energies, weights_temp);
+		if(target_rel_error > 0. && local.n >= WELFORD_MERGE){
+			#pragma omp critical
+			{
+			polycap_welford_merge(&total, &local, source->n_energies);
+			if(polycap_welford_converged(&total, target_rel_error, source->n_energies, n_selected, selected))
+				converged = true;
+			}
 		}
 		//save photon exit coordinates and propagation vector
 		//Make sure to calculate exit_coord at capillary exit (Z = capillary length); currently the exit_coord is the coordinate of the last photon-wall interaction
 //printf("** coords: %lf, %lf, %lf; length: %lf\n", photon->exit_coords.x, photon->exit_coords.y, photon->exit_coords.z, );
-		efficiencies->images->pc_exit_coords[0][j] = photon->exit_coords.x + photon->exit_direction.x*
+		efficiencies->images->pc_exit_coords[0][slot] = photon->exit_coords.x + photon->exit_direction.x*
 			(description->profile->z[description->profile->nmax] - photon->exit_coords.z)/photon->exit_direction.z;
-		efficiencies->images->pc_exit_coords[1][j] = photon->exit_coords.y + photon->exit_direction.y*
+		efficiencies->images->pc_exit_coords[1][slot] = photon->exit_coords.y + photon->exit_direction.y*
 			(description->profile->z[description->profile->nmax] - photon->exit_coords.z)/photon->exit_direction.z;
-		efficiencies->images->pc_exit_coords[2][j] = photon->exit_coords.z + photon->exit_direction.z*
+		efficiencies->images->pc_exit_coords[2][slot] = photon->exit_coords.z + photon->exit_direction.z*
 			(description->profile->z[description->profile->nmax] - photon->exit_coords.z)/photon->exit_direction.z;
-		efficiencies->images->pc_exit_dir[0][j] = photon->exit_direction.x;
-		efficiencies->images->pc_exit_dir[1][j] = photon->exit_direction.y;
+		efficiencies->images->pc_exit_dir[0][slot] = photon->exit_direction.x;
+		efficiencies->images->pc_exit_dir[1][slot] = photon->exit_direction.y;
+		efficiencies->images->pc_exit_dir[2][slot] = photon->exit_direction.z;
 		// the electric_vector here is along polycapillary axis, better to project this to photon direction axis (i.e. result should be 1 0 or 0 1)
 		cosalpha = polycap_scalar(photon->start_electric_vector, photon->start_direction);
 		alpha = acos(cosalpha);
@@ -914,12 +1044,13 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		temp_vect.y = photon->exit_electric_vector.y * c_ae + photon->exit_direction.y * c_be;
 		temp_vect.z = photon->exit_electric_vector.z * c_ae + photon->exit_direction.z * c_be;
 		polycap_norm(&temp_vect);
-		efficiencies->images->pc_exit_elecv[0][j] = round(temp_vect.x);
-		efficiencies->images->pc_exit_elecv[1][j] = round(temp_vect.y);
-		efficiencies->images->pc_exit_nrefl[j] = photon->i_refl;
-		efficiencies->images->pc_exit_dtravel[j] = photon->d_travel + 
-			sqrt( (efficiencies->images->pc_exit_coords[0][j] - photon->exit_coords.x)*(efficiencies->images->pc_exit_coords[0][j] - photon->exit_coords.x) + 
-			(efficiencies->images->pc_exit_coords[1][j] - photon->exit_coords.y)*(efficiencies->images->pc_exit_coords[1][j] - photon->exit_coords.y) + 
+		efficiencies->images->pc_exit_elecv[0][slot] = round(temp_vect.x);
+		efficiencies->images->pc_exit_elecv[1][slot] = round(temp_vect.y);
+		efficiencies->images->pc_exit_elecv[2][slot] = round(temp_vect.z);
+		efficiencies->images->pc_exit_nrefl[slot] = photon->i_refl;
+		efficiencies->images->pc_exit_dtravel[slot] = photon->d_travel + 
+			sqrt( (efficiencies->images->pc_exit_coords[0][slot] - photon->exit_coords.x)*(efficiencies->images->pc_exit_coords[0][slot] - photon->exit_coords.x) + 
+			(efficiencies->images->pc_exit_coords[1][slot] - photon->exit_coords.y)*(efficiencies->images->pc_exit_coords[1][slot] - photon->exit_coords.y) + 
 			(description->profile->z[description->profile->nmax] - photon->exit_coords.z)*(description->profile->z[description->profile->nmax] - photon->exit_coords.z));
 
 		//Assign memory to arrays holding leak photon information (and fill them)
@@ -960,6 +1091,13 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 			}
 		}
 
+		//hand the reflection history over to the images
+		if(source->record_histories){
+			slot_history[slot] = photon->refl_history;
+			slot_n_history[slot] = photon->n_refl_history;
+			photon->refl_history = NULL;
+		}
+
 		#pragma omp critical
 		{
 		sum_irefl += photon->i_refl;
@@ -973,6 +1111,8 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 	#pragma omp critical
 	{
 	for(i=0; i<source->n_energies; i++) sum_weights[i] += weights[i];
+	if(!welford_failed)
+		polycap_welford_merge(&total, &local, source->n_energies);
 	if(leak_calc){
 		efficiencies->images->i_extleak += n_extleak;
 		efficiencies->images->i_intleak += n_intleak;
@@ -983,20 +1123,26 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		#pragma omp barrier //All threads must reach here before we continue.
 		#pragma omp single //Only one thread should allocate following memory. There is an automatic barrier at the end of this block.
 		{
-		efficiencies->images->extleak_coords[0] = realloc(efficiencies->images->extleak_coords[0], sizeof(double)* efficiencies->images->i_extleak);
-		efficiencies->images->extleak_coords[1] = realloc(efficiencies->images->extleak_coords[1], sizeof(double)* efficiencies->images->i_extleak);
-		efficiencies->images->extleak_coords[2] = realloc(efficiencies->images->extleak_coords[2], sizeof(double)* efficiencies->images->i_extleak);
-		efficiencies->images->extleak_dir[0] = realloc(efficiencies->images->extleak_dir[0], sizeof(double)* efficiencies->images->i_extleak);
-		efficiencies->images->extleak_dir[1] = realloc(efficiencies->images->extleak_dir[1], sizeof(double)* efficiencies->images->i_extleak);
+		efficiencies->images->extleak_coords[0] = realloc(efficiencies->images->extleak_coords[0], sizeof(double)* efficiencies->images->i_extleak*3);
+		efficiencies->images->extleak_coords[1] = efficiencies->images->extleak_coords[0] + efficiencies->images->i_extleak;
+		efficiencies->images->extleak_coords[2] = efficiencies->images->extleak_coords[0] + efficiencies->images->i_extleak*2;
+		efficiencies->images->extleak_dir[0] = realloc(efficiencies->images->extleak_dir[0], sizeof(double)* efficiencies->images->i_extleak*3);
+		efficiencies->images->extleak_dir[1] = efficiencies->images->extleak_dir[0] + efficiencies->images->i_extleak;
+		efficiencies->images->extleak_dir[2] = efficiencies->images->extleak_dir[0] + efficiencies->images->i_extleak*2;
+		efficiencies->images->extleak_elecv[0] = realloc(efficiencies->images->extleak_elecv[0], sizeof(double)* efficiencies->images->i_extleak*3);
+		efficiencies->images->extleak_elecv[1] = efficiencies->images->extleak_elecv[0] + efficiencies->images->i_extleak;
+		efficiencies->images->extleak_elecv[2] = efficiencies->images->extleak_elecv[0] + efficiencies->images->i_extleak*2;
 		efficiencies->images->extleak_n_refl = realloc(efficiencies->images->extleak_n_refl, sizeof(int64_t)* efficiencies->images->i_extleak);
 		efficiencies->images->extleak_coord_weights = realloc(efficiencies->images->extleak_coord_weights, sizeof(double)*source->n_energies* efficiencies->images->i_extleak);
-		efficiencies->images->intleak_coords[0] = realloc(efficiencies->images->intleak_coords[0], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_coords[1] = realloc(efficiencies->images->intleak_coords[1], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_coords[2] = realloc(efficiencies->images->intleak_coords[2], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_dir[0] = realloc(efficiencies->images->intleak_dir[0], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_dir[1] = realloc(efficiencies->images->intleak_dir[1], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_elecv[0] = realloc(efficiencies->images->intleak_elecv[0], sizeof(double)* efficiencies->images->i_intleak);
-		efficiencies->images->intleak_elecv[1] = realloc(efficiencies->images->intleak_elecv[1], sizeof(double)* efficiencies->images->i_intleak);
+		efficiencies->images->intleak_coords[0] = realloc(efficiencies->images->intleak_coords[0], sizeof(double)* efficiencies->images->i_intleak*3);
+		efficiencies->images->intleak_coords[1] = efficiencies->images->intleak_coords[0] + efficiencies->images->i_intleak;
+		efficiencies->images->intleak_coords[2] = efficiencies->images->intleak_coords[0] + efficiencies->images->i_intleak*2;
+		efficiencies->images->intleak_dir[0] = realloc(efficiencies->images->intleak_dir[0], sizeof(double)* efficiencies->images->i_intleak*3);
+		efficiencies->images->intleak_dir[1] = efficiencies->images->intleak_dir[0] + efficiencies->images->i_intleak;
+		efficiencies->images->intleak_dir[2] = efficiencies->images->intleak_dir[0] + efficiencies->images->i_intleak*2;
+		efficiencies->images->intleak_elecv[0] = realloc(efficiencies->images->intleak_elecv[0], sizeof(double)* efficiencies->images->i_intleak*3);
+		efficiencies->images->intleak_elecv[1] = efficiencies->images->intleak_elecv[0] + efficiencies->images->i_intleak;
+		efficiencies->images->intleak_elecv[2] = efficiencies->images->intleak_elecv[0] + efficiencies->images->i_intleak*2;
 		efficiencies->images->intleak_n_refl = realloc(efficiencies->images->intleak_n_refl, sizeof(int64_t)* efficiencies->images->i_intleak);
 		efficiencies->images->intleak_coord_weights = realloc(efficiencies->images->intleak_coord_weights, sizeof(double)*source->n_energies* efficiencies->images->i_intleak);
 		leak_counter = 0;
@@ -1010,6 +1156,10 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 			efficiencies->images->extleak_coords[2][leak_counter] = extleak[k]->coords.z;
 			efficiencies->images->extleak_dir[0][leak_counter] = extleak[k]->direction.x;
 			efficiencies->images->extleak_dir[1][leak_counter] = extleak[k]->direction.y;
+			efficiencies->images->extleak_dir[2][leak_counter] = extleak[k]->direction.z;
+			efficiencies->images->extleak_elecv[0][leak_counter] = extleak[k]->elecv.x;
+			efficiencies->images->extleak_elecv[1][leak_counter] = extleak[k]->elecv.y;
+			efficiencies->images->extleak_elecv[2][leak_counter] = extleak[k]->elecv.z;
 			efficiencies->images->extleak_n_refl[leak_counter] = extleak[k]->n_refl;
 			for(l=0; l < source->n_energies; l++)
 				efficiencies->images->extleak_coord_weights[leak_counter*source->n_energies+l] = extleak[k]->weight[l];
@@ -1021,8 +1171,10 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 			efficiencies->images->intleak_coords[2][intleak_counter] = intleak[k]->coords.z;
 			efficiencies->images->intleak_dir[0][intleak_counter] = intleak[k]->direction.x;
 			efficiencies->images->intleak_dir[1][intleak_counter] = intleak[k]->direction.y;
+			efficiencies->images->intleak_dir[2][intleak_counter] = intleak[k]->direction.z;
 			efficiencies->images->intleak_elecv[0][intleak_counter] = intleak[k]->elecv.x;
 			efficiencies->images->intleak_elecv[1][intleak_counter] = intleak[k]->elecv.y;
+			efficiencies->images->intleak_elecv[2][intleak_counter] = intleak[k]->elecv.z;
 			efficiencies->images->intleak_n_refl[intleak_counter] = intleak[k]->n_refl;
 			for(l=0; l < source->n_energies; l++)
 				efficiencies->images->intleak_coord_weights[intleak_counter*source->n_energies+l] = intleak[k]->weight[l];
@@ -1046,11 +1198,55 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 	}
 	polycap_rng_free(rng);
 	free(weights);
+	polycap_welford_clear(&local);
 } //#pragma omp parallel
 
 //	if (cancelled)
 //		return NULL;
 
+	if(welford_failed){
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for the running statistics -> %s", strerror(ENOMEM));
+		if(source->record_histories){
+			for(j=0; j < n_stored; j++)
+				free(slot_history[j]);
+			free(slot_history);
+			free(slot_n_history);
+		}
+		polycap_transmission_efficiencies_free(efficiencies);
+		polycap_welford_clear(&total);
+		free(sum_weights);
+		free(iexit_temp);
+		free(not_entered_temp);
+		free(not_transmitted_temp);
+		return NULL;
+	}
+
+	//gather the reflection histories in a single array, ordered as the transmitted photons
+	if(source->record_histories){
+		efficiencies->images->refl_history_offset[0] = 0;
+		for(j=0; j < n_stored; j++)
+			efficiencies->images->refl_history_offset[j+1] = efficiencies->images->refl_history_offset[j] + slot_n_history[j];
+		n_history = efficiencies->images->refl_history_offset[n_stored];
+		efficiencies->images->refl_history = malloc(sizeof(polycap_refl_event)*(n_history > 0 ? n_history : 1));
+		for(j=0; j < n_stored; j++){
+			if(efficiencies->images->refl_history != NULL && slot_n_history[j] > 0)
+				memcpy(efficiencies->images->refl_history+efficiencies->images->refl_history_offset[j], slot_history[j], sizeof(polycap_refl_event)*slot_n_history[j]);
+			free(slot_history[j]);
+		}
+		free(slot_history);
+		free(slot_n_history);
+		if(efficiencies->images->refl_history == NULL){
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for efficiencies->images->refl_history -> %s", strerror(errno));
+			polycap_transmission_efficiencies_free(efficiencies);
+			polycap_welford_clear(&total);
+			free(sum_weights);
+			free(iexit_temp);
+			free(not_entered_temp);
+			free(not_transmitted_temp);
+			return NULL;
+		}
+	}
+
 	//add all started photons together
 	for(i=0; i < max_threads; i++){
 		sum_iexit += iexit_temp[i];
@@ -1058,7 +1254,9 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 		sum_not_transmitted += not_transmitted_temp[i];
 	}
 	
-	printf("Average number of reflections: %lf, Simulated photons: %" PRId64 "\n",(double)sum_irefl/n_photons,sum_iexit+sum_not_entered+sum_not_transmitted);
+	printf("Average number of reflections: %lf, Simulated photons: %" PRId64 "\n",(double)sum_irefl/sum_iexit,sum_iexit+sum_not_entered+sum_not_transmitted);
+	if(target_rel_error > 0.)
+		printf("Target uncertainty %s after %" PRId64 " transmitted photons\n", converged ? "reached" : "not reached", sum_iexit);
 	printf("Open area Calculated: %lf, Simulated: %lf\n",((round(sqrt(12. * description->n_cap - 3.)/6.-0.5)+0.5)*6.)*((round(sqrt(12. * description->n_cap - 3.)/6.-0.5)+0.5)*6.)/12.*(description->profile->cap[0]*description->profile->cap[0]*M_PI)/(3.*sin(M_PI/3)*description->profile->ext[0]*description->profile->ext[0]), (double)(sum_iexit+sum_not_transmitted)/(sum_iexit+sum_not_entered+sum_not_transmitted));
 	printf("iexit: %" PRId64 ", no enter: %" PRId64 ", no trans: %" PRId64 "\n",sum_iexit,sum_not_entered,sum_not_transmitted);
 
@@ -1073,19 +1271,285 @@ polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(
 	for(i=0; i<source->n_energies; i++){
 		efficiencies->energies[i] = source->energies[i];
 		efficiencies->efficiencies[i] = (sum_weights[i] / ((double)sum_iexit+(double)sum_not_transmitted)) * description->open_area;
+		efficiencies->std_errors[i] = polycap_welford_std_error(&total, i);
 //printf("	Energy: %lf keV, Weight: %lf \n", efficiencies->energies[i], sum_weights[i]);
 	}
 //printf("//////\n");
 
 
+	//keep the raw sums, so partial results can be merged
+	efficiencies->sum_weights = sum_weights;
+	efficiencies->sum_sq_dev = total.m2;
+	total.m2 = NULL;
+	efficiencies->n_not_entered = sum_not_entered;
+	efficiencies->n_not_transmitted = sum_not_transmitted;
+
 	//free alloc'ed memory
-	free(sum_weights);
+	polycap_welford_clear(&total);
 	free(iexit_temp);
 	free(not_entered_temp);
 	free(not_transmitted_temp);
+	polycap_progress_monitor_set_value(progress_monitor, 1.);
 	return efficiencies;
 }
 //===========================================
+// for a given array of energies, and a full polycap_description, get the transmission efficiencies,
+//	calculating the attenuation coefficients and scattering factors of the material once for all photons
+static polycap_transmission_efficiencies* polycap_source_trace(polycap_source *source, int max_threads, int n_photons, int64_t photon_offset, double target_rel_error, size_t n_selected, const size_t *selected, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
+{
+	double *amu = NULL, *scatf = NULL;
+	polycap_transmission_efficiencies *efficiencies;
+
+	//invalid arguments are reported by polycap_source_trace_tables()
+	if (source != NULL && source->description != NULL && source->energies != NULL && source->n_energies >= 1) {
+		amu = malloc(sizeof(double)*source->n_energies);
+		scatf = malloc(sizeof(double)*source->n_energies);
+		if (amu == NULL || scatf == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_get_transmission_efficiencies: could not allocate memory for the attenuation coefficients and scattering factors -> %s", strerror(errno));
+			free(amu);
+			free(scatf);
+			return NULL;
+		}
+		polycap_material_scatf(source->description, source->n_energies, source->energies, amu, scatf);
+	}
+
+	efficiencies = polycap_source_trace_tables(source, max_threads, n_photons, photon_offset, target_rel_error, n_selected, selected, amu, scatf, leak_calc, progress_monitor, error);
+	free(amu);
+	free(scatf);
+
+	return efficiencies;
+}
+//===========================================
+// for a given array of energies, and a full polycap_description, get the transmission efficiencies.
+polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies(polycap_source *source, int max_threads, int n_photons, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
+{
+	return polycap_source_trace(source, max_threads, n_photons, 0, 0., 0, NULL, leak_calc, progress_monitor, error);
+}
+//===========================================
+// get the transmission efficiencies, simulating photons until their relative standard error drops below target_rel_error
+polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_converged(polycap_source *source, int max_threads, int max_photons, double target_rel_error, size_t n_selected, const size_t *selected, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
+{
+	size_t i;
+
+	// argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_converged: source cannot be NULL");
+		return NULL;
+	}
+	if (target_rel_error <= 0.) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_converged: target_rel_error must be greater than 0");
+		return NULL;
+	}
+	if (n_selected > 0 && selected == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_converged: selected cannot be NULL if n_selected is greater than 0");
+		return NULL;
+	}
+	for(i=0; i < n_selected; i++){
+		if (selected[i] >= source->n_energies) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_converged: selected must contain indices less than the amount of source energies");
+			return NULL;
+		}
+	}
+
+	return polycap_source_trace(source, max_threads, max_photons, 0, target_rel_error, n_selected, selected, leak_calc, progress_monitor, error);
+}
+//===========================================
+// simulate shard shard_index of a simulation of n_photons photons split in n_shards shards
+//	each shard traces its own range of photon indices, and the random numbers of each photon are derived from the source seed and its index,
+//	so the shards are disjoint and together reproduce a single seeded simulation of n_photons photons
+polycap_transmission_efficiencies* polycap_source_get_transmission_efficiencies_shard(polycap_source *source, int max_threads, int n_photons, int shard_index, int n_shards, bool leak_calc, polycap_progress_monitor *progress_monitor, polycap_error **error)
+{
+	int64_t photon_start, photon_end;
+	polycap_transmission_efficiencies *efficiencies;
+
+	// argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_shard: source cannot be NULL");
+		return NULL;
+	}
+	if (!source->use_seed) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_shard: a seed must be set with polycap_source_set_seed()");
+		return NULL;
+	}
+	if (n_shards < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_shard: n_shards must be greater than 0");
+		return NULL;
+	}
+	if (shard_index < 0 || shard_index >= n_shards) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_shard: shard_index must be greater than or equal to 0 and less than n_shards");
+		return NULL;
+	}
+	if (n_photons < n_shards) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_get_transmission_efficiencies_shard: n_photons must be greater than or equal to n_shards");
+		return NULL;
+	}
+
+	photon_start = (int64_t) n_photons * shard_index / n_shards;
+	photon_end = (int64_t) n_photons * (shard_index + 1) / n_shards;
+	efficiencies = polycap_source_trace(source, max_threads, (int) (photon_end - photon_start), photon_start, 0., 0, NULL, leak_calc, progress_monitor, error);
+	if (efficiencies == NULL)
+		return NULL;
+	efficiencies->n_shards = n_shards;
+	efficiencies->shard_index = shard_index;
+	efficiencies->n_photons_total = n_photons;
+	efficiencies->seed = source->seed;
+
+	return efficiencies;
+}
+//===========================================
+// simulate the transmission efficiencies for a grid of source and surface roughness parameters
+//	all grid points share the profile and material of source, which are therefore not validated again,
+//	and the same random numbers, so differences between grid points are not dominated by statistical noise
+bool polycap_source_sweep(polycap_source *source, size_t n_points, const polycap_sweep_point *points, int max_threads, int n_photons, bool leak_calc, polycap_progress_monitor *progress_monitor, double **efficiencies_arr, double **std_errors_arr, polycap_error **error)
+{
+	int i;
+	int threads_per_point, n_concurrent;
+	int64_t n_done = 0;
+	unsigned long int seed;
+	bool failed = false;
+	polycap_rng *rng;
+	double *efficiencies_temp, *std_errors_temp;
+	double *amu, *scatf;
+
+	// argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: source cannot be NULL");
+		return false;
+	}
+	if (n_points < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: n_points must be greater than 0");
+		return false;
+	}
+	if (points == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: points cannot be NULL");
+		return false;
+	}
+	for(i=0; i < n_points; i++){
+		if (points[i].d_source <= 0. || points[i].src_x <= 0. || points[i].src_y <= 0.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: d_source, src_x and src_y of all points must be greater than 0");
+			return false;
+		}
+		if (points[i].sig_rough < 0.) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: sig_rough of all points must be greater than or equal to 0");
+			return false;
+		}
+	}
+	if (n_photons < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: n_photons must be greater than 0");
+		return false;
+	}
+	if (efficiencies_arr == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep: efficiencies_arr cannot be NULL");
+		return false;
+	}
+
+	efficiencies_temp = malloc(sizeof(double)*n_points*source->n_energies);
+	std_errors_temp = malloc(sizeof(double)*n_points*source->n_energies);
+	if (efficiencies_temp == NULL || std_errors_temp == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_sweep: could not allocate memory for the efficiencies -> %s", strerror(errno));
+		free(efficiencies_temp);
+		free(std_errors_temp);
+		return false;
+	}
+
+	//the attenuation coefficients and scattering factors do not depend on the grid point parameters,
+	//	so they are calculated once and shared by the photons of all grid points
+	amu = malloc(sizeof(double)*source->n_energies);
+	scatf = malloc(sizeof(double)*source->n_energies);
+	if (amu == NULL || scatf == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_source_sweep: could not allocate memory for the attenuation coefficients and scattering factors -> %s", strerror(errno));
+		free(amu);
+		free(scatf);
+		free(efficiencies_temp);
+		free(std_errors_temp);
+		return false;
+	}
+	polycap_material_scatf(source->description, source->n_energies, source->energies, amu, scatf);
+
+	//common random numbers for all grid points
+	if (source->use_seed) {
+		seed = source->seed;
+	} else {
+		rng = polycap_rng_new();
+		seed = (unsigned long int) (polycap_rng_uniform(rng) * 4294967295.);
+		polycap_rng_free(rng);
+	}
+
+	// check max_threads
+	if (max_threads < 1 || max_threads > omp_get_max_threads())
+		max_threads = omp_get_max_threads();
+	//with at least as many grid points as threads, each thread simulates entire grid points,
+	//	otherwise the grid points are simulated one after another using all threads
+	if (n_points >= max_threads) {
+		n_concurrent = max_threads;
+		threads_per_point = 1;
+	} else {
+		n_concurrent = 1;
+		threads_per_point = max_threads;
+	}
+
+	#pragma omp parallel for schedule(dynamic) num_threads(n_concurrent)
+	for(i=0; i < n_points; i++){
+		polycap_description point_description;
+		polycap_source point_source;
+		polycap_transmission_efficiencies *efficiencies;
+		polycap_error *local_error = NULL;
+		size_t k;
+
+		#pragma omp flush(failed)
+		if (failed)
+			continue;
+
+		//shallow copies sharing the profile, material and energies of source
+		point_description = *source->description;
+		point_description.sig_rough = points[i].sig_rough;
+		point_source = *source;
+		point_source.description = &point_description;
+		point_source.d_source = points[i].d_source;
+		point_source.src_x = points[i].src_x;
+		point_source.src_y = points[i].src_y;
+		point_source.src_shiftx = points[i].src_shiftx;
+		point_source.src_shifty = points[i].src_shifty;
+		point_source.record_histories = false;
+		point_source.use_seed = true;
+		point_source.seed = seed;
+
+		efficiencies = polycap_source_trace_tables(&point_source, threads_per_point, n_photons, 0, 0., 0, NULL, amu, scatf, leak_calc, NULL, &local_error);
+		#pragma omp critical
+		{
+		if (efficiencies == NULL) {
+			if (!failed)
+				polycap_set_error_literal(error, local_error != NULL ? local_error->code : POLYCAP_ERROR_RUNTIME, local_error != NULL ? local_error->message : "polycap_source_sweep: simulation of a grid point failed");
+			failed = true;
+		} else {
+			for(k=0; k < source->n_energies; k++){
+				efficiencies_temp[i*source->n_energies+k] = efficiencies->efficiencies[k];
+				std_errors_temp[i*source->n_energies+k] = efficiencies->std_errors[k];
+			}
+			n_done++;
+			polycap_progress_monitor_set_value(progress_monitor, (double) n_done/(double) n_points);
+		}
+		}
+		polycap_clear_error(&local_error);
+		polycap_transmission_efficiencies_free(efficiencies);
+	}
+	free(amu);
+	free(scatf);
+
+	if (failed) {
+		free(efficiencies_temp);
+		free(std_errors_temp);
+		return false;
+	}
+
+	*efficiencies_arr = efficiencies_temp;
+	if (std_errors_arr)
+		*std_errors_arr = std_errors_temp;
+	else
+		free(std_errors_temp);
+	return true;
+}
+//===========================================
 // free a polycap_source struct
 void polycap_source_free(polycap_source *source)
 {
@@ -1107,3 +1571,31 @@ void polycap_source_free(polycap_source *source)
 const polycap_description* polycap_source_get_description(polycap_source *source) {
 	return source->description;
 }
+//===========================================
+bool polycap_source_set_record_histories(polycap_source *source, bool record_histories, polycap_error **error) {
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_set_record_histories: source cannot be NULL");
+		return false;
+	}
+	source->record_histories = record_histories;
+	return true;
+}
+//===========================================
+bool polycap_source_set_single_precision(polycap_source *source, bool single_precision, polycap_error **error) {
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_set_single_precision: source cannot be NULL");
+		return false;
+	}
+	source->single_precision = single_precision;
+	return true;
+}
+//===========================================
+bool polycap_source_set_seed(polycap_source *source, unsigned long int seed, polycap_error **error) {
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_set_seed: source cannot be NULL");
+		return false;
+	}
+	source->use_seed = true;
+	source->seed = seed;
+	return true;
+}
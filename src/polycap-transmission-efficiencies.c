@@ -19,6 +19,7 @@
 #include <inttypes.h>
 #include <hdf5.h>
 #include <math.h>
+#include <omp.h> /* openmp header */
 
 /* Ideally, we would need to do something similar on Windows, instead of just disabling the use of a mutex...
  * Still, seems unlikely to cause problems anytime soon...
@@ -231,32 +232,31 @@ static void set_exception(polycap_error **error) {
 }
 
 //===========================================
-// Write data set in HDF5 file
-static bool polycap_h5_write_dataset(hid_t file, int rank, hsize_t *dim, char *dataset_name, double *data, char *unitname, polycap_error **error) {
-	herr_t status;
+// Create a data set of doubles in HDF5 file, with the given dimensions
+//	returns the data set, or a negative value on error. The data space of the data set is stored in dataspace
+static hid_t polycap_h5_create_dataset(hid_t file, int rank, hsize_t *dim, char *dataset_name, hid_t *dataspace, polycap_error **error) {
 	hid_t dataset;
-	hid_t dataspace, attr_id, attr_type, attr_dataspace_id; //handles
 
 	//Describe size of the array and make fixed data space
-	dataspace = H5Screate_simple(rank, dim, NULL);
-	if (dataspace < 0) {
+	*dataspace = H5Screate_simple(rank, dim, NULL);
+	if (*dataspace < 0) {
 		set_exception(error);
-		return false;
+		return -1;
 	}
 
 	//Create new dataset within the HDF5 file with default creation properties
-	dataset = H5Dcreate(file, dataset_name, H5T_NATIVE_DOUBLE, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	dataset = H5Dcreate(file, dataset_name, H5T_NATIVE_DOUBLE, *dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 	if (dataset < 0) {
 		set_exception(error);
-		return false;
-	}
-
-	//Write data to the dataset with default transfer properties
-	status = H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
-	if(status < 0){
-		set_exception(error);
-		return false;
+		return -1;
 	}
+	return dataset;
+}
+//===========================================
+// Write the unit attribute of a data set created with polycap_h5_create_dataset(), and close it
+static bool polycap_h5_close_dataset(hid_t dataset, hid_t dataspace, char *unitname, polycap_error **error) {
+	herr_t status;
+	hid_t attr_id, attr_type, attr_dataspace_id; //handles
 
 	//Write unit attributes
 	attr_dataspace_id = H5Screate(H5S_SCALAR);
@@ -304,11 +304,149 @@ static bool polycap_h5_write_dataset(hid_t file, int rank, hsize_t *dim, char *d
 	return true;
 }
 //===========================================
+// Write data set in HDF5 file
+static bool polycap_h5_write_dataset(hid_t file, int rank, hsize_t *dim, char *dataset_name, double *data, char *unitname, polycap_error **error) {
+	herr_t status;
+	hid_t dataset, dataspace;
+
+	dataset = polycap_h5_create_dataset(file, rank, dim, dataset_name, &dataspace, error);
+	if (dataset < 0)
+		return false;
+
+	//Write data to the dataset with default transfer properties
+	status = H5Dwrite(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+	if(status < 0){
+		set_exception(error);
+		return false;
+	}
+
+	return polycap_h5_close_dataset(dataset, dataspace, unitname, error);
+}
+//===========================================
+// Write data set in HDF5 file from separate arrays, one for each row
+//	with rank 2 the data set has dim[0] rows of dim[1] elements, each written directly from rows[i] by selecting row i in the file as a hyperslab
+//	with rank 1 the data set is a single row of dim[0] elements
+//	mem_type is the HDF5 type of the elements in rows, which are converted to doubles while writing
+static bool polycap_h5_write_rows(hid_t file, int rank, hsize_t *dim, char *dataset_name, hid_t mem_type, void **rows, char *unitname, polycap_error **error) {
+	herr_t status;
+	hid_t dataset, dataspace, memspace;
+	hsize_t start[2], count[2], n_rows, i;
+
+	dataset = polycap_h5_create_dataset(file, rank, dim, dataset_name, &dataspace, error);
+	if (dataset < 0)
+		return false;
+
+	n_rows = rank == 2 ? dim[0] : 1;
+	count[0] = rank == 2 ? 1 : dim[0];
+	count[1] = dim[rank-1];
+	//nothing to write for empty rows, selecting them would fail
+	if (dim[rank-1] > 0) {
+		memspace = H5Screate_simple(1, &count[1], NULL);
+		if (memspace < 0) {
+			set_exception(error);
+			return false;
+		}
+		start[1] = 0;
+		for(i=0; i < n_rows; i++){
+			start[0] = i;
+			if (H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, NULL, count, NULL) < 0) {
+				set_exception(error);
+				return false;
+			}
+			status = H5Dwrite(dataset, mem_type, memspace, dataspace, H5P_DEFAULT, rows[i]);
+			if(status < 0){
+				set_exception(error);
+				return false;
+			}
+		}
+		if (H5Sclose(memspace) < 0) {
+			set_exception(error);
+			return false;
+		}
+	}
+
+	return polycap_h5_close_dataset(dataset, dataspace, unitname, error);
+}
+//===========================================
+// Read data set from HDF5 file
+//	dim receives the dimensions of the data set, which must have the given rank. If data is NULL, only the dimensions are read
+static bool polycap_h5_read_dataset(hid_t file, int rank, hsize_t *dim, const char *dataset_name, double **data, polycap_error **error) {
+	hid_t dataset, dataspace;
+	hsize_t n_elements = 1;
+	int i;
+
+	dataset = H5Dopen2(file, dataset_name, H5P_DEFAULT);
+	if (dataset < 0) {
+		set_exception(error);
+		return false;
+	}
+	dataspace = H5Dget_space(dataset);
+	if (dataspace < 0) {
+		set_exception(error);
+		H5Dclose(dataset);
+		return false;
+	}
+	if (H5Sget_simple_extent_ndims(dataspace) != rank) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_h5_read_dataset: %s does not have rank %d", dataset_name, rank);
+		H5Sclose(dataspace);
+		H5Dclose(dataset);
+		return false;
+	}
+	H5Sget_simple_extent_dims(dataspace, dim, NULL);
+	H5Sclose(dataspace);
+
+	if (data != NULL) {
+		for (i = 0 ; i < rank ; i++)
+			n_elements *= dim[i];
+		*data = malloc(sizeof(double)*(n_elements > 0 ? n_elements : 1));
+		if (*data == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_h5_read_dataset: could not allocate memory for %s -> %s", dataset_name, strerror(errno));
+			H5Dclose(dataset);
+			return false;
+		}
+		if (n_elements > 0 && H5Dread(dataset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, *data) < 0) {
+			set_exception(error);
+			free(*data);
+			*data = NULL;
+			H5Dclose(dataset);
+			return false;
+		}
+	}
+	if (H5Dclose(dataset) < 0) {
+		set_exception(error);
+		if (data != NULL) {
+			free(*data);
+			*data = NULL;
+		}
+		return false;
+	}
+	return true;
+}
+//===========================================
+// Read a single value from HDF5 file
+static bool polycap_h5_read_scalar(hid_t file, const char *dataset_name, double *value, polycap_error **error) {
+	hsize_t dim;
+	double *data;
+
+	if (!polycap_h5_read_dataset(file, 1, &dim, dataset_name, &data, error))
+		return false;
+	if (dim != 1) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_h5_read_scalar: %s does not contain a single value", dataset_name);
+		free(data);
+		return false;
+	}
+	*value = *data;
+	free(data);
+	return true;
+}
+//===========================================
 // Write efficiencies output in a hdf5 file
 bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficiencies *efficiencies, const char *filename, polycap_error **error) {
-	hid_t file, PC_Exit_id, PC_Start_id, Leaks_id, Recap_id, Input_id;
+	hid_t file, PC_Exit_id, PC_Start_id, Leaks_id, Recap_id, Input_id, Shard_id;
 	hsize_t n_energies_temp, dim[2];
 	double *data_temp;
+	void *n_refl_temp, *shape_rows[2];
+	double shard_temp[7];
 	int j,k;
 
 	tables_init();
@@ -339,159 +477,69 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Transmission_Efficiencies", efficiencies->efficiencies,"a.u.", error))
 		return false;
 
+	//Write standard errors of the efficiencies
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Transmission_Efficiencies_Std_Errors", efficiencies->std_errors,"a.u.", error))
+		return false;
+
+	//Write relative standard errors of the efficiencies
+	if (!polycap_transmission_efficiencies_get_uncertainties(efficiencies, NULL, &data_temp, error))
+		return false;
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Transmission_Efficiencies_Uncertainties", data_temp,"a.u.", error))
+		return false;
+	free(data_temp);
+
 	//Write simulated polycap start coordinates
 	//Create PC_Start group
 	PC_Start_id = H5Gcreate2(file, "/PC_Start", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-	//Copy coordiante data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_start_coords[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_start_coords[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Start/Coordinates", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Start/Coordinates", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_start_coords, "[cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 	
 	//Write simulated polycap start direction
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_start_dir[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_start_dir[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Start/Direction", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Start/Direction", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_start_dir, "[cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write simulated polycap start electric vectors
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_start_elecv[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_start_elecv[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Start/Electric_Vector", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Start/Electric_Vector", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_start_elecv, "[cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write simulated polycap exit coordinates
 	//Create PC_Exit group
 	PC_Exit_id = H5Gcreate2(file, "/PC_Exit", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-	//Copy coordinate data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*3);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_exit_coords[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_exit_coords[1][j];
-		data_temp[j+efficiencies->images->i_exit*2] = efficiencies->images->pc_exit_coords[2][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 3;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Exit/Coordinates", data_temp,"[cm,cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Exit/Coordinates", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_exit_coords, "[cm,cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write n_reflections for each exited photon
 	n_energies_temp = efficiencies->images->i_exit;
-	data_temp = malloc(sizeof(double)*n_energies_temp);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+	//the counts are converted to doubles by HDF5 while writing
+	n_refl_temp = efficiencies->images->pc_exit_nrefl;
+	if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/PC_Exit/N_Reflections", H5T_NATIVE_INT64, &n_refl_temp, "a.u.", error))
 		return false;
-	}
-	for(j=0; j<n_energies_temp; j++)
-		data_temp[j] = (double)efficiencies->images->pc_exit_nrefl[j];
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/PC_Exit/N_Reflections", data_temp,"a.u.", error))
-		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write simulated polycap exit direction
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_exit_dir[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_exit_dir[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Exit/Direction", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Exit/Direction", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_exit_dir, "[cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write simulated source start coordinates
-	//Copy coordiante data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->src_start_coords[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->src_start_coords[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/Source_Start_Coordinates", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/Source_Start_Coordinates", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->src_start_coords, "[cm,cm]", error))
 		return false;
 
-	//Free data_temp
-	free(data_temp);
-
 	//Write simulated polycap exit electric vectors
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->images->i_exit*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->images->i_exit;j++){
-		data_temp[j] = efficiencies->images->pc_exit_elecv[0][j];
-		data_temp[j+efficiencies->images->i_exit] = efficiencies->images->pc_exit_elecv[1][j];
-	}
-	//Define temporary dataset dimension
 	dim[0] = 2;
 	dim[1] = efficiencies->images->i_exit;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/PC_Exit/Electric_Vector", data_temp,"[cm,cm]", error))
+	if (!polycap_h5_write_rows(file, 2, dim, "/PC_Exit/Electric_Vector", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->pc_exit_elecv, "[cm,cm]", error))
 		return false;
-	//Free data_temp
-	free(data_temp);
 
 	//Write transmitted photon weights
 	//Define temporary dataset dimension
@@ -510,42 +558,20 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 		//Make Leaks group
 		Leaks_id = H5Gcreate2(file, "/ExternalLeaks", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 			//write coordinates
-		//Copy coordinate data to temporary array for straightforward HDF5 writing
-		data_temp = malloc(sizeof(double)*efficiencies->images->i_extleak*3);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-			return false;
-		}
-		for(j=0;j<efficiencies->images->i_extleak;j++){
-			data_temp[j] = efficiencies->images->extleak_coords[0][j];
-			data_temp[j+efficiencies->images->i_extleak] = efficiencies->images->extleak_coords[1][j];
-			data_temp[j+efficiencies->images->i_extleak*2] = efficiencies->images->extleak_coords[2][j];
-		}
-		//Define temporary dataset dimension
 		dim[0] = 3;
 		dim[1] = efficiencies->images->i_extleak;
-		if (!polycap_h5_write_dataset(file, 2, dim, "/ExternalLeaks/Coordinates", data_temp,"[cm,cm,cm]", error))
+		if (!polycap_h5_write_rows(file, 2, dim, "/ExternalLeaks/Coordinates", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->extleak_coords, "[cm,cm,cm]", error))
 			return false;
-		//Free data_temp
-		free(data_temp);
 			//write direction
-		//Copy direction data to temporary array for straightforward HDF5 writing
-		data_temp = malloc(sizeof(double)*efficiencies->images->i_extleak*2);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		dim[0] = 2;
+		dim[1] = efficiencies->images->i_extleak;
+		if (!polycap_h5_write_rows(file, 2, dim, "/ExternalLeaks/Direction", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->extleak_dir, "[cm,cm]", error))
 			return false;
-		}
-		for(j=0;j<efficiencies->images->i_extleak;j++){
-			data_temp[j] = efficiencies->images->extleak_dir[0][j];
-			data_temp[j+efficiencies->images->i_extleak] = efficiencies->images->extleak_dir[1][j];
-		}
-		//Define temporary dataset dimension
+			//write electric vectors
 		dim[0] = 2;
 		dim[1] = efficiencies->images->i_extleak;
-		if (!polycap_h5_write_dataset(file, 2, dim, "/ExternalLeaks/Direction", data_temp,"[cm,cm]", error))
+		if (!polycap_h5_write_rows(file, 2, dim, "/ExternalLeaks/Electric_Vector", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->extleak_elecv, "[cm,cm]", error))
 			return false;
-		//Free data_temp
-		free(data_temp);
 			//Write leaked photon weights
 		//Define temporary dataset dimension
 		dim[1] = efficiencies->n_energies;
@@ -568,17 +594,9 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 		free(data_temp);
 		//Write n_reflections for each leaked photon
 		n_energies_temp = efficiencies->images->i_extleak;
-		data_temp = malloc(sizeof(double)*n_energies_temp);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		n_refl_temp = efficiencies->images->extleak_n_refl;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/ExternalLeaks/N_Reflections", H5T_NATIVE_INT64, &n_refl_temp, "a.u.", error))
 			return false;
-		}
-		for(j=0; j<n_energies_temp; j++)
-			data_temp[j] = (double)efficiencies->images->extleak_n_refl[j];
-		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/ExternalLeaks/N_Reflections", data_temp,"a.u.", error))
-			return false;
-		//Free data_temp
-		free(data_temp);
 
 		if (H5Gclose(Leaks_id) < 0)
 			set_exception(error);
@@ -589,59 +607,20 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 	if(efficiencies->images->i_intleak > 0){
 		Recap_id = H5Gcreate2(file, "/InternalLeaks", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
 			//write coordinates
-		//Copy coordinate data to temporary array for straightforward HDF5 writing
-		data_temp = malloc(sizeof(double)*efficiencies->images->i_intleak*3);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-			return false;
-		}
-		for(j=0;j<efficiencies->images->i_intleak;j++){
-			data_temp[j] = efficiencies->images->intleak_coords[0][j];
-			data_temp[j+efficiencies->images->i_intleak] = efficiencies->images->intleak_coords[1][j];
-			data_temp[j+efficiencies->images->i_intleak*2] = efficiencies->images->intleak_coords[2][j];
-		}
-		//Define temporary dataset dimension
 		dim[0] = 3;
 		dim[1] = efficiencies->images->i_intleak;
-		if (!polycap_h5_write_dataset(file, 2, dim, "/InternalLeaks/Coordinates", data_temp,"[cm,cm,cm]", error))
+		if (!polycap_h5_write_rows(file, 2, dim, "/InternalLeaks/Coordinates", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->intleak_coords, "[cm,cm,cm]", error))
 			return false;
-		//Free data_temp
-		free(data_temp);
 			//write direction
-		//Copy direction data to temporary array for straightforward HDF5 writing
-		data_temp = malloc(sizeof(double)*efficiencies->images->i_intleak*2);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-			return false;
-		}
-		for(j=0;j<efficiencies->images->i_intleak;j++){
-			data_temp[j] = efficiencies->images->intleak_dir[0][j];
-			data_temp[j+efficiencies->images->i_intleak] = efficiencies->images->intleak_dir[1][j];
-		}
-		//Define temporary dataset dimension
 		dim[0] = 2;
 		dim[1] = efficiencies->images->i_intleak;
-		if (!polycap_h5_write_dataset(file, 2, dim, "/InternalLeaks/Direction", data_temp,"[cm,cm]", error))
+		if (!polycap_h5_write_rows(file, 2, dim, "/InternalLeaks/Direction", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->intleak_dir, "[cm,cm]", error))
 			return false;
-		//Free data_temp
-		free(data_temp);
 		//Write intleak electric vectors
-		data_temp = malloc(sizeof(double)*efficiencies->images->i_intleak*2);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-			return false;
-		}
-		for(j=0;j<efficiencies->images->i_intleak;j++){
-			data_temp[j] = efficiencies->images->intleak_elecv[0][j];
-			data_temp[j+efficiencies->images->i_intleak] = efficiencies->images->intleak_elecv[1][j];
-		}
-		//Define temporary dataset dimension
 		dim[0] = 2;
 		dim[1] = efficiencies->images->i_intleak;
-		if (!polycap_h5_write_dataset(file, 2, dim, "/InternalLeaks/Electric_Vector", data_temp,"[cm,cm]", error))
+		if (!polycap_h5_write_rows(file, 2, dim, "/InternalLeaks/Electric_Vector", H5T_NATIVE_DOUBLE, (void **) efficiencies->images->intleak_elecv, "[cm,cm]", error))
 			return false;
-		//Free data_temp
-		free(data_temp);
 		//Write intleak photon weights
 		//Define temporary dataset dimension
 		dim[1] = efficiencies->n_energies;
@@ -664,109 +643,714 @@ bool polycap_transmission_efficiencies_write_hdf5(polycap_transmission_efficienc
 		free(data_temp);
 		//Write	n_reflections for each intleak photon
 		n_energies_temp = efficiencies->images->i_intleak;
-		data_temp = malloc(sizeof(double)*n_energies_temp);
-		if(data_temp == NULL){
-			polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		n_refl_temp = efficiencies->images->intleak_n_refl;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/InternalLeaks/N_Reflections", H5T_NATIVE_INT64, &n_refl_temp, "a.u.", error))
 			return false;
-		}
-		for(j=0; j<n_energies_temp; j++)
-			data_temp[j] = (double)efficiencies->images->intleak_n_refl[j];
-		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/InternalLeaks/N_Reflections", data_temp,"a.u.", error))
-			return false;
-		//Free data_temp
-		free(data_temp);
 
 		if (H5Gclose(Recap_id) < 0)
 			set_exception(error);
 	}
 
-	//Write Input parameters
-	//Make Input group
-	Input_id = H5Gcreate2(file, "/Input", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->source->description->profile->nmax*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
-	}
-	for(j=0;j<efficiencies->source->description->profile->nmax;j++){
-		data_temp[j] = efficiencies->source->description->profile->z[j];
-		data_temp[j+efficiencies->source->description->profile->nmax] = efficiencies->source->description->profile->ext[j];
+	//Write Input parameters
+	//Make Input group
+	Input_id = H5Gcreate2(file, "/Input", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	//Write the Z-coordinates and radii directly from the profile
+	dim[0] = 2;
+	dim[1] = efficiencies->source->description->profile->nmax;
+	shape_rows[0] = efficiencies->source->description->profile->z;
+	shape_rows[1] = efficiencies->source->description->profile->ext;
+	if (!polycap_h5_write_rows(file, 2, dim, "/Input/PC_Shape", H5T_NATIVE_DOUBLE, shape_rows, "[cm,cm]", error))
+		return false;
+	shape_rows[1] = efficiencies->source->description->profile->cap;
+	if (!polycap_h5_write_rows(file, 2, dim, "/Input/Cap_Shape", H5T_NATIVE_DOUBLE, shape_rows, "[cm,cm]", error))
+		return false;
+	
+	//Write ncap and other input parameters
+	n_energies_temp = 1;
+	data_temp = malloc(sizeof(double));
+	if(data_temp == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		return false;
+	}
+	*data_temp = (double)efficiencies->source->description->n_cap;
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/N_Capillaries", data_temp,"a.u.", error))
+		return false;
+	free(data_temp);
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Surface_Roughness", &efficiencies->source->description->sig_rough,"Angstrom", error))
+		return false;
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Open_Area", &efficiencies->source->description->open_area,"a.u.", error))
+		return false;
+	dim[0] = 2;
+	dim[1] = efficiencies->source->description->nelem;
+	data_temp = malloc(sizeof(double)*efficiencies->source->description->nelem*2);
+	if(data_temp == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		return false;
+	}
+	for(j=0 ; j < efficiencies->source->description->nelem ; j++){
+		data_temp[j] = efficiencies->source->description->iz[j];
+		data_temp[j+ efficiencies->source->description->nelem] = efficiencies->source->description->wi[j];
+	}
+	if (!polycap_h5_write_dataset(file, 2, dim, "/Input/PC_Composition", data_temp,"[Z,w%]", error))
+		return false;
+	free(data_temp);
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/PC_Density", &efficiencies->source->description->density,"g/cm3", error))
+		return false;
+	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Src_PC_Dist", &efficiencies->source->d_source,"cm", error))
+		return false;
+
+	//Write the raw sums and counters of a shard, required by polycap_transmission_efficiencies_merge()
+	if(efficiencies->n_shards > 0){
+		Shard_id = H5Gcreate2(file, "/Shard", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+		shard_temp[0] = (double)efficiencies->shard_index;
+		shard_temp[1] = (double)efficiencies->n_shards;
+		shard_temp[2] = (double)efficiencies->n_photons_total;
+		shard_temp[3] = (double)efficiencies->seed;
+		shard_temp[4] = (double)efficiencies->images->i_start;
+		shard_temp[5] = (double)efficiencies->n_not_entered;
+		shard_temp[6] = (double)efficiencies->n_not_transmitted;
+		n_energies_temp = 1;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/Index", &shard_temp[0],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/Count", &shard_temp[1],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/N_Photons", &shard_temp[2],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/Seed", &shard_temp[3],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/N_Started", &shard_temp[4],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/N_Not_Entered", &shard_temp[5],"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/N_Not_Transmitted", &shard_temp[6],"a.u.", error))
+			return false;
+		n_energies_temp = efficiencies->n_energies;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/Sum_Weights", efficiencies->sum_weights,"a.u.", error))
+			return false;
+		if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Shard/Sum_Squared_Deviations", efficiencies->sum_sq_dev,"a.u.", error))
+			return false;
+		//the groups above only hold the x and y components of the directions and electric vectors,
+		//	the z components are kept here so the merged results do not have to reconstruct them
+		n_energies_temp = efficiencies->images->i_exit;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/PC_Start_Direction_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->pc_start_dir[2], "[cm]", error))
+			return false;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/PC_Start_Electric_Vector_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->pc_start_elecv[2], "[cm]", error))
+			return false;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/PC_Exit_Direction_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->pc_exit_dir[2], "[cm]", error))
+			return false;
+		if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/PC_Exit_Electric_Vector_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->pc_exit_elecv[2], "[cm]", error))
+			return false;
+		if(efficiencies->images->i_extleak > 0){
+			n_energies_temp = efficiencies->images->i_extleak;
+			if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/ExternalLeaks_Direction_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->extleak_dir[2], "[cm]", error))
+				return false;
+			if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/ExternalLeaks_Electric_Vector_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->extleak_elecv[2], "[cm]", error))
+				return false;
+		}
+		if(efficiencies->images->i_intleak > 0){
+			n_energies_temp = efficiencies->images->i_intleak;
+			if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/InternalLeaks_Direction_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->intleak_dir[2], "[cm]", error))
+				return false;
+			if (!polycap_h5_write_rows(file, 1, &n_energies_temp, "/Shard/InternalLeaks_Electric_Vector_Z", H5T_NATIVE_DOUBLE, (void **) &efficiencies->images->intleak_elecv[2], "[cm]", error))
+				return false;
+		}
+		if (H5Gclose(Shard_id) < 0)
+			set_exception(error);
+	}
+
+
+	//Close Group access
+	if (H5Gclose(PC_Exit_id) < 0)
+		set_exception(error);
+	if (H5Gclose(PC_Start_id) < 0)
+		set_exception(error);
+	if (H5Gclose(Input_id) < 0)
+		set_exception(error);
+
+	//Close file
+	if (H5Fclose(file) < 0)
+		set_exception(error);
+	
+	return true;
+}
+//===========================================
+// Write the results of a parameter sweep in a hdf5 file
+bool polycap_source_sweep_write_hdf5(polycap_source *source, size_t n_points, const polycap_sweep_point *points, double *efficiencies, double *std_errors, const char *filename, polycap_error **error) {
+	hid_t file, Sweep_id;
+	hsize_t dim[2];
+	double *data_temp;
+	size_t j;
+
+	tables_init();
+
+	//argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep_write_hdf5: source cannot be NULL");
+		return false;
+	}
+	if (n_points < 1 || points == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep_write_hdf5: n_points must be greater than 0 and points cannot be NULL");
+		return false;
+	}
+	if (efficiencies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep_write_hdf5: efficiencies cannot be NULL");
+		return false;
+	}
+	if (filename == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_source_sweep_write_hdf5: filename cannot be NULL");
+		return false;
+	}
+	//Create new HDF5 file using H5F_ACC_TRUNC and default creation and access properties
+	file = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT); 
+	if (file < 0) {
+		set_exception(error);
+		return false;
+	}
+
+	//Write energies and efficiencies, one row per grid point
+	dim[0] = source->n_energies;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Energies", source->energies,"keV", error))
+		return false;
+	dim[0] = n_points;
+	dim[1] = source->n_energies;
+	if (!polycap_h5_write_dataset(file, 2, dim, "/Transmission_Efficiencies", efficiencies,"a.u.", error))
+		return false;
+	if (std_errors != NULL && !polycap_h5_write_dataset(file, 2, dim, "/Transmission_Efficiencies_Std_Errors", std_errors,"a.u.", error))
+		return false;
+
+	//Write the parameters of the grid points
+	Sweep_id = H5Gcreate2(file, "/Sweep", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+	data_temp = malloc(sizeof(double)*n_points);
+	if(data_temp == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
+		return false;
+	}
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].d_source;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Src_PC_Dist", data_temp,"cm", error))
+		return false;
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].src_x;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Src_Size_X", data_temp,"cm", error))
+		return false;
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].src_y;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Src_Size_Y", data_temp,"cm", error))
+		return false;
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].src_shiftx;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Src_Shift_X", data_temp,"cm", error))
+		return false;
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].src_shifty;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Src_Shift_Y", data_temp,"cm", error))
+		return false;
+	for(j=0; j < n_points; j++)
+		data_temp[j] = points[j].sig_rough;
+	if (!polycap_h5_write_dataset(file, 1, dim, "/Sweep/Surface_Roughness", data_temp,"Angstrom", error))
+		return false;
+	free(data_temp);
+
+	//Close Group access
+	if (H5Gclose(Sweep_id) < 0)
+		set_exception(error);
+
+	//Close file
+	if (H5Fclose(file) < 0)
+		set_exception(error);
+
+	return true;
+}
+//===========================================
+// Read a dataset of n x n_values elements into values
+static bool polycap_h5_read_values(hid_t file, const char *dataset_name, int64_t n, size_t n_values, double *values, polycap_error **error) {
+	hsize_t dim[2];
+	double *data;
+
+	if (!polycap_h5_read_dataset(file, n_values > 1 ? 2 : 1, dim, dataset_name, &data, error))
+		return false;
+	if (dim[0] != (hsize_t) n || (n_values > 1 && dim[1] != (hsize_t) n_values)) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_h5_read_values: %s has inconsistent dimensions", dataset_name);
+		free(data);
+		return false;
+	}
+	memcpy(values, data, sizeof(double)*n*n_values);
+	free(data);
+	return true;
+}
+//===========================================
+// Read a dataset of n_comp x n vector components, as written by polycap_transmission_efficiencies_write_hdf5(), into vect
+//	if only two components were written, the third one is read from the dataset z_dataset_name, or is 0 if z_dataset_name is NULL
+static bool polycap_h5_read_vectors(hid_t file, const char *dataset_name, const char *z_dataset_name, int n_comp, int64_t n, double **vect, polycap_error **error) {
+	hsize_t dim[2];
+	double *data;
+	int64_t j;
+
+	if (!polycap_h5_read_dataset(file, 2, dim, dataset_name, &data, error))
+		return false;
+	if (dim[0] != (hsize_t) n_comp || dim[1] != (hsize_t) n) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_h5_read_vectors: %s has inconsistent dimensions", dataset_name);
+		free(data);
+		return false;
+	}
+	for(j=0; j < n; j++){
+		vect[0][j] = data[j];
+		vect[1][j] = data[j+n];
+		vect[2][j] = n_comp == 3 ? data[j+n*2] : 0.;
+	}
+	free(data);
+	if (n_comp == 2 && z_dataset_name != NULL)
+		return polycap_h5_read_values(file, z_dataset_name, n, 1, vect[2], error);
+	return true;
+}
+//===========================================
+// Read a dataset of n reflection counts into n_refl
+static bool polycap_h5_read_n_refl(hid_t file, const char *dataset_name, int64_t n, int64_t *n_refl, polycap_error **error) {
+	hsize_t dim;
+	double *data;
+	int64_t j;
+
+	if (!polycap_h5_read_dataset(file, 1, &dim, dataset_name, &data, error))
+		return false;
+	if (dim != (hsize_t) n) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_h5_read_n_refl: %s has inconsistent dimensions", dataset_name);
+		free(data);
+		return false;
+	}
+	for(j=0; j < n; j++)
+		n_refl[j] = (int64_t) data[j];
+	free(data);
+	return true;
+}
+//===========================================
+
+//the raw sums and counters of a single shard, see polycap_transmission_efficiencies_write_hdf5()
+typedef struct {
+	int index;
+	int count;
+	int n_photons;
+	double seed;
+	int64_t n_started;
+	int64_t n_exit;
+	int64_t n_not_entered;
+	int64_t n_not_transmitted;
+	int64_t n_extleak;
+	int64_t n_intleak;
+	double *sum_weights;
+	double *sum_sq_dev;
+} polycap_shard_header;
+
+//===========================================
+// Read the raw sums and counters of a shard, and check that the shard was simulated for the energies of source
+static bool polycap_shard_read_header(hid_t file, const char *filename, polycap_source *source, polycap_shard_header *header, polycap_error **error) {
+	hsize_t dim[2];
+	double *energies;
+	double value;
+	size_t i;
+
+	if (H5Lexists(file, "/Shard", H5P_DEFAULT) <= 0) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: %s does not contain the partial results of a shard", filename);
+		return false;
+	}
+
+	if (!polycap_h5_read_dataset(file, 1, dim, "/Energies", &energies, error))
+		return false;
+	if (dim[0] != source->n_energies) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: %s was simulated for a different amount of energies than source", filename);
+		free(energies);
+		return false;
+	}
+	for(i=0; i < source->n_energies; i++){
+		if (fabs(energies[i] - source->energies[i]) > 1.e-10) {
+			polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: %s was simulated for different energies than source", filename);
+			free(energies);
+			return false;
+		}
+	}
+	free(energies);
+
+	if (!polycap_h5_read_scalar(file, "/Shard/Index", &value, error))
+		return false;
+	header->index = (int) value;
+	if (!polycap_h5_read_scalar(file, "/Shard/Count", &value, error))
+		return false;
+	header->count = (int) value;
+	if (!polycap_h5_read_scalar(file, "/Shard/N_Photons", &value, error))
+		return false;
+	header->n_photons = (int) value;
+	if (!polycap_h5_read_scalar(file, "/Shard/Seed", &header->seed, error))
+		return false;
+	if (!polycap_h5_read_scalar(file, "/Shard/N_Started", &value, error))
+		return false;
+	header->n_started = (int64_t) value;
+	if (!polycap_h5_read_scalar(file, "/Shard/N_Not_Entered", &value, error))
+		return false;
+	header->n_not_entered = (int64_t) value;
+	if (!polycap_h5_read_scalar(file, "/Shard/N_Not_Transmitted", &value, error))
+		return false;
+	header->n_not_transmitted = (int64_t) value;
+
+	if (!polycap_h5_read_dataset(file, 1, dim, "/Shard/Sum_Weights", &header->sum_weights, error))
+		return false;
+	if (dim[0] != source->n_energies) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_transmission_efficiencies_merge: /Shard/Sum_Weights of %s has inconsistent dimensions", filename);
+		return false;
+	}
+	if (!polycap_h5_read_dataset(file, 1, dim, "/Shard/Sum_Squared_Deviations", &header->sum_sq_dev, error))
+		return false;
+	if (dim[0] != source->n_energies) {
+		polycap_set_error(error, POLYCAP_ERROR_IO, "polycap_transmission_efficiencies_merge: /Shard/Sum_Squared_Deviations of %s has inconsistent dimensions", filename);
+		return false;
+	}
+
+	//the amount of stored events follows from the dataset dimensions
+	if (!polycap_h5_read_dataset(file, 1, dim, "/PC_Exit/D_Travel", NULL, error))
+		return false;
+	header->n_exit = (int64_t) dim[0];
+	header->n_extleak = 0;
+	if (H5Lexists(file, "/ExternalLeaks", H5P_DEFAULT) > 0) {
+		if (!polycap_h5_read_dataset(file, 1, dim, "/ExternalLeaks/N_Reflections", NULL, error))
+			return false;
+		header->n_extleak = (int64_t) dim[0];
+	}
+	header->n_intleak = 0;
+	if (H5Lexists(file, "/InternalLeaks", H5P_DEFAULT) > 0) {
+		if (!polycap_h5_read_dataset(file, 1, dim, "/InternalLeaks/N_Reflections", NULL, error))
+			return false;
+		header->n_intleak = (int64_t) dim[0];
+	}
+
+	return true;
+}
+//===========================================
+// Read the photon events of a shard into images
+static bool polycap_shard_read_images(hid_t file, polycap_shard_header *header, struct _polycap_images *images, size_t n_energies, polycap_error **error) {
+	if (!polycap_h5_read_vectors(file, "/Source_Start_Coordinates", NULL, 2, header->n_exit, images->src_start_coords, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Start/Coordinates", NULL, 2, header->n_exit, images->pc_start_coords, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Start/Direction", "/Shard/PC_Start_Direction_Z", 2, header->n_exit, images->pc_start_dir, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Start/Electric_Vector", "/Shard/PC_Start_Electric_Vector_Z", 2, header->n_exit, images->pc_start_elecv, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Exit/Coordinates", NULL, 3, header->n_exit, images->pc_exit_coords, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Exit/Direction", "/Shard/PC_Exit_Direction_Z", 2, header->n_exit, images->pc_exit_dir, error) ||
+	    !polycap_h5_read_vectors(file, "/PC_Exit/Electric_Vector", "/Shard/PC_Exit_Electric_Vector_Z", 2, header->n_exit, images->pc_exit_elecv, error) ||
+	    !polycap_h5_read_n_refl(file, "/PC_Exit/N_Reflections", header->n_exit, images->pc_exit_nrefl, error) ||
+	    !polycap_h5_read_values(file, "/PC_Exit/D_Travel", header->n_exit, 1, images->pc_exit_dtravel, error) ||
+	    !polycap_h5_read_values(file, "/PC_Exit/Weights", header->n_exit, n_energies, images->exit_coord_weights, error))
+		return false;
+
+	if (header->n_extleak > 0) {
+		if (!polycap_h5_read_vectors(file, "/ExternalLeaks/Coordinates", NULL, 3, header->n_extleak, images->extleak_coords, error) ||
+		    !polycap_h5_read_vectors(file, "/ExternalLeaks/Direction", "/Shard/ExternalLeaks_Direction_Z", 2, header->n_extleak, images->extleak_dir, error) ||
+		    !polycap_h5_read_vectors(file, "/ExternalLeaks/Electric_Vector", "/Shard/ExternalLeaks_Electric_Vector_Z", 2, header->n_extleak, images->extleak_elecv, error) ||
+		    !polycap_h5_read_n_refl(file, "/ExternalLeaks/N_Reflections", header->n_extleak, images->extleak_n_refl, error) ||
+		    !polycap_h5_read_values(file, "/ExternalLeaks/Weights", header->n_extleak, n_energies, images->extleak_coord_weights, error))
+			return false;
+	}
+	if (header->n_intleak > 0) {
+		if (!polycap_h5_read_vectors(file, "/InternalLeaks/Coordinates", NULL, 3, header->n_intleak, images->intleak_coords, error) ||
+		    !polycap_h5_read_vectors(file, "/InternalLeaks/Direction", "/Shard/InternalLeaks_Direction_Z", 2, header->n_intleak, images->intleak_dir, error) ||
+		    !polycap_h5_read_vectors(file, "/InternalLeaks/Electric_Vector", "/Shard/InternalLeaks_Electric_Vector_Z", 2, header->n_intleak, images->intleak_elecv, error) ||
+		    !polycap_h5_read_n_refl(file, "/InternalLeaks/N_Reflections", header->n_intleak, images->intleak_n_refl, error) ||
+		    !polycap_h5_read_values(file, "/InternalLeaks/Weights", header->n_intleak, n_energies, images->intleak_coord_weights, error))
+			return false;
+	}
+	return true;
+}
+//===========================================
+// Allocate the event arrays of images, with the components of the vector arrays within a single allocation
+static bool polycap_images_alloc(struct _polycap_images *images, size_t n_energies, int64_t n_exit, int64_t n_extleak, int64_t n_intleak) {
+	int i;
+	double **exit_vect[] = {images->src_start_coords, images->pc_start_coords, images->pc_start_dir, images->pc_start_elecv, images->pc_exit_coords, images->pc_exit_dir, images->pc_exit_elecv};
+	double **extleak_vect[] = {images->extleak_coords, images->extleak_dir, images->extleak_elecv};
+	double **intleak_vect[] = {images->intleak_coords, images->intleak_dir, images->intleak_elecv};
+	bool ok = true;
+
+	images->mem_size = n_exit;
+	for(i=0; i < 7; i++){
+		exit_vect[i][0] = malloc(sizeof(double)*(n_exit > 0 ? n_exit : 1)*3);
+		exit_vect[i][1] = exit_vect[i][0] + n_exit;
+		exit_vect[i][2] = exit_vect[i][0] + n_exit*2;
+		ok = ok && exit_vect[i][0] != NULL;
+	}
+	images->pc_exit_nrefl = malloc(sizeof(int64_t)*(n_exit > 0 ? n_exit : 1));
+	images->pc_exit_dtravel = malloc(sizeof(double)*(n_exit > 0 ? n_exit : 1));
+	images->exit_coord_weights = malloc(sizeof(double)*(n_exit > 0 ? n_exit : 1)*n_energies);
+	ok = ok && images->pc_exit_nrefl != NULL && images->pc_exit_dtravel != NULL && images->exit_coord_weights != NULL;
+
+	if (n_extleak > 0) {
+		for(i=0; i < 3; i++){
+			extleak_vect[i][0] = malloc(sizeof(double)*n_extleak*3);
+			extleak_vect[i][1] = extleak_vect[i][0] + n_extleak;
+			extleak_vect[i][2] = extleak_vect[i][0] + n_extleak*2;
+			ok = ok && extleak_vect[i][0] != NULL;
+		}
+		images->extleak_n_refl = malloc(sizeof(int64_t)*n_extleak);
+		images->extleak_coord_weights = malloc(sizeof(double)*n_extleak*n_energies);
+		ok = ok && images->extleak_n_refl != NULL && images->extleak_coord_weights != NULL;
+	}
+	if (n_intleak > 0) {
+		for(i=0; i < 3; i++){
+			intleak_vect[i][0] = malloc(sizeof(double)*n_intleak*3);
+			intleak_vect[i][1] = intleak_vect[i][0] + n_intleak;
+			intleak_vect[i][2] = intleak_vect[i][0] + n_intleak*2;
+			ok = ok && intleak_vect[i][0] != NULL;
+		}
+		images->intleak_n_refl = malloc(sizeof(int64_t)*n_intleak);
+		images->intleak_coord_weights = malloc(sizeof(double)*n_intleak*n_energies);
+		ok = ok && images->intleak_n_refl != NULL && images->intleak_coord_weights != NULL;
+	}
+	images->i_exit = n_exit;
+	images->i_extleak = n_extleak;
+	images->i_intleak = n_intleak;
+	return ok;
+}
+//===========================================
+// Allocate efficiencies for n_energies energies, with room for n_exit transmitted photons and n_extleak and n_intleak leaks
+//	the counters and sums are zero, returns NULL if the memory could not be allocated
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_alloc(size_t n_energies, int64_t n_exit, int64_t n_extleak, int64_t n_intleak) {
+	polycap_transmission_efficiencies *efficiencies;
+
+	efficiencies = calloc(1, sizeof(polycap_transmission_efficiencies));
+	if (efficiencies == NULL)
+		return NULL;
+	efficiencies->n_energies = n_energies;
+	efficiencies->images = calloc(1, sizeof(struct _polycap_images));
+	efficiencies->energies = malloc(sizeof(double)*n_energies);
+	efficiencies->efficiencies = malloc(sizeof(double)*n_energies);
+	efficiencies->std_errors = malloc(sizeof(double)*n_energies);
+	efficiencies->sum_weights = calloc(n_energies, sizeof(double));
+	efficiencies->sum_sq_dev = calloc(n_energies, sizeof(double));
+	if (efficiencies->images == NULL || efficiencies->energies == NULL || efficiencies->efficiencies == NULL || efficiencies->std_errors == NULL || efficiencies->sum_weights == NULL || efficiencies->sum_sq_dev == NULL || !polycap_images_alloc(efficiencies->images, n_energies, n_exit, n_extleak, n_intleak)) {
+		polycap_transmission_efficiencies_free(efficiencies);
+		return NULL;
+	}
+	return efficiencies;
+}
+//===========================================
+// Compute the efficiencies and standard errors of efficiencies from its counters and raw sums, as for a single simulation
+void polycap_transmission_efficiencies_finalize(polycap_transmission_efficiencies *efficiencies, polycap_source *source) {
+	int64_t n_exit = efficiencies->images->i_exit;
+	int64_t n_started = efficiencies->images->i_start;
+	double n = (double)n_started;
+	size_t i;
+
+	//Continue working with simulated open area, as for a single simulation
+	source->description->open_area = (double)(n_exit+efficiencies->n_not_transmitted)/n;
+
+	efficiencies->source = source;
+	for (i = 0 ; i < efficiencies->n_energies ; i++) {
+		efficiencies->energies[i] = source->energies[i];
+		efficiencies->efficiencies[i] = (efficiencies->sum_weights[i] / ((double)n_exit+(double)efficiencies->n_not_transmitted)) * source->description->open_area;
+		efficiencies->std_errors[i] = n_started < 2 ? 0. : sqrt(efficiencies->sum_sq_dev[i]/(n-1.)/n);
+	}
+}
+//===========================================
+// Copy n vectors of the vector arrays src to dst starting at offset
+static void polycap_images_copy_vectors(double **dst, int64_t offset, double **src, int64_t n) {
+	int i;
+
+	for(i=0; i < 3; i++)
+		memcpy(dst[i]+offset, src[i], sizeof(double)*n);
+}
+//===========================================
+// Concatenate the photon events of the partial results in parts, and combine their counters and raw sums into the results of all parts together
+//	the reflection histories of the parts are not kept, call polycap_transmission_efficiencies_finalize() to obtain the efficiencies
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_concatenate(size_t n_energies, size_t n_parts, polycap_transmission_efficiencies **parts, polycap_error **error) {
+	polycap_transmission_efficiencies *efficiencies;
+	struct _polycap_images *images, *part;
+	int64_t n_exit = 0, n_extleak = 0, n_intleak = 0;
+	int64_t exit_offset = 0, extleak_offset = 0, intleak_offset = 0;
+	size_t i, k;
+	double n, n_new, delta;
+
+	for (k = 0 ; k < n_parts ; k++) {
+		n_exit += parts[k]->images->i_exit;
+		n_extleak += parts[k]->images->i_extleak;
+		n_intleak += parts[k]->images->i_intleak;
+	}
+	efficiencies = polycap_transmission_efficiencies_alloc(n_energies, n_exit, n_extleak, n_intleak);
+	if (efficiencies == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_concatenate: could not allocate memory for efficiencies -> %s", strerror(errno));
+		return NULL;
+	}
+	images = efficiencies->images;
+
+	for (k = 0 ; k < n_parts ; k++) {
+		part = parts[k]->images;
+		polycap_images_copy_vectors(images->src_start_coords, exit_offset, part->src_start_coords, part->i_exit);
+		polycap_images_copy_vectors(images->pc_start_coords, exit_offset, part->pc_start_coords, part->i_exit);
+		polycap_images_copy_vectors(images->pc_start_dir, exit_offset, part->pc_start_dir, part->i_exit);
+		polycap_images_copy_vectors(images->pc_start_elecv, exit_offset, part->pc_start_elecv, part->i_exit);
+		polycap_images_copy_vectors(images->pc_exit_coords, exit_offset, part->pc_exit_coords, part->i_exit);
+		polycap_images_copy_vectors(images->pc_exit_dir, exit_offset, part->pc_exit_dir, part->i_exit);
+		polycap_images_copy_vectors(images->pc_exit_elecv, exit_offset, part->pc_exit_elecv, part->i_exit);
+		memcpy(images->pc_exit_nrefl+exit_offset, part->pc_exit_nrefl, sizeof(int64_t)*part->i_exit);
+		memcpy(images->pc_exit_dtravel+exit_offset, part->pc_exit_dtravel, sizeof(double)*part->i_exit);
+		memcpy(images->exit_coord_weights+exit_offset*n_energies, part->exit_coord_weights, sizeof(double)*part->i_exit*n_energies);
+		if (part->i_extleak > 0) {
+			polycap_images_copy_vectors(images->extleak_coords, extleak_offset, part->extleak_coords, part->i_extleak);
+			polycap_images_copy_vectors(images->extleak_dir, extleak_offset, part->extleak_dir, part->i_extleak);
+			polycap_images_copy_vectors(images->extleak_elecv, extleak_offset, part->extleak_elecv, part->i_extleak);
+			memcpy(images->extleak_n_refl+extleak_offset, part->extleak_n_refl, sizeof(int64_t)*part->i_extleak);
+			memcpy(images->extleak_coord_weights+extleak_offset*n_energies, part->extleak_coord_weights, sizeof(double)*part->i_extleak*n_energies);
+		}
+		if (part->i_intleak > 0) {
+			polycap_images_copy_vectors(images->intleak_coords, intleak_offset, part->intleak_coords, part->i_intleak);
+			polycap_images_copy_vectors(images->intleak_dir, intleak_offset, part->intleak_dir, part->i_intleak);
+			polycap_images_copy_vectors(images->intleak_elecv, intleak_offset, part->intleak_elecv, part->i_intleak);
+			memcpy(images->intleak_n_refl+intleak_offset, part->intleak_n_refl, sizeof(int64_t)*part->i_intleak);
+			memcpy(images->intleak_coord_weights+intleak_offset*n_energies, part->intleak_coord_weights, sizeof(double)*part->i_intleak*n_energies);
+		}
+		exit_offset += part->i_exit;
+		extleak_offset += part->i_extleak;
+		intleak_offset += part->i_intleak;
+
+		//combine the running statistics of the parts (Chan et al.)
+		if (part->i_start > 0) {
+			n = (double)images->i_start;
+			n_new = n + (double)part->i_start;
+			for (i = 0 ; i < n_energies ; i++) {
+				delta = parts[k]->sum_weights[i]/(double)part->i_start - (n > 0. ? efficiencies->sum_weights[i]/n : 0.);
+				efficiencies->sum_sq_dev[i] += parts[k]->sum_sq_dev[i] + delta*delta*n*(double)part->i_start/n_new;
+				efficiencies->sum_weights[i] += parts[k]->sum_weights[i];
+			}
+		}
+		images->i_start += part->i_start;
+		efficiencies->n_not_entered += parts[k]->n_not_entered;
+		efficiencies->n_not_transmitted += parts[k]->n_not_transmitted;
+	}
+
+	return efficiencies;
+}
+//===========================================
+// Read the partial results of a shard, of which the header was already read
+static polycap_transmission_efficiencies* polycap_shard_read(const char *filename, polycap_shard_header *header, size_t n_energies, polycap_error **error) {
+	polycap_transmission_efficiencies *efficiencies;
+	hid_t file;
+	bool ok;
+
+	efficiencies = polycap_transmission_efficiencies_alloc(n_energies, header->n_exit, header->n_extleak, header->n_intleak);
+	if (efficiencies == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_merge: could not allocate memory for efficiencies -> %s", strerror(errno));
+		return NULL;
+	}
+	file = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+	if (file < 0) {
+		set_exception(error);
+		polycap_transmission_efficiencies_free(efficiencies);
+		return NULL;
+	}
+	ok = polycap_shard_read_images(file, header, efficiencies->images, n_energies, error);
+	H5Fclose(file);
+	if (!ok) {
+		polycap_transmission_efficiencies_free(efficiencies);
+		return NULL;
+	}
+	memcpy(efficiencies->sum_weights, header->sum_weights, sizeof(double)*n_energies);
+	memcpy(efficiencies->sum_sq_dev, header->sum_sq_dev, sizeof(double)*n_energies);
+	efficiencies->images->i_start = header->n_started;
+	efficiencies->n_not_entered = header->n_not_entered;
+	efficiencies->n_not_transmitted = header->n_not_transmitted;
+	return efficiencies;
+}
+//===========================================
+// Merge the partial results of all shards of a sharded simulation
+//	the shards are ordered by their index, so the photon events appear in the same order for any order of filenames
+polycap_transmission_efficiencies* polycap_transmission_efficiencies_merge(polycap_source *source, size_t n_files, const char **filenames, polycap_error **error) {
+	polycap_transmission_efficiencies *efficiencies = NULL;
+	polycap_transmission_efficiencies **parts = NULL;
+	polycap_shard_header *headers;
+	int *order = NULL; //file of each shard index
+	hid_t file;
+	size_t i, k;
+	bool ok = true;
+
+	tables_init();
+
+	//argument sanity check
+	if (source == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: source cannot be NULL");
+		return NULL;
+	}
+	if (n_files < 1 || filenames == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: n_files must be greater than 0 and filenames cannot be NULL");
+		return NULL;
+	}
+	for (i = 0 ; i < n_files ; i++) {
+		if (filenames[i] == NULL) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: filenames cannot contain NULL");
+			return NULL;
+		}
 	}
-	//Define temporary dataset dimension
-	dim[0] = 2;
-	dim[1] = efficiencies->source->description->profile->nmax;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/Input/PC_Shape", data_temp,"[cm,cm]", error))
-		return false;
-	//Free data_temp
-	free(data_temp);
 
-	//Copy direction data to temporary array for straightforward HDF5 writing
-	data_temp = malloc(sizeof(double)*efficiencies->source->description->profile->nmax*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
+	headers = calloc(n_files, sizeof(polycap_shard_header));
+	if (headers == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_merge: could not allocate memory for headers -> %s", strerror(errno));
+		return NULL;
 	}
-	for(j=0 ; j < efficiencies->source->description->profile->nmax ; j++){
-		data_temp[j] = efficiencies->source->description->profile->z[j];
-		data_temp[j+ efficiencies->source->description->profile->nmax] = efficiencies->source->description->profile->cap[j];
+
+	//read the counters of all shards and check that they belong to the same simulation
+	for (i = 0 ; ok && i < n_files ; i++) {
+		file = H5Fopen(filenames[i], H5F_ACC_RDONLY, H5P_DEFAULT);
+		if (file < 0) {
+			set_exception(error);
+			ok = false;
+			break;
+		}
+		ok = polycap_shard_read_header(file, filenames[i], source, &headers[i], error);
+		H5Fclose(file);
+		if (!ok)
+			break;
+		if (headers[i].count != headers[0].count || headers[i].n_photons != headers[0].n_photons || headers[i].seed != headers[0].seed) {
+			polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: %s belongs to a different sharded simulation than %s", filenames[i], filenames[0]);
+			ok = false;
+		}
 	}
-	//Define temporary dataset dimension
-	dim[0] = 2;
-	dim[1] = efficiencies->source->description->profile->nmax;
-	if (!polycap_h5_write_dataset(file, 2, dim, "/Input/Cap_Shape", data_temp,"[cm,cm]", error))
-		return false;
-	//Free data_temp
-	free(data_temp);
-	
-	//Write ncap and other input parameters
-	n_energies_temp = 1;
-	data_temp = malloc(sizeof(double));
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
+	if (ok && (size_t) headers[0].count != n_files) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: the simulation was split in %d shards, but %d files were supplied", headers[0].count, (int) n_files);
+		ok = false;
 	}
-	*data_temp = (double)efficiencies->source->description->n_cap;
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/N_Capillaries", data_temp,"a.u.", error))
-		return false;
-	free(data_temp);
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Surface_Roughness", &efficiencies->source->description->sig_rough,"Angstrom", error))
-		return false;
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Open_Area", &efficiencies->source->description->open_area,"a.u.", error))
-		return false;
-	dim[0] = 2;
-	dim[1] = efficiencies->source->description->nelem;
-	data_temp = malloc(sizeof(double)*efficiencies->source->description->nelem*2);
-	if(data_temp == NULL){
-		polycap_set_error_literal(error, POLYCAP_ERROR_MEMORY, strerror(errno));
-		return false;
+	if (ok) {
+		order = malloc(sizeof(int)*n_files);
+		parts = calloc(n_files, sizeof(polycap_transmission_efficiencies*));
+		if (order == NULL || parts == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_merge: could not allocate memory for parts -> %s", strerror(errno));
+			ok = false;
+		}
 	}
-	for(j=0 ; j < efficiencies->source->description->nelem ; j++){
-		data_temp[j] = efficiencies->source->description->iz[j];
-		data_temp[j+ efficiencies->source->description->nelem] = efficiencies->source->description->wi[j];
+	if (ok) {
+		for (k = 0 ; k < n_files ; k++)
+			order[k] = -1;
+		for (i = 0 ; i < n_files ; i++) {
+			if (headers[i].index < 0 || headers[i].index >= headers[i].count || order[headers[i].index] != -1) {
+				polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_merge: %s has an invalid or duplicate shard index", filenames[i]);
+				ok = false;
+				break;
+			}
+			order[headers[i].index] = (int) i;
+		}
 	}
-	if (!polycap_h5_write_dataset(file, 2, dim, "/Input/PC_Composition", data_temp,"[Z,w%]", error))
-		return false;
-	free(data_temp);
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/PC_Density", &efficiencies->source->description->density,"g/cm3", error))
-		return false;
-	if (!polycap_h5_write_dataset(file, 1, &n_energies_temp, "/Input/Src_PC_Dist", &efficiencies->source->d_source,"cm", error))
-		return false;
 
+	//read the photon events of the shards in order of their index, and concatenate them
+	for (k = 0 ; ok && k < n_files ; k++) {
+		parts[k] = polycap_shard_read(filenames[order[k]], &headers[order[k]], source->n_energies, error);
+		ok = parts[k] != NULL;
+	}
+	if (ok) {
+		efficiencies = polycap_transmission_efficiencies_concatenate(source->n_energies, n_files, parts, error);
+		if (efficiencies != NULL)
+			polycap_transmission_efficiencies_finalize(efficiencies, source);
+	}
 
-	//Close Group access
-	if (H5Gclose(PC_Exit_id) < 0)
-		set_exception(error);
-	if (H5Gclose(PC_Start_id) < 0)
-		set_exception(error);
-	if (H5Gclose(Input_id) < 0)
-		set_exception(error);
-
-	//Close file
-	if (H5Fclose(file) < 0)
-		set_exception(error);
-	
-	return true;
+	for (i = 0 ; i < n_files ; i++) {
+		free(headers[i].sum_weights);
+		free(headers[i].sum_sq_dev);
+		if (parts != NULL)
+			polycap_transmission_efficiencies_free(parts[i]);
+	}
+	free(headers);
+	free(parts);
+	free(order);
+	return efficiencies;
 }
 //===========================================
 bool polycap_transmission_efficiencies_get_start_data(polycap_transmission_efficiencies *efficiencies, int64_t *n_start, int64_t *n_exit, polycap_vector3 **start_coords, polycap_vector3 **start_direction, polycap_vector3 **start_elecv, polycap_vector3 **src_start_coords, polycap_error **error)
@@ -817,19 +1401,19 @@ bool polycap_transmission_efficiencies_get_start_data(polycap_transmission_effic
 	for(i = 0; i < efficiencies->images->i_exit; i++) {
 		(*start_coords)[i].x = efficiencies->images->pc_start_coords[0][i];
 		(*start_coords)[i].y = efficiencies->images->pc_start_coords[1][i];
-		(*start_coords)[i].z = 0.;
+		(*start_coords)[i].z = efficiencies->images->pc_start_coords[2][i];
 
 		(*start_direction)[i].x = efficiencies->images->pc_start_dir[0][i];
 		(*start_direction)[i].y = efficiencies->images->pc_start_dir[1][i];
-		(*start_direction)[i].z = sqrt(1.- (*start_direction)[i].x * (*start_direction)[i].x - (*start_direction)[i].y * (*start_direction)[i].y);
+		(*start_direction)[i].z = efficiencies->images->pc_start_dir[2][i];
 
 		(*start_elecv)[i].x = efficiencies->images->pc_start_elecv[0][i];
 		(*start_elecv)[i].y = efficiencies->images->pc_start_elecv[1][i];
-		(*start_elecv)[i].z = sqrt(1.- (*start_elecv)[i].x * (*start_elecv)[i].x - (*start_elecv)[i].y * (*start_elecv)[i].y);
+		(*start_elecv)[i].z = efficiencies->images->pc_start_elecv[2][i];
 
 		(*src_start_coords)[i].x = efficiencies->images->src_start_coords[0][i];
 		(*src_start_coords)[i].y = efficiencies->images->src_start_coords[1][i];
-		(*src_start_coords)[i].z = 0.;
+		(*src_start_coords)[i].z = efficiencies->images->src_start_coords[2][i];
 	}
 
 	return true;
@@ -897,11 +1481,11 @@ bool polycap_transmission_efficiencies_get_exit_data(polycap_transmission_effici
 
 		(*exit_direction)[i].x = efficiencies->images->pc_exit_dir[0][i];
 		(*exit_direction)[i].y = efficiencies->images->pc_exit_dir[1][i];
-		(*exit_direction)[i].z = sqrt(1.-(*exit_direction)[i].x*(*exit_direction)[i].x - (*exit_direction)[i].y*(*exit_direction)[i].y);
+		(*exit_direction)[i].z = efficiencies->images->pc_exit_dir[2][i];
 
 		(*exit_elecv)[i].x = efficiencies->images->pc_exit_elecv[0][i];
 		(*exit_elecv)[i].y = efficiencies->images->pc_exit_elecv[1][i];
-		(*exit_elecv)[i].z = sqrt(1.-(*exit_elecv)[i].x*(*exit_elecv)[i].x - (*exit_elecv)[i].y*(*exit_elecv)[i].y);
+		(*exit_elecv)[i].z = efficiencies->images->pc_exit_elecv[2][i];
 
 		(*exit_weights)[i] = malloc(sizeof(double) * efficiencies->n_energies);
 		if ( (*exit_weights)[i] == NULL){
@@ -916,6 +1500,66 @@ bool polycap_transmission_efficiencies_get_exit_data(polycap_transmission_effici
 	return true;
 }
 //===========================================
+bool polycap_transmission_efficiencies_get_start_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_start, int64_t *n_exit, int64_t *stride, const double **start_coords, const double **start_direction, const double **start_elecv, const double **src_start_coords, polycap_error **error)
+{
+	if (efficiencies == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_start_buffers: efficiencies cannot be NULL");
+		return false;
+	}
+	if (efficiencies->images == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_start_buffers: efficiencies->images cannot be NULL");
+		return false;
+	}
+
+	*n_start = efficiencies->images->i_start;
+	if (efficiencies->images->i_start == 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_start_buffers: no photon start events in efficiencies");
+		return false;
+	}
+	*n_exit = efficiencies->images->i_exit;
+	if (efficiencies->images->i_exit == 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_start_buffers: no photon exit events in efficiencies");
+		return false;
+	}
+
+	*stride = efficiencies->images->mem_size;
+	*start_coords = efficiencies->images->pc_start_coords[0];
+	*start_direction = efficiencies->images->pc_start_dir[0];
+	*start_elecv = efficiencies->images->pc_start_elecv[0];
+	*src_start_coords = efficiencies->images->src_start_coords[0];
+
+	return true;
+}
+//===========================================
+bool polycap_transmission_efficiencies_get_exit_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_exit, int64_t *stride, const double **exit_coords, const double **exit_direction, const double **exit_elecv, const int64_t **n_refl, const double **d_travel, size_t *n_energies, const double **exit_weights, polycap_error **error)
+{
+	if (efficiencies == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_exit_buffers: efficiencies cannot be NULL");
+		return false;
+	}
+	if (efficiencies->images == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_exit_buffers: efficiencies->images cannot be NULL");
+		return false;
+	}
+
+	*n_exit = efficiencies->images->i_exit;
+	*n_energies = efficiencies->n_energies;
+	if (efficiencies->images->i_start == 0){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_exit_buffers: no photon start events in efficiencies");
+		return false;
+	}
+
+	*stride = efficiencies->images->mem_size;
+	*exit_coords = efficiencies->images->pc_exit_coords[0];
+	*exit_direction = efficiencies->images->pc_exit_dir[0];
+	*exit_elecv = efficiencies->images->pc_exit_elecv[0];
+	*n_refl = efficiencies->images->pc_exit_nrefl;
+	*d_travel = efficiencies->images->pc_exit_dtravel;
+	*exit_weights = efficiencies->images->exit_coord_weights;
+
+	return true;
+}
+//===========================================
 bool polycap_transmission_efficiencies_get_extleak_data(polycap_transmission_efficiencies *efficiencies, polycap_leak ***leaks, int64_t *n_leaks, polycap_error **error)
 {
 	int i,j;
@@ -956,12 +1600,12 @@ bool polycap_transmission_efficiencies_get_extleak_data(polycap_transmission_eff
 		memcpy(&(*leaks)[i]->coords, &temp, sizeof(polycap_vector3));
 		temp.x = efficiencies->images->extleak_dir[0][i];
 		temp.y = efficiencies->images->extleak_dir[1][i];
-		temp.z = sqrt(1.-temp.x*temp.x - temp.y*temp.y);
+		temp.z = efficiencies->images->extleak_dir[2][i];
 		memcpy(&(*leaks)[i]->direction, &temp, sizeof(polycap_vector3));
-		//temp.x = efficiencies->images->extleak_elecv[0][i];
-		//temp.y = efficiencies->images->extleak_elecv[1][i];
-		//temp.z = sqrt(1.-temp.x*temp.x - temp.y*temp.y);
-		//memcpy(&(*leaks)[i]->elecv, &temp, sizeof(polycap_vector3));
+		temp.x = efficiencies->images->extleak_elecv[0][i];
+		temp.y = efficiencies->images->extleak_elecv[1][i];
+		temp.z = efficiencies->images->extleak_elecv[2][i];
+		memcpy(&(*leaks)[i]->elecv, &temp, sizeof(polycap_vector3));
 		
 		(*leaks)[i]->n_energies = efficiencies->n_energies;
 		(*leaks)[i]->n_refl = efficiencies->images->extleak_n_refl[i];
@@ -1020,11 +1664,11 @@ bool polycap_transmission_efficiencies_get_intleak_data(polycap_transmission_eff
 		memcpy(&(*leaks)[i]->coords, &temp, sizeof(polycap_vector3));
 		temp.x = efficiencies->images->intleak_dir[0][i];
 		temp.y = efficiencies->images->intleak_dir[1][i];
-		temp.z = sqrt(1.-temp.x*temp.x - temp.y*temp.y);
+		temp.z = efficiencies->images->intleak_dir[2][i];
 		memcpy(&(*leaks)[i]->direction, &temp, sizeof(polycap_vector3));
 		temp.x = efficiencies->images->intleak_elecv[0][i];
 		temp.y = efficiencies->images->intleak_elecv[1][i];
-		temp.z = sqrt(1.-temp.x*temp.x - temp.y*temp.y);
+		temp.z = efficiencies->images->intleak_elecv[2][i];
 		memcpy(&(*leaks)[i]->elecv, &temp, sizeof(polycap_vector3));
 		
 		(*leaks)[i]->n_energies = efficiencies->n_energies;
@@ -1043,6 +1687,50 @@ bool polycap_transmission_efficiencies_get_intleak_data(polycap_transmission_eff
 	return true;
 }
 //===========================================
+bool polycap_transmission_efficiencies_get_extleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error)
+{
+	if (efficiencies == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_extleak_buffers: efficiencies cannot be NULL");
+		return false;
+	}
+	if (efficiencies->images == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_extleak_buffers: efficiencies->images cannot be NULL");
+		return false;
+	}
+
+	*n_leaks = efficiencies->images->i_extleak;
+	*n_energies = efficiencies->n_energies;
+	*coords = efficiencies->images->extleak_coords[0];
+	*direction = efficiencies->images->extleak_dir[0];
+	*elecv = efficiencies->images->extleak_elecv[0];
+	*n_refl = efficiencies->images->extleak_n_refl;
+	*weights = efficiencies->images->extleak_coord_weights;
+
+	return true;
+}
+//===========================================
+bool polycap_transmission_efficiencies_get_intleak_buffers(polycap_transmission_efficiencies *efficiencies, int64_t *n_leaks, const double **coords, const double **direction, const double **elecv, const int64_t **n_refl, size_t *n_energies, const double **weights, polycap_error **error)
+{
+	if (efficiencies == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_intleak_buffers: efficiencies cannot be NULL");
+		return false;
+	}
+	if (efficiencies->images == NULL){
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_intleak_buffers: efficiencies->images cannot be NULL");
+		return false;
+	}
+
+	*n_leaks = efficiencies->images->i_intleak;
+	*n_energies = efficiencies->n_energies;
+	*coords = efficiencies->images->intleak_coords[0];
+	*direction = efficiencies->images->intleak_dir[0];
+	*elecv = efficiencies->images->intleak_elecv[0];
+	*n_refl = efficiencies->images->intleak_n_refl;
+	*weights = efficiencies->images->intleak_coord_weights;
+
+	return true;
+}
+//===========================================
 void polycap_images_free(struct _polycap_images *images)
 {
 	if (images == NULL)
@@ -1050,68 +1738,44 @@ void polycap_images_free(struct _polycap_images *images)
 
 	if (images->src_start_coords[0])
 		free(images->src_start_coords[0]);
-	if (images->src_start_coords[1])
-		free(images->src_start_coords[1]);
 	if (images->pc_start_coords[0])
 		free(images->pc_start_coords[0]);
-	if (images->pc_start_coords[1])
-		free(images->pc_start_coords[1]);
 	if (images->pc_start_dir[0])
 		free(images->pc_start_dir[0]);
-	if (images->pc_start_dir[1])
-		free(images->pc_start_dir[1]);
 	if (images->pc_start_elecv[0])
 		free(images->pc_start_elecv[0]);
-	if (images->pc_start_elecv[1])
-		free(images->pc_start_elecv[1]);
 	if (images->pc_exit_coords[0])
 		free(images->pc_exit_coords[0]);
-	if (images->pc_exit_coords[1])
-		free(images->pc_exit_coords[1]);
-	if (images->pc_exit_coords[2])
-		free(images->pc_exit_coords[2]);
 	if (images->pc_exit_dir[0])
 		free(images->pc_exit_dir[0]);
-	if (images->pc_exit_dir[1])
-		free(images->pc_exit_dir[1]);
 	if (images->pc_exit_elecv[0])
 		free(images->pc_exit_elecv[0]);
-	if (images->pc_exit_elecv[1])
-		free(images->pc_exit_elecv[1]);
 	if (images->pc_exit_nrefl)
 		free(images->pc_exit_nrefl);
 	if (images->pc_exit_dtravel)
 		free(images->pc_exit_dtravel);
 	if (images->exit_coord_weights)
 		free(images->exit_coord_weights);
+	if (images->refl_history)
+		free(images->refl_history);
+	if (images->refl_history_offset)
+		free(images->refl_history_offset);
 	if (images->extleak_coords[0])
 		free(images->extleak_coords[0]);
-	if (images->extleak_coords[1])
-		free(images->extleak_coords[1]);
-	if (images->extleak_coords[2])
-		free(images->extleak_coords[2]);
 	if (images->extleak_dir[0])
 		free(images->extleak_dir[0]);
-	if (images->extleak_dir[1])
-		free(images->extleak_dir[1]);
+	if (images->extleak_elecv[0])
+		free(images->extleak_elecv[0]);
 	if (images->extleak_coord_weights)
 		free(images->extleak_coord_weights);
 	if (images->extleak_n_refl)
 		free(images->extleak_n_refl);
 	if (images->intleak_coords[0])
 		free(images->intleak_coords[0]);
-	if (images->intleak_coords[1])
-		free(images->intleak_coords[1]);
-	if (images->intleak_coords[2])
-		free(images->intleak_coords[2]);
 	if (images->intleak_dir[0])
 		free(images->intleak_dir[0]);
-	if (images->intleak_dir[1])
-		free(images->intleak_dir[1]);
 	if (images->intleak_elecv[0])
 		free(images->intleak_elecv[0]);
-	if (images->intleak_elecv[1])
-		free(images->intleak_elecv[1]);
 	if (images->intleak_coord_weights)
 		free(images->intleak_coord_weights);
 	if (images->intleak_n_refl)
@@ -1128,6 +1792,12 @@ void polycap_transmission_efficiencies_free(polycap_transmission_efficiencies *e
 		free(efficiencies->energies);
 	if (efficiencies->efficiencies)
 		free(efficiencies->efficiencies);
+	if (efficiencies->std_errors)
+		free(efficiencies->std_errors);
+	if (efficiencies->sum_weights)
+		free(efficiencies->sum_weights);
+	if (efficiencies->sum_sq_dev)
+		free(efficiencies->sum_sq_dev);
 	if (efficiencies->images) {
 		polycap_images_free(efficiencies->images);
 	}
@@ -1156,6 +1826,268 @@ bool polycap_transmission_efficiencies_get_data(polycap_transmission_efficiencie
 	return true;
 }
 
+bool polycap_transmission_efficiencies_get_uncertainties(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **uncertainties_arr, polycap_error **error) {
+	size_t i;
+
+	if (efficiencies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_uncertainties: efficiencies cannot be NULL");
+		return false;
+	}
+
+	if (n_energies)
+		*n_energies = efficiencies->n_energies;
+
+	if (uncertainties_arr) {
+		*uncertainties_arr = malloc(sizeof(double) * efficiencies->n_energies);
+		if (*uncertainties_arr == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_get_uncertainties: could not allocate memory for uncertainties_arr -> %s", strerror(errno));
+			return false;
+		}
+		for(i=0; i < efficiencies->n_energies; i++)
+			(*uncertainties_arr)[i] = efficiencies->efficiencies[i] > 0. ? efficiencies->std_errors[i] / efficiencies->efficiencies[i] : NAN;
+	}
+
+	return true;
+}
+
+bool polycap_transmission_efficiencies_get_std_errors(polycap_transmission_efficiencies *efficiencies, size_t *n_energies, double **std_errors_arr, polycap_error **error) {
+	if (efficiencies == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_get_std_errors: efficiencies cannot be NULL");
+		return false;
+	}
+
+	if (n_energies)
+		*n_energies = efficiencies->n_energies;
+
+	if (std_errors_arr) {
+		*std_errors_arr = malloc(sizeof(double) * efficiencies->n_energies);
+		if (*std_errors_arr == NULL) {
+			polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_get_std_errors: could not allocate memory for std_errors_arr -> %s", strerror(errno));
+			return false;
+		}
+		memcpy(*std_errors_arr, efficiencies->std_errors, sizeof(double) * efficiencies->n_energies);
+	}
+
+	return true;
+}
+//===========================================
+// check whether a description can be used to recompute reflection weights
+static bool polycap_reweight_check_description(polycap_description *description, const char *func, polycap_error **error) {
+	if (description == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: description cannot be NULL", func);
+		return false;
+	}
+	if (description->density <= 0.) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: description->density must be greater than 0", func);
+		return false;
+	}
+	if (description->nelem < 1) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: description->nelem must be greater than 0", func);
+		return false;
+	}
+	return true;
+}
+//===========================================
+// replay the recorded reflections of all transmitted photons for n_variants capillary materials at once
+//	sums (n_variants*n_energies elements) receives the summed weights per material and energy,
+//	weights (i_exit*n_variants*n_energies elements) the weights of each photon if not NULL
+static bool polycap_images_replay(struct _polycap_images *images, size_t n_variants, polycap_description **variants, size_t n_energies, double *energies, double *weights, double *sums, polycap_error **error) {
+	int j;
+	size_t i, v;
+	bool failed = false;
+	int64_t i_exit = images->i_exit;
+	size_t n_weights = n_variants*n_energies;
+	double *amu, *scatf;
+
+	//absorption coefficients and scatter factors of each material, n_energies per material
+	amu = malloc(sizeof(double)*n_weights);
+	scatf = malloc(sizeof(double)*n_weights);
+	if (amu == NULL || scatf == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_images_replay: could not allocate memory for amu and scatf -> %s", strerror(errno));
+		free(amu);
+		free(scatf);
+		return false;
+	}
+	for(v=0; v < n_variants; v++)
+		polycap_material_scatf(variants[v], n_energies, energies, amu+v*n_energies, scatf+v*n_energies);
+	for(i=0; i < n_weights; i++)
+		sums[i] = 0.;
+
+	#pragma omp parallel default(shared) private(i, v)
+	{
+	int64_t k;
+	double cons1;
+	polycap_refl_event *event;
+	double *weight;
+	double *weight_buf = malloc(sizeof(double)*n_weights);
+	double *sums_local = calloc(n_weights, sizeof(double));
+
+	if (weight_buf == NULL || sums_local == NULL) {
+		#pragma omp critical
+		{
+		failed = true;
+		}
+	}
+	#pragma omp barrier
+
+	//each reflection is evaluated for all materials and energies before moving on to the next
+	#pragma omp for
+	for(j=0; j < i_exit; j++){
+		if (failed)
+			continue;
+		weight = weights != NULL ? weights + (int64_t) j*n_weights : weight_buf;
+		for(i=0; i < n_weights; i++)
+			weight[i] = 1.;
+		for(k=images->refl_history_offset[j]; k < images->refl_history_offset[j+1]; k++){
+			event = &images->refl_history[k];
+			for(v=0; v < n_variants; v++){
+				for(i=0; i < n_energies; i++){
+					cons1 = (1.01358e0*energies[i])*event->alfa*variants[v]->sig_rough;
+					weight[v*n_energies+i] = weight[v*n_energies+i] * polycap_refl_fresnel(energies[i], variants[v]->density, scatf[v*n_energies+i], amu[v*n_energies+i], event->theta, event->frac_s) * exp(-1.*cons1*cons1);
+				}
+			}
+		}
+		for(i=0; i < n_weights; i++)
+			sums_local[i] += weight[i];
+	}
+
+	#pragma omp critical
+	{
+	if (sums_local != NULL) {
+		for(i=0; i < n_weights; i++)
+			sums[i] += sums_local[i];
+	}
+	}
+	free(weight_buf);
+	free(sums_local);
+	} //#pragma omp parallel
+
+	free(amu);
+	free(scatf);
+	if (failed) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_images_replay: could not allocate memory for the weights -> %s", strerror(errno));
+		return false;
+	}
+	return true;
+}
+//===========================================
+// check the arguments common to polycap_transmission_efficiencies_reweight() and polycap_transmission_efficiencies_reweight_materials()
+static bool polycap_reweight_check(polycap_transmission_efficiencies *efficiencies, size_t n_energies, double *energies, const char *func, polycap_error **error) {
+	size_t i;
+
+	if (efficiencies == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: efficiencies cannot be NULL", func);
+		return false;
+	}
+	if (efficiencies->images == NULL || efficiencies->images->refl_history == NULL || efficiencies->images->refl_history_offset == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: efficiencies contain no reflection histories, enable these with polycap_source_set_record_histories() before the simulation", func);
+		return false;
+	}
+	if (n_energies < 1) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: n_energies must be greater than 0", func);
+		return false;
+	}
+	if (energies == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: energies cannot be NULL", func);
+		return false;
+	}
+	for(i=0; i < n_energies; i++){
+		if (energies[i] < 1. || energies[i] > 100.) {
+			polycap_set_error(error, POLYCAP_ERROR_INVALID_ARGUMENT, "%s: energies must be greater than 1 and smaller than 100", func);
+			return false;
+		}
+	}
+	return true;
+}
+//===========================================
+// recompute the weights of the transmitted photons for other energies and/or another capillary material from their recorded reflections
+bool polycap_transmission_efficiencies_reweight(polycap_transmission_efficiencies *efficiencies, polycap_description *description, size_t n_energies, double *energies, double **weights_arr, double **efficiencies_arr, polycap_error **error) {
+	size_t i;
+	double *weights = NULL, *sums;
+
+	// argument sanity check
+	if (!polycap_reweight_check(efficiencies, n_energies, energies, "polycap_transmission_efficiencies_reweight", error))
+		return false;
+	if (description == NULL) {
+		if (efficiencies->source == NULL || efficiencies->source->description == NULL) {
+			polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_reweight: description cannot be NULL if efficiencies were not obtained from a polycap_source");
+			return false;
+		}
+		description = efficiencies->source->description;
+	}
+	if (!polycap_reweight_check_description(description, "polycap_transmission_efficiencies_reweight", error))
+		return false;
+
+	sums = malloc(sizeof(double)*n_energies);
+	if (weights_arr)
+		weights = malloc(sizeof(double)*n_energies*(efficiencies->images->i_exit > 0 ? efficiencies->images->i_exit : 1));
+	if (sums == NULL || (weights_arr && weights == NULL)) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_reweight: could not allocate memory for weights -> %s", strerror(errno));
+		free(sums);
+		free(weights);
+		return false;
+	}
+	if (!polycap_images_replay(efficiencies->images, 1, &description, n_energies, energies, weights, sums, error)) {
+		free(sums);
+		free(weights);
+		return false;
+	}
+
+	//the efficiencies are the summed weights per started photon
+	for(i=0; i < n_energies; i++)
+		sums[i] /= (double) efficiencies->images->i_start;
+
+	if (efficiencies_arr)
+		*efficiencies_arr = sums;
+	else
+		free(sums);
+	if (weights_arr)
+		*weights_arr = weights;
+
+	return true;
+}
+//===========================================
+// obtain the transmission efficiencies of several capillary materials from a single set of recorded photon paths
+bool polycap_transmission_efficiencies_reweight_materials(polycap_transmission_efficiencies *efficiencies, size_t n_variants, polycap_description **variants, double **efficiencies_arr, polycap_error **error) {
+	size_t i, v;
+	double *sums;
+
+	// argument sanity check
+	if (!polycap_reweight_check(efficiencies, efficiencies != NULL ? efficiencies->n_energies : 0, efficiencies != NULL ? efficiencies->energies : NULL, "polycap_transmission_efficiencies_reweight_materials", error))
+		return false;
+	if (n_variants < 1) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_reweight_materials: n_variants must be greater than 0");
+		return false;
+	}
+	if (variants == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_reweight_materials: variants cannot be NULL");
+		return false;
+	}
+	for(v=0; v < n_variants; v++){
+		if (!polycap_reweight_check_description(variants[v], "polycap_transmission_efficiencies_reweight_materials", error))
+			return false;
+	}
+	if (efficiencies_arr == NULL) {
+		polycap_set_error_literal(error, POLYCAP_ERROR_INVALID_ARGUMENT, "polycap_transmission_efficiencies_reweight_materials: efficiencies_arr cannot be NULL");
+		return false;
+	}
+
+	sums = malloc(sizeof(double)*n_variants*efficiencies->n_energies);
+	if (sums == NULL) {
+		polycap_set_error(error, POLYCAP_ERROR_MEMORY, "polycap_transmission_efficiencies_reweight_materials: could not allocate memory for efficiencies_arr -> %s", strerror(errno));
+		return false;
+	}
+	if (!polycap_images_replay(efficiencies->images, n_variants, variants, efficiencies->n_energies, efficiencies->energies, NULL, sums, error)) {
+		free(sums);
+		return false;
+	}
+	for(i=0; i < n_variants*efficiencies->n_energies; i++)
+		sums[i] /= (double) efficiencies->images->i_start;
+	*efficiencies_arr = sums;
+
+	return true;
+}
+
 void polycap_free(void *data) {
 	if (data)
 		free(data);
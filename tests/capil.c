@@ -355,8 +355,8 @@ void test_polycap_capil_trace() {
 	double wi[2]={53.0,47.0};
 	polycap_photon *photon;
 	int ix_val = 0;
-	int *ix=&ix_val, i;
-	double *cap;
+	int *ix=&ix_val;
+	polycap_capil_axis cap_axis = {0., 0., 1.};
 
 	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., rad_ext_upstream, rad_ext_downstream, rad_int_upstream, rad_int_downstream, focal_dist_upstream, focal_dist_downstream, &error);
 	assert(profile != NULL);
@@ -390,21 +390,15 @@ void test_polycap_capil_trace() {
 	polycap_photon_scatf(photon, &error);
 	polycap_clear_error(&error);
 
-	cap = malloc(sizeof(double)*1000);
-	assert(cap != NULL);
-	for(i=0; i< 1000; i++){
-		cap[i] = 0.;
-	}
-
 	//won't work
-	test = polycap_capil_trace(NULL, NULL, NULL, NULL, NULL, false, &error);
+	test = polycap_capil_trace(NULL, NULL, NULL, cap_axis, false, &error);
 	assert(test == -1);
 	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
 
 
 	//Should work, finds new reflection point
 	polycap_clear_error(&error);
-	test = polycap_capil_trace(ix, photon, description, cap, cap, false, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, false, &error);
 	assert(test == 0); //new reflection found, but weight is too low
 	assert(photon->weight[0] < 1.e-4);
 	assert(*ix == 0);
@@ -437,7 +431,7 @@ void test_polycap_capil_trace() {
 	photon->exit_direction.x = 3.e-5;
 	photon->exit_direction.y = 3.e-5;
 	photon->exit_direction.z = 0.999;
-	test = polycap_capil_trace(ix, photon, description, cap, cap, false, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, false, &error);
 	assert(test == 1);
 	assert(fabs(photon->weight[0] - 0.999585 ) < 1.e-4);
 	assert(*ix == 552);
@@ -467,7 +461,7 @@ void test_polycap_capil_trace() {
 	//calculate attenuation coefficients and scattering factors
 	polycap_photon_scatf(photon, &error);
 	polycap_clear_error(&error);
-	test = polycap_capil_trace(ix, photon, description, cap, cap, false, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, false, &error);
 	assert(test == 0);
 	polycap_photon_free(photon);
 	
@@ -488,14 +482,105 @@ void test_polycap_capil_trace() {
 	photon->energies[0] = energies;
 	photon->weight[0] = 1.0;
 	photon->i_refl = 0;
-	test = polycap_capil_trace(ix, photon, description, cap, cap, false, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, false, &error);
 	assert(test == -2);
 	assert(photon->i_refl == 0);
 
 	polycap_description_free(description);
 	polycap_profile_free(profile);
 	polycap_photon_free(photon);
-	free(cap);
+}
+
+void test_polycap_capil_trace_analytic() {
+	polycap_error *error = NULL;
+	polycap_profile_type types[2] = {POLYCAP_PROFILE_CONICAL, POLYCAP_PROFILE_ELLIPSOIDAL};
+	polycap_profile *profile, *segmented;
+	polycap_description *description, *description_segmented;
+	polycap_photon *photon, *photon_segmented;
+	polycap_vector3 start_coords, start_direction, start_electric_vector = {0.5, 0.5, 0.};
+	polycap_capil_axis cap_axis;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double n_shells, ext, slope;
+	int i, j, ix, ix_segmented, test;
+
+	for(i=0; i<2; i++){
+		profile = polycap_profile_new(types[i], 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+		assert(profile != NULL);
+		segmented = polycap_profile_new_from_arrays(profile->nmax, profile->ext, profile->cap, profile->z, &error);
+		assert(segmented != NULL);
+		//only profiles from polycap_profile_new() have a closed-form shape
+		assert(polycap_profile_set_analytic_tracing(segmented, true, &error) == false);
+		assert(polycap_error_matches(error, POLYCAP_ERROR_UNSUPPORTED));
+		polycap_clear_error(&error);
+		assert(polycap_profile_set_analytic_tracing(profile, true, &error));
+		description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+		assert(description != NULL);
+		description_segmented = polycap_description_new(segmented, 0.0, 200000, 2, iz, wi, 2.23, &error);
+		assert(description_segmented != NULL);
+		n_shells = round(sqrt(12. * description->n_cap - 3.)/6.-0.5);
+
+		//photons that start inside an off-axis capillary, along its axis with a small deviation
+		for(j=0; j<10; j++){
+			cap_axis = polycap_capil_axis_new(n_shells, 10.*j-30., 40.-7.*j);
+			ix = ix_segmented = 100*j;
+			ext = profile->ext[ix];
+			slope = (profile->ext[ix+1] - profile->ext[ix])/(profile->z[ix+1] - profile->z[ix]);
+			start_coords.x = cap_axis.x*ext/cap_axis.z_div + 0.5*profile->cap[ix]*cos(j);
+			start_coords.y = cap_axis.y*ext/cap_axis.z_div + 0.5*profile->cap[ix]*sin(j);
+			start_coords.z = profile->z[ix];
+			start_direction.x = cap_axis.x*slope/cap_axis.z_div + 1.e-3*sin(j);
+			start_direction.y = cap_axis.y*slope/cap_axis.z_div + 1.e-3*cos(j);
+			start_direction.z = 1.;
+			photon = polycap_photon_new(description, start_coords, start_direction, start_electric_vector, &error);
+			assert(photon != NULL);
+			photon_segmented = polycap_photon_new(description_segmented, start_coords, start_direction, start_electric_vector, &error);
+			assert(photon_segmented != NULL);
+			photon->n_energies = photon_segmented->n_energies = 1;
+			photon->energies = malloc(sizeof(double));
+			photon->weight = malloc(sizeof(double));
+			photon_segmented->energies = malloc(sizeof(double));
+			photon_segmented->weight = malloc(sizeof(double));
+			photon->energies[0] = photon_segmented->energies[0] = 10.;
+			photon->weight[0] = photon_segmented->weight[0] = 1.;
+			photon->i_refl = photon_segmented->i_refl = 0;
+			polycap_photon_scatf(photon, &error);
+			polycap_photon_scatf(photon_segmented, &error);
+
+			//a conical wall is traced exactly in both cases, the segments approximate the curved ellipsoidal wall
+			test = polycap_capil_trace(&ix, photon, description, cap_axis, false, &error);
+			assert(test == 1);
+			assert(polycap_capil_trace(&ix_segmented, photon_segmented, description_segmented, cap_axis, false, &error) == 1);
+			assert(i == 1 || ix == ix_segmented);
+			assert(fabs(photon->exit_coords.z - photon_segmented->exit_coords.z) < (i == 0 ? 1.e-9 : 1.e-3));
+			assert(fabs(photon->exit_direction.x - photon_segmented->exit_direction.x) < (i == 0 ? 1.e-8 : 1.e-4));
+			assert(fabs(photon->exit_direction.y - photon_segmented->exit_direction.y) < (i == 0 ? 1.e-8 : 1.e-4));
+			polycap_photon_free(photon);
+			polycap_photon_free(photon_segmented);
+		}
+
+		polycap_description_free(description);
+		polycap_description_free(description_segmented);
+		polycap_profile_free(profile);
+		polycap_profile_free(segmented);
+	}
+}
+
+void test_polycap_capil_axis() {
+	polycap_capil_axis cap_axis;
+	double n_shells = 200., q_i = 12., r_i = -5.;
+	double ext = 0.35, z;
+
+	//central capillary always lies on the optic axis
+	cap_axis = polycap_capil_axis_new(n_shells, 0., 0.);
+	assert(cap_axis.x == 0.);
+	assert(cap_axis.y == 0.);
+
+	//axis coordinates scaled by the exterior radius should match the hexagonal lattice positions
+	cap_axis = polycap_capil_axis_new(n_shells, q_i, r_i);
+	z = ext/(2.*COSPI_6*(n_shells+1));
+	assert(cap_axis.x * (ext/cap_axis.z_div) == (2.* q_i+r_i) * COSPI_6 * z);
+	assert(cap_axis.y * (ext/cap_axis.z_div) == r_i * (3./2) * z);
 }
 
 int main(int argc, char *argv[]) {
@@ -505,6 +590,8 @@ int main(int argc, char *argv[]) {
 	test_polycap_refl_polar();
 	test_polycap_capil_reflect();
 	test_polycap_capil_trace();
+	test_polycap_capil_trace_analytic();
+	test_polycap_capil_axis();
 
 	return 0;
 }
@@ -63,6 +63,7 @@ void test_polycap_description_new() {
 	polycap_profile *profile;
 	polycap_error *error = NULL;
 	polycap_description *description;
+	int i;
 	double rad_ext_upstream = 0.2065;
 	double rad_ext_downstream = 0.0585;
 	double rad_int_upstream = 0.00035;
@@ -120,6 +121,13 @@ void test_polycap_description_new() {
 	assert(polycap_description_get_profile(description) == polycap_description_get_profile(description));
 	assert(profile != polycap_description_get_profile(description));
 
+	//the capillary lattice is precomputed: 200000 capillaries fill 258 shells
+	assert(description->geometry.n_shells == 258.);
+	assert(!description->geometry.monocap);
+	assert(description->geometry.z_div == 2.*COSPI_6*(258.+1));
+	for(i = 0; i <= description->profile->nmax; i++)
+		assert(description->geometry.hex_dist[i] == description->profile->ext[i]/(2.*COSPI_6*(258.+1)));
+
 	polycap_profile_free(profile);
 	polycap_description_free(description);
 }
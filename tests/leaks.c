@@ -126,6 +126,7 @@ void test_polycap_capil_leak() {
 	polycap_vector3 cap_coord0, cap_coord1, surface_norm;
 	polycap_vector3 phot_coord0, phot_coord1;
 	double *cap_x, *cap_y, z;
+	polycap_capil_axis cap_axis;
 	double r_i, q_i;
 	double alfa, rad0, rad1;
 	double n_shells;
@@ -590,13 +591,7 @@ void test_polycap_capil_leak() {
 		r_i = round(r_i);
 	}
 
-	cap_x = malloc(sizeof(double)*(description->profile->nmax+1));
-	cap_y = malloc(sizeof(double)*(description->profile->nmax+1));
-	for(i=0; i<=description->profile->nmax; i++){
-		z = description->profile->ext[i]/(2.*COSPI_6*(n_shells+1));
-		cap_x[i] = (2.* q_i+r_i) * COSPI_6 * z;
-		cap_y[i] = r_i * (3./2) * z;
-	}
+	cap_axis = polycap_capil_axis_new(n_shells, q_i, r_i);
         //calculate initial photon weight based on capillary channel effective solid angle.
 		//Mathematically, this is the cos of the angle between photon propagation and polycapillary-to-photonsource axis
 	weight = polycap_scalar(photon->start_direction,central_axis);
@@ -607,7 +602,7 @@ void test_polycap_capil_leak() {
 	assert(fabs(weight-0.997509) < 1e-5);
 	assert(fabs(photon->weight[0]-0.997509) < 1e-5);
 	for(i=0; i<=description->profile->nmax; i++){
-		iesc = polycap_capil_trace(ix, photon, description, cap_x, cap_y, true, &error);
+		iesc = polycap_capil_trace(ix, photon, description, cap_axis, true, &error);
 		if(iesc != 1){
 			break;
 		}	
@@ -618,11 +613,6 @@ void test_polycap_capil_leak() {
 	assert(photon->n_extleak == 0);
 	assert(photon->n_intleak == 0);
 
-	polycap_free(cap_x);
-	cap_x = NULL;
-	polycap_free(cap_y);
-	cap_y = NULL;
-
 	polycap_profile_free(profile);
 	polycap_description_free(description);
 	polycap_photon_free(photon);
@@ -741,8 +731,8 @@ void test_polycap_capil_trace_leak() {
 	double wi[2]={53.0,47.0};
 	polycap_photon *photon;
 	int ix_val = 0;
-	int *ix=&ix_val, i;
-	double *cap;
+	int *ix=&ix_val;
+	polycap_capil_axis cap_axis = {0., 0., 1.};
 
 	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., rad_ext_upstream, rad_ext_downstream, rad_int_upstream, rad_int_downstream, focal_dist_upstream, focal_dist_downstream, &error);
 	assert(profile != NULL);
@@ -776,20 +766,14 @@ void test_polycap_capil_trace_leak() {
 	polycap_photon_scatf(photon, &error);
 	polycap_clear_error(&error);
 
-	cap = malloc(sizeof(double)*1000);
-	assert(cap != NULL);
-	for(i=0; i< 1000; i++){
-		cap[i] = 0.;
-	}
-
 	//won't work
-	test = polycap_capil_trace(NULL, NULL, NULL, NULL, NULL, true, &error);
+	test = polycap_capil_trace(NULL, NULL, NULL, cap_axis, true, &error);
 	assert(test == -1);
 	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
 
 	//Should work, finds new reflection point
 	polycap_clear_error(&error);
-	test = polycap_capil_trace(ix, photon, description, cap, cap, true, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, true, &error);
 	assert(test == 0); //new reflection found, but weight is too low
 	assert(photon->weight[0] < 1.e-4);
 	assert(*ix == 0);
@@ -822,7 +806,7 @@ void test_polycap_capil_trace_leak() {
 	photon->exit_direction.x = 3.e-5;
 	photon->exit_direction.y = 3.e-5;
 	photon->exit_direction.z = 0.999;
-	test = polycap_capil_trace(ix, photon, description, cap, cap, true, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, true, &error);
 	assert(test == 1);
 	assert(fabs(photon->weight[0] - 0.999585 ) < 1.e-4);
 	assert(*ix == 552);
@@ -852,14 +836,13 @@ void test_polycap_capil_trace_leak() {
 	photon->energies[0] = energies;
 	photon->weight[0] = 1.0;
 	photon->i_refl = 0;
-	test = polycap_capil_trace(ix, photon, description, cap, cap, true, &error);
+	test = polycap_capil_trace(ix, photon, description, cap_axis, true, &error);
 	assert(test == -2);
 	assert(photon->i_refl == 0);
 
 	polycap_description_free(description);
 	polycap_profile_free(profile);
 	polycap_photon_free(photon);
-	free(cap);
 }
 
 void test_polycap_photon_leak() {
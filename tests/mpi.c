@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+#include "config.h"
+#include "polycap-private.h"
+#include <polycap-mpi.h>
+#ifdef NDEBUG
+  #undef NDEBUG
+#endif
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// to be run with mpiexec, with any amount of processes
+void test_polycap_source_get_transmission_efficiencies_mpi(bool leak_calc) {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies, *distributed;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	int n_photons = leak_calc ? 12 : 500;
+	int rank, i, k;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	//Something that shouldn't work
+	assert(!polycap_source_get_transmission_efficiencies_mpi(NULL, MPI_COMM_WORLD, 1, n_photons, 50, leak_calc, NULL, &distributed, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_source_get_transmission_efficiencies_mpi(source, MPI_COMM_WORLD, 1, 0, 50, leak_calc, NULL, &distributed, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_source_get_transmission_efficiencies_mpi(source, MPI_COMM_WORLD, 1, n_photons, 0, leak_calc, NULL, &distributed, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//distributed over all processes, in batches of unequal size
+	assert(polycap_source_set_seed(source, 12345, &error));
+	assert(polycap_source_get_transmission_efficiencies_mpi(source, MPI_COMM_WORLD, 1, n_photons, leak_calc ? 5 : 30, leak_calc, NULL, &distributed, &error));
+	if (rank != 0) {
+		assert(distributed == NULL);
+		polycap_source_free(source);
+		return;
+	}
+	assert(distributed != NULL);
+
+	//with a single thread, the photon events of the single simulation are stored in order of the photon index, as are those of the batches
+	efficiencies = polycap_source_get_transmission_efficiencies(source, 1, n_photons, leak_calc, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(distributed->images->i_start == efficiencies->images->i_start);
+	assert(distributed->images->i_exit == efficiencies->images->i_exit);
+	assert(distributed->images->i_extleak == efficiencies->images->i_extleak);
+	assert(distributed->images->i_intleak == efficiencies->images->i_intleak);
+	for(i=0; i < 7; i++){
+		assert(fabs(distributed->efficiencies[i] - efficiencies->efficiencies[i]) <= 1E-10);
+		assert(fabs(distributed->std_errors[i] - efficiencies->std_errors[i]) <= 1E-10);
+	}
+	for(i=0; i < efficiencies->images->i_exit; i++){
+		for(k=0; k < 3; k++){
+			assert(distributed->images->pc_start_coords[k][i] == efficiencies->images->pc_start_coords[k][i]);
+			assert(distributed->images->pc_exit_dir[k][i] == efficiencies->images->pc_exit_dir[k][i]);
+		}
+		assert(distributed->images->pc_exit_nrefl[i] == efficiencies->images->pc_exit_nrefl[i]);
+		assert(distributed->images->exit_coord_weights[i*7+6] == efficiencies->images->exit_coord_weights[i*7+6]);
+	}
+	for(i=0; i < efficiencies->images->i_extleak; i++){
+		assert(distributed->images->extleak_coords[2][i] == efficiencies->images->extleak_coords[2][i]);
+		assert(distributed->images->extleak_n_refl[i] == efficiencies->images->extleak_n_refl[i]);
+	}
+	for(i=0; i < efficiencies->images->i_intleak; i++){
+		assert(distributed->images->intleak_coords[2][i] == efficiencies->images->intleak_coords[2][i]);
+		assert(distributed->images->intleak_n_refl[i] == efficiencies->images->intleak_n_refl[i]);
+	}
+
+	polycap_transmission_efficiencies_free(distributed);
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_source_free(source);
+}
+
+int main(int argc, char *argv[]) {
+
+	MPI_Init(&argc, &argv);
+
+	test_polycap_source_get_transmission_efficiencies_mpi(false);
+	test_polycap_source_get_transmission_efficiencies_mpi(true);
+
+	MPI_Finalize();
+
+	return 0;
+}
@@ -191,6 +191,116 @@ void test_polycap_photon_within_pc_boundary() {
 
 }
 
+void test_polycap_photon_within_pc_boundary_batch() {
+	polycap_vector3 photon_coord;
+	double x[5] = {0.025, 0.075, 0.05, 0., -0.04};
+	double y[5] = {0.025, 0.025, 0.05, -0.04, 0.};
+	int inside[5];
+	int i;
+
+	//the batch variant agrees with polycap_photon_within_pc_boundary() point by point
+	assert(polycap_photon_within_pc_boundary_batch(polycap_hex_apothem(0.05), 5, x, y, inside) == 3);
+	for(i = 0; i < 5; i++){
+		photon_coord.x = x[i];
+		photon_coord.y = y[i];
+		photon_coord.z = 0;
+		assert(inside[i] == polycap_photon_within_pc_boundary(0.05, photon_coord, NULL));
+	}
+	assert(inside[0] == 1 && inside[1] == 0 && inside[2] == 0);
+
+	//nothing to check
+	assert(polycap_photon_within_pc_boundary_batch(polycap_hex_apothem(0.05), 0, x, y, inside) == 0);
+}
+
+void test_polycap_hex_round_batch() {
+	double x[4] = {0., 0.005, 2.*COSPI_6*0.01, -2.*COSPI_6*0.01-0.002};
+	double y[4] = {0., 0., 0., 0.001};
+	double q[4], r[4], d_axis[4];
+	double px, py, q_s, r_s, d_s, d_min, d;
+	int i, j, k;
+
+	assert(fabs(polycap_hex_round(0.01, COSPI_6*0.01, 0.015, &q_s, &r_s)) < 1e-10);
+	assert(q_s == 0. && r_s == 1.);
+
+	polycap_hex_round_batch(0.01, 4, x, y, q, r, d_axis);
+	assert(q[0] == 0. && r[0] == 0. && fabs(d_axis[0]) < 1e-10);
+	assert(q[1] == 0. && r[1] == 0. && fabs(d_axis[1] - 0.005) < 1e-10);
+	assert(q[2] == 1. && r[2] == 0. && fabs(d_axis[2]) < 1e-10);
+	assert(q[3] == -1. && r[3] == 0. && fabs(d_axis[3] - sqrt(0.002*0.002 + 0.001*0.001)) < 1e-10);
+
+	//the capillary found is the one with the nearest axis
+	for(i = 0; i < 1000; i++){
+		px = -0.04 + 0.08 * (i % 40) / 40. + 0.0001 * (i / 40);
+		py = -0.04 + 0.0008 * (i / 10) + 0.00003 * i;
+		d_s = polycap_hex_round(0.01, px, py, &q_s, &r_s);
+		d_min = 1.;
+		for(j = -5; j <= 5; j++){
+			for(k = -5; k <= 5; k++){
+				d = sqrt((px - (2.*j+k)*COSPI_6*0.01)*(px - (2.*j+k)*COSPI_6*0.01) + (py - k*1.5*0.01)*(py - k*1.5*0.01));
+				if(d < d_min)
+					d_min = d;
+			}
+		}
+		assert(fabs(d_s - d_min) < 1e-10);
+	}
+}
+
+void test_polycap_photon_pc_intersect() {
+	polycap_error *error = NULL; //this has to be set to NULL before feeding to the function!
+	polycap_profile *profile;
+	polycap_vector3 photon_coord, photon_direction, intersection;
+	double ext[901], cap[901], z[901];
+	int i;
+
+	//straight optic with external radius 0.1, 9 cm long
+	for(i = 0; i <= 900; i++){
+		ext[i] = 0.1;
+		cap[i] = 0.001;
+		z[i] = i * 0.01;
+	}
+	profile = polycap_profile_new_from_arrays(900, ext, cap, z, &error);
+	assert(profile != NULL);
+
+	//photon at the exit window, outside of the optic, that left it through its side wall at Z = 7.95
+	photon_coord.x = 0.1105;
+	photon_coord.y = 0.;
+	photon_coord.z = 9.;
+	photon_direction.x = 0.01;
+	photon_direction.y = 0.;
+	photon_direction.z = 1.;
+
+	//won't work
+	assert(!polycap_photon_pc_intersect(photon_coord, photon_direction, NULL, &intersection, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_photon_pc_intersect(photon_coord, photon_direction, profile, NULL, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	photon_direction.z = 0.;
+	assert(!polycap_photon_pc_intersect(photon_coord, photon_direction, profile, &intersection, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	photon_direction.z = 1.;
+	photon_coord.x = 0.05; //inside of the optic
+	assert(!polycap_photon_pc_intersect(photon_coord, photon_direction, profile, &intersection, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//should work: the intersection is on the photon path, within a segment of the side wall crossing
+	photon_coord.x = 0.1105;
+	assert(polycap_photon_pc_intersect(photon_coord, photon_direction, profile, &intersection, &error));
+	assert(fabs(intersection.z - 7.95) <= 0.01 + 1.e-9);
+	assert(fabs(intersection.x - (0.1105 - 0.01 * (9. - intersection.z))) < 1.e-9);
+	assert(fabs(intersection.y) < 1.e-9);
+
+	//the photon path never crossed the optic
+	photon_direction.x = -0.01;
+	assert(!polycap_photon_pc_intersect(photon_coord, photon_direction, profile, &intersection, &error));
+	assert(error == NULL);
+
+	polycap_profile_free(profile);
+}
+
 void test_polycap_photon_launch() {
 	polycap_error *error = NULL; //this has to be set to NULL before feeding to the function!
 	double *weights;
@@ -359,12 +469,194 @@ void test_polycap_photon_launch() {
 	polycap_profile_free(profile);
 }
 
+void test_polycap_photon_launch_with_buffers() {
+	polycap_error *error = NULL; //this has to be set to NULL before feeding to the function!
+	double energies[2] = {10.0, 20.0};
+	double weights[2], *weights_single;
+	double *amu;
+	polycap_photon *photon, *photon_single;
+	polycap_vector3 start_coords, start_direction, start_electric_vector;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	int test, test_single;
+	polycap_profile *profile;
+	polycap_description *description;
+	double rad_ext_upstream = 0.2065;
+	double rad_ext_downstream = 0.0585;
+	double rad_int_upstream = 0.00035;
+	double rad_int_downstream = 9.9153E-5;
+	double focal_dist_upstream = 1000.0;
+	double focal_dist_downstream = 0.5;
+
+	start_coords.x = 0.;
+	start_coords.y = 0.;
+	start_coords.z = 0.;
+	start_direction.x = 0.005;
+	start_direction.y = -0.005;
+	start_direction.z = 0.1;
+	start_electric_vector.x = 0.5;
+	start_electric_vector.y = 0.5;
+	start_electric_vector.z = 0.;
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., rad_ext_upstream, rad_ext_downstream, rad_int_upstream, rad_int_downstream, focal_dist_upstream, focal_dist_downstream, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	photon = polycap_photon_new(description, start_coords, start_direction, start_electric_vector, &error);
+	assert(photon != NULL);
+
+	//This should not work
+	test = polycap_photon_launch_with_buffers(NULL, 2, energies, weights, false, &error);
+	assert(test == -1);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	test = polycap_photon_launch_with_buffers(photon, 2, energies, NULL, false, &error);
+	assert(test == -1);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	start_direction.z = -1.;
+	assert(polycap_photon_set_start(photon, start_coords, start_direction, start_electric_vector, &error) == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+
+	//This should work and keep the photon buffers
+	polycap_clear_error(&error);
+	test = polycap_photon_launch_with_buffers(photon, 2, energies, weights, false, &error);
+	assert(test == 0);
+	assert(photon->n_energies == 2);
+	assert(photon->amu != NULL);
+	assert(photon->scatf != NULL);
+	amu = photon->amu;
+
+	//relaunch along the central axis: the buffers are reused and the photon reaches the end of the capillary
+	start_direction.x = 0.;
+	start_direction.y = 0.;
+	start_direction.z = 1.;
+	assert(polycap_photon_set_start(photon, start_coords, start_direction, start_electric_vector, &error) == true);
+	test = polycap_photon_launch_with_buffers(photon, 2, energies, weights, false, &error);
+	assert(test == 1);
+	assert(photon->amu == amu);
+
+	//results should be identical to those of polycap_photon_launch()
+	photon_single = polycap_photon_new(description, start_coords, start_direction, start_electric_vector, &error);
+	assert(photon_single != NULL);
+	test_single = polycap_photon_launch(photon_single, 2, energies, &weights_single, false, &error);
+	assert(test_single == test);
+	assert(fabs(weights_single[0] - weights[0]) < 1.e-10);
+	assert(fabs(weights_single[1] - weights[1]) < 1.e-10);
+	assert(photon_single->i_refl == photon->i_refl);
+	polycap_free(weights_single);
+	polycap_photon_free(photon_single);
+
+	//different energies require new attenuation coefficients
+	energies[1] = 30.0;
+	test = polycap_photon_launch_with_buffers(photon, 2, energies, weights, false, &error);
+	assert(test == 1);
+	assert(photon->energies[1] == 30.0);
+
+	polycap_photon_free(photon);
+	polycap_description_free(description);
+	polycap_profile_free(profile);
+}
+
+void test_polycap_photon_launch_batch() {
+	polycap_error *error = NULL; //this has to be set to NULL before feeding to the function!
+	double energies[2] = {10.0, 20.0};
+	double *weights_single;
+	polycap_photon *photon;
+	polycap_vector3 start_coords[3], start_direction[3], start_electric_vector[3];
+	polycap_vector3 exit_coords[3], exit_direction[3], exit_electric_vector[3];
+	int64_t n_refl[3];
+	double d_travel[3], weights[3*2];
+	int launch_status[3];
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	int i, j, test;
+	bool rv;
+	polycap_profile *profile;
+	polycap_description *description;
+	double rad_ext_upstream = 0.2065;
+	double rad_ext_downstream = 0.0585;
+	double rad_int_upstream = 0.00035;
+	double rad_int_downstream = 9.9153E-5;
+	double focal_dist_upstream = 1000.0;
+	double focal_dist_downstream = 0.5;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., rad_ext_upstream, rad_ext_downstream, rad_int_upstream, rad_int_downstream, focal_dist_upstream, focal_dist_downstream, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+
+	//photon absorbed, photon transmitted and photon hitting the capillary wall at the entrance
+	for(i = 0; i < 3; i++){
+		start_coords[i].x = 0.;
+		start_coords[i].y = 0.;
+		start_coords[i].z = 0.;
+		start_direction[i].x = 0.;
+		start_direction[i].y = 0.;
+		start_direction[i].z = 1.;
+		start_electric_vector[i].x = 0.5;
+		start_electric_vector[i].y = 0.5;
+		start_electric_vector[i].z = 0.;
+	}
+	start_direction[0].x = 0.005;
+	start_direction[0].y = -0.005;
+	start_direction[0].z = 0.1;
+	start_coords[2].x = 0.15104418;
+	start_coords[2].y = 0.087000430;
+
+	//This should not work
+	rv = polycap_photon_launch_batch(NULL, 1, 3, start_coords, start_direction, start_electric_vector, 2, energies, false, launch_status, exit_coords, exit_direction, exit_electric_vector, n_refl, d_travel, weights, &error);
+	assert(rv == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	rv = polycap_photon_launch_batch(description, 1, 3, start_coords, start_direction, start_electric_vector, 2, energies, false, launch_status, exit_coords, exit_direction, exit_electric_vector, n_refl, d_travel, NULL, &error);
+	assert(rv == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+
+	//This should work
+	polycap_clear_error(&error);
+	rv = polycap_photon_launch_batch(description, -1, 3, start_coords, start_direction, start_electric_vector, 2, energies, false, launch_status, exit_coords, exit_direction, exit_electric_vector, n_refl, d_travel, weights, &error);
+	assert(rv == true);
+	assert(launch_status[0] == 0);
+	assert(launch_status[1] == 1);
+	assert(launch_status[2] == 2);
+	assert(weights[2*2] == 0.);
+	assert(weights[2*2+1] == 0.);
+
+	//results should be identical to those of polycap_photon_launch()
+	for(i = 0; i < 3; i++){
+		photon = polycap_photon_new(description, start_coords[i], start_direction[i], start_electric_vector[i], &error);
+		assert(photon != NULL);
+		test = polycap_photon_launch(photon, 2, energies, &weights_single, false, &error);
+		polycap_clear_error(&error);
+		assert(test == launch_status[i]);
+		assert(photon->i_refl == n_refl[i]);
+		assert(fabs(photon->exit_coords.x - exit_coords[i].x) < 1.e-10);
+		assert(fabs(photon->exit_coords.y - exit_coords[i].y) < 1.e-10);
+		assert(fabs(photon->exit_coords.z - exit_coords[i].z) < 1.e-10);
+		assert(fabs(photon->exit_direction.z - exit_direction[i].z) < 1.e-10);
+		if (test == 0 || test == 1) {
+			for(j = 0; j < 2; j++)
+				assert(fabs(weights_single[j] - weights[i*2+j]) < 1.e-10);
+		}
+		polycap_free(weights_single);
+		polycap_photon_free(photon);
+	}
+
+	polycap_description_free(description);
+	polycap_profile_free(profile);
+}
+
 int main(int argc, char *argv[]) {
 
 	test_polycap_photon_scatf();
 	test_polycap_photon_new();
 	test_polycap_photon_within_pc_boundary();
+	test_polycap_photon_within_pc_boundary_batch();
+	test_polycap_hex_round_batch();
+	test_polycap_photon_pc_intersect();
 	test_polycap_photon_launch();
+	test_polycap_photon_launch_with_buffers();
+	test_polycap_photon_launch_batch();
 
 	return 0;
 }
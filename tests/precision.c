@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Pieter Tack, Tom Schoonjans and Laszlo Vincze
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * */
+
+#include "config.h"
+#include <polycap-source.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+//===========================================
+// traces the photons of source with a fixed seed in the requested precision, returning the efficiencies and their standard errors
+static bool precision_trace(polycap_source *source, bool single_precision, int n_photons, size_t *n_energies, double **energies, double **effs, double **std_errors, double *time)
+{
+	polycap_transmission_efficiencies *efficiencies;
+	polycap_error *error = NULL;
+	double start;
+
+	if (!polycap_source_set_single_precision(source, single_precision, &error) || !polycap_source_set_seed(source, 12345, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return false;
+	}
+	start = omp_get_wtime();
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, n_photons, false, NULL, &error);
+	*time = omp_get_wtime() - start;
+	if (efficiencies == NULL ||
+		!polycap_transmission_efficiencies_get_data(efficiencies, n_energies, energies, effs, &error) ||
+		!polycap_transmission_efficiencies_get_std_errors(efficiencies, n_energies, std_errors, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		return false;
+	}
+	polycap_transmission_efficiencies_free(efficiencies);
+	return true;
+}
+
+//===========================================
+//call example: ./precision ellip_l9.inp 10000
+// compares the transmission efficiencies and timings of the simulation of an input file in double and single precision, see polycap_source_set_single_precision()
+// 	both simulations use the same seed, so the efficiencies should agree within their standard errors: fails otherwise
+int main(int argc, char *argv[])
+{
+	polycap_source *source;
+	polycap_error *error = NULL;
+	int n_photons = 10000;
+	size_t n_energies, i;
+	double *energies, *effs_double, *effs_single, *errors_double, *errors_single;
+	double time_double, time_single, n_sigma;
+	int rv = 0;
+
+	if(argc < 2){
+		printf("Usage: precision input-file [#photons]\n");
+		return 1;
+	}
+	if(argc >= 3)
+		n_photons = atoi(argv[2]);
+
+	source = polycap_source_new_from_file(argv[1], &error);
+	if (source == NULL) {
+		fprintf(stderr, "%s\n", error->message);
+		return 1;
+	}
+	if (!precision_trace(source, false, n_photons, &n_energies, &energies, &effs_double, &errors_double, &time_double))
+		return 1;
+	free(energies);
+	if (!precision_trace(source, true, n_photons, &n_energies, &energies, &effs_single, &errors_single, &time_single))
+		return 1;
+
+	printf("%s: %i photons\n", argv[1], n_photons);
+	printf("Energy [keV]\tDouble\t\t\tSingle\t\t\tDifference [sigma]\n");
+	for(i=0; i < n_energies; i++){
+		n_sigma = 0.;
+		if(errors_double[i] > 0. || errors_single[i] > 0.)
+			n_sigma = fabs(effs_single[i] - effs_double[i])/sqrt(errors_double[i]*errors_double[i] + errors_single[i]*errors_single[i]);
+		else if(effs_single[i] != effs_double[i])
+			n_sigma = INFINITY;
+		printf("%lf\t%lf +- %lf\t%lf +- %lf\t%lf\n", energies[i], effs_double[i], errors_double[i], effs_single[i], errors_single[i], n_sigma);
+		if(n_sigma > 3.)
+			rv = 1;
+	}
+	printf("Time [s]\t%lf\t\t%lf\n", time_double, time_single);
+
+	free(energies);
+	free(effs_double);
+	free(effs_single);
+	free(errors_double);
+	free(errors_single);
+	polycap_source_free(source);
+
+	return rv;
+}
@@ -20,6 +20,12 @@
 #endif
 #include <assert.h>
 #include <stddef.h>
+#include <math.h>
+#ifdef HAVE__UNLINK
+  #include <stdio.h>
+#elif defined(HAVE_UNLINK)
+  #include <unistd.h>
+#endif
 
 void test_profile_new() {
 	// first test some cases that are expected to fail
@@ -144,6 +150,12 @@ void test_profile_new_from_array_and_get() {
 		assert(cap[i] == profile->cap[i]);
 		assert(z[i] == profile->z[i]);
 	}
+	// precomputed segment coefficients should match the profile arrays
+	assert(profile->segments != NULL);
+	for(i=0; i<profile->nmax; i++){
+		assert(profile->segments[i].dz == z[i+1] - z[i]);
+		assert(profile->segments[i].rad_slope == (cap[i+1] - cap[i])/(z[i+1] - z[i]));
+	}
 	
 	// free memory
 	polycap_clear_error(&error);
@@ -153,11 +165,141 @@ void test_profile_new_from_array_and_get() {
 	polycap_free(z);
 }
 
+void test_profile_binary() {
+	polycap_profile *profile, *binary_profile;
+	polycap_description *description;
+	polycap_error *error = NULL;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double ext0;
+	int i;
+
+	// cases that are expected to fail
+	assert(polycap_profile_new_from_binary_file(NULL, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_profile_new_from_binary_file("this-file-does-not-exist", &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_IO));
+	polycap_clear_error(&error);
+	// an ASCII profile file is not a binary profile file
+	assert(polycap_profile_new_from_binary_file(EXAMPLE_DIR"xos1.prf", &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_IO));
+	polycap_clear_error(&error);
+	assert(polycap_profile_write_binary(NULL, "temp_profile.pcp", &error) == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	// convert the ASCII profile files to a binary profile file
+	profile = polycap_profile_new_from_file(EXAMPLE_DIR"xos1.prf", EXAMPLE_DIR"xos1.axs", EXAMPLE_DIR"xos1.ext", &error);
+	assert(profile != NULL);
+	assert(polycap_profile_write_binary(profile, "temp_profile.pcp", &error));
+	binary_profile = polycap_profile_new_from_binary_file("temp_profile.pcp", &error);
+	assert(binary_profile != NULL);
+	assert(binary_profile->mapping != NULL);
+	assert(binary_profile->nmax == profile->nmax);
+	for(i=0; i<=profile->nmax; i++){
+		assert(binary_profile->z[i] == profile->z[i]);
+		assert(binary_profile->cap[i] == profile->cap[i]);
+		assert(binary_profile->ext[i] == profile->ext[i]);
+	}
+	for(i=0; i<profile->nmax; i++){
+		assert(binary_profile->segments[i].dz == profile->segments[i].dz);
+		assert(binary_profile->segments[i].rad_slope == profile->segments[i].rad_slope);
+	}
+	ext0 = profile->ext[0];
+	polycap_profile_free(profile);
+
+	// a description shares the mapping, which remains valid after the profile is freed
+	description = polycap_description_new(binary_profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	assert(description->profile->mapping == binary_profile->mapping);
+	assert(binary_profile->mapping->refcount == 2);
+	polycap_profile_free(binary_profile);
+	assert(description->profile->mapping->refcount == 1);
+	assert(description->profile->ext[0] == ext0);
+	assert(description->profile->segments != NULL);
+	polycap_description_free(description);
+
+#ifdef HAVE__UNLINK
+	_unlink("temp_profile.pcp"); // cleanup
+#elif defined(HAVE_UNLINK)
+	unlink("temp_profile.pcp"); // cleanup
+#endif
+}
+
+void test_profile_compact() {
+	polycap_profile *profile, *compacted;
+	polycap_error *error = NULL;
+	double tolerance = 1E-4;
+	double cap, ext, z;
+	int i, j, z_id;
+
+	// cases that are expected to fail
+	profile = polycap_profile_new(POLYCAP_PROFILE_CONICAL, 6., 0.5, 0.25, 0.0005, 0.0002, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	assert(polycap_profile_compact(NULL, tolerance, &error) == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_profile_compact(profile, -1.0, &error) == false);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	// a conical profile is a single straight segment
+	assert(polycap_profile_compact(profile, tolerance, &error));
+	assert(profile->nmax == 1);
+	assert(profile->nmax_trace == 999);
+	assert(profile->z[0] == 0.0);
+	assert(profile->z[1] == 6.0);
+	assert(profile->ext[0] == 0.5);
+	assert(profile->ext[1] == 0.25);
+	assert(profile->segments[0].dz == 6.0);
+	polycap_profile_free(profile);
+
+	// compacting an ellipsoidal profile removes points while staying within tolerance
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	compacted = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(compacted != NULL);
+	assert(polycap_profile_compact(compacted, tolerance, &error));
+	assert(compacted->nmax > 1);
+	assert(compacted->nmax < profile->nmax);
+	assert(compacted->nmax_trace == profile->nmax);
+	assert(compacted->z[0] == profile->z[0]);
+	assert(compacted->z[compacted->nmax] == profile->z[profile->nmax]);
+	for(i=0; i<compacted->nmax; i++)
+		assert(compacted->z[i] < compacted->z[i+1]);
+	for(i=0; i<=profile->nmax; i++){
+		z_id = polycap_profile_find_segment(compacted, profile->z[i], compacted->nmax-1, 0);
+		z = profile->z[i] - compacted->z[z_id];
+		cap = compacted->cap[z_id] + compacted->segments[z_id].rad_slope * z;
+		ext = compacted->ext[z_id] + (compacted->ext[z_id+1] - compacted->ext[z_id])/compacted->segments[z_id].dz * z;
+		assert(fabs(cap - profile->cap[i]) <= tolerance * profile->cap[i] * (1. + 1E-9));
+		assert(fabs(ext - profile->ext[i]) <= tolerance * profile->ext[i] * (1. + 1E-9));
+	}
+	polycap_profile_free(compacted);
+
+	// the segment lookup matches a linear scan over the segments
+	for(i=-1; i<=2*profile->nmax+1; i++){
+		z = 9. * i / (2.*profile->nmax);
+		z_id = -1;
+		for(j=0; j<profile->nmax; j++){
+			if(profile->z[j] <= z)
+				z_id = j;
+		}
+		assert(polycap_profile_find_segment(profile, z, profile->nmax-1, -1) == z_id);
+	}
+	for(i=0; i<=profile->nmax; i++)
+		assert(polycap_profile_find_segment(profile, profile->z[i], profile->nmax, -1) == i);
+	polycap_profile_free(profile);
+}
+
 int main(int argc, char *argv[]) {
 
 	test_profile_new();
 	test_profile_new_from_file();
 	test_profile_new_from_array_and_get();
+	test_profile_binary();
+	test_profile_compact();
 
 	return 0;
 }
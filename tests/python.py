@@ -15,6 +15,7 @@ import polycap
 import numpy as np
 import os
 import sys
+import threading
 from collections import namedtuple
 import logging
 #import matplotlib.pyplot as plt
@@ -63,6 +64,37 @@ class TestPolycapProfile(unittest.TestCase):
         profile = polycap.Profile.new_from_arrays(np.linspace(TestPolycapProfile.rad_ext_upstream, TestPolycapProfile.rad_ext_downstream, 1000), np.linspace(TestPolycapProfile.rad_int_upstream, TestPolycapProfile.rad_int_downstream, 1000), np.linspace(0., 6., 1000))
         self.assertIsInstance(profile, polycap.Profile)
 
+    def test_profile_binary(self):
+        with self.assertRaises(IOError):
+            profile = polycap.Profile.new_from_binary_file("this-file-does-not-exist")
+        profile = polycap.Profile(polycap.Profile.ELLIPSOIDAL, 6., TestPolycapProfile.rad_ext_upstream, TestPolycapProfile.rad_ext_downstream, TestPolycapProfile.rad_int_upstream, TestPolycapProfile.rad_int_downstream, TestPolycapProfile.focal_dist_upstream, TestPolycapProfile.focal_dist_downstream)
+        profile.write_binary("temp_profile.pcp")
+        binary_profile = polycap.Profile.new_from_binary_file("temp_profile.pcp")
+        self.assertIsInstance(binary_profile, polycap.Profile)
+        np.testing.assert_array_equal(binary_profile.get_ext, profile.get_ext)
+        np.testing.assert_array_equal(binary_profile.get_cap, profile.get_cap)
+        np.testing.assert_array_equal(binary_profile.get_z, profile.get_z)
+        del binary_profile
+        os.remove("temp_profile.pcp")
+
+    def test_profile_set_analytic_tracing(self):
+        profile = polycap.Profile(polycap.Profile.ELLIPSOIDAL, 6., TestPolycapProfile.rad_ext_upstream, TestPolycapProfile.rad_ext_downstream, TestPolycapProfile.rad_int_upstream, TestPolycapProfile.rad_int_downstream, TestPolycapProfile.focal_dist_upstream, TestPolycapProfile.focal_dist_downstream)
+        profile.set_analytic_tracing(True)
+        profile.set_analytic_tracing(False)
+        profile = polycap.Profile.new_from_arrays(profile.get_ext, profile.get_cap, profile.get_z)
+        with self.assertRaises(NotImplementedError):
+            profile.set_analytic_tracing(True)
+
+    def test_profile_compact(self):
+        profile = polycap.Profile(polycap.Profile.ELLIPSOIDAL, 6., TestPolycapProfile.rad_ext_upstream, TestPolycapProfile.rad_ext_downstream, TestPolycapProfile.rad_int_upstream, TestPolycapProfile.rad_int_downstream, TestPolycapProfile.focal_dist_upstream, TestPolycapProfile.focal_dist_downstream)
+        z = profile.get_z
+        with self.assertRaises(ValueError):
+            profile.compact(-1.0)
+        profile.compact(1E-4)
+        self.assertLess(profile.get_z.size, z.size)
+        self.assertEqual(profile.get_z[0], z[0])
+        self.assertEqual(profile.get_z[-1], z[-1])
+
 class TestPolycapDescription(unittest.TestCase):
     rad_ext_upstream = 0.2065
     rad_ext_downstream = 0.0585
@@ -189,12 +221,52 @@ class TestPolycapPhoton(unittest.TestCase):
         self.assertAlmostEqual(intleaks[2].direction.y, 0., delta=1e-6)
         self.assertAlmostEqual(intleaks[2].direction.z, 0.999981, delta=1e-6)
         self.assertAlmostEqual(intleaks[2].weight[0], 0.000142, delta=1e-6)
+        # columnar access to the same leak data
+        extleak_arrays = photon.extleak_arrays
+        self.assertIsInstance(extleak_arrays, polycap.LeakArrays)
+        self.assertEqual(extleak_arrays.coords.shape, (2, 3))
+        self.assertEqual(extleak_arrays.weights.shape, (2, 1))
+        for i in range(2):
+            np.testing.assert_array_equal(extleak_arrays.coords[i], extleaks[i].coords)
+            np.testing.assert_array_equal(extleak_arrays.direction[i], extleaks[i].direction)
+            np.testing.assert_array_equal(extleak_arrays.weights[i], extleaks[i].weight)
+            self.assertEqual(extleak_arrays.n_refl[i], extleaks[i].n_refl)
+        intleak_arrays = photon.intleak_arrays
+        self.assertEqual(intleak_arrays.elecv.shape, (3, 3))
+        for i in range(3):
+            np.testing.assert_array_equal(intleak_arrays.coords[i], intleaks[i].coords)
+            np.testing.assert_array_equal(intleak_arrays.elecv[i], intleaks[i].elecv)
         self.assertIsInstance(weights, np.ndarray)
         self.assertIsInstance(photon.get_exit_coords, VectorTuple)
         self.assertIsInstance(photon.get_exit_direction, VectorTuple)
         self.assertIsInstance(photon.get_exit_electric_vector, VectorTuple)
         del photon
 
+    def test_photon_launch_batch(self):
+        start_coords = np.array([(0., 0., 0.), (0.15104418, 0.087000430, 0.), (0.0585, 0., 0.)])
+        start_directions = np.array([(0., 0., 1.), (0., 0., 1.), (0.001, 0., 1.)])
+        start_electric_vectors = np.array([(0.5, 0.5, 0.), (0.5, 0.5, 0.), (0.5, 0.5, 0.)])
+        energies = np.linspace(1., 25., 10)
+        result = TestPolycapPhoton.description.launch_batch(start_coords, start_directions, start_electric_vectors, energies)
+        self.assertIsInstance(result, polycap.LaunchBatchTuple)
+        self.assertEqual(result.exit_coords.shape, (3, 3))
+        self.assertEqual(result.weights.shape, (3, 10))
+        self.assertEqual(result.status[1], 2)
+        # compare with single photon launches
+        for i in (0, 2):
+            photon = polycap.Photon(TestPolycapPhoton.description, tuple(start_coords[i]), tuple(start_directions[i]), tuple(start_electric_vectors[i]))
+            weights = photon.launch(energies)
+            self.assertEqual(result.status[i], 1)
+            np.testing.assert_allclose(result.weights[i], weights)
+            np.testing.assert_allclose(result.exit_coords[i], photon.exit_coords)
+            np.testing.assert_allclose(result.exit_direction[i], photon.exit_direction)
+            self.assertEqual(result.n_refl[i], photon.i_refl)
+            self.assertAlmostEqual(result.d_travel[i], photon.d_travel)
+        with self.assertRaises(ValueError):
+            TestPolycapPhoton.description.launch_batch(start_coords[:, :2], start_directions, start_electric_vectors, energies)
+        with self.assertRaises(ValueError):
+            TestPolycapPhoton.description.launch_batch(start_coords, start_directions[:2], start_electric_vectors, energies)
+
 class TestPolycapSource(unittest.TestCase):
     rng = polycap.Rng()
 
@@ -253,7 +325,34 @@ class TestPolycapSource(unittest.TestCase):
         self.assertIsInstance(n_refl[0], int)
         self.assertIsInstance(exit_weights[0], np.ndarray)
         self.assertIsInstance(d_travel[0], float)
-        
+
+        # the array views should refer to the same data as the generators
+        exit_coords_array = efficiencies.exit_coords_array
+        self.assertEqual(exit_coords_array.shape, (10000, 3))
+        self.assertFalse(exit_coords_array.flags.writeable)
+        np.testing.assert_array_equal(exit_coords_array, np.array(exit_coords))
+        np.testing.assert_array_equal(efficiencies.exit_direction_array, np.array(exit_direction))
+        np.testing.assert_array_equal(efficiencies.exit_elecv_array, np.array(exit_elecv))
+        np.testing.assert_array_equal(efficiencies.start_coords_array, np.array(start_coords))
+        np.testing.assert_array_equal(efficiencies.start_direction_array, np.array(start_direction))
+        np.testing.assert_array_equal(efficiencies.start_elecv_array, np.array(start_elecv))
+        np.testing.assert_array_equal(efficiencies.src_start_coords_array, np.array(src_start_coords))
+        np.testing.assert_array_equal(efficiencies.n_refl_array, np.array(n_refl))
+        np.testing.assert_array_equal(efficiencies.d_travel_array, np.array(d_travel))
+        exit_weights_array = efficiencies.exit_weights_array
+        self.assertEqual(exit_weights_array.shape, (10000, 250))
+        np.testing.assert_array_equal(exit_weights_array, np.array(exit_weights))
+        with self.assertRaises(ValueError):
+            exit_weights_array[0, 0] = 6
+        self.assertIs(exit_coords_array.base, efficiencies)
+        # no leak events were simulated
+        extleak_arrays = efficiencies.extleak_arrays
+        self.assertEqual(extleak_arrays.coords.shape, (0, 3))
+        self.assertEqual(extleak_arrays.weights.shape, (0, 250))
+        self.assertEqual(efficiencies.intleak_arrays.n_refl.shape, (0,))
+        del(exit_coords_array)
+        del(exit_weights_array)
+
         self.assertEqual(sys.getrefcount(data[0]), 4)
 
         #fig = plt.figure()
@@ -297,6 +396,168 @@ class TestPolycapSource(unittest.TestCase):
 
         del(efficiencies)
 
+    def test_source_get_transmission_efficiencies_threaded(self):
+        # the GIL is released during the simulations, so these should be able to run concurrently
+        sources = [polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10)) for i in range(2)]
+        efficiencies = [None, None]
+        progress = [[], []]
+        def simulate(i):
+            efficiencies[i] = sources[i].get_transmission_efficiencies(2, 1000, leak_calc=False, progress_callback=progress[i].append)
+        threads = [threading.Thread(target=simulate, args=(i,)) for i in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for i in range(2):
+            self.assertIsInstance(efficiencies[i], polycap.TransmissionEfficiencies)
+            self.assertEqual(efficiencies[i].data[1].size, 10)
+            self.assertGreater(len(progress[i]), 1)
+            self.assertEqual(progress[i], sorted(progress[i]))
+            self.assertEqual(progress[i][-1], 1.)
+
+        with self.assertRaises(TypeError):
+            sources[0].get_transmission_efficiencies(2, 1000, progress_callback="not callable")
+
+    def test_source_get_transmission_efficiencies_converged(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        with self.assertRaises(ValueError):
+            source.get_transmission_efficiencies_converged(-1, 30000, 0.0)
+        with self.assertRaises(ValueError):
+            source.get_transmission_efficiencies_converged(-1, 30000, 0.05, selected_energies=[10])
+        with self.assertRaises(ValueError):
+            source.get_transmission_efficiencies_converged(-1, 30000, 0.05, selected_energies=[-1])
+        efficiencies = source.get_transmission_efficiencies_converged(-1, 30000, 0.05, selected_energies=[2])
+        self.assertLess(len(efficiencies.exit_coords_array), 30000)
+        uncertainties = efficiencies.uncertainties
+        self.assertEqual(uncertainties.shape, efficiencies.data[1].shape)
+        self.assertGreater(uncertainties[2], 0.)
+        self.assertLessEqual(uncertainties[2], 0.06)
+        with self.assertRaises(ValueError):
+            uncertainties[0] = 0.
+
+        # regular simulations provide uncertainties as well
+        efficiencies = source.get_transmission_efficiencies(-1, 1000)
+        self.assertTrue(np.all(efficiencies.uncertainties[efficiencies.data[1] > 0.] > 0.))
+
+    def test_source_std_errors(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        efficiencies = source.get_transmission_efficiencies(-1, 2000)
+        std_errors = efficiencies.std_errors
+        self.assertEqual(std_errors.shape, (10,))
+        self.assertTrue(np.all(std_errors >= 0.))
+        mask = efficiencies.data[1] > 0.
+        self.assertTrue(np.allclose(std_errors[mask], efficiencies.uncertainties[mask] * efficiencies.data[1][mask]))
+        with self.assertRaises(ValueError):
+            std_errors[0] = 0.
+
+    def test_source_reweight(self):
+        energies = np.linspace(1, 25.0, 10)
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, energies)
+        efficiencies = source.get_transmission_efficiencies(-1, 100)
+        with self.assertRaises(ValueError):
+            efficiencies.reweight(energies)
+
+        source.set_record_histories(True)
+        efficiencies = source.get_transmission_efficiencies(-1, 1000)
+        with self.assertRaises(ValueError):
+            efficiencies.reweight([150.0])
+        reweighted = efficiencies.reweight(energies)
+        self.assertTrue(np.allclose(reweighted.efficiencies, efficiencies.data[1], rtol=0., atol=1E-10))
+        self.assertEqual(reweighted.weights.shape, (1000, 10))
+        self.assertTrue(np.allclose(reweighted.weights, efficiencies.exit_weights_array, rtol=0., atol=1E-10))
+        reweighted = efficiencies.reweight(energies[[2, 5]])
+        self.assertTrue(np.allclose(reweighted.efficiencies, efficiencies.data[1][[2, 5]], rtol=0., atol=1E-10))
+        self.assertEqual(reweighted.weights.shape, (1000, 2))
+
+        description_si = polycap.Description(TestPolycapDescription.profile, 0.0, 200000, {"Si": 100.0}, 2.33)
+        with self.assertRaises(TypeError):
+            efficiencies.reweight_materials([TestPolycapPhoton.description, None])
+        with self.assertRaises(ValueError):
+            efficiencies.reweight_materials([])
+        variant_efficiencies = efficiencies.reweight_materials([TestPolycapPhoton.description, description_si])
+        self.assertEqual(variant_efficiencies.shape, (2, 10))
+        self.assertTrue(np.allclose(variant_efficiencies[0], efficiencies.data[1], rtol=0., atol=1E-10))
+        self.assertTrue(np.allclose(variant_efficiencies[1], efficiencies.reweight(energies, description_si).efficiencies, rtol=0., atol=1E-10))
+
+    def test_source_single_precision(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        source.set_seed(12345)
+        efficiencies = source.get_transmission_efficiencies(-1, 1000)
+        source.set_single_precision(True)
+        efficiencies_single = source.get_transmission_efficiencies(-1, 1000)
+        self.assertTrue(np.all(np.abs(efficiencies_single.data[1] - efficiencies.data[1]) <= 3. * np.sqrt(efficiencies.std_errors ** 2 + efficiencies_single.std_errors ** 2)))
+
+    def test_source_sweep(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        with self.assertRaises(ValueError):
+            source.sweep(np.zeros((2, 5)), 500)
+        with self.assertRaises(ValueError):
+            source.sweep([[-1.0, 0.2065, 0.2065, 0.0, 0.0, 0.0]], 500)
+
+        source.set_seed(12345)
+        efficiencies = source.get_transmission_efficiencies(-1, 500)
+        points = [[2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0], [2000.0, 0.2065, 0.2065, 0.0, 0.0, 20.0]]
+        result = source.sweep(points, 500, filename="temp_sweep.h5")
+        os.remove("temp_sweep.h5")
+        self.assertEqual(result.efficiencies.shape, (2, 10))
+        self.assertEqual(result.std_errors.shape, (2, 10))
+        self.assertTrue(np.allclose(result.efficiencies[0], efficiencies.data[1], rtol=0., atol=1E-10))
+        self.assertTrue(np.all(result.efficiencies[1] <= result.efficiencies[0] + 1E-10))
+
+    def test_source_shard(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        with self.assertRaises(ValueError):
+            source.get_transmission_efficiencies_shard(-1, 500, 0, 2)
+        source.set_seed(12345)
+        with self.assertRaises(ValueError):
+            source.get_transmission_efficiencies_shard(-1, 500, 2, 2)
+        with self.assertRaises(ValueError):
+            source.merge_shards([])
+
+        efficiencies = source.get_transmission_efficiencies(-1, 500)
+        filenames = ["temp_shard0.h5", "temp_shard1.h5"]
+        for i, filename in enumerate(filenames):
+            source.get_transmission_efficiencies_shard(-1, 500, i, 2).write_hdf5(filename)
+        with self.assertRaises(ValueError):
+            source.merge_shards(filenames[:1])
+        merged = source.merge_shards(filenames)
+        for filename in filenames:
+            os.remove(filename)
+        self.assertTrue(np.allclose(merged.data[1], efficiencies.data[1], rtol=0., atol=1E-10))
+        self.assertTrue(np.allclose(merged.std_errors, efficiencies.std_errors, rtol=0., atol=1E-10))
+
+    def test_source_iter_transmission(self):
+        source = polycap.Source(TestPolycapPhoton.description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, np.linspace(1, 25.0, 10))
+        with self.assertRaises(ValueError):
+            next(source.iter_transmission(0, 1000))
+        with self.assertRaises(ValueError):
+            next(source.iter_transmission(1000, 0))
+
+        batches = list(source.iter_transmission(2500, 1000, leak_calc=False))
+        self.assertEqual(len(batches), 3)
+        self.assertEqual([batch.n_photons for batch in batches], [1000, 2000, 2500])
+        self.assertEqual(batches[2].transmission_efficiencies.exit_coords_array.shape, (500, 3))
+        efficiencies = [batch.transmission_efficiencies.data[1] for batch in batches]
+        n_start = [batch.transmission_efficiencies.n_start for batch in batches]
+        self.assertTrue(all(n >= 1000 for n in n_start[:2]))
+        expected = (efficiencies[0] * n_start[0] + efficiencies[1] * n_start[1] + efficiencies[2] * n_start[2]) / sum(n_start)
+        self.assertTrue(np.allclose(batches[2].running_efficiencies, expected))
+        self.assertTrue(np.array_equal(batches[0].running_efficiencies, efficiencies[0]))
+
+        # with a seed the batches trace disjoint photon ranges, and together reproduce a single seeded simulation
+        source.set_seed(12345)
+        batches = list(source.iter_transmission(2500, 1000, leak_calc=False))
+        self.assertEqual([batch.n_photons for batch in batches], [833, 1667, 2500])
+        self.assertFalse(np.array_equal(batches[0].transmission_efficiencies.exit_coords_array, batches[1].transmission_efficiencies.exit_coords_array[:833]))
+        single = source.get_transmission_efficiencies(-1, 2500, leak_calc=False)
+        self.assertEqual(sum(batch.transmission_efficiencies.n_start for batch in batches), single.n_start)
+        self.assertTrue(np.allclose(batches[2].running_efficiencies, single.data[1]))
+
+        # stopping early should not leave the background simulation running
+        for batch in source.iter_transmission(5000, 1000):
+            break
+        self.assertEqual(batch.n_photons, 1000)
+
 if __name__ == '__main__':
     logging.basicConfig(stream=sys.stderr)
     logging.getLogger('polycap').setLevel(logging.DEBUG)
@@ -162,6 +162,19 @@ void test_polycap_source_new_from_file() {
 	polycap_source_free(source2);
 }
 
+struct progress_data {
+	int n_calls;
+	double last_value;
+};
+
+void progress_set_value(double value, void *user_data) {
+	struct progress_data *data = user_data;
+	assert(value >= data->last_value);
+	assert(value <= 1.);
+	data->n_calls++;
+	data->last_value = value;
+}
+
 void test_polycap_source_get_transmission_efficiencies() {
 	polycap_error *error = NULL;
 	polycap_profile *profile;
@@ -198,6 +211,21 @@ void test_polycap_source_get_transmission_efficiencies() {
 	assert(efficiencies != NULL);
 	polycap_transmission_efficiencies_free(efficiencies);
 
+	//Same with a progress monitor
+	struct progress_data data = {0, 0.};
+	polycap_progress_monitor *progress_monitor = polycap_progress_monitor_new(NULL, &data, &error);
+	assert(progress_monitor == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	progress_monitor = polycap_progress_monitor_new(progress_set_value, &data, &error);
+	assert(progress_monitor != NULL);
+	efficiencies = polycap_source_get_transmission_efficiencies(source, 1, 5, false, progress_monitor, &error);
+	assert(efficiencies != NULL);
+	assert(data.n_calls > 1);
+	assert(data.last_value == 1.);
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_progress_monitor_free(progress_monitor);
+
 	//Now we test actual values
 	//This will take a while...
 	polycap_clear_error(&error);
@@ -286,6 +314,55 @@ printf("eff0: %lf, eff1: %lf, eff2: %lf, eff3: %lf, eff4: %lf, eff5: %lf, eff6:
 	}
 	polycap_free(exit_weights);
 
+	// test get_start_buffers and get_exit_buffers functions: these should refer to the same data as returned by get_start_data and get_exit_data
+	polycap_clear_error(&error);
+	int64_t stride=0;
+	const double *start_coords_buf=NULL, *start_direction_buf=NULL, *start_elecv_buf=NULL, *src_start_coords_buf=NULL;
+	assert(!polycap_transmission_efficiencies_get_start_buffers(NULL, &n_start, &n_exit, &stride, &start_coords_buf, &start_direction_buf, &start_elecv_buf, &src_start_coords_buf, &error));
+	assert(error->code == POLYCAP_ERROR_INVALID_ARGUMENT);
+	polycap_clear_error(&error);
+	assert(polycap_transmission_efficiencies_get_start_buffers(efficiencies, &n_start, &n_exit, &stride, &start_coords_buf, &start_direction_buf, &start_elecv_buf, &src_start_coords_buf, &error) == true);
+	assert(n_exit == 30000);
+	assert(stride >= n_exit);
+	assert(polycap_transmission_efficiencies_get_start_data(efficiencies, &n_start, &n_exit, &start_coords, &start_direction, &start_elecv, &src_start_coords, &error) == true);
+	for(i=0; i<n_exit; i++){
+		assert(start_coords_buf[i] == start_coords[i].x);
+		assert(start_coords_buf[i+stride] == start_coords[i].y);
+		assert(start_coords_buf[i+stride*2] == start_coords[i].z);
+		assert(start_direction_buf[i+stride*2] == start_direction[i].z);
+		assert(start_elecv_buf[i+stride] == start_elecv[i].y);
+		assert(src_start_coords_buf[i] == src_start_coords[i].x);
+	}
+	polycap_free(start_coords);
+	polycap_free(start_direction);
+	polycap_free(start_elecv);
+	polycap_free(src_start_coords);
+	const double *exit_coords_buf=NULL, *exit_direction_buf=NULL, *exit_elecv_buf=NULL, *d_travel_buf=NULL, *exit_weights_buf=NULL;
+	const int64_t *n_refl_buf=NULL;
+	assert(polycap_transmission_efficiencies_get_exit_buffers(efficiencies, &n_exit, &stride, &exit_coords_buf, &exit_direction_buf, &exit_elecv_buf, &n_refl_buf, &d_travel_buf, &n_energies, &exit_weights_buf, &error) == true);
+	assert(n_exit == 30000);
+	assert(n_energies == 7);
+	polycap_transmission_efficiencies_get_exit_data(efficiencies, &n_exit, &exit_coords, &exit_direction, &exit_elecv, &n_refl, &d_travel, &n_energies, &exit_weights, &error);
+	for(i=0; i<n_exit; i++){
+		assert(exit_coords_buf[i] == exit_coords[i].x);
+		assert(exit_coords_buf[i+stride*2] == exit_coords[i].z);
+		assert(exit_direction_buf[i+stride] == exit_direction[i].y);
+		assert(exit_direction_buf[i+stride*2] == exit_direction[i].z);
+		assert(exit_elecv_buf[i+stride*2] == exit_elecv[i].z);
+		assert(n_refl_buf[i] == n_refl[i]);
+		assert(d_travel_buf[i] == d_travel[i]);
+		assert(exit_weights_buf[i*n_energies+6] == exit_weights[i][6]);
+	}
+	polycap_free(exit_coords);
+	polycap_free(exit_direction);
+	polycap_free(exit_elecv);
+	polycap_free(d_travel);
+	polycap_free(n_refl);
+	for(i=0; i<n_exit; i++){
+		polycap_free(exit_weights[i]);
+	}
+	polycap_free(exit_weights);
+
 	// Try writing
 	assert(!polycap_transmission_efficiencies_write_hdf5(efficiencies, NULL, &error));
 	assert(error->code == POLYCAP_ERROR_INVALID_ARGUMENT);
@@ -344,12 +421,512 @@ printf("eff0: %lf, eff1: %lf, eff2: %lf, eff3: %lf, eff4: %lf, eff5: %lf, eff6:
 	polycap_source_free(source);
 }
 
+void test_polycap_source_get_transmission_efficiencies_converged() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	size_t selected[1] = {1}, bad_selected[1] = {7}, n_energies, i;
+	double *uncertainties, *std_errors;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	//Something that shouldn't work
+	efficiencies = polycap_source_get_transmission_efficiencies_converged(NULL, -1, 30000, 0.05, 1, selected, false, NULL, &error);
+	assert(efficiencies == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	efficiencies = polycap_source_get_transmission_efficiencies_converged(source, -1, 30000, 0., 1, selected, false, NULL, &error);
+	assert(efficiencies == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	efficiencies = polycap_source_get_transmission_efficiencies_converged(source, -1, 30000, 0.05, 1, NULL, false, NULL, &error);
+	assert(efficiencies == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	efficiencies = polycap_source_get_transmission_efficiencies_converged(source, -1, 30000, 0.05, 1, bad_selected, false, NULL, &error);
+	assert(efficiencies == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_transmission_efficiencies_get_uncertainties(NULL, &n_energies, &uncertainties, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//This should stop well before 30000 photons are transmitted
+	efficiencies = polycap_source_get_transmission_efficiencies_converged(source, -1, 30000, 0.05, 1, selected, false, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(efficiencies->images->i_exit > 0);
+	assert(efficiencies->images->i_exit < 30000);
+	assert(polycap_transmission_efficiencies_get_uncertainties(efficiencies, &n_energies, &uncertainties, &error));
+	assert(n_energies == 7);
+	assert(uncertainties[1] > 0.);
+	assert(uncertainties[1] <= 0.06);
+	polycap_free(uncertainties);
+	polycap_transmission_efficiencies_free(efficiencies);
+
+	//The uncertainties are available for regular simulations too
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 1000, false, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(efficiencies->images->i_exit == 1000);
+	assert(polycap_transmission_efficiencies_get_uncertainties(efficiencies, &n_energies, &uncertainties, &error));
+	assert(uncertainties[1] > 0.);
+	assert(!polycap_transmission_efficiencies_get_std_errors(NULL, &n_energies, &std_errors, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_transmission_efficiencies_get_std_errors(efficiencies, &n_energies, &std_errors, &error));
+	assert(n_energies == 7);
+	for(i=0; i < n_energies; i++){
+		assert(std_errors[i] >= 0.);
+		if (efficiencies->efficiencies[i] > 0.)
+			assert(fabs(std_errors[i] - uncertainties[i] * efficiencies->efficiencies[i]) <= 1E-12);
+	}
+	polycap_free(std_errors);
+	polycap_free(uncertainties);
+	polycap_transmission_efficiencies_free(efficiencies);
+
+	polycap_source_free(source);
+}
+
+void test_polycap_source_reweight() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description, *description_si, *variants[2];
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	int iz_si[1]={14};
+	double wi_si[1]={1.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	double energies_sub[2]={5,20};
+	double bad_energies[1]={150};
+	double *weights, *new_efficiencies, *variant_efficiencies;
+	int64_t j;
+	size_t i;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	description_si = polycap_description_new(profile, 0.0, 200000, 1, iz_si, wi_si, 2.33, &error);
+	assert(description_si != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	variants[0] = description;
+	variants[1] = description_si;
+
+	//Something that shouldn't work
+	assert(!polycap_source_set_record_histories(NULL, true, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_transmission_efficiencies_reweight(NULL, NULL, 7, energies, &weights, &new_efficiencies, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	//histories are not recorded by default
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 100, false, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(!polycap_transmission_efficiencies_reweight(efficiencies, NULL, 7, energies, &weights, &new_efficiencies, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	polycap_transmission_efficiencies_free(efficiencies);
+
+	assert(polycap_source_set_record_histories(source, true, &error));
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 1000, false, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(!polycap_transmission_efficiencies_reweight(efficiencies, NULL, 1, bad_energies, &weights, &new_efficiencies, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//reweighting at the simulated energies reproduces the simulation
+	assert(polycap_transmission_efficiencies_reweight(efficiencies, NULL, 7, energies, &weights, &new_efficiencies, &error));
+	for(i=0; i < 7; i++){
+		assert(fabs(new_efficiencies[i] - efficiencies->efficiencies[i]) <= 1E-10);
+		for(j=0; j < efficiencies->images->i_exit; j++)
+			assert(fabs(weights[j*7+i] - efficiencies->images->exit_coord_weights[j*7+i]) <= 1E-10);
+	}
+	polycap_free(weights);
+	polycap_free(new_efficiencies);
+
+	//as well as any subset of them
+	assert(polycap_transmission_efficiencies_reweight(efficiencies, NULL, 2, energies_sub, NULL, &new_efficiencies, &error));
+	assert(fabs(new_efficiencies[0] - efficiencies->efficiencies[1]) <= 1E-10);
+	assert(fabs(new_efficiencies[1] - efficiencies->efficiencies[4]) <= 1E-10);
+	polycap_free(new_efficiencies);
+
+	//another capillary material
+	assert(polycap_transmission_efficiencies_reweight(efficiencies, description_si, 7, energies, NULL, &new_efficiencies, &error));
+	for(i=0; i < 7; i++){
+		assert(new_efficiencies[i] >= 0.);
+		assert(new_efficiencies[i] <= 1.);
+	}
+
+	//several capillary materials at once
+	assert(!polycap_transmission_efficiencies_reweight_materials(efficiencies, 0, variants, &variant_efficiencies, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_transmission_efficiencies_reweight_materials(efficiencies, 2, NULL, &variant_efficiencies, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_transmission_efficiencies_reweight_materials(efficiencies, 2, variants, &variant_efficiencies, &error));
+	for(i=0; i < 7; i++){
+		assert(fabs(variant_efficiencies[i] - efficiencies->efficiencies[i]) <= 1E-10);
+		assert(fabs(variant_efficiencies[7+i] - new_efficiencies[i]) <= 1E-10);
+	}
+	polycap_free(variant_efficiencies);
+	polycap_free(new_efficiencies);
+	polycap_transmission_efficiencies_free(efficiencies);
+
+	polycap_description_free(description);
+	polycap_description_free(description_si);
+	polycap_source_free(source);
+}
+
+void test_polycap_source_single_precision() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies, *efficiencies_single;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	int i;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	//Something that shouldn't work
+	assert(!polycap_source_set_single_precision(NULL, true, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//with the same seed, the efficiencies in single precision agree with those in double precision within their standard errors
+	assert(polycap_source_set_seed(source, 12345, &error));
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 1000, false, NULL, &error);
+	assert(efficiencies != NULL);
+	assert(polycap_source_set_single_precision(source, true, &error));
+	efficiencies_single = polycap_source_get_transmission_efficiencies(source, -1, 1000, false, NULL, &error);
+	assert(efficiencies_single != NULL);
+	for(i=0; i < 7; i++){
+		assert(efficiencies_single->efficiencies[i] > 0.);
+		assert(fabs(efficiencies_single->efficiencies[i] - efficiencies->efficiencies[i]) <= 3.*sqrt(efficiencies->std_errors[i]*efficiencies->std_errors[i] + efficiencies_single->std_errors[i]*efficiencies_single->std_errors[i]));
+	}
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_transmission_efficiencies_free(efficiencies_single);
+	polycap_source_free(source);
+}
+
+void test_polycap_source_sweep() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies, *efficiencies_seeded;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	polycap_sweep_point points[3] = {
+		{2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0},
+		{2000.0, 0.2065, 0.2065, 0.01, 0.0, 0.0},
+		{2000.0, 0.2065, 0.2065, 0.0, 0.0, 20.0},
+	};
+	polycap_sweep_point bad_points[1] = {{-1.0, 0.2065, 0.2065, 0.0, 0.0, 0.0}};
+	double *sweep_efficiencies, *sweep_std_errors;
+	size_t i;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	//Something that shouldn't work
+	assert(!polycap_source_set_seed(NULL, 12345, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_source_sweep(NULL, 3, points, -1, 500, false, NULL, &sweep_efficiencies, &sweep_std_errors, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_source_sweep(source, 0, points, -1, 500, false, NULL, &sweep_efficiencies, &sweep_std_errors, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(!polycap_source_sweep(source, 1, bad_points, -1, 500, false, NULL, &sweep_efficiencies, &sweep_std_errors, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//with a fixed seed the results do not depend on the amount of threads
+	assert(polycap_source_set_seed(source, 12345, &error));
+	efficiencies = polycap_source_get_transmission_efficiencies(source, 1, 500, false, NULL, &error);
+	assert(efficiencies != NULL);
+	efficiencies_seeded = polycap_source_get_transmission_efficiencies(source, -1, 500, false, NULL, &error);
+	assert(efficiencies_seeded != NULL);
+	for(i=0; i < 7; i++)
+		assert(fabs(efficiencies->efficiencies[i] - efficiencies_seeded->efficiencies[i]) <= 1E-10);
+	polycap_transmission_efficiencies_free(efficiencies_seeded);
+
+	//the grid point equal to the source reproduces the seeded simulation
+	assert(polycap_source_sweep(source, 3, points, -1, 500, false, NULL, &sweep_efficiencies, &sweep_std_errors, &error));
+	for(i=0; i < 7; i++){
+		assert(fabs(sweep_efficiencies[i] - efficiencies->efficiencies[i]) <= 1E-10);
+		assert(sweep_std_errors[i] >= 0.);
+		assert(sweep_efficiencies[7+i] >= 0.);
+		//roughness can only decrease the efficiencies of the same photons
+		assert(sweep_efficiencies[14+i] <= sweep_efficiencies[i] + 1E-10);
+	}
+	polycap_transmission_efficiencies_free(efficiencies);
+
+	assert(!polycap_source_sweep_write_hdf5(source, 3, points, sweep_efficiencies, sweep_std_errors, NULL, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_source_sweep_write_hdf5(source, 3, points, sweep_efficiencies, sweep_std_errors, "temp_sweep.h5", &error));
+#ifdef HAVE__UNLINK
+	_unlink("temp_sweep.h5"); // cleanup
+#elif defined(HAVE_UNLINK)
+	unlink("temp_sweep.h5"); // cleanup
+#endif
+	polycap_free(sweep_efficiencies);
+	polycap_free(sweep_std_errors);
+
+	polycap_source_free(source);
+}
+
+void test_polycap_source_shard() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies, *shard, *merged;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	const char *filenames[3] = {"temp_shard2.h5", "temp_shard0.h5", "temp_shard1.h5"};
+	const char *single_filename[1] = {"temp_single.h5"};
+	int64_t n_exit, n_exit_merged, j, k;
+	polycap_vector3 *exit_coords, *exit_direction, *exit_elecv;
+	polycap_vector3 *exit_coords_merged, *exit_direction_merged, *exit_elecv_merged;
+	int64_t *n_refl, *n_refl_merged;
+	double *d_travel, *d_travel_merged;
+	double **exit_weights, **exit_weights_merged;
+	size_t n_energies;
+	int i;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, 0.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	//Something that shouldn't work
+	assert(polycap_source_get_transmission_efficiencies_shard(source, -1, 500, 0, 3, false, NULL, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_source_set_seed(source, 12345, &error));
+	assert(polycap_source_get_transmission_efficiencies_shard(NULL, -1, 500, 0, 3, false, NULL, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_source_get_transmission_efficiencies_shard(source, -1, 500, 3, 3, false, NULL, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_source_get_transmission_efficiencies_shard(source, -1, 2, 0, 3, false, NULL, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_transmission_efficiencies_merge(NULL, 3, filenames, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+	assert(polycap_transmission_efficiencies_merge(source, 0, filenames, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//a single seeded simulation
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 12, true, NULL, &error);
+	assert(efficiencies != NULL);
+	//which is not a shard
+	assert(polycap_transmission_efficiencies_write_hdf5(efficiencies, single_filename[0], &error));
+	assert(polycap_transmission_efficiencies_merge(source, 1, single_filename, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//the same simulation split in three shards
+	for(i=0; i < 3; i++){
+		shard = polycap_source_get_transmission_efficiencies_shard(source, i+1, 12, i, 3, true, NULL, &error);
+		assert(shard != NULL);
+		assert(shard->images->i_exit == (12*(i+1))/3 - (12*i)/3);
+		assert(polycap_transmission_efficiencies_write_hdf5(shard, filenames[(i+1)%3], &error));
+		polycap_transmission_efficiencies_free(shard);
+	}
+
+	//all shards are required
+	assert(polycap_transmission_efficiencies_merge(source, 2, filenames, &error) == NULL);
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//merging the shards reproduces the single simulation
+	merged = polycap_transmission_efficiencies_merge(source, 3, filenames, &error);
+	assert(merged != NULL);
+	assert(merged->images->i_start == efficiencies->images->i_start);
+	assert(merged->images->i_exit == efficiencies->images->i_exit);
+	assert(merged->images->i_extleak == efficiencies->images->i_extleak);
+	assert(merged->images->i_intleak == efficiencies->images->i_intleak);
+	for(i=0; i < 7; i++){
+		assert(fabs(merged->efficiencies[i] - efficiencies->efficiencies[i]) <= 1E-10);
+		assert(fabs(merged->std_errors[i] - efficiencies->std_errors[i]) <= 1E-10);
+	}
+	//including the z components of the exit directions and electric vectors, which the shard files store separately
+	//	the photons may have been stored in a different order by the threads, so they are matched on their exit coordinates
+	assert(polycap_transmission_efficiencies_get_exit_data(efficiencies, &n_exit, &exit_coords, &exit_direction, &exit_elecv, &n_refl, &d_travel, &n_energies, &exit_weights, &error));
+	assert(polycap_transmission_efficiencies_get_exit_data(merged, &n_exit_merged, &exit_coords_merged, &exit_direction_merged, &exit_elecv_merged, &n_refl_merged, &d_travel_merged, &n_energies, &exit_weights_merged, &error));
+	assert(n_exit_merged == n_exit);
+	for(j=0; j < n_exit_merged; j++){
+		for(k=0; k < n_exit; k++){
+			if(exit_coords[k].x == exit_coords_merged[j].x && exit_coords[k].y == exit_coords_merged[j].y)
+				break;
+		}
+		assert(k < n_exit);
+		assert(exit_direction_merged[j].z == exit_direction[k].z);
+		assert(exit_elecv_merged[j].z == exit_elecv[k].z);
+	}
+	for(j=0; j < n_exit; j++){
+		polycap_free(exit_weights[j]);
+		polycap_free(exit_weights_merged[j]);
+	}
+	polycap_free(exit_coords);
+	polycap_free(exit_direction);
+	polycap_free(exit_elecv);
+	polycap_free(n_refl);
+	polycap_free(d_travel);
+	polycap_free(exit_weights);
+	polycap_free(exit_coords_merged);
+	polycap_free(exit_direction_merged);
+	polycap_free(exit_elecv_merged);
+	polycap_free(n_refl_merged);
+	polycap_free(d_travel_merged);
+	polycap_free(exit_weights_merged);
+	assert(polycap_transmission_efficiencies_write_hdf5(merged, "temp_merged.h5", &error));
+	polycap_transmission_efficiencies_free(merged);
+	polycap_transmission_efficiencies_free(efficiencies);
+
+#ifdef HAVE__UNLINK
+	_unlink("temp_single.h5"); // cleanup
+	_unlink("temp_merged.h5");
+	for(i=0; i < 3; i++)
+		_unlink(filenames[i]);
+#elif defined(HAVE_UNLINK)
+	unlink("temp_single.h5"); // cleanup
+	unlink("temp_merged.h5");
+	for(i=0; i < 3; i++)
+		unlink(filenames[i]);
+#endif
+
+	polycap_source_free(source);
+}
+
+void test_polycap_source_get_leak_buffers() {
+	polycap_error *error = NULL;
+	polycap_profile *profile;
+	polycap_description *description;
+	polycap_source *source;
+	polycap_transmission_efficiencies *efficiencies;
+	polycap_leak **leaks;
+	int iz[2]={8,14};
+	double wi[2]={53.0,47.0};
+	double energies[7]={1,5,10,15,20,25,30};
+	int64_t i, n_leaks, n_leaks_buf;
+	size_t n_energies;
+	const double *coords, *direction, *elecv, *weights;
+	const int64_t *n_refl;
+
+	profile = polycap_profile_new(POLYCAP_PROFILE_ELLIPSOIDAL, 9., 0.2065, 0.0585, 0.00035, 9.9153E-5, 1000.0, 0.5, &error);
+	assert(profile != NULL);
+	description = polycap_description_new(profile, 0.0, 200000, 2, iz, wi, 2.23, &error);
+	assert(description != NULL);
+	polycap_profile_free(profile);
+	source = polycap_source_new(description, 2000.0, 0.2065, 0.2065, -1.0, 0.0, 0.0, 0.0, 0.5, 7, energies, &error);
+	assert(source != NULL);
+	polycap_description_free(description);
+
+	efficiencies = polycap_source_get_transmission_efficiencies(source, -1, 30, true, NULL, &error);
+	assert(efficiencies != NULL);
+
+	//Something that shouldn't work
+	assert(!polycap_transmission_efficiencies_get_extleak_buffers(NULL, &n_leaks_buf, &coords, &direction, &elecv, &n_refl, &n_energies, &weights, &error));
+	assert(polycap_error_matches(error, POLYCAP_ERROR_INVALID_ARGUMENT));
+	polycap_clear_error(&error);
+
+	//the buffers should contain the same data as returned by get_extleak_data and get_intleak_data
+	assert(polycap_transmission_efficiencies_get_extleak_buffers(efficiencies, &n_leaks_buf, &coords, &direction, &elecv, &n_refl, &n_energies, &weights, &error));
+	assert(n_leaks_buf == efficiencies->images->i_extleak);
+	assert(n_energies == 7);
+	if (n_leaks_buf > 0) {
+		assert(polycap_transmission_efficiencies_get_extleak_data(efficiencies, &leaks, &n_leaks, &error));
+		assert(n_leaks == n_leaks_buf);
+		for(i=0; i<n_leaks; i++){
+			assert(coords[i] == leaks[i]->coords.x);
+			assert(coords[i+n_leaks] == leaks[i]->coords.y);
+			assert(coords[i+n_leaks*2] == leaks[i]->coords.z);
+			assert(direction[i+n_leaks*2] == leaks[i]->direction.z);
+			assert(elecv[i+n_leaks] == leaks[i]->elecv.y);
+			assert(n_refl[i] == leaks[i]->n_refl);
+			assert(weights[i*n_energies+6] == leaks[i]->weight[6]);
+			polycap_leak_free(leaks[i]);
+		}
+		polycap_free(leaks);
+	}
+	assert(polycap_transmission_efficiencies_get_intleak_buffers(efficiencies, &n_leaks_buf, &coords, &direction, &elecv, &n_refl, &n_energies, &weights, &error));
+	assert(n_leaks_buf == efficiencies->images->i_intleak);
+	if (n_leaks_buf > 0) {
+		assert(polycap_transmission_efficiencies_get_intleak_data(efficiencies, &leaks, &n_leaks, &error));
+		assert(n_leaks == n_leaks_buf);
+		for(i=0; i<n_leaks; i++){
+			assert(coords[i+n_leaks] == leaks[i]->coords.y);
+			assert(direction[i] == leaks[i]->direction.x);
+			assert(elecv[i+n_leaks*2] == leaks[i]->elecv.z);
+			assert(n_refl[i] == leaks[i]->n_refl);
+			assert(weights[i*n_energies] == leaks[i]->weight[0]);
+			polycap_leak_free(leaks[i]);
+		}
+		polycap_free(leaks);
+	}
+
+	polycap_transmission_efficiencies_free(efficiencies);
+	polycap_source_free(source);
+}
+
 int main(int argc, char *argv[]) {
 
 	test_polycap_source_get_photon();
 	test_polycap_source_new();
 	test_polycap_source_new_from_file();
 	test_polycap_source_get_transmission_efficiencies();
+	test_polycap_source_get_transmission_efficiencies_converged();
+	test_polycap_source_reweight();
+	test_polycap_source_single_precision();
+	test_polycap_source_sweep();
+	test_polycap_source_shard();
+	test_polycap_source_get_leak_buffers();
 
 
 	return 0;